@@ -0,0 +1,748 @@
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../include/basic_math.h"
+#include "../include/matrix_batch.h"
+#include "../include/matrix_lu.h"
+#include "../include/matrix_math.h"
+#include "../include/thread_pool.h"
+#include "../include/typed_math.h"
+#include "../include/vector_expr.h"
+#include "../include/vector_kernels.h"
+#include "../include/vector_math.h"
+
+// Micro-benchmark driver for the math library
+// Every case is swept over power-of-two sizes. Each sample runs the
+// operation enough times to take at least BENCH_SAMPLE_NS, and the reported
+// time per operation is the median (and 99th percentile) over the samples.
+
+#define BENCH_SAMPLE_NS 200000.0
+#define BENCH_MAX_SAMPLES 1000
+
+typedef enum { FORMAT_TABLE, FORMAT_CSV, FORMAT_JSON } OutputFormat;
+
+// Operands for one case at one size; n is the vector length, the matrix
+// order or the batch count
+typedef struct {
+    int n;
+    Vector x, y, z;
+    Matrix a, b, c;
+    MatrixLU lu;
+    SparseMatrix s;
+    VectorF32 fx, fy;
+    MatrixF32 fa, fb, fc;
+    MatrixBatch ba, bb, bc;
+    double scalar;
+} BenchData;
+
+typedef struct {
+    const char *name;
+    // Largest size swept unless --full is given
+    int max_n;
+    int (*setup)(BenchData *d);
+    int (*run)(BenchData *d);
+    double (*flops)(double n);
+    double (*bytes)(double n);
+} BenchCase;
+
+typedef struct {
+    int min_n;
+    int max_n;
+    int full;
+    int samples;
+    int warmup;
+    int cpu;
+    int threads;
+    const char *filter;
+    OutputFormat format;
+} BenchOptions;
+
+static double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static void bench_fill(double *data, size_t count, unsigned seed) {
+    for (size_t i = 0; i < count; i++) {
+        seed = seed * 1103515245u + 12345u;
+        data[i] = (double)(seed >> 16 & 0x7fff) / 32768.0 - 0.5;
+    }
+}
+
+static void bench_fill_matrix(Matrix *m, unsigned seed) {
+    for (int i = 0; i < m->rows; i++) {
+        bench_fill(MATRIX_ROW(m, i), (size_t)m->cols, seed + (unsigned)i);
+    }
+}
+
+// Setup helpers --------------------------------------------------------------
+
+static int setup_vectors(BenchData *d) {
+    if (vector_create(d->n, &d->x) != SUCCESS ||
+        vector_create(d->n, &d->y) != SUCCESS ||
+        vector_create(d->n, &d->z) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    bench_fill(d->x.data, (size_t)d->n, 1);
+    bench_fill(d->y.data, (size_t)d->n, 2);
+    d->scalar = 1.0000001;
+    return SUCCESS;
+}
+
+static int setup_matrices(BenchData *d) {
+    if (matrix_create(d->n, d->n, &d->a) != SUCCESS ||
+        matrix_create(d->n, d->n, &d->b) != SUCCESS ||
+        matrix_create(d->n, d->n, &d->c) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    bench_fill_matrix(&d->a, 3);
+    bench_fill_matrix(&d->b, 4);
+    d->scalar = 1.0000001;
+    return SUCCESS;
+}
+
+// Positive bases keep power_n on its vector path
+static int setup_powers(BenchData *d) {
+    if (setup_vectors(d) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    for (int i = 0; i < d->n; i++) {
+        d->x.data[i] += 1.0;
+    }
+    return SUCCESS;
+}
+
+static int setup_gemv(BenchData *d) {
+    if (setup_vectors(d) != SUCCESS ||
+        matrix_create(d->n, d->n, &d->a) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    bench_fill_matrix(&d->a, 3);
+    return SUCCESS;
+}
+
+static int setup_lu(BenchData *d) {
+    if (setup_matrices(d) != SUCCESS ||
+        matrix_lu_create(d->n, &d->lu) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    // Diagonal dominance keeps pivoting cheap and the factors finite
+    for (int i = 0; i < d->n; i++) {
+        MATRIX_AT(&d->a, i, i) += d->n;
+    }
+    return SUCCESS;
+}
+
+// Banded matrix with 9 nonzeros per row
+static int setup_sparse(BenchData *d) {
+    if (setup_vectors(d) != SUCCESS ||
+        matrix_create(d->n, d->n, &d->a) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    for (int i = 0; i < d->n; i++) {
+        for (int j = i - 4; j <= i + 4; j++) {
+            if (j >= 0 && j < d->n) {
+                MATRIX_AT(&d->a, i, j) = 1.0 + 0.01 * (i - j);
+            }
+        }
+    }
+    return sparse_matrix_from_dense(&d->a, SPARSE_CSR, &d->s);
+}
+
+static int setup_f32_vectors(BenchData *d) {
+    if (setup_vectors(d) != SUCCESS ||
+        vector_f32_create(d->n, &d->fx) != SUCCESS ||
+        vector_f32_create(d->n, &d->fy) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    vector_f32_from_double(&d->x, &d->fx);
+    vector_f32_from_double(&d->y, &d->fy);
+    return SUCCESS;
+}
+
+static int setup_f32_matrices(BenchData *d) {
+    if (setup_matrices(d) != SUCCESS ||
+        matrix_f32_create(d->n, d->n, &d->fa) != SUCCESS ||
+        matrix_f32_create(d->n, d->n, &d->fb) != SUCCESS ||
+        matrix_f32_create(d->n, d->n, &d->fc) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    matrix_f32_from_double(&d->a, &d->fa);
+    matrix_f32_from_double(&d->b, &d->fb);
+    return SUCCESS;
+}
+
+// n 4x4 matrices per operand
+static int setup_batches(BenchData *d) {
+    if (matrix_batch_create(4, d->n, &d->ba) != SUCCESS ||
+        matrix_batch_create(4, d->n, &d->bb) != SUCCESS ||
+        matrix_batch_create(4, d->n, &d->bc) != SUCCESS) {
+        return ERROR_NULL_POINTER;
+    }
+    bench_fill(d->ba.data, (size_t)16 * (size_t)d->ba.stride, 5);
+    bench_fill(d->bb.data, (size_t)16 * (size_t)d->bb.stride, 6);
+    return SUCCESS;
+}
+
+static void bench_data_free(BenchData *d) {
+    vector_free(&d->x);
+    vector_free(&d->y);
+    vector_free(&d->z);
+    matrix_free(&d->a);
+    matrix_free(&d->b);
+    matrix_free(&d->c);
+    if (d->lu.pivots != NULL) {
+        matrix_lu_free(&d->lu);
+    }
+    if (d->s.offsets != NULL) {
+        sparse_matrix_free(&d->s);
+    }
+    vector_f32_free(&d->fx);
+    vector_f32_free(&d->fy);
+    matrix_f32_free(&d->fa);
+    matrix_f32_free(&d->fb);
+    matrix_f32_free(&d->fc);
+    matrix_batch_free(&d->ba);
+    matrix_batch_free(&d->bb);
+    matrix_batch_free(&d->bc);
+}
+
+// Operations -----------------------------------------------------------------
+// Each returns the status of the call it times; bench_one checks it once
+// before timing
+
+static int run_vector_add(BenchData *d) {
+    return vector_add_into(&d->x, &d->y, &d->z);
+}
+
+static int run_vector_subtract(BenchData *d) {
+    return vector_subtract_into(&d->x, &d->y, &d->z);
+}
+
+static int run_vector_scale(BenchData *d) {
+    return vector_scale_into(&d->x, d->scalar, &d->z);
+}
+
+static int run_vector_axpy(BenchData *d) {
+    return vector_axpy(1e-9, &d->x, &d->y);
+}
+
+static int run_vector_dot(BenchData *d) {
+    double result;
+    int status = vector_dot_product(&d->x, &d->y, &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_vector_sum(BenchData *d) {
+    double result;
+    int status = vector_sum(&d->x, &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_vector_magnitude(BenchData *d) {
+    double result;
+    int status = vector_magnitude(&d->x, &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_vector_dot_compensated(BenchData *d) {
+    double result;
+    int status = vector_dot_product_mode(&d->x, &d->y, REDUCTION_COMPENSATED,
+                                         &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_vector_normalize(BenchData *d) {
+    return vector_normalize_into(&d->x, &d->z);
+}
+
+// dot(x + y, x) in one fused pass
+static int run_vector_expr_dot(BenchData *d) {
+    VectorExpr e;
+    double result;
+    vector_expr_init(&e);
+    int x = vector_expr_input(&e, &d->x);
+    int sum = vector_expr_add(&e, x, vector_expr_input(&e, &d->y));
+    int status = vector_expr_dot(&e, sum, x, &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_matrix_add(BenchData *d) {
+    return matrix_add_into(&d->a, &d->b, &d->c);
+}
+
+static int run_matrix_subtract(BenchData *d) {
+    return matrix_subtract_into(&d->a, &d->b, &d->c);
+}
+
+static int run_matrix_scale(BenchData *d) {
+    return matrix_scale_into(&d->a, d->scalar, &d->c);
+}
+
+static int run_matrix_transpose(BenchData *d) {
+    return matrix_transpose_into(&d->a, &d->c);
+}
+
+static int run_matrix_transpose_inplace(BenchData *d) {
+    return matrix_transpose_inplace(&d->a);
+}
+
+static int run_matrix_vector(BenchData *d) {
+    return matrix_vector_multiply_into(&d->a, &d->x, &d->z);
+}
+
+static int run_matrix_multiply(BenchData *d) {
+    return matrix_multiply_into(1.0, &d->a, &d->b, 0.0, &d->c);
+}
+
+static int run_matrix_lu(BenchData *d) {
+    return matrix_lu_into(&d->a, &d->lu);
+}
+
+static int run_matrix_determinant(BenchData *d) {
+    double result;
+    int status = matrix_determinant(&d->a, &result);
+    d->scalar = result;
+    return status;
+}
+
+// matrix_inverse allocates its result, so the time includes the
+// allocation and the release
+static int run_matrix_inverse(BenchData *d) {
+    Matrix inverse;
+    int status = matrix_inverse(&d->a, &inverse);
+    if (status == SUCCESS) {
+        matrix_free(&inverse);
+    }
+    return status;
+}
+
+static int run_sparse_vector(BenchData *d) {
+    return sparse_matrix_vector_multiply_into(&d->s, &d->x, &d->z);
+}
+
+static int run_matrix_multiply_batched(BenchData *d) {
+    return matrix_multiply_batched(&d->ba, &d->bb, &d->bc);
+}
+
+static int run_vector_f32_dot(BenchData *d) {
+    float result;
+    int status = vector_f32_dot_product(&d->fx, &d->fy, &result);
+    d->scalar = result;
+    return status;
+}
+
+static int run_matrix_f32_multiply(BenchData *d) {
+    return matrix_f32_multiply_into(1.0f, &d->fa, &d->fb, 0.0f, &d->fc);
+}
+
+static int run_exp_n(BenchData *d) {
+    return exp_n(d->x.data, d->z.data, (size_t)d->n);
+}
+
+static int run_power_n(BenchData *d) {
+    return power_n(d->x.data, d->y.data, d->z.data, (size_t)d->n);
+}
+
+// Scalar basic_math calls, one per element, on setup_powers operands so
+// divisors are nonzero and bases positive
+
+static int run_add(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        d->z.data[i] = add(d->x.data[i], d->y.data[i]);
+    }
+    return SUCCESS;
+}
+
+static int run_subtract(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        d->z.data[i] = subtract(d->x.data[i], d->y.data[i]);
+    }
+    return SUCCESS;
+}
+
+static int run_multiply(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        d->z.data[i] = multiply(d->x.data[i], d->y.data[i]);
+    }
+    return SUCCESS;
+}
+
+static int run_divide(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        int status = divide(d->y.data[i], d->x.data[i], &d->z.data[i]);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+    return SUCCESS;
+}
+
+static int run_power(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        d->z.data[i] = power(d->x.data[i], d->y.data[i]);
+    }
+    return SUCCESS;
+}
+
+static int run_square_root(BenchData *d) {
+    for (int i = 0; i < d->n; i++) {
+        d->z.data[i] = square_root(d->x.data[i]);
+    }
+    return SUCCESS;
+}
+
+// Operation counts -----------------------------------------------------------
+
+static double flops_none(double n) {
+    (void)n;
+    return 0.0;
+}
+static double flops_n(double n) { return n; }
+static double flops_2n(double n) { return 2.0 * n; }
+static double flops_3n(double n) { return 3.0 * n; }
+static double flops_n2(double n) { return n * n; }
+static double flops_2n2(double n) { return 2.0 * n * n; }
+static double flops_2n3(double n) { return 2.0 * n * n * n; }
+static double flops_lu(double n) { return 2.0 / 3.0 * n * n * n; }
+static double flops_inverse(double n) { return 8.0 / 3.0 * n * n * n; }
+static double flops_batch4(double n) { return 128.0 * n; }
+static double flops_sparse(double n) { return 2.0 * 9.0 * n; }
+
+// Minimum traffic in bytes, assuming every operand streams once
+static double bytes_8n(double n) { return 8.0 * n; }
+static double bytes_16n(double n) { return 16.0 * n; }
+static double bytes_24n(double n) { return 24.0 * n; }
+static double bytes_8n2(double n) { return 8.0 * n * n; }
+static double bytes_16n2(double n) { return 16.0 * n * n; }
+static double bytes_12n2(double n) { return 12.0 * n * n; }
+static double bytes_24n2(double n) { return 24.0 * n * n; }
+static double bytes_batch4(double n) { return 3.0 * 16.0 * 8.0 * n; }
+static double bytes_sparse(double n) { return 9.0 * 12.0 * n + 16.0 * n; }
+
+static const BenchCase bench_cases[] = {
+    {"vector_add", 1 << 22, setup_vectors, run_vector_add, flops_n,
+     bytes_24n},
+    {"vector_subtract", 1 << 22, setup_vectors, run_vector_subtract, flops_n,
+     bytes_24n},
+    {"vector_scale", 1 << 22, setup_vectors, run_vector_scale, flops_n,
+     bytes_16n},
+    {"vector_axpy", 1 << 22, setup_vectors, run_vector_axpy, flops_2n,
+     bytes_24n},
+    {"vector_dot", 1 << 22, setup_vectors, run_vector_dot, flops_2n,
+     bytes_16n},
+    {"vector_sum", 1 << 22, setup_vectors, run_vector_sum, flops_n, bytes_8n},
+    {"vector_magnitude", 1 << 22, setup_vectors, run_vector_magnitude,
+     flops_2n, bytes_8n},
+    {"vector_dot_compensated", 1 << 22, setup_vectors,
+     run_vector_dot_compensated, flops_2n, bytes_16n},
+    {"vector_normalize", 1 << 22, setup_vectors, run_vector_normalize,
+     flops_3n, bytes_16n},
+    {"vector_expr_dot", 1 << 22, setup_vectors, run_vector_expr_dot,
+     flops_3n, bytes_16n},
+    {"exp_n", 1 << 22, setup_vectors, run_exp_n, flops_n, bytes_16n},
+    {"power_n", 1 << 22, setup_powers, run_power_n, flops_n, bytes_24n},
+    {"basic_add", 1 << 22, setup_powers, run_add, flops_n, bytes_24n},
+    {"basic_subtract", 1 << 22, setup_powers, run_subtract, flops_n, bytes_24n},
+    {"basic_multiply", 1 << 22, setup_powers, run_multiply, flops_n, bytes_24n},
+    {"basic_divide", 1 << 22, setup_powers, run_divide, flops_n, bytes_24n},
+    {"basic_power", 1 << 22, setup_powers, run_power, flops_n, bytes_24n},
+    {"basic_square_root", 1 << 22, setup_powers, run_square_root, flops_n,
+     bytes_16n},
+    {"matrix_add", 2048, setup_matrices, run_matrix_add, flops_n2,
+     bytes_24n2},
+    {"matrix_subtract", 2048, setup_matrices, run_matrix_subtract, flops_n2,
+     bytes_24n2},
+    {"matrix_scale", 2048, setup_matrices, run_matrix_scale, flops_n2,
+     bytes_16n2},
+    {"matrix_transpose", 2048, setup_matrices, run_matrix_transpose,
+     flops_none, bytes_16n2},
+    {"matrix_transpose_inplace", 2048, setup_matrices,
+     run_matrix_transpose_inplace, flops_none, bytes_16n2},
+    {"matrix_vector_multiply", 2048, setup_gemv, run_matrix_vector, flops_2n2,
+     bytes_8n2},
+    {"matrix_multiply", 512, setup_matrices, run_matrix_multiply, flops_2n3,
+     bytes_24n2},
+    {"matrix_lu", 512, setup_lu, run_matrix_lu, flops_lu, bytes_16n2},
+    {"matrix_determinant", 512, setup_lu, run_matrix_determinant, flops_lu,
+     bytes_16n2},
+    {"matrix_inverse", 512, setup_lu, run_matrix_inverse, flops_inverse,
+     bytes_24n2},
+    {"matrix_multiply_batched", 1 << 20, setup_batches,
+     run_matrix_multiply_batched, flops_batch4, bytes_batch4},
+    {"sparse_matrix_vector_multiply", 1 << 20, setup_sparse,
+     run_sparse_vector, flops_sparse, bytes_sparse},
+    {"vector_f32_dot", 1 << 22, setup_f32_vectors, run_vector_f32_dot,
+     flops_2n, bytes_8n},
+    {"matrix_f32_multiply", 512, setup_f32_matrices, run_matrix_f32_multiply,
+     flops_2n3, bytes_12n2},
+};
+
+#define BENCH_NUM_CASES ((int)(sizeof(bench_cases) / sizeof(bench_cases[0])))
+
+// Reporting ------------------------------------------------------------------
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int count, double q) {
+    int index = (int)(q * (count - 1) + 0.5);
+    return sorted[index];
+}
+
+static int first_row = 1;
+
+static void report_header(const BenchOptions *opts) {
+    switch (opts->format) {
+        case FORMAT_TABLE:
+            printf("# kernels=%s threads=%d\n", vector_kernels()->name,
+                   thread_pool_size());
+            printf("%-30s %9s %8s %14s %14s %10s %10s\n", "operation", "n",
+                   "iters", "median_ns", "p99_ns", "GFLOP/s", "GB/s");
+            break;
+        case FORMAT_CSV:
+            printf("operation,n,iters,median_ns,p99_ns,gflops,gbps\n");
+            break;
+        case FORMAT_JSON:
+            printf("{\"kernels\": \"%s\", \"threads\": %d, \"results\": [",
+                   vector_kernels()->name, thread_pool_size());
+            break;
+    }
+}
+
+static void report_row(const BenchOptions *opts, const BenchCase *bc, int n,
+                       long iters, double median, double p99) {
+    double gflops = bc->flops(n) / median;
+    double gbps = bc->bytes(n) / median;
+
+    switch (opts->format) {
+        case FORMAT_TABLE:
+            printf("%-30s %9d %8ld %14.1f %14.1f %10.3f %10.3f\n", bc->name,
+                   n, iters, median, p99, gflops, gbps);
+            break;
+        case FORMAT_CSV:
+            printf("%s,%d,%ld,%.1f,%.1f,%.4f,%.4f\n", bc->name, n, iters,
+                   median, p99, gflops, gbps);
+            break;
+        case FORMAT_JSON:
+            printf("%s\n  {\"operation\": \"%s\", \"n\": %d, \"iters\": %ld, "
+                   "\"median_ns\": %.1f, \"p99_ns\": %.1f, \"gflops\": %.4f, "
+                   "\"gbps\": %.4f}",
+                   first_row ? "" : ",", bc->name, n, iters, median, p99,
+                   gflops, gbps);
+            break;
+    }
+    first_row = 0;
+    fflush(stdout);
+}
+
+static void report_footer(const BenchOptions *opts) {
+    if (opts->format == FORMAT_JSON) {
+        printf("\n]}\n");
+    }
+}
+
+// Driver ---------------------------------------------------------------------
+
+static int bench_one(const BenchOptions *opts, const BenchCase *bc, int n) {
+    BenchData d;
+    memset(&d, 0, sizeof(d));
+    d.n = n;
+
+    if (bc->setup(&d) != SUCCESS) {
+        bench_data_free(&d);
+        fprintf(stderr, "%s: setup failed at n=%d\n", bc->name, n);
+        return ERROR_NULL_POINTER;
+    }
+
+    // Calibrate so one sample is long enough for the clock resolution,
+    // after one checked run: a failing case is reported, not timed
+    int status = bc->run(&d);
+    if (status != SUCCESS) {
+        bench_data_free(&d);
+        fprintf(stderr, "%s: failed at n=%d (status %d)\n", bc->name, n,
+                status);
+        return status;
+    }
+
+    for (int i = 0; i < opts->warmup; i++) {
+        bc->run(&d);
+    }
+
+    long iters = 1;
+    for (;;) {
+        double start = bench_now_ns();
+        for (long i = 0; i < iters; i++) {
+            bc->run(&d);
+        }
+        double elapsed = bench_now_ns() - start;
+        if (elapsed >= BENCH_SAMPLE_NS || iters >= (1L << 30)) {
+            break;
+        }
+        iters *= elapsed > 0.0 && BENCH_SAMPLE_NS / elapsed < 16.0
+                     ? (long)(BENCH_SAMPLE_NS / elapsed) + 1
+                     : 16;
+    }
+
+    double times[BENCH_MAX_SAMPLES];
+    for (int s = 0; s < opts->samples; s++) {
+        double start = bench_now_ns();
+        for (long i = 0; i < iters; i++) {
+            bc->run(&d);
+        }
+        times[s] = (bench_now_ns() - start) / (double)iters;
+    }
+
+    qsort(times, (size_t)opts->samples, sizeof(double), compare_doubles);
+    report_row(opts, bc, n, iters, percentile(times, opts->samples, 0.5),
+               percentile(times, opts->samples, 0.99));
+
+    bench_data_free(&d);
+    return SUCCESS;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --min-size=N     smallest size swept (default 8)\n"
+            "  --max-size=N     largest size swept (default 8192)\n"
+            "  --full           ignore per-operation size limits\n"
+            "  --samples=N      timed samples per point (default 15)\n"
+            "  --warmup=N       untimed runs before sampling (default 3)\n"
+            "  --cpu=N          pin the benchmark thread to CPU N\n"
+            "  --threads=N      start the thread pool with N threads\n"
+            "  --filter=TEXT    only run operations whose name contains TEXT\n"
+            "  --format=F       table, csv or json (default table)\n",
+            prog);
+}
+
+// Whole decimal value that fits an int
+static int parse_int(const char *value, int *result) {
+    char *end;
+    errno = 0;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || errno != 0 || parsed < INT_MIN ||
+        parsed > INT_MAX) {
+        return ERROR_INVALID_DIMENSION;
+    }
+    *result = (int)parsed;
+    return SUCCESS;
+}
+
+static int parse_options(int argc, char **argv, BenchOptions *opts) {
+    opts->min_n = 8;
+    opts->max_n = 8192;
+    opts->full = 0;
+    opts->samples = 15;
+    opts->warmup = 3;
+    opts->cpu = -1;
+    opts->threads = 1;
+    opts->filter = NULL;
+    opts->format = FORMAT_TABLE;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = strchr(arg, '=');
+        value = value != NULL ? value + 1 : "";
+        int status = SUCCESS;
+
+        if (strncmp(arg, "--min-size=", 11) == 0) {
+            status = parse_int(value, &opts->min_n);
+        } else if (strncmp(arg, "--max-size=", 11) == 0) {
+            status = parse_int(value, &opts->max_n);
+        } else if (strcmp(arg, "--full") == 0) {
+            opts->full = 1;
+        } else if (strncmp(arg, "--samples=", 10) == 0) {
+            status = parse_int(value, &opts->samples);
+        } else if (strncmp(arg, "--warmup=", 9) == 0) {
+            status = parse_int(value, &opts->warmup);
+        } else if (strncmp(arg, "--cpu=", 6) == 0) {
+            status = parse_int(value, &opts->cpu);
+        } else if (strncmp(arg, "--threads=", 10) == 0) {
+            status = parse_int(value, &opts->threads);
+        } else if (strncmp(arg, "--filter=", 9) == 0) {
+            opts->filter = value;
+        } else if (strcmp(arg, "--format=table") == 0) {
+            opts->format = FORMAT_TABLE;
+        } else if (strcmp(arg, "--format=csv") == 0) {
+            opts->format = FORMAT_CSV;
+        } else if (strcmp(arg, "--format=json") == 0) {
+            opts->format = FORMAT_JSON;
+        } else {
+            return ERROR_INVALID_DIMENSION;
+        }
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+
+    if (opts->min_n < 1 || opts->max_n < opts->min_n || opts->samples < 1 ||
+        opts->samples > BENCH_MAX_SAMPLES || opts->warmup < 0 ||
+        opts->threads < 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+int main(int argc, char **argv) {
+    BenchOptions opts;
+    if (parse_options(argc, argv, &opts) != SUCCESS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (opts.cpu >= 0) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(opts.cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            fprintf(stderr, "Could not pin to CPU %d\n", opts.cpu);
+        }
+    }
+
+    // Pool workers are pinned whenever the caller is
+    if (opts.threads != 1) {
+        thread_pool_init(opts.threads, opts.cpu >= 0);
+    }
+
+    int failed = 0;
+    report_header(&opts);
+    for (int c = 0; c < BENCH_NUM_CASES; c++) {
+        const BenchCase *bc = &bench_cases[c];
+        if (opts.filter != NULL && strstr(bc->name, opts.filter) == NULL) {
+            continue;
+        }
+
+        int limit =
+            opts.full || bc->max_n > opts.max_n ? opts.max_n : bc->max_n;
+        for (int n = opts.min_n; n <= limit; n *= 2) {
+            failed |= bench_one(&opts, bc, n) != SUCCESS;
+            // The next size would pass limit, or INT_MAX when limit is
+            // close to it
+            if (n > limit / 2) {
+                break;
+            }
+        }
+    }
+    report_footer(&opts);
+
+    thread_pool_shutdown();
+    return failed ? 1 : 0;
+}
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment (in bytes) of every Vector and Matrix buffer
+#define MATH_ALIGNMENT 64
+
+// Pluggable allocator used by vector_create and matrix_create
+// alloc returns memory aligned to at least `alignment` bytes or NULL; free
+// receives the same size that was passed to alloc. zeroed != 0 promises
+// that alloc only returns zero-filled memory, so creation can skip its
+// fill pass.
+typedef struct {
+    void *(*alloc)(void *ctx, size_t size, size_t alignment);
+    void (*free)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+    int zeroed;
+} Allocator;
+
+// Allocator used by create functions on the calling thread (NULL = heap)
+// Returns the previous allocator so callers can restore it.
+Allocator *allocator_set_current(Allocator *allocator);
+Allocator *allocator_current(void);
+
+// Allocate/free through an allocator, falling back to the heap for NULL
+void *allocator_alloc(Allocator *allocator, size_t size);
+void allocator_free(Allocator *allocator, void *ptr, size_t size);
+
+// Whole-page anonymous mappings, released with munmap. The kernel hands out
+// fresh pages zeroed on first touch, so this allocator is zeroed. Zeroed
+// creation draws heap buffers of at least ALLOCATOR_PAGES_THRESHOLD bytes
+// from it, and a large result costs no fill pass before the kernel that
+// computes it writes it. Creation still stores one byte per page on the
+// pool workers, so the pages are placed like those of a filled matrix.
+#define ALLOCATOR_PAGES_THRESHOLD ((size_t)1 << 21)
+
+Allocator *allocator_pages(void);
+
+// Bump arena
+// Allocations are carved sequentially out of chained blocks and are only
+// released in bulk with arena_reset/arena_reset_to. Individual frees are
+// no-ops. Not thread-safe: use one arena per thread.
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *head;
+    ArenaBlock *current;
+    size_t block_size;
+    Allocator allocator;
+} Arena;
+
+typedef struct {
+    ArenaBlock *block;
+    size_t used;
+} ArenaMark;
+
+int arena_init(Arena *arena, size_t block_size);
+void arena_destroy(Arena *arena);
+Allocator *arena_allocator(Arena *arena);
+ArenaMark arena_mark(const Arena *arena);
+void arena_reset_to(Arena *arena, ArenaMark mark);
+void arena_reset(Arena *arena);
+
+// Size-class pool
+// Freed buffers are kept on per-class free lists (powers of two from
+// POOL_MIN_SIZE to POOL_MAX_SIZE bytes) and handed back to later requests
+// of the same class; larger requests go straight to the heap. Not
+// thread-safe: use one pool per thread.
+#define POOL_MIN_SIZE 64
+#define POOL_MAX_SIZE (1 << 20)
+#define POOL_NUM_CLASSES 15
+
+typedef struct {
+    void *free_lists[POOL_NUM_CLASSES];
+    Allocator allocator;
+} Pool;
+
+int pool_init(Pool *pool);
+void pool_destroy(Pool *pool);
+Allocator *pool_allocator(Pool *pool);
+// Return every cached buffer to the heap
+void pool_trim(Pool *pool);
+
+// NUMA placement
+// Page mappings, like allocator_pages, for large matrices on multi-socket
+// hosts. The kernel places a page on the node of the thread that first
+// touches it. Creation leaves these zeroed pages untouched, so by default
+// each row panel lands near the worker whose kernel first writes it.
+// NUMA_FLAG_INTERLEAVE instead spreads the pages round-robin over every
+// node, which suits data that all threads share (the B of a product, for
+// example). NUMA_FLAG_HUGE_PAGES asks for transparent huge pages.
+// Thread-safe. Placement is best effort: on a single-node host, or where
+// the kernel refuses, allocations succeed with default placement.
+#define NUMA_FLAG_INTERLEAVE 0x1
+#define NUMA_FLAG_HUGE_PAGES 0x2
+
+typedef struct {
+    int flags;
+    Allocator allocator;
+} NumaAllocator;
+
+int numa_allocator_init(NumaAllocator *numa, int flags);
+Allocator *numa_allocator(NumaAllocator *numa);
+// Online NUMA nodes; 1 when the topology cannot be read
+int numa_node_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ALLOCATOR_H
\ No newline at end of file
@@ -0,0 +1,118 @@
+#ifndef ASYNC_QUEUE_H
+#define ASYNC_QUEUE_H
+
+#include <pthread.h>
+
+#include "matrix_math.h"
+#include "thread_pool.h"
+#include "vector_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous operations
+// Submitting copies an operation into a bounded queue and returns; the
+// queue is drained on the thread pool in batches, so the caller can keep
+// preparing inputs while earlier operations run. Submission blocks while
+// the queue is full, except from inside the queue's own drain (see
+// AsyncFn). Without pool workers every submission runs before returning.
+//
+// Operations in the queue are independent: they may run in any order and
+// at the same time, so an operation that reads another's result must be
+// submitted after waiting for it. Operands and results must stay valid
+// until the operation completes. Matrix-vector products that share the
+// same (non-transposed) matrix and are in the queue together run as one
+// fused pass, reading the matrix once for all of their vectors.
+//
+// Errors the synchronous function would return (a NULL operand, a shape
+// mismatch) are reported through the future and by async_wait_all.
+
+typedef struct AsyncOp AsyncOp;
+
+// Called on the thread that ran the operation, before waiters see it done.
+// A callback is part of the drain like an AsyncFn and follows its rules.
+typedef void (*AsyncCallback)(void *user, int status);
+
+// Custom operation for async_submit; returns a status code. It runs as
+// part of its queue's drain, and only that drain frees queue slots, so it
+// must not wait on its own queue. A submission it makes to its own queue
+// while the queue is full fails with ERROR_UNSUPPORTED instead of
+// blocking forever.
+typedef int (*AsyncFn)(void *ctx);
+
+// Completion record owned by the caller. Optional for every submission;
+// it must stay valid until the operation completes.
+typedef struct {
+    int status;
+    // Accessed atomically; set once the operation and its callback are done
+    int done;
+    AsyncCallback callback;
+    void *user;
+} AsyncFuture;
+
+#define ASYNC_FUTURE_INIT {SUCCESS, 0, NULL, NULL}
+
+typedef struct {
+    AsyncOp *ops;
+    int capacity;
+    int head;
+    int count;
+    // Submitted and not yet completed (queued plus running)
+    int pending;
+    int draining;
+    // First failure since the last async_wait_all
+    int first_error;
+
+    pthread_mutex_t lock;
+    pthread_cond_t completed;
+
+    TaskGroup group;
+    Task drain;
+} AsyncQueue;
+
+// capacity is the maximum number of queued operations
+int async_queue_init(AsyncQueue *queue, int capacity);
+// Waits for outstanding operations, then releases the queue
+void async_queue_destroy(AsyncQueue *queue);
+
+// Callback may be NULL
+void async_future_init(AsyncFuture *future, AsyncCallback callback,
+                       void *user);
+// 1 once the operation has completed
+int async_future_done(const AsyncFuture *future);
+// Blocks until the operation completes and returns its status
+int async_wait(AsyncQueue *queue, AsyncFuture *future);
+// Blocks until every submitted operation completes. Returns the first
+// failure since the previous call, or SUCCESS.
+int async_wait_all(AsyncQueue *queue);
+
+// Submissions return ERROR_NULL_POINTER for a NULL queue and
+// ERROR_UNSUPPORTED for a full queue submitted to from its own drain,
+// otherwise SUCCESS once the operation is queued
+int async_submit(AsyncQueue *queue, AsyncFn fn, void *ctx,
+                 AsyncFuture *future);
+// result = m * v
+int async_matrix_vector_multiply(AsyncQueue *queue, const Matrix *m,
+                                 const Vector *v, Vector *result,
+                                 AsyncFuture *future);
+// result = alpha * m1 * m2 + beta * result
+int async_matrix_multiply(AsyncQueue *queue, double alpha, const Matrix *m1,
+                          const Matrix *m2, double beta, Matrix *result,
+                          AsyncFuture *future);
+int async_vector_add(AsyncQueue *queue, const Vector *v1, const Vector *v2,
+                     Vector *result, AsyncFuture *future);
+int async_vector_subtract(AsyncQueue *queue, const Vector *v1,
+                          const Vector *v2, Vector *result,
+                          AsyncFuture *future);
+int async_vector_scale(AsyncQueue *queue, const Vector *v, double scalar,
+                       Vector *result, AsyncFuture *future);
+// y = alpha * x + y
+int async_vector_axpy(AsyncQueue *queue, double alpha, const Vector *x,
+                      Vector *y, AsyncFuture *future);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // ASYNC_QUEUE_H
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef BLAS_BACKEND_H
+#define BLAS_BACKEND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "matrix_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Vendor BLAS/LAPACK backend
+// When the library is built with BLAS=openblas, mkl or blis (see the
+// Makefile), these entry points hand calls whose FLOP count reaches the
+// op's threshold to the vendor library:
+//     vector_dot_product, vector_scale_into   (BLAS_OP_DOT, BLAS_OP_SCALE)
+//     matrix_vector_multiply_into             (BLAS_OP_GEMV)
+//     matrix_multiply_into                    (BLAS_OP_GEMM)
+//     matrix_lu_into                          (BLAS_OP_GETRF, LAPACK only)
+//     matrix_lu_solve_matrix_into             (BLAS_OP_TRSM)
+// Smaller calls stay on the built-in kernels, which win below the vendor
+// library's setup cost. Arguments are validated and errors reported as
+// before either way; results may differ from the built-in kernels in
+// rounding. Without a vendor library every call stays built in.
+typedef enum {
+    BLAS_OP_DOT,
+    BLAS_OP_SCALE,
+    BLAS_OP_GEMV,
+    BLAS_OP_GEMM,
+    BLAS_OP_GETRF,
+    BLAS_OP_TRSM,
+    BLAS_OP_COUNT
+} BlasOp;
+
+#define BLAS_THRESHOLD_NEVER UINT64_MAX
+
+// 1 when built against a vendor library
+int blas_backend_available(void);
+// The BLAS= value the library was built with, or "none"
+const char *blas_backend_name(void);
+// Forward calls of at least `flops` floating-point operations;
+// BLAS_THRESHOLD_NEVER keeps the op built in. Returns ERROR_UNSUPPORTED
+// for an op the build cannot forward.
+int blas_backend_set_threshold(BlasOp op, uint64_t flops);
+uint64_t blas_backend_threshold(BlasOp op);
+
+// Forwarding used by the library
+// Each returns ERROR_UNSUPPORTED (or ERROR_NULL_POINTER for scratch
+// memory) when it could not run, and the caller falls back.
+#ifdef MATHLIB_BLAS
+extern uint64_t blas_thresholds[BLAS_OP_COUNT];
+
+static inline int blas_backend_use(BlasOp op, uint64_t flops) {
+    return flops >= __atomic_load_n(&blas_thresholds[op], __ATOMIC_RELAXED);
+}
+#else
+static inline int blas_backend_use(BlasOp op, uint64_t flops) {
+    (void)op;
+    (void)flops;
+    return 0;
+}
+#endif
+
+int blas_ddot(const double *a, const double *b, size_t n, double *result);
+int blas_dscal(const double *a, double scalar, double *out, size_t n);
+// y = A x for a logical (possibly transposed) A
+int blas_dgemv(const Matrix *a, const double *x, double *y);
+// C = alpha * A * B + beta * C; C must not be transposed
+int blas_dgemm(double alpha, const Matrix *a, const Matrix *b, double beta,
+               Matrix *c);
+// In-place LU of a square, non-transposed matrix in the MatrixLU format
+int blas_dgetrf(Matrix *a, int *pivots, int *sign);
+// X = U^-1 L^-1 X with L and U packed in lu; X is already permuted
+int blas_lu_trsm(const Matrix *lu, Matrix *x);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // BLAS_BACKEND_H
\ No newline at end of file
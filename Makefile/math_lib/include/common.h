@@ -5,17 +5,31 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "trace_log.h"
+
 // Define error codes
 #define SUCCESS 0
 #define ERROR_NULL_POINTER -1
 #define ERROR_DIVISION_BY_ZERO -2
 #define ERROR_INVALID_DIMENSION -3
+#define ERROR_SINGULAR_MATRIX -4
+#define ERROR_IO -5
+#define ERROR_INVALID_FORMAT -6
+#define ERROR_UNSUPPORTED -7
 
 // Debug macro
-#ifdef DEBUG
-#define DEBUG_PRINT(fmt, ...) printf("DEBUG: " fmt, ##__VA_ARGS__)
-#else
+// Records a line in the calling thread's trace ring (see trace_log.h) when
+// tracing is on. Defining MATHLIB_NO_TRACE compiles trace points out.
+#ifdef MATHLIB_NO_TRACE
 #define DEBUG_PRINT(fmt, ...)
+#else
+#define DEBUG_PRINT(fmt, ...)                                           \
+    do {                                                                \
+        if (__builtin_expect(                                           \
+                __atomic_load_n(&trace_active, __ATOMIC_RELAXED), 0)) { \
+            trace_record(fmt, ##__VA_ARGS__);                           \
+        }                                                               \
+    } while (0)
 #endif
 
 #endif  // COMMON_H
\ No newline at end of file
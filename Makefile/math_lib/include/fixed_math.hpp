@@ -0,0 +1,380 @@
+#ifndef FIXED_MATH_HPP
+#define FIXED_MATH_HPP
+
+#include <cmath>
+
+#include "matrix_math.h"
+
+// Header-only C++17 layer for vectors and matrices of compile-time size
+// FixedVector<N> and FixedMatrix<R, C> are plain aggregates that live on the
+// stack (or inside other objects) with no allocation. Dimensions are
+// template parameters, so mismatched shapes fail to compile instead of
+// returning ERROR_INVALID_DIMENSION, and every loop has a constant trip
+// count the compiler can unroll.
+//
+// Conversions to and from the dynamic Vector and Matrix types follow the C
+// API: they return SUCCESS or an error code, and the dynamic side must
+// already be created with the matching shape.
+
+namespace mathlib {
+
+template <int N>
+struct FixedVector {
+    static_assert(N > 0, "FixedVector needs at least one element");
+
+    double data[N];
+
+    static constexpr int size() { return N; }
+
+    constexpr double &operator[](int i) { return data[i]; }
+    constexpr const double &operator[](int i) const { return data[i]; }
+
+    static constexpr FixedVector zero() {
+        FixedVector v{};
+        return v;
+    }
+};
+
+// Row-major, like Matrix with stride == C
+template <int R, int C>
+struct FixedMatrix {
+    static_assert(R > 0 && C > 0, "FixedMatrix needs at least one element");
+
+    double data[R][C];
+
+    static constexpr int rows() { return R; }
+    static constexpr int cols() { return C; }
+
+    constexpr double &operator()(int i, int j) { return data[i][j]; }
+    constexpr const double &operator()(int i, int j) const {
+        return data[i][j];
+    }
+
+    static constexpr FixedMatrix zero() {
+        FixedMatrix m{};
+        return m;
+    }
+
+    static constexpr FixedMatrix identity() {
+        static_assert(R == C, "identity needs a square matrix");
+        FixedMatrix m{};
+        for (int i = 0; i < R; i++) {
+            m.data[i][i] = 1.0;
+        }
+        return m;
+    }
+};
+
+// Vector operations ---------------------------------------------------------
+
+template <int N>
+constexpr FixedVector<N> operator+(const FixedVector<N> &a,
+                                   const FixedVector<N> &b) {
+    FixedVector<N> r{};
+    for (int i = 0; i < N; i++) {
+        r.data[i] = a.data[i] + b.data[i];
+    }
+    return r;
+}
+
+template <int N>
+constexpr FixedVector<N> operator-(const FixedVector<N> &a,
+                                   const FixedVector<N> &b) {
+    FixedVector<N> r{};
+    for (int i = 0; i < N; i++) {
+        r.data[i] = a.data[i] - b.data[i];
+    }
+    return r;
+}
+
+template <int N>
+constexpr FixedVector<N> operator-(const FixedVector<N> &a) {
+    FixedVector<N> r{};
+    for (int i = 0; i < N; i++) {
+        r.data[i] = -a.data[i];
+    }
+    return r;
+}
+
+template <int N>
+constexpr FixedVector<N> operator*(double scalar, const FixedVector<N> &a) {
+    FixedVector<N> r{};
+    for (int i = 0; i < N; i++) {
+        r.data[i] = scalar * a.data[i];
+    }
+    return r;
+}
+
+template <int N>
+constexpr FixedVector<N> operator*(const FixedVector<N> &a, double scalar) {
+    return scalar * a;
+}
+
+template <int N>
+constexpr FixedVector<N> &operator+=(FixedVector<N> &a,
+                                     const FixedVector<N> &b) {
+    for (int i = 0; i < N; i++) {
+        a.data[i] += b.data[i];
+    }
+    return a;
+}
+
+template <int N>
+constexpr FixedVector<N> &operator-=(FixedVector<N> &a,
+                                     const FixedVector<N> &b) {
+    for (int i = 0; i < N; i++) {
+        a.data[i] -= b.data[i];
+    }
+    return a;
+}
+
+template <int N>
+constexpr FixedVector<N> &operator*=(FixedVector<N> &a, double scalar) {
+    for (int i = 0; i < N; i++) {
+        a.data[i] *= scalar;
+    }
+    return a;
+}
+
+template <int N>
+constexpr double dot(const FixedVector<N> &a, const FixedVector<N> &b) {
+    double sum = 0.0;
+    for (int i = 0; i < N; i++) {
+        sum += a.data[i] * b.data[i];
+    }
+    return sum;
+}
+
+template <int N>
+inline double magnitude(const FixedVector<N> &a) {
+    return std::sqrt(dot(a, a));
+}
+
+// Same contract as vector_normalize_into: ERROR_DIVISION_BY_ZERO for a
+// zero vector; result may be a
+template <int N>
+inline int normalize(const FixedVector<N> &a, FixedVector<N> *result) {
+    if (result == nullptr) {
+        return ERROR_NULL_POINTER;
+    }
+
+    double m = magnitude(a);
+    if (m == 0) {
+        return ERROR_DIVISION_BY_ZERO;
+    }
+
+    *result = (1.0 / m) * a;
+    return SUCCESS;
+}
+
+constexpr FixedVector<3> cross(const FixedVector<3> &a,
+                               const FixedVector<3> &b) {
+    return FixedVector<3>{{a.data[1] * b.data[2] - a.data[2] * b.data[1],
+                           a.data[2] * b.data[0] - a.data[0] * b.data[2],
+                           a.data[0] * b.data[1] - a.data[1] * b.data[0]}};
+}
+
+// Matrix operations ---------------------------------------------------------
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator+(const FixedMatrix<R, C> &a,
+                                      const FixedMatrix<R, C> &b) {
+    FixedMatrix<R, C> r{};
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            r.data[i][j] = a.data[i][j] + b.data[i][j];
+        }
+    }
+    return r;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator-(const FixedMatrix<R, C> &a,
+                                      const FixedMatrix<R, C> &b) {
+    FixedMatrix<R, C> r{};
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            r.data[i][j] = a.data[i][j] - b.data[i][j];
+        }
+    }
+    return r;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator*(double scalar,
+                                      const FixedMatrix<R, C> &a) {
+    FixedMatrix<R, C> r{};
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            r.data[i][j] = scalar * a.data[i][j];
+        }
+    }
+    return r;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<R, C> operator*(const FixedMatrix<R, C> &a,
+                                      double scalar) {
+    return scalar * a;
+}
+
+// The k loop runs outermost so each step is a row axpy over c
+template <int R, int K, int C>
+constexpr FixedMatrix<R, C> operator*(const FixedMatrix<R, K> &a,
+                                      const FixedMatrix<K, C> &b) {
+    FixedMatrix<R, C> r{};
+    for (int i = 0; i < R; i++) {
+        for (int k = 0; k < K; k++) {
+            for (int j = 0; j < C; j++) {
+                r.data[i][j] += a.data[i][k] * b.data[k][j];
+            }
+        }
+    }
+    return r;
+}
+
+template <int R, int C>
+constexpr FixedVector<R> operator*(const FixedMatrix<R, C> &a,
+                                   const FixedVector<C> &x) {
+    FixedVector<R> y{};
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            y.data[i] += a.data[i][j] * x.data[j];
+        }
+    }
+    return y;
+}
+
+template <int R, int C>
+constexpr FixedMatrix<C, R> transpose(const FixedMatrix<R, C> &a) {
+    FixedMatrix<C, R> t{};
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            t.data[j][i] = a.data[i][j];
+        }
+    }
+    return t;
+}
+
+// Closed forms only; use matrix_determinant on matrix_view_of for larger
+// orders
+template <int N>
+constexpr double determinant(const FixedMatrix<N, N> &m) {
+    static_assert(N <= 4, "determinant is provided for orders 1 to 4");
+    const auto &a = m.data;
+
+    if constexpr (N == 1) {
+        return a[0][0];
+    } else if constexpr (N == 2) {
+        return a[0][0] * a[1][1] - a[0][1] * a[1][0];
+    } else if constexpr (N == 3) {
+        return a[0][0] * (a[1][1] * a[2][2] - a[1][2] * a[2][1]) -
+               a[0][1] * (a[1][0] * a[2][2] - a[1][2] * a[2][0]) +
+               a[0][2] * (a[1][0] * a[2][1] - a[1][1] * a[2][0]);
+    } else {
+        // 2x2 minors of rows 0-1 against rows 2-3
+        double s0 = a[0][0] * a[1][1] - a[1][0] * a[0][1];
+        double s1 = a[0][0] * a[1][2] - a[1][0] * a[0][2];
+        double s2 = a[0][0] * a[1][3] - a[1][0] * a[0][3];
+        double s3 = a[0][1] * a[1][2] - a[1][1] * a[0][2];
+        double s4 = a[0][1] * a[1][3] - a[1][1] * a[0][3];
+        double s5 = a[0][2] * a[1][3] - a[1][2] * a[0][3];
+        double c5 = a[2][2] * a[3][3] - a[3][2] * a[2][3];
+        double c4 = a[2][1] * a[3][3] - a[3][1] * a[2][3];
+        double c3 = a[2][1] * a[3][2] - a[3][1] * a[2][2];
+        double c2 = a[2][0] * a[3][3] - a[3][0] * a[2][3];
+        double c1 = a[2][0] * a[3][2] - a[3][0] * a[2][2];
+        double c0 = a[2][0] * a[3][1] - a[3][0] * a[2][1];
+        return s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+    }
+}
+
+// Interop with the dynamic types --------------------------------------------
+
+template <int N>
+inline int from_vector(const Vector *v, FixedVector<N> *result) {
+    if (v == nullptr || v->data == nullptr || result == nullptr) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v->size != N) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < N; i++) {
+        result->data[i] = v->data[i];
+    }
+    return SUCCESS;
+}
+
+template <int N>
+inline int to_vector(const FixedVector<N> &v, Vector *result) {
+    if (result == nullptr || result->data == nullptr) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (result->size != N) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < N; i++) {
+        result->data[i] = v.data[i];
+    }
+    return SUCCESS;
+}
+
+// Honors MATRIX_FLAG_TRANSPOSED and views like every Matrix operation
+template <int R, int C>
+inline int from_matrix(const Matrix *m, FixedMatrix<R, C> *result) {
+    if (m == nullptr || m->data == nullptr || result == nullptr) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->rows != R || m->cols != C) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            result->data[i][j] = MATRIX_ELEM(m, i, j);
+        }
+    }
+    return SUCCESS;
+}
+
+template <int R, int C>
+inline int to_matrix(const FixedMatrix<R, C> &a, Matrix *result) {
+    if (result == nullptr || result->data == nullptr) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (result->rows != R || result->cols != C) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(result);
+    for (int i = 0; i < R; i++) {
+        for (int j = 0; j < C; j++) {
+            MATRIX_ELEM(result, i, j) = a.data[i][j];
+        }
+    }
+    return SUCCESS;
+}
+
+// Zero-copy views for passing fixed storage to the C API. A Matrix view
+// carries MATRIX_FLAG_VIEW, so matrix_free only clears it. Vector has no
+// such flag: never pass the result of vector_view_of to vector_free.
+template <int R, int C>
+inline Matrix matrix_view_of(FixedMatrix<R, C> &a) {
+    return Matrix{R, C, C, &a.data[0][0], nullptr, MATRIX_FLAG_VIEW,
+                  0, 0};
+}
+
+template <int N>
+inline Vector vector_view_of(FixedVector<N> &v) {
+    return Vector{N, v.data, nullptr};
+}
+
+}  // namespace mathlib
+
+#endif  // FIXED_MATH_HPP
\ No newline at end of file
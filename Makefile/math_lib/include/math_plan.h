@@ -0,0 +1,87 @@
+#ifndef MATH_PLAN_H
+#define MATH_PLAN_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "matrix_math.h"
+#include "vector_kernels.h"
+#include "vector_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Checked-once execution plans
+// A plan binds one operation to its operands. Building it runs every check
+// the direct call would (NULL operands, shapes) and settles the kernel
+// path: the ISA table, the vendor library, transposed operands. Running it
+// goes straight to that kernel without validation, trace points or perf
+// counting, which is what a small operation repeated in a loop pays for
+// most. The plan copies the operand descriptors, so the buffers must stay
+// allocated and their shapes unchanged while it is in use; the elements
+// may change freely. A matrix destination must also stay in place, since
+// each run bumps its version. Builders return the direct call's error codes; a
+// plan whose builder failed has run == NULL and must not be run.
+typedef struct MathPlan MathPlan;
+
+struct MathPlan {
+    // SUCCESS, or ERROR_NULL_POINTER when a product's temporaries cannot
+    // be allocated
+    int (*run)(const MathPlan *plan);
+    const VectorKernels *kernels;
+    int op;
+    // Kernel path chosen by the builder, per operation
+    int path;
+    double alpha;
+    double beta;
+
+    // Vector operands
+    const double *x;
+    const double *y;
+    double *out;
+    size_t n;
+
+    // Matrix operands, views already resolved
+    Matrix a;
+    Matrix b;
+    Matrix c;
+    // Destination matrix whose version each run bumps
+    Matrix *target;
+};
+
+int vector_plan_add(MathPlan *plan, const Vector *v1, const Vector *v2,
+                    Vector *result);
+int vector_plan_subtract(MathPlan *plan, const Vector *v1, const Vector *v2,
+                         Vector *result);
+int vector_plan_scale(MathPlan *plan, const Vector *v, double scalar,
+                      Vector *result);
+// y = alpha * x + y
+int vector_plan_axpy(MathPlan *plan, double alpha, const Vector *x,
+                     Vector *y);
+int vector_plan_dot_product(MathPlan *plan, const Vector *v1,
+                            const Vector *v2, double *result);
+
+int matrix_plan_add(MathPlan *plan, const Matrix *m1, const Matrix *m2,
+                    Matrix *result);
+int matrix_plan_subtract(MathPlan *plan, const Matrix *m1, const Matrix *m2,
+                         Matrix *result);
+int matrix_plan_scale(MathPlan *plan, const Matrix *m, double scalar,
+                      Matrix *result);
+int matrix_plan_axpy(MathPlan *plan, double alpha, const Matrix *x,
+                     Matrix *y);
+int matrix_plan_vector_multiply(MathPlan *plan, const Matrix *m,
+                                const Vector *v, Vector *result);
+// result = alpha * m1 * m2 + beta * result
+int matrix_plan_multiply(MathPlan *plan, double alpha, const Matrix *m1,
+                         const Matrix *m2, double beta, Matrix *result);
+
+static inline int math_plan_run(const MathPlan *plan) {
+    return plan->run(plan);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MATH_PLAN_H
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef MATRIX_BATCH_H
+#define MATRIX_BATCH_H
+
+#include "matrix_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Batches of small square matrices and short vectors
+// Storage is structure-of-arrays: every element position has its own plane
+// of count lanes, one lane per batch member, so the kernels run the same
+// unrolled 2x2/3x3/4x4 formula across consecutive members with full-width
+// SIMD loads instead of one tiny matrix at a time.
+//
+// Element (i, j) of member k lives at data[(i * order + j) * stride + k];
+// stride is count rounded up so every plane starts on MATH_ALIGNMENT.
+// data is owned by allocator (NULL = heap) and released by *_batch_free.
+
+#define MATRIX_BATCH_MAX_ORDER 4
+
+typedef struct {
+    int order;
+    int count;
+    int stride;
+    double *data;
+    Allocator *allocator;
+} MatrixBatch;
+
+// Element i of member k lives at data[i * stride + k]
+typedef struct {
+    int size;
+    int count;
+    int stride;
+    double *data;
+    Allocator *allocator;
+} VectorBatch;
+
+#define MATRIX_BATCH_AT(b, k, i, j)                                       \
+    ((b)->data[((size_t)(i) * (size_t)(b)->order + (size_t)(j)) *        \
+                   (size_t)(b)->stride +                                   \
+               (size_t)(k)])
+#define VECTOR_BATCH_AT(b, k, i) \
+    ((b)->data[(size_t)(i) * (size_t)(b)->stride + (size_t)(k)])
+
+// order (or size) must be 1..MATRIX_BATCH_MAX_ORDER; members start zeroed
+int matrix_batch_create(int order, int count, MatrixBatch *result);
+void matrix_batch_free(MatrixBatch *batch);
+int vector_batch_create(int size, int count, VectorBatch *result);
+void vector_batch_free(VectorBatch *batch);
+
+// Copy one member in or out; the Matrix or Vector must have the member
+// shape
+int matrix_batch_set(MatrixBatch *batch, int index, const Matrix *m);
+int matrix_batch_get(const MatrixBatch *batch, int index, Matrix *result);
+int vector_batch_set(VectorBatch *batch, int index, const Vector *v);
+int vector_batch_get(const VectorBatch *batch, int index, Vector *result);
+
+// Member-wise operations; all batches must have the same count and order.
+// The result may be the same batch as an operand.
+int matrix_multiply_batched(const MatrixBatch *a, const MatrixBatch *b,
+                            MatrixBatch *result);
+int matrix_vector_multiply_batched(const MatrixBatch *a, const VectorBatch *x,
+                                   VectorBatch *result);
+// result->size must equal the batch count
+int matrix_determinant_batched(const MatrixBatch *a, Vector *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MATRIX_BATCH_H
\ No newline at end of file
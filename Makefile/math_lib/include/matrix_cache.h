@@ -0,0 +1,86 @@
+#ifndef MATRIX_CACHE_H
+#define MATRIX_CACHE_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "matrix_lu.h"
+#include "matrix_math.h"
+#include "vector_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Factorization result cache
+// Keeps LU factors and inverses keyed by matrix id. Each entry records the
+// version of the matrix it was computed from, so repeating a request for
+// an unchanged matrix is a lookup, while a matrix written since then is
+// factored again (see matrix_mark_modified). The least recently used
+// entries are evicted to stay within max_entries and max_bytes. A missed
+// inverse is formed from the cached LU factors, so the determinant, solves
+// and the inverse of one matrix share a single factorization.
+//
+// Thread-safe. Cached buffers come from the heap, never from the calling
+// thread's allocator, so an arena reset cannot pull them out from under
+// the cache. Matrices with id 0 are computed without caching.
+typedef struct MatrixCacheEntry MatrixCacheEntry;
+
+typedef struct {
+    MatrixCacheEntry **buckets;
+    int bucket_mask;
+    // Most and least recently used ends of the LRU list
+    MatrixCacheEntry *newest;
+    MatrixCacheEntry *oldest;
+    int count;
+    int max_entries;
+    size_t bytes;
+    size_t max_bytes;
+    uint64_t hits;
+    uint64_t misses;
+    pthread_mutex_t lock;
+} MatrixCache;
+
+typedef struct {
+    uint64_t hits;
+    uint64_t misses;
+    int entries;
+    size_t bytes;
+} MatrixCacheStats;
+
+// max_entries > 0; max_bytes bounds the cached buffers (0 = no byte limit)
+int matrix_cache_init(MatrixCache *cache, int max_entries, size_t max_bytes);
+// The cache must not be in use or enabled
+void matrix_cache_destroy(MatrixCache *cache);
+// Drop every entry
+void matrix_cache_clear(MatrixCache *cache);
+// Drop the entries of one matrix to release their memory early
+void matrix_cache_forget(MatrixCache *cache, const Matrix *m);
+void matrix_cache_stats(MatrixCache *cache, MatrixCacheStats *stats);
+
+// Cached counterparts of matrix_determinant, matrix_solve and
+// matrix_inverse
+int matrix_cache_determinant(MatrixCache *cache, const Matrix *m,
+                             double *result);
+int matrix_cache_solve(MatrixCache *cache, const Matrix *a, const Vector *b,
+                       Vector *x);
+int matrix_cache_inverse(MatrixCache *cache, const Matrix *m, Matrix *result);
+
+// Opt-in memoization of the plain API
+// While a cache is enabled, matrix_determinant, matrix_solve and
+// matrix_inverse route matrices of order >= MATRIX_CACHE_MIN_ORDER through
+// it; smaller ones are cheaper to recompute than to look up. Process-wide;
+// returns the previously enabled cache (NULL = disabled).
+#define MATRIX_CACHE_MIN_ORDER 16
+
+MatrixCache *matrix_cache_enable(MatrixCache *cache);
+// The enabled cache if m qualifies for it, otherwise NULL
+MatrixCache *matrix_cache_for(const Matrix *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MATRIX_CACHE_H
\ No newline at end of file
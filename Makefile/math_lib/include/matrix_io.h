@@ -0,0 +1,79 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <stdint.h>
+
+#include "matrix_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary matrix files
+// A file is a 64-byte MatrixFileHeader followed, at data_offset, by the
+// rows exactly as they sit in a matrix_create buffer: rows x stride
+// doubles with every row padded to stride. data_offset and the row length
+// are multiples of MATRIX_ALIGNMENT, so a mapped file is a ready-made
+// Matrix with aligned rows and nothing is copied.
+//
+// Fields are in the byte order of the machine that wrote the file;
+// endian_tag reads back as MATRIX_FILE_ENDIAN_TAG only on a machine with
+// the same order. checksum covers the data region (padding included).
+
+#define MATRIX_FILE_MAGIC "MLMATRIX"
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_ENDIAN_TAG 0x01020304u
+#define MATRIX_FILE_DTYPE_F64 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_tag;
+    uint32_t dtype;
+    uint32_t reserved;
+    uint64_t rows;
+    uint64_t cols;
+    // Elements per stored row
+    uint64_t stride;
+    // Bytes from the start of the file to row 0
+    uint64_t data_offset;
+    uint64_t checksum;
+} MatrixFileHeader;
+
+// Mapping flags
+// The default is a private copy-on-write mapping: element stores stay in
+// memory and never reach the file.
+// SHARED: element stores write through to the file
+// POPULATE: fault every page in now instead of on first touch
+// VERIFY: check the checksum before returning (reads the whole file)
+#define MATRIX_MAP_SHARED 0x1
+#define MATRIX_MAP_POPULATE 0x2
+#define MATRIX_MAP_VERIFY 0x4
+
+// Writes the logical matrix; views and transposed matrices are accepted
+int matrix_save(const Matrix *m, const char *path);
+// The result owns the mapping and matrix_free unmaps it. Returns ERROR_IO
+// when the file cannot be opened or mapped and ERROR_INVALID_FORMAT for a
+// bad header, a truncated file or a checksum mismatch.
+int matrix_map_file(const char *path, int flags, Matrix *result);
+// Reads the header alone, e.g. to size buffers before mapping
+int matrix_file_read_header(const char *path, MatrixFileHeader *header);
+
+// Out-of-core products with a matrix file as the left operand
+// The file is read in row panels of about panel_bytes (0 selects
+// MATRIX_STREAM_PANEL_BYTES) into two buffers: the next panel is read in
+// the background while the current one is multiplied, so memory use stays
+// at two panels however large the file is. Panels already consumed are
+// dropped from the page cache. result is created like matrix_multiply's.
+#define MATRIX_STREAM_PANEL_BYTES ((size_t)64 << 20)
+
+int matrix_file_vector_multiply(const char *path, size_t panel_bytes,
+                                const Vector *v, Vector *result);
+int matrix_file_multiply(const char *path, size_t panel_bytes,
+                         const Matrix *b, Matrix *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MATRIX_IO_H
\ No newline at end of file
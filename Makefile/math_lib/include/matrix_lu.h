@@ -0,0 +1,48 @@
+#ifndef MATRIX_LU_H
+#define MATRIX_LU_H
+
+#include "common.h"
+#include "matrix_math.h"
+#include "vector_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// LU factorization with partial pivoting: P * A = L * U
+// L (unit diagonal, not stored) and U share one n x n matrix. Row i of A
+// was exchanged with row pivots[i] at step i; sign is the permutation
+// parity (+1 or -1). A factor object can be refilled for another matrix of
+// the same size with matrix_lu_into, so repeated factorizations do not
+// allocate.
+typedef struct {
+    Matrix lu;
+    int *pivots;
+    int sign;
+} MatrixLU;
+
+// Function prototypes for LU factorization
+int matrix_lu_create(int n, MatrixLU *result);
+void matrix_lu_free(MatrixLU *lu);
+int matrix_lu(const Matrix *m, MatrixLU *result);
+int matrix_lu_into(const Matrix *m, MatrixLU *lu);
+int matrix_lu_determinant(const MatrixLU *lu, double *result);
+
+// Solve A x = b from the factors; the _into form writes a pre-sized x,
+// which may be the same Vector as b
+int matrix_lu_solve(const MatrixLU *lu, const Vector *b, Vector *x);
+int matrix_lu_solve_into(const MatrixLU *lu, const Vector *b, Vector *x);
+// Solve A X = B for every column of B at once
+int matrix_lu_solve_matrix(const MatrixLU *lu, const Matrix *b, Matrix *x);
+int matrix_lu_solve_matrix_into(const MatrixLU *lu, const Matrix *b,
+                                Matrix *x);
+
+// One-shot helpers that factor internally
+int matrix_solve(const Matrix *a, const Vector *b, Vector *x);
+int matrix_inverse(const Matrix *m, Matrix *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // MATRIX_LU_H
\ No newline at end of file
@@ -1,25 +1,212 @@
 #ifndef MATRIX_MATH_H
 #define MATRIX_MATH_H
 
+#include <stdint.h>
+
 #include "common.h"
 #include "vector_math.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Alignment (in bytes) of matrix storage; every row starts on this boundary
+#define MATRIX_ALIGNMENT MATH_ALIGNMENT
+
 // Matrix struct definition
+// Elements are stored row-major in one contiguous buffer. Row i starts at
+// data + i * stride, where stride (the leading dimension) is >= cols.
+// data is owned by allocator (NULL = heap) and released by matrix_free.
+// A MATRIX_FLAG_TRANSPOSED matrix is the transpose of its storage: rows and
+// cols give the logical shape, while the buffer holds cols rows of rows
+// elements. id and version identify the contents for result caches (see
+// matrix_mark_modified).
 typedef struct {
     int rows;
     int cols;
-    double **data;
+    int stride;
+    double *data;
+    Allocator *allocator;
+    int flags;
+    uint64_t id;
+    uint64_t version;
 } Matrix;
 
+// Matrix flags
+// VIEW: data belongs to another matrix; matrix_free only clears the struct
+// TRANSPOSED: logical element (i, j) is stored at storage (j, i)
+#define MATRIX_FLAG_VIEW 0x1
+#define MATRIX_FLAG_TRANSPOSED 0x2
+
+#define MATRIX_IS_TRANSPOSED(m) (((m)->flags & MATRIX_FLAG_TRANSPOSED) != 0)
+
+// Element access helpers
+// MATRIX_ROW and MATRIX_AT address storage; MATRIX_ELEM addresses the
+// logical matrix and honors MATRIX_FLAG_TRANSPOSED
+#define MATRIX_ROW(m, i) ((m)->data + (size_t)(i) * (size_t)(m)->stride)
+#define MATRIX_AT(m, i, j) (MATRIX_ROW(m, i)[j])
+#define MATRIX_ELEM(m, i, j)                                     \
+    (*(MATRIX_IS_TRANSPOSED(m) ? &MATRIX_AT(m, j, i) : &MATRIX_AT(m, i, j)))
+
+// Logical element access without bounds checks, like MATRIX_ELEM
+static inline double matrix_get(const Matrix *m, int i, int j) {
+    return MATRIX_ELEM(m, i, j);
+}
+
+static inline void matrix_set(Matrix *m, int i, int j, double value) {
+    MATRIX_ELEM(m, i, j) = value;
+}
+
+// Contents identity
+// Creation gives every matrix a process-wide unique id; views, mapped files
+// and matrices built by hand have id 0 and are never cached. Library
+// functions that write a matrix bump its version. Code that writes
+// elements itself (MATRIX_AT, matrix_set, data, or a view of the matrix)
+// must call matrix_mark_modified on the owning matrix afterwards, or a
+// cache may serve results for the old contents.
+static inline void matrix_mark_modified(Matrix *m) {
+    m->version++;
+}
+
 // Function prototypes for matrix operations
+// matrix_create draws from allocator_current() for the calling thread
 int matrix_create(int rows, int cols, Matrix *result);
+int matrix_create_with(int rows, int cols, Allocator *allocator,
+                       Matrix *result);
+// Contents, padding included, are left undefined for a caller that
+// overwrites every element. Zeroed creation is cheap for large heap
+// matrices too: they come from fresh pages (see allocator_pages).
+int matrix_create_uninitialized(int rows, int cols, Matrix *result);
+int matrix_create_uninitialized_with(int rows, int cols, Allocator *allocator,
+                                     Matrix *result);
 void matrix_free(Matrix *m);
 int matrix_add(const Matrix *m1, const Matrix *m2, Matrix *result);
 int matrix_subtract(const Matrix *m1, const Matrix *m2, Matrix *result);
 int matrix_multiply(const Matrix *m1, const Matrix *m2, Matrix *result);
+// result = alpha * m1 * m2 + beta * result; result must already be
+// m1->rows x m2->cols and must not overlap m1 or m2
+int matrix_multiply_into(double alpha, const Matrix *m1, const Matrix *m2,
+                         double beta, Matrix *result);
 int matrix_scale(const Matrix *m, double scalar, Matrix *result);
 int matrix_transpose(const Matrix *m, Matrix *result);
 int matrix_determinant(const Matrix *m, double *result);
 int matrix_vector_multiply(const Matrix *m, const Vector *v, Vector *result);
 
+// Strassen-Winograd
+// matrix_multiply and matrix_multiply_into recurse with Strassen-Winograd
+// (7 half-size products per level instead of 8) while all of m, n and k
+// are above the cutover, then run the tiled kernel; an odd edge is peeled
+// off at each level. A level needs temporaries of about three quarters of
+// its C (more when its products run in parallel), and the error bound is
+// normwise and grows with the recursion depth, so results differ from the
+// tiled kernel in rounding. A cutover of 0 disables the recursion.
+#define MATRIX_STRASSEN_DEFAULT_CUTOVER 512
+
+void matrix_set_strassen_cutover(int n);
+int matrix_strassen_cutover(void);
+
+// Views
+// A view shares the storage of m and stays valid while m does. The
+// rows x cols block starts at logical element (row, col).
+int matrix_view(const Matrix *m, int row, int col, int rows, int cols,
+                Matrix *view);
+// Lazy transpose: flips MATRIX_FLAG_TRANSPOSED without moving data.
+// Every operation accepts transposed operands; element-wise operations on
+// operands of mixed orientation fall back to strided access.
+int matrix_transpose_view(const Matrix *m, Matrix *view);
+
+// Non-allocating variants
+// The destination must already be created with the result shape. The
+// element-wise operations (copy, add, subtract, scale, axpy) accept a
+// destination that is the same Matrix as an operand. Transpose and
+// matrix-vector multiply require a destination that does not overlap the
+// inputs.
+int matrix_copy(const Matrix *src, Matrix *dst);
+int matrix_add_into(const Matrix *m1, const Matrix *m2, Matrix *result);
+int matrix_subtract_into(const Matrix *m1, const Matrix *m2, Matrix *result);
+int matrix_scale_into(const Matrix *m, double scalar, Matrix *result);
+int matrix_scale_inplace(Matrix *m, double scalar);
+// y = alpha * x + y
+int matrix_axpy(double alpha, const Matrix *x, Matrix *y);
+int matrix_transpose_into(const Matrix *m, Matrix *result);
+// Square matrices only; swaps tiles in place without a second buffer
+int matrix_transpose_inplace(Matrix *m);
+int matrix_vector_multiply_into(const Matrix *m, const Vector *v,
+                                Vector *result);
+
+// Multiple right-hand sides
+// result[k] = m * v[k] for k < count. The matrix is streamed from memory
+// once for the whole panel of vectors, not once per vector: each block of
+// rows stays in cache while every group of MATRIX_GEMV_GROUP vectors runs
+// its dots over it. For
+// a non-transposed m each result is bitwise equal to what
+// matrix_vector_multiply returns without the vendor backend. The _many
+// form creates the count results and leaves none allocated on failure.
+#define MATRIX_GEMV_GROUP 8
+
+int matrix_vector_multiply_many(const Matrix *m, const Vector *v,
+                                Vector *result, int count);
+int matrix_vector_multiply_many_into(const Matrix *m, const Vector *v,
+                                     Vector *result, int count);
+
+// result = m^T v without walking columns: the stored rows of m are swept
+// with contiguous axpys, as for any transposed view
+int matrix_transpose_vector_multiply(const Matrix *m, const Vector *v,
+                                     Vector *result);
+int matrix_transpose_vector_multiply_into(const Matrix *m, const Vector *v,
+                                          Vector *result);
+int matrix_transpose_vector_multiply_many_into(const Matrix *m,
+                                               const Vector *v,
+                                               Vector *result, int count);
+
+
+// Compressed sparse matrices
+// CSR stores each row's nonzeros contiguously: offsets has rows + 1 entries
+// and row i owns values[offsets[i] .. offsets[i + 1]), with the column of
+// each value in indices. CSC is the same with the roles of rows and columns
+// swapped. Indices are sorted within each row (CSR) or column (CSC).
+typedef enum {
+    SPARSE_CSR,
+    SPARSE_CSC,
+} SparseFormat;
+
+typedef struct {
+    int rows;
+    int cols;
+    int nnz;
+    SparseFormat format;
+    int *offsets;
+    int *indices;
+    double *values;
+    Allocator *allocator;
+} SparseMatrix;
+
+// Allocates room for nnz entries with offsets zeroed; the caller fills in
+// the structure. Draws from allocator_current() like matrix_create.
+int sparse_matrix_create(int rows, int cols, int nnz, SparseFormat format,
+                         SparseMatrix *result);
+void sparse_matrix_free(SparseMatrix *m);
+// Keeps every element of m that is not exactly zero
+int sparse_matrix_from_dense(const Matrix *m, SparseFormat format,
+                             SparseMatrix *result);
+int sparse_matrix_to_dense(const SparseMatrix *m, Matrix *result);
+int sparse_matrix_to_dense_into(const SparseMatrix *m, Matrix *result);
+// CSR <-> CSC (or a plain copy when the formats match)
+int sparse_matrix_convert(const SparseMatrix *m, SparseFormat format,
+                          SparseMatrix *result);
+int sparse_matrix_vector_multiply(const SparseMatrix *m, const Vector *v,
+                                  Vector *result);
+int sparse_matrix_vector_multiply_into(const SparseMatrix *m, const Vector *v,
+                                       Vector *result);
+// Sparse x dense products; result = alpha * m1 * m2 + beta * result for
+// the _into variant, with the same aliasing rules as matrix_multiply_into
+int sparse_matrix_multiply(const SparseMatrix *m1, const Matrix *m2,
+                           Matrix *result);
+int sparse_matrix_multiply_into(double alpha, const SparseMatrix *m1,
+                                const Matrix *m2, double beta, Matrix *result);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif  // MATRIX_MATH_H
\ No newline at end of file
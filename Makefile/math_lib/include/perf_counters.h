@@ -0,0 +1,146 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "common.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Operation counters
+// Always compiled in and off until perf_counters_enable(1). While off, an
+// instrumented call costs one relaxed load and a branch. While on, it reads
+// the cycle counter on entry and exit and adds to counters owned by the
+// calling thread, so threads never contend; snapshots sum every thread.
+//
+// bytes and flops are derived from the operand shapes (each operand read
+// or written once), not measured. An op that calls another instrumented op
+// (LU calls GEMM, for example) is counted by both.
+
+#define PERF_OP_LIST(X)                                          \
+    X(VECTOR_ADD, "vector_add")                                  \
+    X(VECTOR_SUBTRACT, "vector_subtract")                        \
+    X(VECTOR_SCALE, "vector_scale")                              \
+    X(VECTOR_AXPY, "vector_axpy")                                \
+    X(VECTOR_DOT, "vector_dot_product")                          \
+    X(VECTOR_SUM, "vector_sum")                                  \
+    X(VECTOR_MAGNITUDE, "vector_magnitude")                      \
+    X(VECTOR_NORMALIZE, "vector_normalize")                      \
+    X(MATRIX_COPY, "matrix_copy")                                \
+    X(MATRIX_ADD, "matrix_add")                                  \
+    X(MATRIX_SUBTRACT, "matrix_subtract")                        \
+    X(MATRIX_SCALE, "matrix_scale")                              \
+    X(MATRIX_AXPY, "matrix_axpy")                                \
+    X(MATRIX_TRANSPOSE, "matrix_transpose")                      \
+    X(MATRIX_MULTIPLY, "matrix_multiply")                        \
+    X(MATRIX_VECTOR_MULTIPLY, "matrix_vector_multiply")          \
+    X(MATRIX_LU, "matrix_lu")                                    \
+    X(MATRIX_LU_SOLVE, "matrix_lu_solve")                        \
+    X(SPARSE_VECTOR_MULTIPLY, "sparse_matrix_vector_multiply")   \
+    X(SPARSE_MULTIPLY, "sparse_matrix_multiply")                 \
+    X(BATCH_MULTIPLY, "matrix_multiply_batched")                 \
+    X(BATCH_VECTOR_MULTIPLY, "matrix_vector_multiply_batched")   \
+    X(BATCH_DETERMINANT, "matrix_determinant_batched")           \
+    X(FILE_VECTOR_MULTIPLY, "matrix_file_vector_multiply")       \
+    X(FILE_MULTIPLY, "matrix_file_multiply")
+
+typedef enum {
+#define PERF_OP_ENUM(name, label) PERF_OP_##name,
+    PERF_OP_LIST(PERF_OP_ENUM)
+#undef PERF_OP_ENUM
+    PERF_OP_COUNT
+} PerfOp;
+
+// Hardware events, counted with perf_event_open on Linux
+typedef enum {
+    PERF_HW_CYCLES,
+    PERF_HW_INSTRUCTIONS,
+    PERF_HW_CACHE_MISSES,
+    PERF_HW_COUNT
+} PerfHardwareEvent;
+
+typedef struct {
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t flops;
+    // Cycle-counter ticks spent inside the op; see perf_ticks_per_second
+    uint64_t ticks;
+    // Zero unless perf_hardware_enable succeeded. Events are counted on the
+    // calling thread only, so thread-pool workers' share of a parallel op
+    // is missing.
+    uint64_t hardware[PERF_HW_COUNT];
+} PerfOpCounters;
+
+typedef struct {
+    PerfOpCounters ops[PERF_OP_COUNT];
+    // Buffers handed out by vector_create_with and matrix_create_with
+    uint64_t vector_allocs;
+    uint64_t matrix_allocs;
+    uint64_t alloc_bytes;
+} PerfSnapshot;
+
+void perf_counters_enable(int enabled);
+int perf_counters_enabled(void);
+// Starts counting hardware events on every thread's next instrumented
+// call. Returns ERROR_UNSUPPORTED when perf_event_open is unavailable or
+// not permitted (see /proc/sys/kernel/perf_event_paranoid).
+int perf_hardware_enable(int enabled);
+// Totals since the last perf_reset, summed over all threads (including
+// threads that have exited)
+int perf_snapshot(PerfSnapshot *snapshot);
+void perf_reset(void);
+const char *perf_op_name(PerfOp op);
+// Rate of the tick counter, measured once on first use
+double perf_ticks_per_second(void);
+// One line per op that was called
+int perf_snapshot_print(const PerfSnapshot *snapshot, FILE *out);
+
+// Instrumentation for library code
+// perf_begin on entry, once arguments are validated, and perf_end on the
+// successful exit:
+//     PerfScope scope;
+//     perf_begin(&scope);
+//     ...
+//     perf_end(&scope, PERF_OP_VECTOR_ADD, 24 * n, n);
+typedef struct {
+    // 0 when counting was off at perf_begin
+    uint64_t start;
+    int has_hardware;
+    uint64_t hardware[PERF_HW_COUNT];
+} PerfScope;
+
+extern int perf_active;
+
+void perf_scope_start(PerfScope *scope);
+void perf_scope_stop(const PerfScope *scope, PerfOp op, uint64_t bytes,
+                     uint64_t flops);
+void perf_record_alloc(int matrix, uint64_t bytes);
+
+static inline void perf_begin(PerfScope *scope) {
+    scope->start = 0;
+    if (__atomic_load_n(&perf_active, __ATOMIC_RELAXED)) {
+        perf_scope_start(scope);
+    }
+}
+
+static inline void perf_end(const PerfScope *scope, PerfOp op, uint64_t bytes,
+                            uint64_t flops) {
+    if (scope->start != 0) {
+        perf_scope_stop(scope, op, bytes, flops);
+    }
+}
+
+static inline void perf_alloc(int matrix, uint64_t bytes) {
+    if (__atomic_load_n(&perf_active, __ATOMIC_RELAXED)) {
+        perf_record_alloc(matrix, bytes);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // PERF_COUNTERS_H
\ No newline at end of file
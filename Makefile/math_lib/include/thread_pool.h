@@ -0,0 +1,96 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Library-owned worker pool used by the parallel matrix kernels
+// The pool is created once with thread_pool_init and shared by every
+// operation. Until it is initialized (or after thread_pool_shutdown) all
+// operations run on the calling thread.
+//
+// Scheduling is by work stealing: each worker keeps the tasks it spawns in
+// its own deque and runs the newest first, and an idle thread steals the
+// oldest task of another worker. Threads waiting for tasks (including
+// application threads outside the pool) run queued tasks meanwhile, so
+// recursive and nested parallelism shares the same workers.
+
+// Default minimum work (roughly element updates) per parallel chunk; below
+// this an operation stays single-threaded to avoid dispatch overhead
+#define THREAD_POOL_DEFAULT_MIN_WORK 65536
+
+// Body of a parallel loop: process indices [begin, end)
+typedef void (*ParallelForFn)(void *ctx, int begin, int end);
+
+// Start num_threads - 1 workers (the caller is the last thread); 0 picks
+// the number of online CPUs. pin != 0 binds worker i to CPU
+// (i + 1) % ncpus, leaving CPU 0 to the caller, which is not pinned.
+int thread_pool_init(int num_threads, int pin);
+void thread_pool_shutdown(void);
+
+// Threads that take part in a parallel loop, including the caller
+int thread_pool_size(void);
+
+void thread_pool_set_min_work(size_t work);
+size_t thread_pool_min_work(void);
+
+// Run fn over [begin, end) split into chunks of at least grain indices.
+// Runs inline when the pool is not started or the range fits in one chunk.
+// The range is halved recursively as threads steal from it, so uneven
+// iterations balance out; a loop nested inside another loop or a task
+// runs on the pool as well.
+void parallel_for(int begin, int end, int grain, ParallelForFn fn, void *ctx);
+
+// Grain (in indices) that gives each chunk at least the configured minimum
+// work when one index costs work_per_index
+int parallel_grain(size_t work_per_index);
+
+// Fork/join tasks
+// A Task is one spawned call, fn(ctx), counted in a TaskGroup until it
+// finishes. The caller owns both: they must stay valid, and the task must
+// not be respawned, until task_group_wait on the group returns (variables
+// in the spawning frame are the usual choice). Tasks may spawn and wait on
+// groups of their own. Spawning is safe from any thread, so applications
+// can run their own work on the library's workers instead of a second
+// pool.
+//
+//     TaskGroup group = TASK_GROUP_INIT;
+//     Task left;
+//     task_spawn(&group, &left, solve_half, &lower);
+//     solve_half(&upper);
+//     task_group_wait(&group);
+typedef void (*TaskFn)(void *ctx);
+
+typedef struct {
+    // Spawned tasks that have not finished; accessed atomically
+    int pending;
+} TaskGroup;
+
+typedef struct Task {
+    TaskFn fn;
+    void *ctx;
+    TaskGroup *group;
+    struct Task *next;
+} Task;
+
+#define TASK_GROUP_INIT {0}
+
+void task_group_init(TaskGroup *group);
+// Queue fn(ctx) for any pool thread. Runs it before returning when the
+// pool is not started (or has no workers) or the caller's deque is full.
+void task_spawn(TaskGroup *group, Task *task, TaskFn fn, void *ctx);
+// Return once every task spawned into group has finished, running queued
+// tasks in the meantime
+void task_group_wait(TaskGroup *group);
+
+// Run a(a_ctx) and b(b_ctx), in parallel when a thread is free to take b
+void parallel_invoke(TaskFn a, void *a_ctx, TaskFn b, void *b_ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // THREAD_POOL_H
\ No newline at end of file
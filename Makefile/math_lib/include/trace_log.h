@@ -0,0 +1,51 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trace log
+// DEBUG_PRINT (common.h) formats its line into a ring owned by the calling
+// thread, so tracing under threads takes no lock and never waits on
+// stdout. Off by default; while off, a trace point costs one relaxed load
+// and a branch. Debug builds (-DDEBUG) and MATHLIB_TRACE=1 in the
+// environment start with tracing on. A ring keeps the newest
+// TRACE_RING_RECORDS lines of its thread, each cut to TRACE_TEXT_BYTES - 1
+// characters. Rings are allocated on a thread's first record, so recording
+// never allocates after that, and are handed to new threads once their
+// thread exits. Trace points reached after that, from thread-local
+// destructors of the exiting thread, record nothing.
+//
+// trace_dump may run at any time from any thread; records overwritten
+// while it reads them are skipped. The rings hang off the global
+// trace_rings as plain NUL-terminated text, so they can also be read from
+// a core file, e.g. in gdb on a build with debug info:
+//     print trace_rings->records[(trace_rings->head - 1) % 512].line.text
+// shows the newest line of the first ring in the list; follow
+// trace_rings->next for the other threads' rings.
+#define TRACE_RING_RECORDS 512
+#define TRACE_TEXT_BYTES 104
+
+void trace_enable(int enabled);
+int trace_enabled(void);
+// Every retained record, grouped by thread and oldest first, one line
+// each: "[tid] seconds text". Returns the number of records written.
+int trace_dump(FILE *out);
+// Drop the records written so far from later dumps
+void trace_clear(void);
+
+// Recording, for DEBUG_PRINT
+extern int trace_active;
+
+void trace_record(const char *fmt, ...)
+    __attribute__((cold, format(printf, 1, 2)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TRACE_LOG_H
\ No newline at end of file
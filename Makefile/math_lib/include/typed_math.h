@@ -0,0 +1,53 @@
+#ifndef TYPED_MATH_H
+#define TYPED_MATH_H
+
+#include <stdint.h>
+
+#include "matrix_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Single- and reduced-precision vectors and matrices
+// Every element type gets the same types and operations, stamped out from
+// typed_math_template.h:
+//   F32  (VectorF32, vector_f32_*)   float storage and arithmetic
+//   BF16 (VectorBF16, vector_bf16_*) bfloat16 storage: float's 8-bit
+//                                    exponent with a 7-bit mantissa
+//   F16  (VectorF16, vector_f16_*)   IEEE binary16 storage: 5-bit exponent,
+//                                    10-bit mantissa
+// The 16-bit formats are storage only. Elements are widened to float, all
+// arithmetic happens in float, and results are rounded to nearest-even on
+// store. Dot products and matrix products accumulate in float and round
+// once per output element.
+
+typedef uint16_t bf16_t;
+typedef uint16_t f16_t;
+
+// Scalar conversions; float_to_f16 overflows to infinity above 65504
+float bf16_to_float(bf16_t x);
+bf16_t float_to_bf16(float x);
+float f16_to_float(f16_t x);
+f16_t float_to_f16(float x);
+
+#define TYPED_NAME F32
+#define TYPED_PREFIX f32
+#define TYPED_ELEM float
+#include "typed_math_template.h"
+
+#define TYPED_NAME BF16
+#define TYPED_PREFIX bf16
+#define TYPED_ELEM bf16_t
+#include "typed_math_template.h"
+
+#define TYPED_NAME F16
+#define TYPED_PREFIX f16
+#define TYPED_ELEM f16_t
+#include "typed_math_template.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TYPED_MATH_H
\ No newline at end of file
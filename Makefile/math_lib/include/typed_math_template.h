@@ -0,0 +1,70 @@
+// Declarations for one element type of typed_math.h
+// Included once per type with TYPED_NAME (type suffix), TYPED_PREFIX
+// (function infix) and TYPED_ELEM (storage type) defined; there is
+// deliberately no include guard. The parameters are undefined at the end.
+
+#ifndef TYPED_CAT
+#define TYPED_CAT_(a, b) a##b
+#define TYPED_CAT(a, b) TYPED_CAT_(a, b)
+#define TYPED_VECTOR TYPED_CAT(Vector, TYPED_NAME)
+#define TYPED_MATRIX TYPED_CAT(Matrix, TYPED_NAME)
+// vector_<prefix>_<op> and matrix_<prefix>_<op>
+#define TYPED_VFN(op) TYPED_CAT(TYPED_CAT(vector_, TYPED_PREFIX), _##op)
+#define TYPED_MFN(op) TYPED_CAT(TYPED_CAT(matrix_, TYPED_PREFIX), _##op)
+#endif
+
+// Same layout rules as Vector and Matrix: rows start on MATRIX_ALIGNMENT
+// boundaries and data is owned by allocator (NULL = heap)
+typedef struct {
+    int size;
+    TYPED_ELEM *data;
+    Allocator *allocator;
+} TYPED_VECTOR;
+
+typedef struct {
+    int rows;
+    int cols;
+    int stride;
+    TYPED_ELEM *data;
+    Allocator *allocator;
+} TYPED_MATRIX;
+
+// Vectors; create draws from allocator_current() and zero-fills
+int TYPED_VFN(create)(int size, TYPED_VECTOR *result);
+void TYPED_VFN(free)(TYPED_VECTOR *v);
+// Conversions to and from double; the destination must already exist
+int TYPED_VFN(from_double)(const Vector *src, TYPED_VECTOR *dst);
+int TYPED_VFN(to_double)(const TYPED_VECTOR *src, Vector *dst);
+int TYPED_VFN(add_into)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                        TYPED_VECTOR *result);
+int TYPED_VFN(subtract_into)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                             TYPED_VECTOR *result);
+int TYPED_VFN(scale_into)(const TYPED_VECTOR *v, float scalar,
+                          TYPED_VECTOR *result);
+// y = alpha * x + y
+int TYPED_VFN(axpy)(float alpha, const TYPED_VECTOR *x, TYPED_VECTOR *y);
+int TYPED_VFN(dot_product)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                           float *result);
+
+// Matrices; same aliasing rules as the double _into operations
+int TYPED_MFN(create)(int rows, int cols, TYPED_MATRIX *result);
+void TYPED_MFN(free)(TYPED_MATRIX *m);
+int TYPED_MFN(from_double)(const Matrix *src, TYPED_MATRIX *dst);
+int TYPED_MFN(to_double)(const TYPED_MATRIX *src, Matrix *dst);
+int TYPED_MFN(add_into)(const TYPED_MATRIX *m1, const TYPED_MATRIX *m2,
+                        TYPED_MATRIX *result);
+int TYPED_MFN(subtract_into)(const TYPED_MATRIX *m1, const TYPED_MATRIX *m2,
+                             TYPED_MATRIX *result);
+int TYPED_MFN(scale_into)(const TYPED_MATRIX *m, float scalar,
+                          TYPED_MATRIX *result);
+// result = alpha * m1 * m2 + beta * result
+int TYPED_MFN(multiply_into)(float alpha, const TYPED_MATRIX *m1,
+                             const TYPED_MATRIX *m2, float beta,
+                             TYPED_MATRIX *result);
+int TYPED_MFN(vector_multiply_into)(const TYPED_MATRIX *m,
+                                    const TYPED_VECTOR *v,
+                                    TYPED_VECTOR *result);
+
+#undef TYPED_NAME
+#undef TYPED_PREFIX
+#undef TYPED_ELEM
\ No newline at end of file
@@ -0,0 +1,83 @@
+#ifndef VECTOR_EXPR_H
+#define VECTOR_EXPR_H
+
+#include "vector_math.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Lazy element-wise vector expressions
+// An expression is a list of nodes built bottom-up; every node refers only
+// to nodes created before it. Evaluation walks the list one cache-sized
+// block of elements at a time, so a chain such as dot(k * (a + b), c) reads
+// each input once, in a single pass, with no intermediate Vectors.
+//
+// The builder functions return the new node's index, or a negative error
+// code. Any operand that is already an error is passed straight through,
+// which lets calls nest:
+//
+//   VectorExpr e;
+//   vector_expr_init(&e);
+//   int sum = vector_expr_add(&e, vector_expr_input(&e, &a),
+//                             vector_expr_input(&e, &b));
+//   vector_expr_dot(&e, vector_expr_scale(&e, sum, k),
+//                   vector_expr_input(&e, &c), &result);
+//
+// Input vectors are referenced, not copied, and must outlive evaluation.
+// The result of vector_expr_eval may be one of the inputs. Evaluation
+// rejects a node list the builders could not have produced (an operand
+// that does not precede its node, an unknown op) with
+// ERROR_INVALID_DIMENSION.
+
+#define VECTOR_EXPR_MAX_NODES 16
+
+typedef enum {
+    VECTOR_EXPR_INPUT,
+    VECTOR_EXPR_CONSTANT,
+    VECTOR_EXPR_ADD,
+    VECTOR_EXPR_SUBTRACT,
+    VECTOR_EXPR_MULTIPLY,
+    VECTOR_EXPR_DIVIDE,
+    VECTOR_EXPR_SCALE,
+} VectorExprOp;
+
+typedef struct {
+    VectorExprOp op;
+    int a;
+    int b;
+    double scalar;
+    const double *data;
+} VectorExprNode;
+
+typedef struct {
+    // Element count shared by every input; 0 until the first input
+    int size;
+    int count;
+    VectorExprNode nodes[VECTOR_EXPR_MAX_NODES];
+} VectorExpr;
+
+void vector_expr_init(VectorExpr *e);
+
+int vector_expr_input(VectorExpr *e, const Vector *v);
+// Same value in every element
+int vector_expr_constant(VectorExpr *e, double value);
+int vector_expr_add(VectorExpr *e, int a, int b);
+int vector_expr_subtract(VectorExpr *e, int a, int b);
+// Element-wise product and quotient (IEEE semantics, no zero check)
+int vector_expr_multiply(VectorExpr *e, int a, int b);
+int vector_expr_divide(VectorExpr *e, int a, int b);
+int vector_expr_scale(VectorExpr *e, int a, double scalar);
+
+// Materialize node root into result, which must have the expression size
+// (any size when the expression has no inputs)
+int vector_expr_eval(const VectorExpr *e, int root, Vector *result);
+// Reductions that never materialize their operands
+int vector_expr_sum(const VectorExpr *e, int root, double *result);
+int vector_expr_dot(const VectorExpr *e, int a, int b, double *result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // VECTOR_EXPR_H
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef VECTOR_KERNELS_H
+#define VECTOR_KERNELS_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Raw element-wise kernels over double arrays, one implementation per ISA.
+// Callers validate arguments; kernels accept any alignment and n == 0.
+typedef struct {
+    const char *name;
+    void (*add)(const double *a, const double *b, double *out, size_t n);
+    void (*subtract)(const double *a, const double *b, double *out, size_t n);
+    void (*scale)(const double *a, double scalar, double *out, size_t n);
+    // y += alpha * x
+    void (*axpy)(double alpha, const double *x, double *y, size_t n);
+    double (*dot)(const double *a, const double *b, size_t n);
+    double (*sum_squares)(const double *a, size_t n);
+    double (*sum)(const double *a, size_t n);
+} VectorKernels;
+
+// Kernel table for the running CPU, selected once on first use.
+// MATHLIB_ISA=scalar|sse2|avx2|avx512|neon in the environment forces a
+// specific table when the CPU supports it.
+const VectorKernels *vector_kernels(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // VECTOR_KERNELS_H
\ No newline at end of file
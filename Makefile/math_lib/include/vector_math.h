@@ -1,22 +1,91 @@
 #ifndef VECTOR_MATH_H
 #define VECTOR_MATH_H
 
+#include "allocator.h"
 #include "common.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 // Vector struct definition
+// data is owned by allocator (NULL = heap) and released by vector_free
 typedef struct {
     int size;
     double *data;
+    Allocator *allocator;
 } Vector;
 
+// Element access without bounds checks, for tight loops; i must be in
+// [0, size)
+#define VECTOR_AT(v, i) ((v)->data[i])
+
+static inline double vector_get(const Vector *v, int i) {
+    return v->data[i];
+}
+
+static inline void vector_set(Vector *v, int i, double value) {
+    v->data[i] = value;
+}
+
 // Function prototypes for vector operations
+// vector_create draws from allocator_current() for the calling thread
 int vector_create(int size, Vector *result);
+int vector_create_with(int size, Allocator *allocator, Vector *result);
+// Contents are left undefined for a caller that overwrites every element;
+// large zeroed heap vectors are cheap anyway (see allocator_pages)
+int vector_create_uninitialized(int size, Vector *result);
+int vector_create_uninitialized_with(int size, Allocator *allocator,
+                                     Vector *result);
 void vector_free(Vector *v);
 int vector_add(const Vector *v1, const Vector *v2, Vector *result);
 int vector_subtract(const Vector *v1, const Vector *v2, Vector *result);
 int vector_scale(const Vector *v, double scalar, Vector *result);
 int vector_dot_product(const Vector *v1, const Vector *v2, double *result);
+// Magnitude and normalization rescale internally when squaring would
+// overflow or underflow; the magnitude only overflows when the norm itself
+// exceeds DBL_MAX
 int vector_magnitude(const Vector *v, double *result);
 int vector_normalize(const Vector *v, Vector *result);
 
+// Non-allocating variants
+// The destination must already be created with the operand size. For the
+// element-wise operations the destination may be the same Vector as either
+// operand (exact aliasing); partially overlapping buffers are not allowed.
+int vector_copy(const Vector *src, Vector *dst);
+int vector_add_into(const Vector *v1, const Vector *v2, Vector *result);
+int vector_subtract_into(const Vector *v1, const Vector *v2, Vector *result);
+int vector_scale_into(const Vector *v, double scalar, Vector *result);
+int vector_scale_inplace(Vector *v, double scalar);
+// y = alpha * x + y
+int vector_axpy(double alpha, const Vector *x, Vector *y);
+int vector_normalize_into(const Vector *v, Vector *result);
+int vector_normalize_inplace(Vector *v);
+
+// Reduction modes
+// FAST: independent SIMD accumulators, the mode used by vector_dot_product
+//   and vector_magnitude; bounded by add/FMA throughput, error grows with n
+// PAIRWISE: tree of FAST blocks; about as fast, error grows with log n
+// COMPENSATED: error-free TwoSum/TwoProduct transforms; as accurate as
+//   accumulating in twice the precision (no long double needed), at a few
+//   times the cost of FAST
+// vector_magnitude_mode falls back to the rescaling FAST magnitude when the
+// sum of squares overflows or underflows.
+typedef enum {
+    REDUCTION_FAST,
+    REDUCTION_PAIRWISE,
+    REDUCTION_COMPENSATED,
+} ReductionMode;
+
+int vector_sum(const Vector *v, double *result);
+int vector_sum_mode(const Vector *v, ReductionMode mode, double *result);
+int vector_dot_product_mode(const Vector *v1, const Vector *v2,
+                            ReductionMode mode, double *result);
+int vector_magnitude_mode(const Vector *v, ReductionMode mode,
+                          double *result);
+
+#ifdef __cplusplus
+}
+#endif
+
 #endif  // VECTOR_MATH_H
\ No newline at end of file
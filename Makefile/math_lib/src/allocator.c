@@ -0,0 +1,426 @@
+#include "../include/allocator.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/common.h"
+
+// Header placed at the start of every arena block; data follows it
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t capacity;
+    size_t used;
+};
+
+// Offset of the first usable byte in a block, keeping data aligned
+#define ARENA_HEADER_SIZE                                   \
+    ((sizeof(ArenaBlock) + MATH_ALIGNMENT - 1) / MATH_ALIGNMENT * \
+     MATH_ALIGNMENT)
+
+static _Thread_local Allocator *current_allocator = NULL;
+
+Allocator *allocator_set_current(Allocator *allocator) {
+    Allocator *previous = current_allocator;
+    current_allocator = allocator;
+    return previous;
+}
+
+Allocator *allocator_current(void) { return current_allocator; }
+
+static void *heap_alloc(size_t size, size_t alignment) {
+    void *ptr = NULL;
+    if (posix_memalign(&ptr, alignment, size) != 0) {
+        return NULL;
+    }
+    return ptr;
+}
+
+void *allocator_alloc(Allocator *allocator, size_t size) {
+    if (allocator == NULL) {
+        return heap_alloc(size, MATH_ALIGNMENT);
+    }
+    return allocator->alloc(allocator->ctx, size, MATH_ALIGNMENT);
+}
+
+void allocator_free(Allocator *allocator, void *ptr, size_t size) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    if (allocator == NULL) {
+        free(ptr);
+    } else {
+        allocator->free(allocator->ctx, ptr, size);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Arena
+// ---------------------------------------------------------------------------
+
+static ArenaBlock *arena_block_create(size_t capacity) {
+    ArenaBlock *block =
+        (ArenaBlock *)heap_alloc(ARENA_HEADER_SIZE + capacity, MATH_ALIGNMENT);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->capacity = capacity;
+    block->used = 0;
+    return block;
+}
+
+// Try to carve size bytes out of a block; returns NULL if it does not fit
+static void *arena_block_take(ArenaBlock *block, size_t size,
+                              size_t alignment) {
+    size_t offset = (block->used + alignment - 1) / alignment * alignment;
+    if (offset > block->capacity || size > block->capacity - offset) {
+        return NULL;
+    }
+
+    block->used = offset + size;
+    return (char *)block + ARENA_HEADER_SIZE + offset;
+}
+
+static void *arena_alloc(void *ctx, size_t size, size_t alignment) {
+    Arena *arena = (Arena *)ctx;
+
+    if (alignment > MATH_ALIGNMENT) {
+        return NULL;
+    }
+
+    void *ptr = arena_block_take(arena->current, size, alignment);
+    if (ptr != NULL) {
+        return ptr;
+    }
+
+    // Reuse blocks left behind by an earlier reset before growing
+    while (arena->current->next != NULL) {
+        arena->current = arena->current->next;
+        arena->current->used = 0;
+        ptr = arena_block_take(arena->current, size, alignment);
+        if (ptr != NULL) {
+            return ptr;
+        }
+    }
+
+    size_t capacity = size > arena->block_size ? size : arena->block_size;
+    ArenaBlock *block = arena_block_create(capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+
+    arena->current->next = block;
+    arena->current = block;
+    return arena_block_take(block, size, alignment);
+}
+
+static void arena_free(void *ctx, void *ptr, size_t size) {
+    // Arena memory is released in bulk by arena_reset
+    (void)ctx;
+    (void)ptr;
+    (void)size;
+}
+
+int arena_init(Arena *arena, size_t block_size) {
+    DEBUG_PRINT("Creating arena with %zu-byte blocks\n", block_size);
+
+    if (arena == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (block_size == 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    arena->head = arena_block_create(block_size);
+    if (arena->head == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    arena->current = arena->head;
+    arena->block_size = block_size;
+    arena->allocator.alloc = arena_alloc;
+    arena->allocator.free = arena_free;
+    arena->allocator.ctx = arena;
+    arena->allocator.zeroed = 0;
+    return SUCCESS;
+}
+
+void arena_destroy(Arena *arena) {
+    DEBUG_PRINT("Destroying arena\n");
+
+    if (arena == NULL) {
+        return;
+    }
+
+    ArenaBlock *block = arena->head;
+    while (block != NULL) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+Allocator *arena_allocator(Arena *arena) {
+    return arena == NULL ? NULL : &arena->allocator;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark = {arena->current, arena->current->used};
+    return mark;
+}
+
+void arena_reset_to(Arena *arena, ArenaMark mark) {
+    if (mark.block == NULL) {
+        arena_reset(arena);
+        return;
+    }
+
+    arena->current = mark.block;
+    arena->current->used = mark.used;
+}
+
+void arena_reset(Arena *arena) {
+    arena->current = arena->head;
+    arena->current->used = 0;
+}
+
+// ---------------------------------------------------------------------------
+// Pool
+// ---------------------------------------------------------------------------
+
+// Smallest class whose buffers hold size bytes, or -1 if too large
+static int pool_class_for(size_t size) {
+    size_t class_size = POOL_MIN_SIZE;
+    for (int c = 0; c < POOL_NUM_CLASSES; c++) {
+        if (size <= class_size) {
+            return c;
+        }
+        class_size <<= 1;
+    }
+    return -1;
+}
+
+static void *pool_alloc(void *ctx, size_t size, size_t alignment) {
+    Pool *pool = (Pool *)ctx;
+    int c = pool_class_for(size);
+
+    if (c < 0 || alignment > MATH_ALIGNMENT) {
+        return heap_alloc(size, alignment);
+    }
+
+    void *ptr = pool->free_lists[c];
+    if (ptr != NULL) {
+        memcpy(&pool->free_lists[c], ptr, sizeof(void *));
+        return ptr;
+    }
+
+    return heap_alloc((size_t)POOL_MIN_SIZE << c, MATH_ALIGNMENT);
+}
+
+static void pool_free(void *ctx, void *ptr, size_t size) {
+    Pool *pool = (Pool *)ctx;
+    int c = pool_class_for(size);
+
+    if (c < 0) {
+        free(ptr);
+        return;
+    }
+
+    // The free list link is stored in the first bytes of the buffer
+    memcpy(ptr, &pool->free_lists[c], sizeof(void *));
+    pool->free_lists[c] = ptr;
+}
+
+int pool_init(Pool *pool) {
+    DEBUG_PRINT("Creating pool\n");
+
+    if (pool == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    for (int c = 0; c < POOL_NUM_CLASSES; c++) {
+        pool->free_lists[c] = NULL;
+    }
+
+    pool->allocator.alloc = pool_alloc;
+    pool->allocator.free = pool_free;
+    pool->allocator.ctx = pool;
+    pool->allocator.zeroed = 0;
+    return SUCCESS;
+}
+
+void pool_trim(Pool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+
+    for (int c = 0; c < POOL_NUM_CLASSES; c++) {
+        void *ptr = pool->free_lists[c];
+        while (ptr != NULL) {
+            void *next;
+            memcpy(&next, ptr, sizeof(void *));
+            free(ptr);
+            ptr = next;
+        }
+        pool->free_lists[c] = NULL;
+    }
+}
+
+void pool_destroy(Pool *pool) {
+    DEBUG_PRINT("Destroying pool\n");
+    pool_trim(pool);
+}
+
+Allocator *pool_allocator(Pool *pool) {
+    return pool == NULL ? NULL : &pool->allocator;
+}
+
+// ---------------------------------------------------------------------------
+// NUMA
+// ---------------------------------------------------------------------------
+
+// mbind is called through syscall rather than libnuma so the build needs no
+// extra library; the policy value matches <linux/mempolicy.h>
+#define NUMA_MPOL_INTERLEAVE 3
+#define NUMA_MAX_NODES 1024
+#define NUMA_MASK_WORDS (NUMA_MAX_NODES / (8 * sizeof(unsigned long)))
+#define NUMA_HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+// Parse the online node list ("0-3,6") into mask; returns the node count
+static int numa_online_nodes(unsigned long *mask) {
+    memset(mask, 0, NUMA_MASK_WORDS * sizeof(unsigned long));
+
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    if (f == NULL) {
+        return 1;
+    }
+
+    int count = 0;
+    int first, last;
+    char sep;
+    while (fscanf(f, "%d", &first) == 1) {
+        last = first;
+        if (fscanf(f, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(f, "%d", &last) != 1) {
+                break;
+            }
+            if (fscanf(f, "%c", &sep) != 1) {
+                sep = '\n';
+            }
+        }
+        for (int node = first; node <= last && node < NUMA_MAX_NODES;
+             node++) {
+            if (node >= 0) {
+                mask[node / (8 * sizeof(unsigned long))] |=
+                    1UL << (node % (8 * sizeof(unsigned long)));
+                count++;
+            }
+        }
+        if (sep != ',') {
+            break;
+        }
+    }
+    fclose(f);
+
+    return count > 0 ? count : 1;
+}
+
+int numa_node_count(void) {
+    unsigned long mask[NUMA_MASK_WORDS];
+    return numa_online_nodes(mask);
+}
+
+static size_t numa_round_up(size_t size, size_t unit) {
+    return (size + unit - 1) / unit * unit;
+}
+
+static void *numa_alloc(void *ctx, size_t size, size_t alignment) {
+    const NumaAllocator *numa = (const NumaAllocator *)ctx;
+    const int huge = (numa->flags & NUMA_FLAG_HUGE_PAGES) != 0;
+    const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    const size_t unit = huge ? NUMA_HUGE_PAGE_SIZE : page;
+
+    if (alignment > unit || size == 0) {
+        return NULL;
+    }
+
+    // Huge pages need a 2 MB aligned range: map one extra unit and trim
+    size_t length = numa_round_up(size, unit);
+    size_t mapped = huge ? length + unit : length;
+    char *base = (char *)mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    char *ptr = base;
+    if (huge) {
+        ptr = (char *)numa_round_up((size_t)(uintptr_t)base, unit);
+        if (ptr > base) {
+            munmap(base, (size_t)(ptr - base));
+        }
+        size_t tail = mapped - (size_t)(ptr - base) - length;
+        if (tail > 0) {
+            munmap(ptr + length, tail);
+        }
+        madvise(ptr, length, MADV_HUGEPAGE);
+    }
+
+    // Policies apply to pages not yet touched, which is all of them
+    if (numa->flags & NUMA_FLAG_INTERLEAVE) {
+        unsigned long mask[NUMA_MASK_WORDS];
+        if (numa_online_nodes(mask) > 1) {
+            syscall(SYS_mbind, ptr, length, NUMA_MPOL_INTERLEAVE, mask,
+                    (unsigned long)NUMA_MAX_NODES + 1, 0);
+        }
+    }
+
+    return ptr;
+}
+
+static void numa_free(void *ctx, void *ptr, size_t size) {
+    const NumaAllocator *numa = (const NumaAllocator *)ctx;
+    size_t unit = (numa->flags & NUMA_FLAG_HUGE_PAGES)
+                      ? NUMA_HUGE_PAGE_SIZE
+                      : (size_t)sysconf(_SC_PAGESIZE);
+    munmap(ptr, numa_round_up(size, unit));
+}
+
+int numa_allocator_init(NumaAllocator *numa, int flags) {
+    DEBUG_PRINT("Creating NUMA allocator with flags %#x\n", flags);
+
+    if (numa == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (flags & ~(NUMA_FLAG_INTERLEAVE | NUMA_FLAG_HUGE_PAGES)) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    numa->flags = flags;
+    numa->allocator.alloc = numa_alloc;
+    numa->allocator.free = numa_free;
+    numa->allocator.ctx = numa;
+    numa->allocator.zeroed = 1;
+    return SUCCESS;
+}
+
+Allocator *numa_allocator(NumaAllocator *numa) {
+    return numa == NULL ? NULL : &numa->allocator;
+}
+
+// Plain page mappings are the NUMA allocator with no policy
+static NumaAllocator page_allocator = {
+    0, {numa_alloc, numa_free, &page_allocator, 1}};
+
+Allocator *allocator_pages(void) { return &page_allocator.allocator; }
\ No newline at end of file
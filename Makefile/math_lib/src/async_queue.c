@@ -0,0 +1,439 @@
+#include "../include/async_queue.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "../include/blas_backend.h"
+
+// Operations taken off the queue per drain step
+#define ASYNC_BATCH_MAX 64
+// Vectors per fused matrix-vector unit; matrix_vector_multiply_many_into
+// streams the matrix once for all of them
+#define ASYNC_FUSE_MAX 32
+
+typedef enum {
+    ASYNC_CALL,
+    ASYNC_MATRIX_VECTOR_MULTIPLY,
+    ASYNC_MATRIX_MULTIPLY,
+    ASYNC_VECTOR_ADD,
+    ASYNC_VECTOR_SUBTRACT,
+    ASYNC_VECTOR_SCALE,
+    ASYNC_VECTOR_AXPY,
+} AsyncKind;
+
+struct AsyncOp {
+    AsyncKind kind;
+    AsyncFuture *future;
+    int status;
+
+    AsyncFn fn;
+    void *ctx;
+    double alpha;
+    double beta;
+    const Matrix *m1;
+    const Matrix *m2;
+    Matrix *c;
+    const Vector *v1;
+    const Vector *v2;
+    Vector *result;
+};
+
+// Operations run by one task: a single operation, or matrix-vector products
+// on the same matrix fused into one pass
+typedef struct {
+    AsyncQueue *queue;
+    AsyncOp *ops[ASYNC_FUSE_MAX];
+    int count;
+    Task task;
+} AsyncUnit;
+
+// Queues whose drain the calling thread is taking part in, innermost
+// first. Only that drain frees slots, so a submission to one of these
+// queues must not wait for the queue to have room.
+typedef struct AsyncScope {
+    const AsyncQueue *queue;
+    struct AsyncScope *outer;
+} AsyncScope;
+
+static _Thread_local AsyncScope *async_scopes;
+
+static void async_scope_enter(AsyncScope *scope, const AsyncQueue *queue) {
+    scope->queue = queue;
+    scope->outer = async_scopes;
+    async_scopes = scope;
+}
+
+static void async_scope_exit(AsyncScope *scope) {
+    async_scopes = scope->outer;
+}
+
+static int async_in_drain(const AsyncQueue *queue) {
+    for (const AsyncScope *s = async_scopes; s != NULL; s = s->outer) {
+        if (s->queue == queue) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int async_run_op(AsyncOp *op) {
+    switch (op->kind) {
+        case ASYNC_CALL:
+            return op->fn(op->ctx);
+        case ASYNC_MATRIX_VECTOR_MULTIPLY:
+            return matrix_vector_multiply_into(op->m1, op->v1, op->result);
+        case ASYNC_MATRIX_MULTIPLY:
+            return matrix_multiply_into(op->alpha, op->m1, op->m2, op->beta,
+                                        op->c);
+        case ASYNC_VECTOR_ADD:
+            return vector_add_into(op->v1, op->v2, op->result);
+        case ASYNC_VECTOR_SUBTRACT:
+            return vector_subtract_into(op->v1, op->v2, op->result);
+        case ASYNC_VECTOR_SCALE:
+            return vector_scale_into(op->v1, op->alpha, op->result);
+        case ASYNC_VECTOR_AXPY:
+            return vector_axpy(op->alpha, op->v1, op->result);
+    }
+    return ERROR_UNSUPPORTED;
+}
+
+// A product the fused pass can take: valid, built in (the vendor library
+// would take it otherwise) and row-major, so results match
+// matrix_vector_multiply_into exactly
+static int async_fusable(const AsyncOp *op) {
+    const Matrix *m = op->m1;
+    return op->kind == ASYNC_MATRIX_VECTOR_MULTIPLY && m != NULL &&
+           op->v1 != NULL && op->result != NULL && m->data != NULL &&
+           op->v1->data != NULL && op->result->data != NULL &&
+           !MATRIX_IS_TRANSPOSED(m) && op->v1->size == m->cols &&
+           op->result->size == m->rows &&
+           !blas_backend_use(BLAS_OP_GEMV,
+                             2 * (uint64_t)m->rows * (uint64_t)m->cols);
+}
+
+static void async_unit_task(void *ctx) {
+    AsyncUnit *unit = (AsyncUnit *)ctx;
+
+    if (unit->count == 1) {
+        AsyncScope scope;
+        async_scope_enter(&scope, unit->queue);
+        unit->ops[0]->status = async_run_op(unit->ops[0]);
+        async_scope_exit(&scope);
+        return;
+    }
+
+    // The copies share the operands' buffers
+    Vector v[ASYNC_FUSE_MAX];
+    Vector result[ASYNC_FUSE_MAX];
+    for (int j = 0; j < unit->count; j++) {
+        v[j] = *unit->ops[j]->v1;
+        result[j] = *unit->ops[j]->result;
+    }
+
+    int status = matrix_vector_multiply_many_into(unit->ops[0]->m1, v, result,
+                                                  unit->count);
+    for (int j = 0; j < unit->count; j++) {
+        unit->ops[j]->status = status;
+    }
+}
+
+// Group the batch into units and run them as tasks
+static void async_run_batch(AsyncQueue *queue, AsyncOp *ops, int n) {
+    AsyncUnit units[ASYNC_BATCH_MAX];
+    char used[ASYNC_BATCH_MAX] = {0};
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (used[i]) {
+            continue;
+        }
+
+        AsyncUnit *unit = &units[count++];
+        unit->queue = queue;
+        unit->ops[0] = &ops[i];
+        unit->count = 1;
+        if (!async_fusable(&ops[i])) {
+            continue;
+        }
+
+        for (int j = i + 1; j < n && unit->count < ASYNC_FUSE_MAX; j++) {
+            if (!used[j] && ops[j].m1 == ops[i].m1 && async_fusable(&ops[j])) {
+                unit->ops[unit->count++] = &ops[j];
+                used[j] = 1;
+            }
+        }
+    }
+
+    TaskGroup group = TASK_GROUP_INIT;
+    for (int u = 1; u < count; u++) {
+        task_spawn(&group, &units[u].task, async_unit_task, &units[u]);
+    }
+    async_unit_task(&units[0]);
+    task_group_wait(&group);
+}
+
+// Take batches until the queue is empty; one drain runs at a time
+static void async_drain(void *ctx) {
+    AsyncQueue *queue = (AsyncQueue *)ctx;
+    AsyncOp batch[ASYNC_BATCH_MAX];
+    // Covers the callbacks and any task this thread runs while waiting
+    AsyncScope scope;
+    async_scope_enter(&scope, queue);
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count > 0) {
+        int n = queue->count < ASYNC_BATCH_MAX ? queue->count : ASYNC_BATCH_MAX;
+        for (int i = 0; i < n; i++) {
+            batch[i] = queue->ops[(queue->head + i) % queue->capacity];
+        }
+        queue->head = (queue->head + n) % queue->capacity;
+        queue->count -= n;
+        pthread_mutex_unlock(&queue->lock);
+
+        async_run_batch(queue, batch, n);
+
+        for (int i = 0; i < n; i++) {
+            AsyncFuture *future = batch[i].future;
+            if (future != NULL && future->callback != NULL) {
+                future->callback(future->user, batch[i].status);
+            }
+        }
+
+        pthread_mutex_lock(&queue->lock);
+        for (int i = 0; i < n; i++) {
+            AsyncFuture *future = batch[i].future;
+            if (future != NULL) {
+                future->status = batch[i].status;
+                __atomic_store_n(&future->done, 1, __ATOMIC_RELEASE);
+            }
+            if (batch[i].status != SUCCESS && queue->first_error == SUCCESS) {
+                queue->first_error = batch[i].status;
+            }
+        }
+        queue->pending -= n;
+        pthread_cond_broadcast(&queue->completed);
+    }
+    queue->draining = 0;
+    pthread_mutex_unlock(&queue->lock);
+    async_scope_exit(&scope);
+}
+
+static int async_enqueue(AsyncQueue *queue, AsyncOp *op) {
+    if (queue == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->capacity) {
+        // Waiting from inside the drain would wait on itself
+        if (async_in_drain(queue)) {
+            pthread_mutex_unlock(&queue->lock);
+            return ERROR_UNSUPPORTED;
+        }
+
+        // Full: help the drain along instead of sleeping, which also keeps
+        // a submitter running on a pool worker from starving it
+        pthread_mutex_unlock(&queue->lock);
+        task_group_wait(&queue->group);
+        pthread_mutex_lock(&queue->lock);
+    }
+
+    if (op->future != NULL) {
+        op->future->status = SUCCESS;
+        __atomic_store_n(&op->future->done, 0, __ATOMIC_RELAXED);
+    }
+    op->status = SUCCESS;
+
+    queue->ops[(queue->head + queue->count) % queue->capacity] = *op;
+    queue->count++;
+    queue->pending++;
+    int start = !queue->draining;
+    queue->draining = 1;
+    pthread_mutex_unlock(&queue->lock);
+
+    // The previous drain has read its task before clearing draining, so
+    // the Task can be reused
+    if (start) {
+        task_spawn(&queue->group, &queue->drain, async_drain, queue);
+    }
+    return SUCCESS;
+}
+
+int async_queue_init(AsyncQueue *queue, int capacity) {
+    DEBUG_PRINT("Creating async queue of %d operations\n", capacity);
+
+    if (queue == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (capacity <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    queue->ops = (AsyncOp *)malloc((size_t)capacity * sizeof(AsyncOp));
+    if (queue->ops == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
+    queue->pending = 0;
+    queue->draining = 0;
+    queue->first_error = SUCCESS;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->completed, NULL);
+    task_group_init(&queue->group);
+    return SUCCESS;
+}
+
+void async_queue_destroy(AsyncQueue *queue) {
+    DEBUG_PRINT("Destroying async queue\n");
+
+    if (queue == NULL || queue->ops == NULL) {
+        return;
+    }
+
+    async_wait_all(queue);
+    // The last drain may still be between its final unlock and returning
+    task_group_wait(&queue->group);
+
+    pthread_cond_destroy(&queue->completed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->ops);
+    queue->ops = NULL;
+}
+
+void async_future_init(AsyncFuture *future, AsyncCallback callback,
+                       void *user) {
+    future->status = SUCCESS;
+    future->done = 0;
+    future->callback = callback;
+    future->user = user;
+}
+
+int async_future_done(const AsyncFuture *future) {
+    return __atomic_load_n(&future->done, __ATOMIC_ACQUIRE);
+}
+
+int async_wait(AsyncQueue *queue, AsyncFuture *future) {
+    DEBUG_PRINT("Waiting for async operation\n");
+
+    if (queue == NULL || future == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (!__atomic_load_n(&future->done, __ATOMIC_ACQUIRE)) {
+        pthread_cond_wait(&queue->completed, &queue->lock);
+    }
+    int status = future->status;
+    pthread_mutex_unlock(&queue->lock);
+    return status;
+}
+
+int async_wait_all(AsyncQueue *queue) {
+    DEBUG_PRINT("Waiting for all async operations\n");
+
+    if (queue == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->pending > 0) {
+        pthread_cond_wait(&queue->completed, &queue->lock);
+    }
+    int status = queue->first_error;
+    queue->first_error = SUCCESS;
+    pthread_mutex_unlock(&queue->lock);
+    return status;
+}
+
+int async_submit(AsyncQueue *queue, AsyncFn fn, void *ctx,
+                 AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async call\n");
+
+    if (fn == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    AsyncOp op = {.kind = ASYNC_CALL, .future = future, .fn = fn, .ctx = ctx};
+    return async_enqueue(queue, &op);
+}
+
+int async_matrix_vector_multiply(AsyncQueue *queue, const Matrix *m,
+                                 const Vector *v, Vector *result,
+                                 AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async matrix-vector multiply\n");
+
+    AsyncOp op = {.kind = ASYNC_MATRIX_VECTOR_MULTIPLY,
+                  .future = future,
+                  .m1 = m,
+                  .v1 = v,
+                  .result = result};
+    return async_enqueue(queue, &op);
+}
+
+int async_matrix_multiply(AsyncQueue *queue, double alpha, const Matrix *m1,
+                          const Matrix *m2, double beta, Matrix *result,
+                          AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async matrix multiply\n");
+
+    AsyncOp op = {.kind = ASYNC_MATRIX_MULTIPLY,
+                  .future = future,
+                  .alpha = alpha,
+                  .beta = beta,
+                  .m1 = m1,
+                  .m2 = m2,
+                  .c = result};
+    return async_enqueue(queue, &op);
+}
+
+int async_vector_add(AsyncQueue *queue, const Vector *v1, const Vector *v2,
+                     Vector *result, AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async vector add\n");
+
+    AsyncOp op = {.kind = ASYNC_VECTOR_ADD,
+                  .future = future,
+                  .v1 = v1,
+                  .v2 = v2,
+                  .result = result};
+    return async_enqueue(queue, &op);
+}
+
+int async_vector_subtract(AsyncQueue *queue, const Vector *v1,
+                          const Vector *v2, Vector *result,
+                          AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async vector subtract\n");
+
+    AsyncOp op = {.kind = ASYNC_VECTOR_SUBTRACT,
+                  .future = future,
+                  .v1 = v1,
+                  .v2 = v2,
+                  .result = result};
+    return async_enqueue(queue, &op);
+}
+
+int async_vector_scale(AsyncQueue *queue, const Vector *v, double scalar,
+                       Vector *result, AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async vector scale\n");
+
+    AsyncOp op = {.kind = ASYNC_VECTOR_SCALE,
+                  .future = future,
+                  .alpha = scalar,
+                  .v1 = v,
+                  .result = result};
+    return async_enqueue(queue, &op);
+}
+
+int async_vector_axpy(AsyncQueue *queue, double alpha, const Vector *x,
+                      Vector *y, AsyncFuture *future) {
+    DEBUG_PRINT("Submitting async vector axpy\n");
+
+    AsyncOp op = {.kind = ASYNC_VECTOR_AXPY,
+                  .future = future,
+                  .alpha = alpha,
+                  .v1 = x,
+                  .result = y};
+    return async_enqueue(queue, &op);
+}
\ No newline at end of file
@@ -0,0 +1,714 @@
+#include "../include/basic_math.h"
+
+#include <limits.h>
+#include <math.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/thread_pool.h"
+#include "../include/vector_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define BASIC_BATCH_X86 1
+#else
+#define BASIC_BATCH_X86 0
+#endif
+
+// The Makefile builds this file with -ffp-contract=off, which the
+// error-free transforms need, and -fno-math-errno so sqrt vectorizes.
+
+// Elements per parallel_for index
+#define BASIC_BLOCK 2048
+#define BASIC_LANES 4
+
+typedef double BasicDouble4 __attribute__((vector_size(32)));
+typedef int64_t BasicInt4 __attribute__((vector_size(32)));
+typedef uint64_t BasicUint4 __attribute__((vector_size(32)));
+
+#define BASIC_SPLAT(x) ((BasicDouble4){(x), (x), (x), (x)})
+
+#define BASIC_INLINE static inline __attribute__((always_inline))
+
+// Knuth's TwoSum: a + b == s + e exactly
+#define BASIC_TWO_SUM(a, b, s, e)            \
+    do {                                     \
+        BasicDouble4 a_ = (a), b_ = (b);     \
+        (s) = a_ + b_;                       \
+        BasicDouble4 z_ = (s) - a_;          \
+        (e) = (a_ - ((s) - z_)) + (b_ - z_); \
+    } while (0)
+
+// TwoProduct: x * y == p + e exactly. The fused form expects an FMA
+// target, where the per-lane fma calls combine into one vector FMA;
+// otherwise Dekker's product, exact barring overflow in the Veltkamp split
+// (inputs stay far below 2^996 here).
+#define BASIC_TWO_PRODUCT(x, y, p, e, fused)                                 \
+    do {                                                                     \
+        BasicDouble4 x_ = (x), y_ = (y);                                     \
+        (p) = x_ * y_;                                                       \
+        if (fused) {                                                         \
+            for (int l_ = 0; l_ < BASIC_LANES; l_++) {                       \
+                (e)[l_] = fma(x_[l_], y_[l_], -(p)[l_]);                     \
+            }                                                                \
+        } else {                                                             \
+            BasicDouble4 cx_ = 134217729.0 * x_;                             \
+            BasicDouble4 cy_ = 134217729.0 * y_;                             \
+            BasicDouble4 xh_ = cx_ - (cx_ - x_);                             \
+            BasicDouble4 yh_ = cy_ - (cy_ - y_);                             \
+            BasicDouble4 xl_ = x_ - xh_;                                     \
+            BasicDouble4 yl_ = y_ - yh_;                                     \
+            (e) = xl_ * yl_ - ((((p) - xh_ * yh_) - xl_ * yh_) - xh_ * yl_); \
+        }                                                                    \
+    } while (0)
+
+// Lane-wise mask ? a : b, with mask lanes all ones or all zeros. Vectors
+// travel through macros and pointers: passing them by value would change
+// the calling convention between the generic and AVX2 kernels.
+#define BASIC_SELECT(mask, a, b)                                             \
+    ((BasicDouble4)(((mask) & (BasicInt4)(a)) | (~(mask) & (BasicInt4)(b))))
+
+// ---------------------------------------------------------------------------
+// log
+// ---------------------------------------------------------------------------
+
+// x = 2^k z with z in [OFF, 2 OFF), OFF ~ sqrt(1/2). The top 7 bits of z's
+// offset from OFF pick one of 128 subintervals with centre c, and
+//     log(x) = k ln2 + log(c) + log1p(r),   r = z / c - 1,  |r| < 2^-7.5
+// Entries hold 1/c and -log(1/c) as a double-double. The subinterval that
+// contains 1.0 uses c = 1 exactly, so log is exact at 1 and keeps its
+// relative accuracy near it.
+#define BASIC_LOG_OFF 0x3fe6955500000000ULL
+#define BASIC_LOG_TABLE_BITS 7
+
+typedef struct {
+    double invc;
+    double logc_hi;
+    double logc_lo;
+} BasicLogEntry;
+
+static const BasicLogEntry basic_log_table[1 << BASIC_LOG_TABLE_BITS] = {
+    {0x1.69be8c81fb00cp+0, -0x1.620ef9ac6aa7cp-2, 0x1.7d5edf2436028p-56},
+    {0x1.67c22fe4dcddap+0, -0x1.5c6bfa1131b89p-2, 0x1.5accf53e0fb97p-56},
+    {0x1.65cb6049c63c4p+0, -0x1.56d0e0c69c3a3p-2, 0x1.c6ff348765107p-57},
+    {0x1.63da068aeb033p+0, -0x1.513d97c718e7ep-2, 0x1.dd1b3b0521ed4p-57},
+    {0x1.61ee0c0281abbp+0, -0x1.4bb20968ac7e1p-2, 0x1.b1c420e7eb68ep-56},
+    {0x1.60075a87531dbp+0, -0x1.462e205af89a2p-2, -0x1.32656a7abcfe8p-65},
+    {0x1.5e25dc6966c26p+0, -0x1.40b1c7a55020fp-2, -0x1.da8ee8453da74p-56},
+    {0x1.5c497c6ec9c1ap+0, -0x1.3b3ceaa4d8c01p-2, -0x1.175a194083e99p-62},
+    {0x1.5a7225d070680p+0, -0x1.35cf750ab91c3p-2, -0x1.3b97926470308p-56},
+    {0x1.589fc43730bf1p+0, -0x1.306952da53478p-2, -0x1.bf85e2d1f17a3p-56},
+    {0x1.56d243b8d56c2p+0, -0x1.2b0a70678b1d0p-2, 0x1.aa5563d85c314p-56},
+    {0x1.550990d547f30p+0, -0x1.25b2ba551821cp-2, 0x1.7ea05254c1a16p-56},
+    {0x1.53459873d182dp+0, -0x1.20621d92e28ddp-2, -0x1.1798dfe721091p-56},
+    {0x1.518647e0717edp+0, -0x1.1b18875c6b297p-2, -0x1.0e046c50d116ep-56},
+    {0x1.4fcb8cc948f96p+0, -0x1.15d5e5373da29p-2, -0x1.1a371bf0ea155p-56},
+    {0x1.4e15553c1a639p+0, -0x1.109a24f16d0e1p-2, -0x1.a3c61fb6a32a4p-58},
+    {0x1.4c638fa3dcb8ep+0, -0x1.0b6534a01a428p-2, -0x1.37c1238e8b88bp-58},
+    {0x1.4ab62ac66176cp+0, -0x1.0637029e03bf8p-2, -0x1.42b5d01e45f31p-57},
+    {0x1.490d15c20cb76p+0, -0x1.010f7d8a1ed9dp-2, 0x1.0734ab1b69901p-56},
+    {0x1.4768400b9ecd3p+0, -0x1.f7dd288c73c7dp-3, -0x1.355c9ac6293ddp-57},
+    {0x1.45c7996c0ec27p+0, -0x1.eda86beb4e196p-3, -0x1.40ffc2a7e6d71p-59},
+    {0x1.442b11fe75285p+0, -0x1.e380a3f7df699p-3, -0x1.862248039fdf5p-58},
+    {0x1.42929a2e06a4dp+0, -0x1.d965aff71ff0bp-3, 0x1.4620b777f6583p-57},
+    {0x1.40fe22b41db5ep+0, -0x1.cf576fa97461cp-3, -0x1.fccfea63fc024p-57},
+    {0x1.3f6d9c965323ep+0, -0x1.c555c34844615p-3, -0x1.782b790e0a62bp-57},
+    {0x1.3de0f924a4a53p+0, -0x1.bb608b83a0031p-3, 0x1.d9b800b01a214p-57},
+    {0x1.3c5829f7a9375p+0, -0x1.b177a97ff3db0p-3, -0x1.a6d00bc3af246p-58},
+    {0x1.3ad320eed2b70p+0, -0x1.a79afed3cb32dp-3, 0x1.6ec8f5499c79cp-57},
+    {0x1.3951d02ebc479p+0, -0x1.9dca6d85a004bp-3, -0x1.ed1e85911c4a0p-57},
+    {0x1.37d42a1f851a3p+0, -0x1.9405d809b84c5p-3, 0x1.4b038a142b56bp-58},
+    {0x1.365a216b372dap+0, -0x1.8a4d214010533p-3, -0x1.6b818e66a5769p-59},
+    {0x1.34e3a8fc39a0ap+0, -0x1.80a02c7251993p-3, -0x1.b4304ad16f8a7p-57},
+    {0x1.3370b3fbce360p+0, -0x1.76fedd51d5fd8p-3, 0x1.05611f9784a98p-60},
+    {0x1.320135d099ac2p+0, -0x1.6d6917f5b6cd2p-3, -0x1.549a64c679070p-65},
+    {0x1.3095221d368ecp+0, -0x1.63dec0d8e7691p-3, 0x1.be5fe31a14be8p-58},
+    {0x1.2f2c6cbed22b0p+0, -0x1.5a5fbcd85b285p-3, -0x1.39affd8c6a2a7p-58},
+    {0x1.2dc709cbd3534p+0, -0x1.50ebf131362fbp-3, -0x1.ef67c0f42aa21p-57},
+    {0x1.2c64ed928aa10p+0, -0x1.4783437f08e8dp-3, 0x1.1ea191ada8bbfp-60},
+    {0x1.2b060c97ebe82p+0, -0x1.3e2599ba15d49p-3, 0x1.64522fe3737adp-57},
+    {0x1.29aa5b9650907p+0, -0x1.34d2da35a16f4p-3, -0x1.04e39c61b7e42p-57},
+    {0x1.2851cf7c428cdp+0, -0x1.2b8aeb9e4bdbdp-3, 0x1.f68c8827b01d1p-59},
+    {0x1.26fc5d6b4fab4p+0, -0x1.224db4f87417bp-3, 0x1.e710e8a29df01p-57},
+    {0x1.25a9fab6e4facp+0, -0x1.191b1d9ea4760p-3, -0x1.90257918c1533p-58},
+    {0x1.245a9ce332056p+0, -0x1.0ff30d40081afp-3, 0x1.4dfd3e1b3ad2ep-59},
+    {0x1.230e39a413a1bp+0, -0x1.06d56bdee9439p-3, -0x1.e2c47ed4c6eccp-59},
+    {0x1.21c4c6dc061e2p+0, -0x1.fb84439e702d1p-4, 0x1.b7f69d2819213p-59},
+    {0x1.207e3a9b1e8d3p+0, -0x1.e9722f6a33913p-4, 0x1.c26f521d03b6ep-59},
+    {0x1.1f3a8b1e0af9dp+0, -0x1.d7746d06ffb25p-4, 0x1.d56376a0acdb6p-63},
+    {0x1.1df9aecd194e9p+0, -0x1.c58acef58e68fp-4, 0x1.28c4213df87bap-59},
+    {0x1.1cbb9c3b44badp+0, -0x1.b3b5284ebe043p-4, -0x1.671a3f8312014p-58},
+    {0x1.1b804a2549645p+0, -0x1.a1f34cc0ede39p-4, 0x1.2b44ab64fb0e4p-58},
+    {0x1.1a47af70be33ap+0, -0x1.9045108d699c6p-4, 0x1.2ab01f5a5978ep-61},
+    {0x1.1911c32b348dcp+0, -0x1.7eaa4885e25e2p-4, 0x1.b55bfcdd3c710p-59},
+    {0x1.17de7c895dcc0p+0, -0x1.6d22ca09f61fap-4, -0x1.ebb3580d31000p-61},
+    {0x1.16add2e63647fp+0, -0x1.5bae6b04c452ep-4, 0x1.ceb706f61e3a3p-59},
+    {0x1.157fbdc235cffp+0, -0x1.4a4d01ea8fb65p-4, -0x1.c196436ab3d12p-60},
+    {0x1.145434c2855c5p+0, -0x1.38fe65b66cfb2p-4, -0x1.0da207c54396ep-59},
+    {0x1.132b2fb039dc6p+0, -0x1.27c26de7fddc6p-4, -0x1.c013d13cde5e0p-59},
+    {0x1.1204a67793f6ap+0, -0x1.1698f281386bap-4, -0x1.014614e0e096bp-61},
+    {0x1.10e0912744966p+0, -0x1.0581cc043a393p-4, 0x1.2a6cb9cc7a32fp-58},
+    {0x1.0fbee7efb622ep+0, -0x1.e8f9a6e24e118p-5, 0x1.5ba90449ac832p-59},
+    {0x1.0e9fa3225a3e1p+0, -0x1.c713c48825a49p-5, -0x1.ee25d828e3ba6p-59},
+    {0x1.0d82bb30fbe96p+0, -0x1.a551a4e5ed89ep-5, 0x1.e694e77e75d05p-59},
+    {0x1.0c6828ad15f01p+0, -0x1.83b2fcd762045p-5, 0x1.91d69959eaea5p-59},
+    {0x1.0b4fe4472d780p+0, -0x1.623782241da36p-5, -0x1.c2ff468d1f31fp-59},
+    {0x1.0a39e6ce309acp+0, -0x1.40deeb7bc2178p-5, -0x1.6ada9c0fbe8dep-60},
+    {0x1.0926292ed8e9ep+0, -0x1.1fa8f07234fb2p-5, 0x1.dd1d46a7618b3p-59},
+    {0x1.0814a47311c1ap+0, -0x1.fd2a92f7e0072p-6, 0x1.fb21098c02293p-60},
+    {0x1.070551c1624f2p+0, -0x1.bb475fd4c8618p-6, -0x1.7c8345628b32fp-63},
+    {0x1.05f82a5c5b2f9p+0, -0x1.79a7bbd0df0e5p-6, -0x1.f270f12ef5506p-66},
+    {0x1.04ed27a2078e3p+0, -0x1.384b1cedc9a50p-6, -0x1.99710299adbd1p-60},
+    {0x1.03e4430b61a92p+0, -0x1.ee61f5a49475bp-7, 0x1.78ad5411fa1d5p-63},
+    {0x1.02dd762bcaa3fp+0, -0x1.6cb19d87294d0p-7, 0x1.bb98528ff019ep-61},
+    {0x1.01d8bab085916p+0, -0x1.d7084e7b15da2p-8, 0x1.cf7a22a6fcac8p-64},
+    {0x1.00d60a60359dbp+0, -0x1.ab622e93ce64bp-9, 0x1.468080bd33f77p-63},
+    {0x1.0000000000000p+0, 0.0, 0.0},
+    {0x1.fb602a2f91e1fp-1, 0x1.294daebc01564p-7, 0x1.4ba451f8ac5a0p-66},
+    {0x1.f77a4dd695191p-1, 0x1.1301d448a0b00p-6, -0x1.bd7b1244a97cfp-61},
+    {0x1.f3a3a89273f9ep-1, 0x1.906542de674f9p-6, 0x1.59199846e2d5ap-61},
+    {0x1.efdbe1f975defp-1, 0x1.066a72e47273fp-5, -0x1.c3eb3d678b4ddp-61},
+    {0x1.ec22a449beb96p-1, 0x1.442a34f660bdep-5, -0x1.359bd583a7670p-62},
+    {0x1.e8779c4ff8ee3p-1, 0x1.8173b38841751p-5, 0x1.5baa264c73457p-59},
+    {0x1.e4da794f1f1e5p-1, 0x1.be48b03e90f71p-5, -0x1.828e29edc3690p-61},
+    {0x1.e14aece9570c6p-1, 0x1.faaae2cc5a017p-5, 0x1.f19e21d368317p-59},
+    {0x1.ddc8ab09cfb09p-1, 0x1.1b4dfc9edb27fp-4, -0x1.7a3a09c5322acp-58},
+    {0x1.da5369cf9557bp-1, 0x1.390ecc1fcd474p-4, 0x1.a1cb77c488e98p-60},
+    {0x1.d6eae1794f6f3p-1, 0x1.5698adb285bd4p-4, -0x1.1cac9690a620ep-58},
+    {0x1.d38ecc51dc50bp-1, 0x1.73ec6ab4ec63cp-4, 0x1.a12ccb19eaba9p-58},
+    {0x1.d03ee69dc00cap-1, 0x1.910ac8397c5fdp-4, -0x1.0469b06e5d776p-59},
+    {0x1.ccfaee895bcefp-1, 0x1.adf487264f359p-4, 0x1.beaf1f2509d6dp-58},
+    {0x1.c9c2a417e40ffp-1, 0x1.caaa645311532p-4, 0x1.75d2300410594p-58},
+    {0x1.c695c9130c4d5p-1, 0x1.e72d18a5ebb68p-4, 0x1.d07e388643b01p-58},
+    {0x1.c37420fb5f8a6p-1, 0x1.01beac97b6e0cp-3, 0x1.a2bd521001a0dp-58},
+    {0x1.c05d70f93d515p-1, 0x1.0fcdeba2c0e23p-3, 0x1.1c7f0787f348bp-64},
+    {0x1.bd517fce73629p-1, 0x1.1dc4a04ebb231p-3, 0x1.0d5c175e1e973p-57},
+    {0x1.ba5015c86caaap-1, 0x1.2ba31fb292d05p-3, 0x1.ea496147f7a4dp-57},
+    {0x1.b758fcb2ee7e3p-1, 0x1.3969bd2da2806p-3, 0x1.46f451211a274p-59},
+    {0x1.b46bffcb5d798p-1, 0x1.4718ca7371c2ap-3, 0x1.6b5749c099af3p-58},
+    {0x1.b188ebb483bc1p-1, 0x1.54b0979710ddcp-3, -0x1.d1078baa02229p-57},
+    {0x1.aeaf8e6ad28c6p-1, 0x1.6231731614b2ep-3, 0x1.afad35c61c340p-57},
+    {0x1.abdfb73919c0fp-1, 0x1.6f9ba9e33686ap-3, 0x1.544cfaa039789p-57},
+    {0x1.a91936adaf945p-1, 0x1.7cef87709b4cdp-3, 0x1.f65b09415eef4p-58},
+    {0x1.a65bde9003d33p-1, 0x1.8a2d55b9c5e17p-3, 0x1.3cbdfde7dde9cp-58},
+    {0x1.a3a781d69993ap-1, 0x1.97555d4d3779fp-3, 0x1.027bd6130df9ep-57},
+    {0x1.a0fbf49d62e51p-1, 0x1.a467e555c16dcp-3, 0x1.86ea130e14454p-58},
+    {0x1.9e590c1c7a228p-1, 0x1.b16533a38b570p-3, 0x1.d680b8bfacfc8p-59},
+    {0x1.9bbe9e9f34c91p-1, 0x1.be4d8cb4d0662p-3, 0x1.0373ad54a0ab2p-58},
+    {0x1.992c837b8be99p-1, 0x1.cb2133be56a3dp-3, -0x1.4ef1f5c32d2dfp-59},
+    {0x1.96a29309d67c9p-1, 0x1.d7e06ab3a2c25p-3, 0x1.23c023db441c8p-59},
+    {0x1.9420a69cd210dp-1, 0x1.e48b724eeafb9p-3, 0x1.cf3eb9b5029b3p-60},
+    {0x1.91a69879f676ap-1, 0x1.f1228a18cb65ap-3, -0x1.75bec5178f06dp-57},
+    {0x1.8f3443d211372p-1, 0x1.fda5f06fbe011p-3, -0x1.d3ba4905db3cfp-63},
+    {0x1.8cc984ba25cabp-1, 0x1.050af147ac5e4p-2, -0x1.cbf6c618cc399p-60},
+    {0x1.8a6638248faa5p-1, 0x1.0b394e4ba9c08p-2, -0x1.9c1f9e095f6cap-57},
+    {0x1.880a3bda6379bp-1, 0x1.115e2cc92c26ap-2, -0x1.6666bb21cac30p-56},
+    {0x1.85b56e750ca95p-1, 0x1.1779a9be4fa76p-2, -0x1.2d78f8f728fe7p-58},
+    {0x1.8367af582510cp-1, 0x1.1d8be1a52c67dp-2, 0x1.147ddea1d4bbep-56},
+    {0x1.8120deab841dcp-1, 0x1.2394f076f3618p-2, 0x1.760791395f8d2p-56},
+    {0x1.7ee0dd558352dp-1, 0x1.2994f1aef3d0ap-2, 0x1.5e4d6256cfd54p-57},
+    {0x1.7ca78cf575ea8p-1, 0x1.2f8c004d8a1a6p-2, 0x1.590ca8dce923ap-57},
+    {0x1.7a74cfde518dap-1, 0x1.357a36daf8f5cp-2, -0x1.3b6477d6c3513p-58},
+    {0x1.7848891186241p-1, 0x1.3b5faf6a2d950p-2, 0x1.26ecf1489e666p-61},
+    {0x1.76229c3a02dd9p-1, 0x1.413c839b6f8adp-2, -0x1.e6471c3e16b15p-56},
+    {0x1.7402eda766a7bp-1, 0x1.4710cc9efd18dp-2, -0x1.4d5a4f28ae725p-60},
+    {0x1.71e962495a585p-1, 0x1.4cdca33794964p-2, -0x1.938c5cdb44450p-56},
+    {0x1.6fd5dfab12e9ep-1, 0x1.52a01fbceb8f3p-2, 0x1.8ac4a85833954p-57},
+    {0x1.6dc84beefa396p-1, 0x1.585b5a1e1438dp-2, -0x1.f90c322f56de5p-61},
+    {0x1.6bc08dca7cc53p-1, 0x1.5e0e69e3d1d5ap-2, -0x1.77b180c1a7a75p-57},
+};
+
+// ln2 split so that k * BASIC_LN2_HI is exact for |k| < 2^11
+#define BASIC_LN2_HI 0x1.62e42fefa3800p-1
+#define BASIC_LN2_LO 0x1.ef35793c76730p-45
+#define BASIC_INV_LN2 0x1.71547652b82fep0
+// Adding 1.5 * 2^52 rounds to an integer held in the low mantissa bits
+#define BASIC_SHIFT 0x1.8p52
+
+// log(x) ~ hi + lo with a relative error near 2^-66, for positive finite x
+BASIC_INLINE void basic_log_core(const BasicDouble4 *xp, BasicDouble4 *hi,
+                                 BasicDouble4 *lo, int fused) {
+    BasicDouble4 x = *xp;
+
+    // Subnormals are scaled into the normal range first
+    BasicInt4 tiny = x < 0x1p-1022;
+    x = BASIC_SELECT(tiny, x * 0x1p52, x);
+
+    BasicUint4 ix = (BasicUint4)x;
+    BasicUint4 tmp = ix - BASIC_LOG_OFF;
+    BasicInt4 k = ((BasicInt4)tmp >> 52) - (tiny & 52);
+    BasicUint4 index = (tmp >> (52 - BASIC_LOG_TABLE_BITS)) &
+                       ((1 << BASIC_LOG_TABLE_BITS) - 1);
+    BasicDouble4 z = (BasicDouble4)(ix - (tmp & (0xfffULL << 52)));
+
+    BasicDouble4 invc, logc_hi, logc_lo;
+    for (int l = 0; l < BASIC_LANES; l++) {
+        const BasicLogEntry *e = &basic_log_table[index[l]];
+        invc[l] = e->invc;
+        logc_hi[l] = e->logc_hi;
+        logc_lo[l] = e->logc_lo;
+    }
+
+    // r = z * invc - 1 exactly as rh + rl; p - 1 is exact since p ~ 1
+    BasicDouble4 p, pe, rh, rl;
+    BASIC_TWO_PRODUCT(z, invc, p, pe, fused);
+    BASIC_TWO_SUM(p - 1.0, pe, rh, rl);
+
+    BasicDouble4 kd =
+        (BasicDouble4)((BasicUint4)k + (BasicUint4)BASIC_SPLAT(BASIC_SHIFT)) -
+        BASIC_SHIFT;
+
+    // Leading terms k ln2 + log(c) + r - r^2 / 2 in double-double
+    BasicDouble4 t, te, s1, e1, s2, e2, qh, ql;
+    BASIC_TWO_SUM(kd * BASIC_LN2_HI, logc_hi, t, te);
+    BASIC_TWO_SUM(t, rh, s1, e1);
+    BASIC_TWO_PRODUCT(rh, 0.5 * rh, qh, ql, fused);
+    BASIC_TWO_SUM(s1, -qh, s2, e2);
+
+    // log1p(r) - r + r^2 / 2 = r^3 (1/3 - r/4 + ... - r^7/10); the next
+    // term is below 2^-80 relative
+    BasicDouble4 r2 = rh * rh;
+    BasicDouble4 p01 = 1.0 / 3.0 - 0.25 * rh;
+    BasicDouble4 p23 = 0.2 - rh * (1.0 / 6.0);
+    BasicDouble4 p45 = 1.0 / 7.0 - 0.125 * rh;
+    BasicDouble4 p67 = 1.0 / 9.0 - 0.1 * rh;
+    BasicDouble4 poly = (p01 + r2 * p23) + (r2 * r2) * (p45 + r2 * p67);
+
+    // (rh + rl)^2 / 2 also contributes rh * rl
+    BasicDouble4 tail = te + e1 + e2 - ql + kd * BASIC_LN2_LO + logc_lo +
+                        (rl - rh * rl) + r2 * rh * poly;
+    BASIC_TWO_SUM(s2, tail, *hi, *lo);
+}
+
+// ---------------------------------------------------------------------------
+// exp
+// ---------------------------------------------------------------------------
+
+// exp(zh + zl) for |zl| <= ulp(zh): z = k ln2 + r with |r| <= ln2 / 2, then
+//     exp(z) = 2^k (1 + r + r^2 / 2 + r^3 E(r)) (1 + rl)
+// with E the Taylor series through r^15 / 15!, whose remainder is below
+// 2^-68. The leading terms are summed as a double-double, so the final
+// rounding dominates the error. The scale is applied in two exact steps
+// so the exponent can reach the subnormal range; a subnormal result is
+// rounded twice and may be off by up to 1 ULP.
+BASIC_INLINE void basic_exp_core(const BasicDouble4 *zhp,
+                                 const BasicDouble4 *zlp,
+                                 BasicDouble4 *result, int fused) {
+    BasicDouble4 zh = *zhp;
+
+    // Beyond these bounds the result is infinity or zero whatever the
+    // reduction does; NaN fails both tests and propagates
+    BasicInt4 high = zh > 710.0;
+    BasicInt4 low = zh < -746.0;
+    zh = BASIC_SELECT(high, BASIC_SPLAT(710.0), zh);
+    zh = BASIC_SELECT(low, BASIC_SPLAT(-746.0), zh);
+    BasicDouble4 zl = BASIC_SELECT(high | low, BASIC_SPLAT(0.0), *zlp);
+
+    BasicDouble4 shifted = zh * BASIC_INV_LN2 + BASIC_SHIFT;
+    BasicDouble4 kd = shifted - BASIC_SHIFT;
+    BasicInt4 k = (BasicInt4)shifted - (BasicInt4)BASIC_SPLAT(BASIC_SHIFT);
+
+    // kd * BASIC_LN2_HI is exact and the subtraction cancels exactly
+    BasicDouble4 r, re;
+    BASIC_TWO_SUM(zh - kd * BASIC_LN2_HI, -(kd * BASIC_LN2_LO), r, re);
+    BasicDouble4 rl = re + zl;
+
+    // r^3 (1/3! + r/4! + ... + r^12/15!), by Estrin's scheme to keep the
+    // dependency chain short
+    BasicDouble4 r2 = r * r;
+    BasicDouble4 r4 = r2 * r2;
+    BasicDouble4 e01 = 1.0 / 6.0 + r * (1.0 / 24.0);
+    BasicDouble4 e23 = 1.0 / 120.0 + r * (1.0 / 720.0);
+    BasicDouble4 e45 = 1.0 / 5040.0 + r * (1.0 / 40320.0);
+    BasicDouble4 e67 = 1.0 / 362880.0 + r * (1.0 / 3628800.0);
+    BasicDouble4 e89 = 1.0 / 39916800.0 + r * (1.0 / 479001600.0);
+    BasicDouble4 e1011 = 1.0 / 6227020800.0 + r * (1.0 / 87178291200.0);
+    BasicDouble4 e03 = e01 + r2 * e23;
+    BasicDouble4 e47 = e45 + r2 * e67;
+    BasicDouble4 e811 = e89 + r2 * (e1011 + r2 * (1.0 / 1307674368000.0));
+    BasicDouble4 e = e03 + r4 * (e47 + r4 * e811);
+    BasicDouble4 cubic = r2 * r * e;
+
+    // 1 + r + r^2 / 2 as s + se; 1 + r is exact by Fast2Sum (|r| < 1)
+    BasicDouble4 s = 1.0 + r;
+    BasicDouble4 se = r - (s - 1.0);
+    BasicDouble4 qh, ql, s2, e2;
+    BASIC_TWO_PRODUCT(r, 0.5 * r, qh, ql, fused);
+    BASIC_TWO_SUM(s, qh, s2, e2);
+    BasicDouble4 p = r + qh + cubic;
+    BasicDouble4 y = s2 + (se + e2 + ql + cubic + rl * (1.0 + p));
+
+    BasicInt4 k1 = k >> 1;
+    BasicInt4 k2 = k - k1;
+    BasicDouble4 scale1 = (BasicDouble4)((BasicUint4)(k1 + 1023) << 52);
+    BasicDouble4 scale2 = (BasicDouble4)((BasicUint4)(k2 + 1023) << 52);
+    *result = y * scale1 * scale2;
+}
+
+// ---------------------------------------------------------------------------
+// Kernel bodies
+// ---------------------------------------------------------------------------
+
+// The vector bodies run whole groups of four; a partial last group is
+// padded with 1.0, which is in every fast path
+#define BASIC_FOR_GROUPS(begin, end, GROUP)                    \
+    do {                                                       \
+        size_t i_ = (begin);                                   \
+        for (; i_ + BASIC_LANES <= (end); i_ += BASIC_LANES) { \
+            GROUP(i_, BASIC_LANES);                            \
+        }                                                      \
+        if (i_ < (end)) {                                      \
+            GROUP(i_, (end) - i_);                             \
+        }                                                      \
+    } while (0)
+
+BASIC_INLINE void basic_load(BasicDouble4 *v, const double *p,
+                             size_t count) {
+    *v = BASIC_SPLAT(1.0);
+    memcpy(v, p, count * sizeof(double));
+}
+
+BASIC_INLINE void multiply_body(const double *a, const double *b,
+                                double *out, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        out[i] = a[i] * b[i];
+    }
+}
+
+BASIC_INLINE void sqrt_body(const double *x, const double *unused,
+                            double *out, size_t begin, size_t end) {
+    (void)unused;
+    for (size_t i = begin; i < end; i++) {
+        out[i] = sqrt(x[i]);
+    }
+}
+
+// The mask is written before any quotient in case out aliases b
+BASIC_INLINE size_t divide_body(const double *a, const double *b,
+                                double *out, unsigned char *zero_lanes,
+                                size_t begin, size_t end) {
+    size_t zeros = 0;
+    if (zero_lanes != NULL) {
+        for (size_t i = begin; i < end; i++) {
+            zero_lanes[i] = b[i] == 0.0;
+            zeros += zero_lanes[i];
+        }
+    } else {
+        for (size_t i = begin; i < end; i++) {
+            zeros += b[i] == 0.0;
+        }
+    }
+
+    for (size_t i = begin; i < end; i++) {
+        out[i] = a[i] / b[i];
+    }
+    return zeros;
+}
+
+#define BASIC_EXP_GROUP(i, count)                         \
+    do {                                                  \
+        BasicDouble4 v_, r_, zero_ = BASIC_SPLAT(0.0);    \
+        basic_load(&v_, x + (i), (count));                \
+        basic_exp_core(&v_, &zero_, &r_, fused);          \
+        memcpy(out + (i), &r_, (count) * sizeof(double)); \
+    } while (0)
+
+BASIC_INLINE void exp_body(const double *x, const double *unused, double *out,
+                           size_t begin, size_t end, int fused) {
+    (void)unused;
+    BASIC_FOR_GROUPS(begin, end, BASIC_EXP_GROUP);
+}
+
+// Lanes outside the fast path are redone by the C library
+#define BASIC_LOG_GROUP(i, count)                         \
+    do {                                                  \
+        BasicDouble4 v_, hi_, lo_;                        \
+        basic_load(&v_, x + (i), (count));                \
+        BasicInt4 fast_ = (v_ > 0.0) & (v_ < INFINITY);   \
+        basic_log_core(&v_, &hi_, &lo_, fused);           \
+        BasicDouble4 r_ = hi_ + lo_;                      \
+        for (size_t l_ = 0; l_ < (count); l_++) {         \
+            if (!fast_[l_]) {                             \
+                r_[l_] = log(v_[l_]);                     \
+            }                                             \
+        }                                                 \
+        memcpy(out + (i), &r_, (count) * sizeof(double)); \
+    } while (0)
+
+BASIC_INLINE void log_body(const double *x, const double *unused, double *out,
+                           size_t begin, size_t end, int fused) {
+    (void)unused;
+    BASIC_FOR_GROUPS(begin, end, BASIC_LOG_GROUP);
+}
+
+// The exponent is clamped to 2^512 before the product so the split cannot
+// overflow; any clamped exponent still sends exp to infinity or zero
+// unless log(x) is exactly 0
+#define BASIC_POWER_GROUP(i, count)                                         \
+    do {                                                                    \
+        BasicDouble4 x_, y_, hi_, lo_, zh_, ze_, r_;                        \
+        basic_load(&x_, a + (i), (count));                                  \
+        basic_load(&y_, b + (i), (count));                                  \
+        BasicInt4 fast_ = (x_ > 0.0) & (x_ < INFINITY) & (y_ == y_);        \
+        basic_log_core(&x_, &hi_, &lo_, fused);                             \
+        BasicDouble4 yc_ = BASIC_SELECT(y_ > 0x1p512, BASIC_SPLAT(0x1p512), \
+                                        y_);                                \
+        yc_ = BASIC_SELECT(yc_ < -0x1p512, BASIC_SPLAT(-0x1p512), yc_);     \
+        BASIC_TWO_PRODUCT(yc_, hi_, zh_, ze_, fused);                       \
+        ze_ += yc_ * lo_;                                                   \
+        basic_exp_core(&zh_, &ze_, &r_, fused);                             \
+        for (size_t l_ = 0; l_ < (count); l_++) {                           \
+            if (!fast_[l_]) {                                               \
+                r_[l_] = pow(x_[l_], y_[l_]);                               \
+            }                                                               \
+        }                                                                   \
+        memcpy(out + (i), &r_, (count) * sizeof(double));                   \
+    } while (0)
+
+BASIC_INLINE void power_body(const double *a, const double *b, double *out,
+                             size_t begin, size_t end, int fused) {
+    BASIC_FOR_GROUPS(begin, end, BASIC_POWER_GROUP);
+}
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+typedef void (*BasicKernel)(const double *a, const double *b, double *out,
+                            size_t begin, size_t end);
+typedef size_t (*BasicDivideKernel)(const double *a, const double *b,
+                                    double *out, unsigned char *zero_lanes,
+                                    size_t begin, size_t end);
+
+typedef struct {
+    BasicKernel multiply;
+    BasicDivideKernel divide;
+    BasicKernel sqrt;
+    BasicKernel exp;
+    BasicKernel log;
+    BasicKernel power;
+} BasicKernels;
+
+static void multiply_generic(const double *a, const double *b, double *out,
+                             size_t begin, size_t end) {
+    multiply_body(a, b, out, begin, end);
+}
+
+static size_t divide_generic(const double *a, const double *b, double *out,
+                             unsigned char *zero_lanes, size_t begin,
+                             size_t end) {
+    return divide_body(a, b, out, zero_lanes, begin, end);
+}
+
+static void sqrt_generic(const double *x, const double *unused, double *out,
+                         size_t begin, size_t end) {
+    sqrt_body(x, unused, out, begin, end);
+}
+
+static void exp_generic(const double *x, const double *unused, double *out,
+                        size_t begin, size_t end) {
+    exp_body(x, unused, out, begin, end, 0);
+}
+
+static void log_generic(const double *x, const double *unused, double *out,
+                        size_t begin, size_t end) {
+    log_body(x, unused, out, begin, end, 0);
+}
+
+static void power_generic(const double *a, const double *b, double *out,
+                          size_t begin, size_t end) {
+    power_body(a, b, out, begin, end, 0);
+}
+
+static const BasicKernels basic_kernels_generic = {
+    multiply_generic, divide_generic, sqrt_generic,
+    exp_generic,      log_generic,    power_generic,
+};
+
+#if BASIC_BATCH_X86
+__attribute__((target("avx2,fma"))) static void multiply_avx2(
+    const double *a, const double *b, double *out, size_t begin,
+    size_t end) {
+    multiply_body(a, b, out, begin, end);
+}
+
+__attribute__((target("avx2,fma"))) static size_t divide_avx2(
+    const double *a, const double *b, double *out, unsigned char *zero_lanes,
+    size_t begin, size_t end) {
+    return divide_body(a, b, out, zero_lanes, begin, end);
+}
+
+__attribute__((target("avx2,fma"))) static void sqrt_avx2(
+    const double *x, const double *unused, double *out, size_t begin,
+    size_t end) {
+    sqrt_body(x, unused, out, begin, end);
+}
+
+__attribute__((target("avx2,fma"))) static void exp_avx2(
+    const double *x, const double *unused, double *out, size_t begin,
+    size_t end) {
+    exp_body(x, unused, out, begin, end, 1);
+}
+
+__attribute__((target("avx2,fma"))) static void log_avx2(
+    const double *x, const double *unused, double *out, size_t begin,
+    size_t end) {
+    log_body(x, unused, out, begin, end, 1);
+}
+
+__attribute__((target("avx2,fma"))) static void power_avx2(
+    const double *a, const double *b, double *out, size_t begin,
+    size_t end) {
+    power_body(a, b, out, begin, end, 1);
+}
+
+static const BasicKernels basic_kernels_avx2 = {
+    multiply_avx2, divide_avx2, sqrt_avx2,
+    exp_avx2,      log_avx2,    power_avx2,
+};
+#endif
+
+static const BasicKernels *basic_kernels(void) {
+    static _Atomic(const BasicKernels *) selected = NULL;
+
+    const BasicKernels *kernels =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernels == NULL) {
+        kernels = &basic_kernels_generic;
+#if BASIC_BATCH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernels = &basic_kernels_avx2;
+        }
+#endif
+        atomic_store_explicit(&selected, kernels, memory_order_release);
+    }
+
+    return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// Batched operations
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    BasicKernel kernel;
+    BasicDivideKernel divide;
+    const double *a;
+    const double *b;
+    double *out;
+    unsigned char *zero_lanes;
+    size_t n;
+    _Atomic size_t zeros;
+} BasicTask;
+
+static void basic_task_range(BasicTask *task, size_t first, size_t last) {
+    if (task->divide != NULL) {
+        size_t zeros = task->divide(task->a, task->b, task->out,
+                                    task->zero_lanes, first, last);
+        atomic_fetch_add_explicit(&task->zeros, zeros, memory_order_relaxed);
+    } else {
+        task->kernel(task->a, task->b, task->out, first, last);
+    }
+}
+
+// Body of the parallel loop over blocks [begin, end)
+static void basic_task(void *ctx, int begin, int end) {
+    BasicTask *task = (BasicTask *)ctx;
+    size_t last = (size_t)end * BASIC_BLOCK;
+    basic_task_range(task, (size_t)begin * BASIC_BLOCK,
+                     last < task->n ? last : task->n);
+}
+
+// work_per_element is a rough cost relative to one multiply
+static void basic_run(BasicTask *task, size_t work_per_element) {
+    size_t blocks = (task->n + BASIC_BLOCK - 1) / BASIC_BLOCK;
+    if (blocks > (size_t)INT_MAX) {
+        // Past parallel_for's index range: run on the calling thread
+        basic_task_range(task, 0, task->n);
+        return;
+    }
+
+    int grain = parallel_grain(work_per_element * BASIC_BLOCK);
+    parallel_for(0, (int)blocks, grain, basic_task, task);
+}
+
+static int basic_binary(BasicKernel kernel, const double *a, const double *b,
+                        double *out, size_t n, size_t work_per_element) {
+    if (a == NULL || b == NULL || out == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    BasicTask task = {kernel, NULL, a, b, out, NULL, n, 0};
+    basic_run(&task, work_per_element);
+    return SUCCESS;
+}
+
+static int basic_unary(BasicKernel kernel, const double *x, double *out,
+                       size_t n, size_t work_per_element) {
+    return basic_binary(kernel, x, x, out, n, work_per_element);
+}
+
+int add_n(const double *a, const double *b, double *out, size_t n) {
+    DEBUG_PRINT("Adding %zu pairs\n", n);
+
+    if (a == NULL || b == NULL || out == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    vector_kernels()->add(a, b, out, n);
+    return SUCCESS;
+}
+
+int subtract_n(const double *a, const double *b, double *out, size_t n) {
+    DEBUG_PRINT("Subtracting %zu pairs\n", n);
+
+    if (a == NULL || b == NULL || out == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    vector_kernels()->subtract(a, b, out, n);
+    return SUCCESS;
+}
+
+int multiply_n(const double *a, const double *b, double *out, size_t n) {
+    DEBUG_PRINT("Multiplying %zu pairs\n", n);
+    return basic_binary(basic_kernels()->multiply, a, b, out, n, 1);
+}
+
+int divide_n(const double *a, const double *b, double *out, size_t n,
+             unsigned char *zero_lanes) {
+    DEBUG_PRINT("Dividing %zu pairs\n", n);
+
+    if (a == NULL || b == NULL || out == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    BasicTask task = {NULL, basic_kernels()->divide, a, b, out, zero_lanes,
+                      n, 0};
+    basic_run(&task, 4);
+    return atomic_load_explicit(&task.zeros, memory_order_relaxed) != 0
+               ? ERROR_DIVISION_BY_ZERO
+               : SUCCESS;
+}
+
+int sqrt_n(const double *x, double *out, size_t n) {
+    DEBUG_PRINT("Calculating %zu square roots\n", n);
+    return basic_unary(basic_kernels()->sqrt, x, out, n, 4);
+}
+
+int exp_n(const double *x, double *out, size_t n) {
+    DEBUG_PRINT("Calculating %zu exponentials\n", n);
+    return basic_unary(basic_kernels()->exp, x, out, n, 24);
+}
+
+int log_n(const double *x, double *out, size_t n) {
+    DEBUG_PRINT("Calculating %zu logarithms\n", n);
+    return basic_unary(basic_kernels()->log, x, out, n, 40);
+}
+
+int power_n(const double *base, const double *exponent, double *out,
+            size_t n) {
+    DEBUG_PRINT("Calculating %zu powers\n", n);
+    return basic_binary(basic_kernels()->power, base, exponent, out, n, 72);
+}
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include "../include/blas_backend.h"
+
+#ifndef MATHLIB_BLAS_NAME
+#define MATHLIB_BLAS_NAME "none"
+#endif
+
+#ifdef MATHLIB_BLAS
+
+// The CBLAS and Fortran LAPACK symbols are declared here rather than taken
+// from cblas.h so the build only needs the library itself; every vendor
+// named in the Makefile exports them with these LP64 signatures.
+enum {
+    BLAS_ROW_MAJOR = 101,
+    BLAS_NO_TRANS = 111,
+    BLAS_TRANS = 112,
+    BLAS_UPPER = 121,
+    BLAS_LOWER = 122,
+    BLAS_NON_UNIT = 131,
+    BLAS_UNIT = 132,
+    BLAS_LEFT = 141
+};
+
+double cblas_ddot(int n, const double *x, int incx, const double *y,
+                  int incy);
+void cblas_dcopy(int n, const double *x, int incx, double *y, int incy);
+void cblas_dscal(int n, double alpha, double *x, int incx);
+void cblas_dgemv(int order, int trans, int m, int n, double alpha,
+                 const double *a, int lda, const double *x, int incx,
+                 double beta, double *y, int incy);
+void cblas_dgemm(int order, int transa, int transb, int m, int n, int k,
+                 double alpha, const double *a, int lda, const double *b,
+                 int ldb, double beta, double *c, int ldc);
+void cblas_dtrsm(int order, int side, int uplo, int transa, int diag, int m,
+                 int n, double alpha, const double *a, int lda, double *b,
+                 int ldb);
+#ifdef MATHLIB_LAPACK
+void dgetrf_(const int *m, const int *n, double *a, const int *lda, int *ipiv,
+             int *info);
+#endif
+
+// Forwarding thresholds in FLOPs. Level-1 ops are memory bound and the
+// built-in kernels already run at bandwidth, so they only move over when
+// the vendor's threading can help.
+uint64_t blas_thresholds[BLAS_OP_COUNT] = {
+    [BLAS_OP_DOT] = (uint64_t)1 << 24,
+    [BLAS_OP_SCALE] = (uint64_t)1 << 24,
+    [BLAS_OP_GEMV] = (uint64_t)1 << 22,
+    [BLAS_OP_GEMM] = (uint64_t)1 << 21,
+#ifdef MATHLIB_LAPACK
+    [BLAS_OP_GETRF] = (uint64_t)1 << 21,
+#else
+    [BLAS_OP_GETRF] = BLAS_THRESHOLD_NEVER,
+#endif
+    [BLAS_OP_TRSM] = (uint64_t)1 << 21,
+};
+
+// Storage of a logical operand: a transposed view is the plain storage
+// with the transpose flag
+static int blas_trans(const Matrix *m) {
+    return MATRIX_IS_TRANSPOSED(m) ? BLAS_TRANS : BLAS_NO_TRANS;
+}
+
+int blas_ddot(const double *a, const double *b, size_t n, double *result) {
+    *result = cblas_ddot((int)n, a, 1, b, 1);
+    return SUCCESS;
+}
+
+int blas_dscal(const double *a, double scalar, double *out, size_t n) {
+    if (out != a) {
+        cblas_dcopy((int)n, a, 1, out, 1);
+    }
+    cblas_dscal((int)n, scalar, out, 1);
+    return SUCCESS;
+}
+
+int blas_dgemv(const Matrix *a, const double *x, double *y) {
+    // The stored matrix is a->rows x a->cols, or the reverse when a is a
+    // transposed view
+    int rows = MATRIX_IS_TRANSPOSED(a) ? a->cols : a->rows;
+    int cols = MATRIX_IS_TRANSPOSED(a) ? a->rows : a->cols;
+    cblas_dgemv(BLAS_ROW_MAJOR, blas_trans(a), rows, cols, 1.0, a->data,
+                a->stride, x, 1, 0.0, y, 1);
+    return SUCCESS;
+}
+
+int blas_dgemm(double alpha, const Matrix *a, const Matrix *b, double beta,
+               Matrix *c) {
+    if (MATRIX_IS_TRANSPOSED(c)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    cblas_dgemm(BLAS_ROW_MAJOR, blas_trans(a), blas_trans(b), c->rows,
+                c->cols, a->cols, alpha, a->data, a->stride, b->data,
+                b->stride, beta, c->data, c->stride);
+    return SUCCESS;
+}
+
+int blas_dgetrf(Matrix *a, int *pivots, int *sign) {
+#ifdef MATHLIB_LAPACK
+    if (MATRIX_IS_TRANSPOSED(a)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    // Fortran LAPACK is column-major: factor a column-major copy, the same
+    // round trip LAPACKE makes for row-major input
+    const int n = a->rows;
+    size_t count = (size_t)n * (size_t)n;
+    double *t = (double *)allocator_alloc(NULL, count * sizeof(double));
+    int *ipiv = (int *)malloc((size_t)n * sizeof(int));
+    if (t == NULL || ipiv == NULL) {
+        allocator_free(NULL, t, count * sizeof(double));
+        free(ipiv);
+        return ERROR_NULL_POINTER;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const double *row = MATRIX_ROW(a, i);
+        for (int j = 0; j < n; j++) {
+            t[(size_t)j * n + i] = row[j];
+        }
+    }
+
+    // info > 0 flags an exactly zero pivot; the factors are still complete
+    // and matrix_lu_solve reports the singularity as it does for the
+    // built-in factorization
+    int info;
+    dgetrf_(&n, &n, t, &n, ipiv, &info);
+
+    for (int i = 0; i < n; i++) {
+        double *row = MATRIX_ROW(a, i);
+        for (int j = 0; j < n; j++) {
+            row[j] = t[(size_t)j * n + i];
+        }
+    }
+
+    *sign = 1;
+    for (int i = 0; i < n; i++) {
+        pivots[i] = ipiv[i] - 1;
+        if (pivots[i] != i) {
+            *sign = -*sign;
+        }
+    }
+
+    allocator_free(NULL, t, count * sizeof(double));
+    free(ipiv);
+    return info < 0 ? ERROR_INVALID_DIMENSION : SUCCESS;
+#else
+    (void)a;
+    (void)pivots;
+    (void)sign;
+    return ERROR_UNSUPPORTED;
+#endif
+}
+
+int blas_lu_trsm(const Matrix *lu, Matrix *x) {
+    if (MATRIX_IS_TRANSPOSED(lu) || MATRIX_IS_TRANSPOSED(x)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    cblas_dtrsm(BLAS_ROW_MAJOR, BLAS_LEFT, BLAS_LOWER, BLAS_NO_TRANS,
+                BLAS_UNIT, x->rows, x->cols, 1.0, lu->data, lu->stride,
+                x->data, x->stride);
+    cblas_dtrsm(BLAS_ROW_MAJOR, BLAS_LEFT, BLAS_UPPER, BLAS_NO_TRANS,
+                BLAS_NON_UNIT, x->rows, x->cols, 1.0, lu->data, lu->stride,
+                x->data, x->stride);
+    return SUCCESS;
+}
+
+#else
+
+// Built without a vendor library: blas_backend_use is constant false and
+// these are never reached
+
+int blas_ddot(const double *a, const double *b, size_t n, double *result) {
+    (void)a;
+    (void)b;
+    (void)n;
+    (void)result;
+    return ERROR_UNSUPPORTED;
+}
+
+int blas_dscal(const double *a, double scalar, double *out, size_t n) {
+    (void)a;
+    (void)scalar;
+    (void)out;
+    (void)n;
+    return ERROR_UNSUPPORTED;
+}
+
+int blas_dgemv(const Matrix *a, const double *x, double *y) {
+    (void)a;
+    (void)x;
+    (void)y;
+    return ERROR_UNSUPPORTED;
+}
+
+int blas_dgemm(double alpha, const Matrix *a, const Matrix *b, double beta,
+               Matrix *c) {
+    (void)alpha;
+    (void)a;
+    (void)b;
+    (void)beta;
+    (void)c;
+    return ERROR_UNSUPPORTED;
+}
+
+int blas_dgetrf(Matrix *a, int *pivots, int *sign) {
+    (void)a;
+    (void)pivots;
+    (void)sign;
+    return ERROR_UNSUPPORTED;
+}
+
+int blas_lu_trsm(const Matrix *lu, Matrix *x) {
+    (void)lu;
+    (void)x;
+    return ERROR_UNSUPPORTED;
+}
+
+#endif
+
+int blas_backend_available(void) {
+#ifdef MATHLIB_BLAS
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+const char *blas_backend_name(void) {
+    return blas_backend_available() ? MATHLIB_BLAS_NAME : "none";
+}
+
+int blas_backend_set_threshold(BlasOp op, uint64_t flops) {
+    DEBUG_PRINT("Setting BLAS threshold of op %d to %llu\n", (int)op,
+                (unsigned long long)flops);
+
+    if ((int)op < 0 || op >= BLAS_OP_COUNT) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+#ifdef MATHLIB_BLAS
+#ifndef MATHLIB_LAPACK
+    if (op == BLAS_OP_GETRF && flops != BLAS_THRESHOLD_NEVER) {
+        return ERROR_UNSUPPORTED;
+    }
+#endif
+    __atomic_store_n(&blas_thresholds[op], flops, __ATOMIC_RELAXED);
+    return SUCCESS;
+#else
+    return flops == BLAS_THRESHOLD_NEVER ? SUCCESS : ERROR_UNSUPPORTED;
+#endif
+}
+
+uint64_t blas_backend_threshold(BlasOp op) {
+#ifdef MATHLIB_BLAS
+    if ((int)op >= 0 && op < BLAS_OP_COUNT) {
+        return __atomic_load_n(&blas_thresholds[op], __ATOMIC_RELAXED);
+    }
+#else
+    (void)op;
+#endif
+    return BLAS_THRESHOLD_NEVER;
+}
\ No newline at end of file
@@ -26,7 +26,7 @@ void test_basic_math() {
 void test_vector_operations() {
     printf("\n===== Vector Operations Tests =====\n");
 
-    Vector v1, v2, v3;
+    Vector v1, v2, v3 = {0};
     double scalar_result;
 
     // Create vectors
@@ -95,24 +95,24 @@ void test_matrix_operations() {
     matrix_create(3, 2, &m2);
 
     // Initialize matrix values
-    m1.data[0][0] = 1.0;
-    m1.data[0][1] = 2.0;
-    m1.data[0][2] = 3.0;
-    m1.data[1][0] = 4.0;
-    m1.data[1][1] = 5.0;
-    m1.data[1][2] = 6.0;
-
-    m2.data[0][0] = 7.0;
-    m2.data[0][1] = 8.0;
-    m2.data[1][0] = 9.0;
-    m2.data[1][1] = 10.0;
-    m2.data[2][0] = 11.0;
-    m2.data[2][1] = 12.0;
+    MATRIX_AT(&m1, 0, 0) = 1.0;
+    MATRIX_AT(&m1, 0, 1) = 2.0;
+    MATRIX_AT(&m1, 0, 2) = 3.0;
+    MATRIX_AT(&m1, 1, 0) = 4.0;
+    MATRIX_AT(&m1, 1, 1) = 5.0;
+    MATRIX_AT(&m1, 1, 2) = 6.0;
+
+    MATRIX_AT(&m2, 0, 0) = 7.0;
+    MATRIX_AT(&m2, 0, 1) = 8.0;
+    MATRIX_AT(&m2, 1, 0) = 9.0;
+    MATRIX_AT(&m2, 1, 1) = 10.0;
+    MATRIX_AT(&m2, 2, 0) = 11.0;
+    MATRIX_AT(&m2, 2, 1) = 12.0;
 
     printf("Matrix 1:\n");
     for (int i = 0; i < m1.rows; i++) {
         for (int j = 0; j < m1.cols; j++) {
-            printf("%.2f ", m1.data[i][j]);
+            printf("%.2f ", MATRIX_AT(&m1, i, j));
         }
         printf("\n");
     }
@@ -120,7 +120,7 @@ void test_matrix_operations() {
     printf("Matrix 2:\n");
     for (int i = 0; i < m2.rows; i++) {
         for (int j = 0; j < m2.cols; j++) {
-            printf("%.2f ", m2.data[i][j]);
+            printf("%.2f ", MATRIX_AT(&m2, i, j));
         }
         printf("\n");
     }
@@ -130,7 +130,7 @@ void test_matrix_operations() {
     printf("Matrix Multiplication:\n");
     for (int i = 0; i < m3.rows; i++) {
         for (int j = 0; j < m3.cols; j++) {
-            printf("%.2f ", m3.data[i][j]);
+            printf("%.2f ", MATRIX_AT(&m3, i, j));
         }
         printf("\n");
     }
@@ -139,20 +139,20 @@ void test_matrix_operations() {
     // Create square matrix for determinant
     matrix_free(&m1);
     matrix_create(3, 3, &m1);
-    m1.data[0][0] = 1.0;
-    m1.data[0][1] = 2.0;
-    m1.data[0][2] = 3.0;
-    m1.data[1][0] = 4.0;
-    m1.data[1][1] = 5.0;
-    m1.data[1][2] = 6.0;
-    m1.data[2][0] = 7.0;
-    m1.data[2][1] = 8.0;
-    m1.data[2][2] = 9.0;
+    MATRIX_AT(&m1, 0, 0) = 1.0;
+    MATRIX_AT(&m1, 0, 1) = 2.0;
+    MATRIX_AT(&m1, 0, 2) = 3.0;
+    MATRIX_AT(&m1, 1, 0) = 4.0;
+    MATRIX_AT(&m1, 1, 1) = 5.0;
+    MATRIX_AT(&m1, 1, 2) = 6.0;
+    MATRIX_AT(&m1, 2, 0) = 7.0;
+    MATRIX_AT(&m1, 2, 1) = 8.0;
+    MATRIX_AT(&m1, 2, 2) = 9.0;
 
     printf("3x3 Matrix:\n");
     for (int i = 0; i < m1.rows; i++) {
         for (int j = 0; j < m1.cols; j++) {
-            printf("%.2f ", m1.data[i][j]);
+            printf("%.2f ", MATRIX_AT(&m1, i, j));
         }
         printf("\n");
     }
@@ -166,7 +166,7 @@ void test_matrix_operations() {
     printf("Matrix Transpose:\n");
     for (int i = 0; i < m3.rows; i++) {
         for (int j = 0; j < m3.cols; j++) {
-            printf("%.2f ", m3.data[i][j]);
+            printf("%.2f ", MATRIX_AT(&m3, i, j));
         }
         printf("\n");
     }
@@ -0,0 +1,547 @@
+#include "../include/matrix_batch.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define MATRIX_BATCH_X86 1
+#else
+#define MATRIX_BATCH_X86 0
+#endif
+
+// Kernels step through the lanes four members at a time. Every plane is
+// padded to a whole number of groups, so only outputs that are not batch
+// planes (the determinant vector) need a partial last group.
+#define BATCH_LANES 4
+
+// Explicit vector type: a group of lanes is loaded in full before any
+// store, which keeps exact aliasing between operands and result safe
+typedef double BatchDouble4 __attribute__((vector_size(32)));
+
+// Planes are read together, so a stride that is a multiple of 4 KB would
+// put every plane of a lane group in the same L1 set; skip one cache line
+// in that case
+static int batch_stride_for(int count) {
+    const int per_line = MATH_ALIGNMENT / (int)sizeof(double);
+    int stride = (count + per_line - 1) / per_line * per_line;
+    if (stride % (4096 / (int)sizeof(double)) == 0) {
+        stride += per_line;
+    }
+    return stride;
+}
+
+static int batch_alloc(int planes, int count, Allocator *allocator,
+                       int *stride, double **data) {
+    *stride = batch_stride_for(count);
+    if ((size_t)*stride > SIZE_MAX / sizeof(double) / (size_t)planes) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    size_t bytes = (size_t)planes * (size_t)*stride * sizeof(double);
+    *data = (double *)allocator_alloc(allocator, bytes);
+    if (*data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    memset(*data, 0, bytes);
+    return SUCCESS;
+}
+
+int matrix_batch_create(int order, int count, MatrixBatch *result) {
+    DEBUG_PRINT("Creating batch of %d %dx%d matrices\n", count, order, order);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (order <= 0 || order > MATRIX_BATCH_MAX_ORDER || count <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    Allocator *allocator = allocator_current();
+    int status = batch_alloc(order * order, count, allocator, &result->stride,
+                             &result->data);
+    if (status != SUCCESS) {
+        result->data = NULL;
+        return status;
+    }
+
+    result->order = order;
+    result->count = count;
+    result->allocator = allocator;
+    return SUCCESS;
+}
+
+void matrix_batch_free(MatrixBatch *batch) {
+    DEBUG_PRINT("Freeing matrix batch\n");
+
+    if (batch == NULL || batch->data == NULL) {
+        return;
+    }
+
+    allocator_free(batch->allocator, batch->data,
+                   (size_t)batch->order * (size_t)batch->order *
+                       (size_t)batch->stride * sizeof(double));
+    batch->data = NULL;
+    batch->order = 0;
+    batch->count = 0;
+    batch->stride = 0;
+}
+
+int vector_batch_create(int size, int count, VectorBatch *result) {
+    DEBUG_PRINT("Creating batch of %d vectors of size %d\n", count, size);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (size <= 0 || size > MATRIX_BATCH_MAX_ORDER || count <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    Allocator *allocator = allocator_current();
+    int status =
+        batch_alloc(size, count, allocator, &result->stride, &result->data);
+    if (status != SUCCESS) {
+        result->data = NULL;
+        return status;
+    }
+
+    result->size = size;
+    result->count = count;
+    result->allocator = allocator;
+    return SUCCESS;
+}
+
+void vector_batch_free(VectorBatch *batch) {
+    DEBUG_PRINT("Freeing vector batch\n");
+
+    if (batch == NULL || batch->data == NULL) {
+        return;
+    }
+
+    allocator_free(batch->allocator, batch->data,
+                   (size_t)batch->size * (size_t)batch->stride *
+                       sizeof(double));
+    batch->data = NULL;
+    batch->size = 0;
+    batch->count = 0;
+    batch->stride = 0;
+}
+
+int matrix_batch_set(MatrixBatch *batch, int index, const Matrix *m) {
+    DEBUG_PRINT("Setting matrix batch member %d\n", index);
+
+    if (batch == NULL || batch->data == NULL || m == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (index < 0 || index >= batch->count || m->rows != batch->order ||
+        m->cols != batch->order) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < batch->order; i++) {
+        for (int j = 0; j < batch->order; j++) {
+            MATRIX_BATCH_AT(batch, index, i, j) = MATRIX_ELEM(m, i, j);
+        }
+    }
+
+    return SUCCESS;
+}
+
+int matrix_batch_get(const MatrixBatch *batch, int index, Matrix *result) {
+    DEBUG_PRINT("Getting matrix batch member %d\n", index);
+
+    if (batch == NULL || batch->data == NULL || result == NULL ||
+        result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (index < 0 || index >= batch->count || result->rows != batch->order ||
+        result->cols != batch->order) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(result);
+    for (int i = 0; i < batch->order; i++) {
+        for (int j = 0; j < batch->order; j++) {
+            MATRIX_ELEM(result, i, j) = MATRIX_BATCH_AT(batch, index, i, j);
+        }
+    }
+
+    return SUCCESS;
+}
+
+int vector_batch_set(VectorBatch *batch, int index, const Vector *v) {
+    DEBUG_PRINT("Setting vector batch member %d\n", index);
+
+    if (batch == NULL || batch->data == NULL || v == NULL || v->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (index < 0 || index >= batch->count || v->size != batch->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < batch->size; i++) {
+        VECTOR_BATCH_AT(batch, index, i) = v->data[i];
+    }
+
+    return SUCCESS;
+}
+
+int vector_batch_get(const VectorBatch *batch, int index, Vector *result) {
+    DEBUG_PRINT("Getting vector batch member %d\n", index);
+
+    if (batch == NULL || batch->data == NULL || result == NULL ||
+        result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (index < 0 || index >= batch->count || result->size != batch->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < batch->size; i++) {
+        result->data[i] = VECTOR_BATCH_AT(batch, index, i);
+    }
+
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Fixed-order kernels
+// ---------------------------------------------------------------------------
+
+// Every body takes the order n as a compile-time constant (see
+// BATCH_FOR_ORDER), so the element loops unroll completely and only the
+// loop over lane groups [begin, end) remains
+
+// c = a * b
+static inline __attribute__((always_inline)) void batch_multiply_body(
+    int n, const double *a, const double *b, double *c, size_t stride,
+    size_t begin, size_t end) {
+    for (size_t l = begin; l < end; l += BATCH_LANES) {
+        BatchDouble4 x[MATRIX_BATCH_MAX_ORDER * MATRIX_BATCH_MAX_ORDER];
+        BatchDouble4 y[MATRIX_BATCH_MAX_ORDER * MATRIX_BATCH_MAX_ORDER];
+#pragma GCC unroll 16
+        for (int e = 0; e < n * n; e++) {
+            memcpy(&x[e], a + (size_t)e * stride + l, sizeof(x[e]));
+            memcpy(&y[e], b + (size_t)e * stride + l, sizeof(y[e]));
+        }
+
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < n; j++) {
+                BatchDouble4 s = x[i * n] * y[j];
+                for (int k = 1; k < n; k++) {
+                    s += x[i * n + k] * y[k * n + j];
+                }
+                memcpy(c + (size_t)(i * n + j) * stride + l, &s, sizeof(s));
+            }
+        }
+    }
+}
+
+// y = a * x
+static inline __attribute__((always_inline)) void batch_vector_body(
+    int n, const double *a, const double *x, double *y, size_t stride,
+    size_t begin, size_t end) {
+    for (size_t l = begin; l < end; l += BATCH_LANES) {
+        BatchDouble4 v[MATRIX_BATCH_MAX_ORDER];
+        BatchDouble4 m[MATRIX_BATCH_MAX_ORDER * MATRIX_BATCH_MAX_ORDER];
+#pragma GCC unroll 4
+        for (int j = 0; j < n; j++) {
+            memcpy(&v[j], x + (size_t)j * stride + l, sizeof(v[j]));
+        }
+#pragma GCC unroll 16
+        for (int e = 0; e < n * n; e++) {
+            memcpy(&m[e], a + (size_t)e * stride + l, sizeof(m[e]));
+        }
+
+        for (int i = 0; i < n; i++) {
+            BatchDouble4 s = m[i * n] * v[0];
+            for (int j = 1; j < n; j++) {
+                s += m[i * n + j] * v[j];
+            }
+            memcpy(y + (size_t)i * stride + l, &s, sizeof(s));
+        }
+    }
+}
+
+// Same closed forms as matrix_determinant for orders 1 to 3; order 4
+// expands along pairs of rows (2x2 minors of rows 0-1 against rows 2-3)
+static inline __attribute__((always_inline)) void batch_determinant_group(
+    int n, const double *a, size_t stride, size_t l, BatchDouble4 *d) {
+    BatchDouble4 m[MATRIX_BATCH_MAX_ORDER * MATRIX_BATCH_MAX_ORDER];
+#pragma GCC unroll 16
+    for (int e = 0; e < n * n; e++) {
+        memcpy(&m[e], a + (size_t)e * stride + l, sizeof(m[e]));
+    }
+
+    if (n == 1) {
+        *d = m[0];
+        return;
+    } else if (n == 2) {
+        *d = m[0] * m[3] - m[1] * m[2];
+        return;
+    } else if (n == 3) {
+        *d = m[0] * (m[4] * m[8] - m[5] * m[7]) -
+             m[1] * (m[3] * m[8] - m[5] * m[6]) +
+             m[2] * (m[3] * m[7] - m[4] * m[6]);
+        return;
+    }
+
+    BatchDouble4 s0 = m[0] * m[5] - m[4] * m[1];
+    BatchDouble4 s1 = m[0] * m[6] - m[4] * m[2];
+    BatchDouble4 s2 = m[0] * m[7] - m[4] * m[3];
+    BatchDouble4 s3 = m[1] * m[6] - m[5] * m[2];
+    BatchDouble4 s4 = m[1] * m[7] - m[5] * m[3];
+    BatchDouble4 s5 = m[2] * m[7] - m[6] * m[3];
+    BatchDouble4 c5 = m[10] * m[15] - m[14] * m[11];
+    BatchDouble4 c4 = m[9] * m[15] - m[13] * m[11];
+    BatchDouble4 c3 = m[9] * m[14] - m[13] * m[10];
+    BatchDouble4 c2 = m[8] * m[15] - m[12] * m[11];
+    BatchDouble4 c1 = m[8] * m[14] - m[12] * m[10];
+    BatchDouble4 c0 = m[8] * m[13] - m[12] * m[9];
+    *d = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+}
+
+// out[k] = det(a_k); out holds only count values, so the last group may be
+// partial
+static inline __attribute__((always_inline)) void batch_determinant_body(
+    int n, const double *a, double *out, size_t stride, size_t count,
+    size_t begin, size_t end) {
+    for (size_t l = begin; l < end; l += BATCH_LANES) {
+        BatchDouble4 d;
+        batch_determinant_group(n, a, stride, l, &d);
+        if (l + BATCH_LANES <= count) {
+            memcpy(out + l, &d, sizeof(d));
+        } else {
+            memcpy(out + l, &d, (count - l) * sizeof(double));
+        }
+    }
+}
+
+// Expand body once per supported order with n as a constant
+#define BATCH_FOR_ORDER(n, body, ...)  \
+    switch (n) {                       \
+        case 1:                        \
+            body(1, __VA_ARGS__);      \
+            break;                     \
+        case 2:                        \
+            body(2, __VA_ARGS__);      \
+            break;                     \
+        case 3:                        \
+            body(3, __VA_ARGS__);      \
+            break;                     \
+        default:                       \
+            body(4, __VA_ARGS__);      \
+            break;                     \
+    }
+
+typedef void (*BatchKernel)(int n, const double *a, const double *b,
+                            double *c, size_t stride, size_t begin,
+                            size_t end);
+typedef void (*BatchDeterminantKernel)(int n, const double *a, double *out,
+                                       size_t stride, size_t count,
+                                       size_t begin, size_t end);
+
+typedef struct {
+    BatchKernel multiply;
+    BatchKernel vector_multiply;
+    BatchDeterminantKernel determinant;
+} BatchKernels;
+
+static void batch_multiply_generic(int n, const double *a, const double *b,
+                                   double *c, size_t stride, size_t begin,
+                                   size_t end) {
+    BATCH_FOR_ORDER(n, batch_multiply_body, a, b, c, stride, begin, end)
+}
+
+static void batch_vector_generic(int n, const double *a, const double *x,
+                                 double *y, size_t stride, size_t begin,
+                                 size_t end) {
+    BATCH_FOR_ORDER(n, batch_vector_body, a, x, y, stride, begin, end)
+}
+
+static void batch_determinant_generic(int n, const double *a, double *out,
+                                      size_t stride, size_t count,
+                                      size_t begin, size_t end) {
+    BATCH_FOR_ORDER(n, batch_determinant_body, a, out, stride, count, begin,
+                    end)
+}
+
+static const BatchKernels batch_kernels_generic = {
+    batch_multiply_generic,
+    batch_vector_generic,
+    batch_determinant_generic,
+};
+
+#if MATRIX_BATCH_X86
+__attribute__((target("avx2,fma"))) static void batch_multiply_avx2(
+    int n, const double *a, const double *b, double *c, size_t stride,
+    size_t begin, size_t end) {
+    BATCH_FOR_ORDER(n, batch_multiply_body, a, b, c, stride, begin, end)
+}
+
+__attribute__((target("avx2,fma"))) static void batch_vector_avx2(
+    int n, const double *a, const double *x, double *y, size_t stride,
+    size_t begin, size_t end) {
+    BATCH_FOR_ORDER(n, batch_vector_body, a, x, y, stride, begin, end)
+}
+
+__attribute__((target("avx2,fma"))) static void batch_determinant_avx2(
+    int n, const double *a, double *out, size_t stride, size_t count,
+    size_t begin, size_t end) {
+    BATCH_FOR_ORDER(n, batch_determinant_body, a, out, stride, count, begin,
+                    end)
+}
+
+static const BatchKernels batch_kernels_avx2 = {
+    batch_multiply_avx2,
+    batch_vector_avx2,
+    batch_determinant_avx2,
+};
+#endif
+
+static const BatchKernels *batch_kernels(void) {
+    static _Atomic(const BatchKernels *) selected = NULL;
+
+    const BatchKernels *kernels =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernels == NULL) {
+        kernels = &batch_kernels_generic;
+#if MATRIX_BATCH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernels = &batch_kernels_avx2;
+        }
+#endif
+        atomic_store_explicit(&selected, kernels, memory_order_release);
+    }
+
+    return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// Batched operations
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    BatchKernel kernel;
+    BatchDeterminantKernel determinant;
+    int n;
+    const double *a;
+    const double *b;
+    double *c;
+    size_t stride;
+    size_t count;
+} BatchTask;
+
+// Body of the parallel loop over lane groups [begin, end)
+static void batch_task(void *ctx, int begin, int end) {
+    const BatchTask *task = (const BatchTask *)ctx;
+    size_t first = (size_t)begin * BATCH_LANES;
+    size_t last = (size_t)end * BATCH_LANES;
+
+    if (task->determinant != NULL) {
+        task->determinant(task->n, task->a, task->c, task->stride,
+                          task->count, first, last);
+    } else {
+        task->kernel(task->n, task->a, task->b, task->c, task->stride, first,
+                     last);
+    }
+}
+
+static void batch_run(BatchTask *task, size_t flops_per_member) {
+    int groups = (int)((task->count + BATCH_LANES - 1) / BATCH_LANES);
+    int grain = parallel_grain(flops_per_member * BATCH_LANES);
+    parallel_for(0, groups, grain, batch_task, task);
+}
+
+int matrix_multiply_batched(const MatrixBatch *a, const MatrixBatch *b,
+                            MatrixBatch *result) {
+    DEBUG_PRINT("Multiplying matrix batches\n");
+
+    if (a == NULL || b == NULL || result == NULL || a->data == NULL ||
+        b->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (a->order != b->order || a->order != result->order ||
+        a->count != b->count || a->count != result->count) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    size_t n = (size_t)a->order;
+    PerfScope scope;
+    perf_begin(&scope);
+    BatchTask task = {batch_kernels()->multiply, NULL, a->order,
+                      a->data, b->data, result->data,
+                      (size_t)a->stride, (size_t)a->count};
+    batch_run(&task, 2 * n * n * n);
+    uint64_t count = (uint64_t)a->count;
+    perf_end(&scope, PERF_OP_BATCH_MULTIPLY, 24 * n * n * count,
+             2 * n * n * n * count);
+    return SUCCESS;
+}
+
+int matrix_vector_multiply_batched(const MatrixBatch *a, const VectorBatch *x,
+                                   VectorBatch *result) {
+    DEBUG_PRINT("Multiplying matrix batch by vector batch\n");
+
+    if (a == NULL || x == NULL || result == NULL || a->data == NULL ||
+        x->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (a->order != x->size || a->order != result->size ||
+        a->count != x->count || a->count != result->count) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    size_t n = (size_t)a->order;
+    PerfScope scope;
+    perf_begin(&scope);
+    BatchTask task = {batch_kernels()->vector_multiply, NULL, a->order,
+                      a->data, x->data, result->data,
+                      (size_t)a->stride, (size_t)a->count};
+    batch_run(&task, 2 * n * n);
+    uint64_t count = (uint64_t)a->count;
+    perf_end(&scope, PERF_OP_BATCH_VECTOR_MULTIPLY, 8 * (n * n + 2 * n) * count,
+             2 * n * n * count);
+    return SUCCESS;
+}
+
+int matrix_determinant_batched(const MatrixBatch *a, Vector *result) {
+    DEBUG_PRINT("Calculating matrix batch determinants\n");
+
+    if (a == NULL || result == NULL || a->data == NULL ||
+        result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (result->size != a->count) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    // Operations in the closed forms of batch_determinant_group
+    static const uint64_t flops_per_order[MATRIX_BATCH_MAX_ORDER] = {
+        0, 3, 14, 47};
+    size_t n = (size_t)a->order;
+    PerfScope scope;
+    perf_begin(&scope);
+    BatchTask task = {NULL, batch_kernels()->determinant, a->order,
+                      a->data, NULL, result->data,
+                      (size_t)a->stride, (size_t)a->count};
+    batch_run(&task, 2 * n * n * n);
+    uint64_t count = (uint64_t)a->count;
+    perf_end(&scope, PERF_OP_BATCH_DETERMINANT, 8 * (n * n + 1) * count,
+             flops_per_order[n - 1] * count);
+    return SUCCESS;
+}
\ No newline at end of file
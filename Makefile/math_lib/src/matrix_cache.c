@@ -0,0 +1,421 @@
+#include "../include/matrix_cache.h"
+
+#include <stdlib.h>
+
+#include "../include/allocator.h"
+
+typedef enum {
+    CACHE_LU,
+    CACHE_INVERSE,
+} CacheKind;
+
+struct MatrixCacheEntry {
+    uint64_t id;
+    uint64_t version;
+    CacheKind kind;
+    MatrixLU lu;
+    Matrix inverse;
+    size_t bytes;
+    // Callers using the entry. An entry dropped from the cache while in
+    // use is freed by its last caller.
+    int refs;
+    int cached;
+    MatrixCacheEntry *chain;
+    MatrixCacheEntry *newer;
+    MatrixCacheEntry *older;
+};
+
+static MatrixCache *matrix_cache_enabled;
+
+static MatrixCacheEntry **cache_bucket(MatrixCache *cache, uint64_t id,
+                                       CacheKind kind) {
+    uint64_t h = (id * 2 + (uint64_t)kind) * 0x9E3779B97F4A7C15ull;
+    return &cache->buckets[(h >> 32) & (uint64_t)cache->bucket_mask];
+}
+
+static size_t cache_matrix_bytes(const Matrix *m) {
+    return (size_t)m->rows * (size_t)m->stride * sizeof(double);
+}
+
+static void cache_entry_free(MatrixCacheEntry *e) {
+    if (e->kind == CACHE_LU) {
+        matrix_lu_free(&e->lu);
+    } else {
+        matrix_free(&e->inverse);
+    }
+    free(e);
+}
+
+// The cache functions below run with the lock held
+static MatrixCacheEntry *cache_find(MatrixCache *cache, uint64_t id,
+                                    CacheKind kind) {
+    MatrixCacheEntry *e = *cache_bucket(cache, id, kind);
+    while (e != NULL && (e->id != id || e->kind != kind)) {
+        e = e->chain;
+    }
+    return e;
+}
+
+static void cache_lru_remove(MatrixCache *cache, MatrixCacheEntry *e) {
+    if (e->newer != NULL) {
+        e->newer->older = e->older;
+    } else {
+        cache->newest = e->older;
+    }
+    if (e->older != NULL) {
+        e->older->newer = e->newer;
+    } else {
+        cache->oldest = e->newer;
+    }
+    e->newer = NULL;
+    e->older = NULL;
+}
+
+static void cache_lru_push(MatrixCache *cache, MatrixCacheEntry *e) {
+    e->older = cache->newest;
+    e->newer = NULL;
+    if (cache->newest != NULL) {
+        cache->newest->newer = e;
+    } else {
+        cache->oldest = e;
+    }
+    cache->newest = e;
+}
+
+static void cache_unlink(MatrixCache *cache, MatrixCacheEntry *e) {
+    MatrixCacheEntry **link = cache_bucket(cache, e->id, e->kind);
+    while (*link != e) {
+        link = &(*link)->chain;
+    }
+    *link = e->chain;
+    e->chain = NULL;
+
+    cache_lru_remove(cache, e);
+    cache->count--;
+    cache->bytes -= e->bytes;
+    e->cached = 0;
+    if (e->refs == 0) {
+        cache_entry_free(e);
+    }
+}
+
+static int cache_over_limit(const MatrixCache *cache) {
+    return cache->count > cache->max_entries ||
+           (cache->max_bytes != 0 && cache->bytes > cache->max_bytes);
+}
+
+// Returns a current entry for m with a reference taken, or NULL on a miss
+static MatrixCacheEntry *cache_acquire(MatrixCache *cache, const Matrix *m,
+                                       CacheKind kind) {
+    if (m->id == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    MatrixCacheEntry *e = cache_find(cache, m->id, kind);
+    if (e != NULL && e->version == m->version) {
+        cache_lru_remove(cache, e);
+        cache_lru_push(cache, e);
+        e->refs++;
+        cache->hits++;
+    } else {
+        // An entry for older contents can never be used again
+        if (e != NULL) {
+            cache_unlink(cache, e);
+        }
+        e = NULL;
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+    return e;
+}
+
+// Links a freshly computed entry, which the caller keeps a reference to,
+// and evicts from the cold end until the cache is within its limits
+static void cache_insert(MatrixCache *cache, MatrixCacheEntry *e) {
+    if (e->id == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    // Another thread may have computed the same result meanwhile
+    MatrixCacheEntry *old = cache_find(cache, e->id, e->kind);
+    if (old != NULL) {
+        cache_unlink(cache, old);
+    }
+
+    MatrixCacheEntry **bucket = cache_bucket(cache, e->id, e->kind);
+    e->chain = *bucket;
+    *bucket = e;
+    cache_lru_push(cache, e);
+    cache->count++;
+    cache->bytes += e->bytes;
+    e->cached = 1;
+
+    while (cache_over_limit(cache) && cache->oldest != e) {
+        cache_unlink(cache, cache->oldest);
+    }
+    // A result larger than the whole budget is only handed to the caller
+    if (cache_over_limit(cache)) {
+        cache_unlink(cache, e);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+static void cache_release(MatrixCache *cache, MatrixCacheEntry *e) {
+    pthread_mutex_lock(&cache->lock);
+    int release = --e->refs == 0 && !e->cached;
+    pthread_mutex_unlock(&cache->lock);
+    if (release) {
+        cache_entry_free(e);
+    }
+}
+
+static MatrixCacheEntry *cache_entry_new(const Matrix *m, CacheKind kind) {
+    MatrixCacheEntry *e = (MatrixCacheEntry *)calloc(1, sizeof(*e));
+    if (e != NULL) {
+        e->id = m->id;
+        e->version = m->version;
+        e->kind = kind;
+        e->refs = 1;
+    }
+    return e;
+}
+
+static int cache_lu(MatrixCache *cache, const Matrix *m,
+                    MatrixCacheEntry **entry) {
+    *entry = cache_acquire(cache, m, CACHE_LU);
+    if (*entry != NULL) {
+        return SUCCESS;
+    }
+
+    MatrixCacheEntry *e = cache_entry_new(m, CACHE_LU);
+    if (e == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    Allocator *previous = allocator_set_current(NULL);
+    int status = matrix_lu(m, &e->lu);
+    allocator_set_current(previous);
+    if (status != SUCCESS) {
+        free(e);
+        return status;
+    }
+
+    e->bytes = cache_matrix_bytes(&e->lu.lu) + (size_t)m->rows * sizeof(int);
+    cache_insert(cache, e);
+    *entry = e;
+    return SUCCESS;
+}
+
+static int cache_inverse(MatrixCache *cache, const Matrix *m,
+                         MatrixCacheEntry **entry) {
+    *entry = cache_acquire(cache, m, CACHE_INVERSE);
+    if (*entry != NULL) {
+        return SUCCESS;
+    }
+
+    MatrixCacheEntry *lu;
+    int status = cache_lu(cache, m, &lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    MatrixCacheEntry *e = cache_entry_new(m, CACHE_INVERSE);
+    if (e == NULL) {
+        cache_release(cache, lu);
+        return ERROR_NULL_POINTER;
+    }
+
+    // Solve A X = I in place
+    const int n = m->rows;
+    status = matrix_create_with(n, n, NULL, &e->inverse);
+    if (status == SUCCESS) {
+        for (int i = 0; i < n; i++) {
+            MATRIX_AT(&e->inverse, i, i) = 1.0;
+        }
+        status = matrix_lu_solve_matrix_into(&lu->lu, &e->inverse,
+                                             &e->inverse);
+    }
+    cache_release(cache, lu);
+    if (status != SUCCESS) {
+        matrix_free(&e->inverse);
+        free(e);
+        return status;
+    }
+
+    e->bytes = cache_matrix_bytes(&e->inverse);
+    cache_insert(cache, e);
+    *entry = e;
+    return SUCCESS;
+}
+
+int matrix_cache_init(MatrixCache *cache, int max_entries, size_t max_bytes) {
+    DEBUG_PRINT("Creating matrix cache of %d entries\n", max_entries);
+
+    if (cache == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (max_entries <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    // About two buckets per entry keeps chains short
+    size_t buckets = 16;
+    while (buckets < 2 * (size_t)max_entries && buckets < ((size_t)1 << 24)) {
+        buckets *= 2;
+    }
+    cache->buckets =
+        (MatrixCacheEntry **)calloc(buckets, sizeof(MatrixCacheEntry *));
+    if (cache->buckets == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    cache->bucket_mask = (int)(buckets - 1);
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->count = 0;
+    cache->max_entries = max_entries;
+    cache->bytes = 0;
+    cache->max_bytes = max_bytes;
+    cache->hits = 0;
+    cache->misses = 0;
+    pthread_mutex_init(&cache->lock, NULL);
+    return SUCCESS;
+}
+
+void matrix_cache_destroy(MatrixCache *cache) {
+    DEBUG_PRINT("Destroying matrix cache\n");
+
+    if (cache == NULL || cache->buckets == NULL) {
+        return;
+    }
+
+    matrix_cache_clear(cache);
+    free(cache->buckets);
+    cache->buckets = NULL;
+    pthread_mutex_destroy(&cache->lock);
+}
+
+void matrix_cache_clear(MatrixCache *cache) {
+    DEBUG_PRINT("Clearing matrix cache\n");
+
+    if (cache == NULL || cache->buckets == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    while (cache->oldest != NULL) {
+        cache_unlink(cache, cache->oldest);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void matrix_cache_forget(MatrixCache *cache, const Matrix *m) {
+    DEBUG_PRINT("Dropping cached results of a matrix\n");
+
+    if (cache == NULL || m == NULL || m->id == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    MatrixCacheEntry *e = cache_find(cache, m->id, CACHE_LU);
+    if (e != NULL) {
+        cache_unlink(cache, e);
+    }
+    e = cache_find(cache, m->id, CACHE_INVERSE);
+    if (e != NULL) {
+        cache_unlink(cache, e);
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void matrix_cache_stats(MatrixCache *cache, MatrixCacheStats *stats) {
+    DEBUG_PRINT("Reading matrix cache statistics\n");
+
+    if (cache == NULL || stats == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    stats->hits = cache->hits;
+    stats->misses = cache->misses;
+    stats->entries = cache->count;
+    stats->bytes = cache->bytes;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+int matrix_cache_determinant(MatrixCache *cache, const Matrix *m,
+                             double *result) {
+    DEBUG_PRINT("Calculating cached matrix determinant\n");
+
+    if (cache == NULL || m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixCacheEntry *e;
+    int status = cache_lu(cache, m, &e);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_determinant(&e->lu, result);
+    cache_release(cache, e);
+    return status;
+}
+
+int matrix_cache_solve(MatrixCache *cache, const Matrix *a, const Vector *b,
+                       Vector *x) {
+    DEBUG_PRINT("Solving linear system with cached factors\n");
+
+    if (cache == NULL || a == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixCacheEntry *e;
+    int status = cache_lu(cache, a, &e);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_solve(&e->lu, b, x);
+    cache_release(cache, e);
+    return status;
+}
+
+int matrix_cache_inverse(MatrixCache *cache, const Matrix *m, Matrix *result) {
+    DEBUG_PRINT("Inverting matrix through the cache\n");
+
+    if (cache == NULL || m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixCacheEntry *e;
+    int status = cache_inverse(cache, m, &e);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_create_uninitialized(m->rows, m->rows, result);
+    if (status == SUCCESS) {
+        status = matrix_copy(&e->inverse, result);
+        if (status != SUCCESS) {
+            matrix_free(result);
+        }
+    }
+    cache_release(cache, e);
+    return status;
+}
+
+MatrixCache *matrix_cache_enable(MatrixCache *cache) {
+    DEBUG_PRINT("Enabling matrix cache\n");
+    return __atomic_exchange_n(&matrix_cache_enabled, cache, __ATOMIC_ACQ_REL);
+}
+
+MatrixCache *matrix_cache_for(const Matrix *m) {
+    if (m == NULL || m->id == 0 || m->rows < MATRIX_CACHE_MIN_ORDER) {
+        return NULL;
+    }
+    return __atomic_load_n(&matrix_cache_enabled, __ATOMIC_ACQUIRE);
+}
\ No newline at end of file
@@ -0,0 +1,718 @@
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../include/blas_backend.h"
+#include "../include/math_plan.h"
+#include "../include/matrix_math.h"
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+
+// Cache blocking parameters
+// MR x NR is the tile of C held in registers by the micro-kernel, KC is the
+// depth of a packed panel (a KC x NR sliver of B stays in L1), MC rows of A
+// are packed per L2 block and NC columns of B per L3 block.
+#define GEMM_MR 4
+#define GEMM_NR 8
+#define GEMM_KC 256
+#define GEMM_MC 96
+#define GEMM_NC 4096
+
+// Below this many multiply-adds packing costs more than it saves
+#define GEMM_SMALL_WORK (32 * 32 * 32)
+
+// Largest Strassen level (in doubles of temporaries) that runs its seven
+// products as parallel tasks; bigger levels use the three-temporary
+// schedule and leave the parallelism to the levels below
+#define STRASSEN_PARALLEL_WORDS ((size_t)1 << 25)
+
+// C[MR x NR] += A_panel * B_panel over kc steps
+// a is packed MR values per step, b is packed NR values per step
+static inline __attribute__((always_inline)) void gemm_micro_kernel_body(
+    int kc, const double *restrict a, const double *restrict b,
+    double *restrict c, int ldc) {
+    double acc[GEMM_MR][GEMM_NR] = {{0.0}};
+
+    for (int p = 0; p < kc; p++) {
+        for (int i = 0; i < GEMM_MR; i++) {
+            const double ai = a[i];
+            for (int j = 0; j < GEMM_NR; j++) {
+                acc[i][j] += ai * b[j];
+            }
+        }
+        a += GEMM_MR;
+        b += GEMM_NR;
+    }
+
+    for (int i = 0; i < GEMM_MR; i++) {
+        for (int j = 0; j < GEMM_NR; j++) {
+            c[(size_t)i * ldc + j] += acc[i][j];
+        }
+    }
+}
+
+static void gemm_micro_kernel_generic(int kc, const double *a,
+                                      const double *b, double *c, int ldc) {
+    gemm_micro_kernel_body(kc, a, b, c, ldc);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2,fma"))) static void gemm_micro_kernel_avx2(
+    int kc, const double *a, const double *b, double *c, int ldc) {
+    gemm_micro_kernel_body(kc, a, b, c, ldc);
+}
+#endif
+
+typedef void (*GemmMicroKernel)(int kc, const double *a, const double *b,
+                                double *c, int ldc);
+
+static GemmMicroKernel gemm_select_kernel(void) {
+    static _Atomic(GemmMicroKernel) selected = NULL;
+
+    GemmMicroKernel kernel =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernel == NULL) {
+        GemmMicroKernel chosen = gemm_micro_kernel_generic;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            chosen = gemm_micro_kernel_avx2;
+        }
+#endif
+        kernel = chosen;
+        atomic_store_explicit(&selected, kernel, memory_order_release);
+    }
+
+    return kernel;
+}
+
+// Pointer to logical element (i, j) of m
+static const double *gemm_elem(const Matrix *m, int i, int j) {
+    return MATRIX_IS_TRANSPOSED(m) ? MATRIX_ROW(m, j) + i
+                                   : MATRIX_ROW(m, i) + j;
+}
+
+// Pack an mc x kc block of A (scaled by alpha) into MR-row slivers,
+// zero-padding the last sliver. A transposed A is read down its stored
+// rows, which is the contiguous direction for this layout.
+static void gemm_pack_a(int mc, int kc, const double *a, int lda,
+                        int transposed, double alpha, double *packed) {
+    for (int i = 0; i < mc; i += GEMM_MR) {
+        int rows = mc - i < GEMM_MR ? mc - i : GEMM_MR;
+        for (int p = 0; p < kc; p++) {
+            if (transposed) {
+                const double *src = a + (size_t)p * lda + i;
+                for (int r = 0; r < rows; r++) {
+                    packed[r] = alpha * src[r];
+                }
+            } else {
+                for (int r = 0; r < rows; r++) {
+                    packed[r] = alpha * a[(size_t)(i + r) * lda + p];
+                }
+            }
+            for (int r = rows; r < GEMM_MR; r++) {
+                packed[r] = 0.0;
+            }
+            packed += GEMM_MR;
+        }
+    }
+}
+
+// Pack a kc x nc block of B into NR-column slivers, zero-padding the last
+// sliver
+static void gemm_pack_b(int kc, int nc, const double *b, int ldb,
+                        int transposed, double *packed) {
+    for (int j = 0; j < nc; j += GEMM_NR) {
+        int cols = nc - j < GEMM_NR ? nc - j : GEMM_NR;
+        for (int p = 0; p < kc; p++) {
+            if (transposed) {
+                for (int c = 0; c < cols; c++) {
+                    packed[c] = b[(size_t)(j + c) * ldb + p];
+                }
+            } else {
+                const double *src = b + (size_t)p * ldb + j;
+                for (int c = 0; c < cols; c++) {
+                    packed[c] = src[c];
+                }
+            }
+            for (int c = cols; c < GEMM_NR; c++) {
+                packed[c] = 0.0;
+            }
+            packed += GEMM_NR;
+        }
+    }
+}
+
+// Multiply one packed A block by one packed B block into C
+static void gemm_macro_kernel(GemmMicroKernel kernel, int mc, int nc, int kc,
+                              const double *packed_a, const double *packed_b,
+                              double *c, int ldc) {
+    double edge[GEMM_MR * GEMM_NR];
+
+    for (int j = 0; j < nc; j += GEMM_NR) {
+        int cols = nc - j < GEMM_NR ? nc - j : GEMM_NR;
+        const double *b = packed_b + (size_t)j * kc;
+
+        for (int i = 0; i < mc; i += GEMM_MR) {
+            int rows = mc - i < GEMM_MR ? mc - i : GEMM_MR;
+            const double *a = packed_a + (size_t)i * kc;
+            double *ct = c + (size_t)i * ldc + j;
+
+            if (rows == GEMM_MR && cols == GEMM_NR) {
+                kernel(kc, a, b, ct, ldc);
+                continue;
+            }
+
+            // Partial tile: accumulate into a scratch tile, then copy out
+            memset(edge, 0, sizeof(edge));
+            kernel(kc, a, b, edge, GEMM_NR);
+            for (int r = 0; r < rows; r++) {
+                for (int s = 0; s < cols; s++) {
+                    ct[(size_t)r * ldc + s] += edge[r * GEMM_NR + s];
+                }
+            }
+        }
+    }
+}
+
+// C = beta * C, treating beta == 0 as an overwrite
+static void gemm_scale_c(Matrix *c, double beta) {
+    if (beta == 1.0) {
+        return;
+    }
+
+    for (int i = 0; i < c->rows; i++) {
+        double *row = MATRIX_ROW(c, i);
+        if (beta == 0.0) {
+            memset(row, 0, (size_t)c->cols * sizeof(double));
+        } else {
+            for (int j = 0; j < c->cols; j++) {
+                row[j] *= beta;
+            }
+        }
+    }
+}
+
+// Unpacked i-k-j loop for matrices too small to amortize packing
+static void gemm_small(double alpha, const Matrix *a, const Matrix *b,
+                       Matrix *c) {
+    if (MATRIX_IS_TRANSPOSED(a) || MATRIX_IS_TRANSPOSED(b)) {
+        for (int i = 0; i < a->rows; i++) {
+            double *cr = MATRIX_ROW(c, i);
+            for (int k = 0; k < a->cols; k++) {
+                const double aik = alpha * MATRIX_ELEM(a, i, k);
+                for (int j = 0; j < b->cols; j++) {
+                    cr[j] += aik * MATRIX_ELEM(b, k, j);
+                }
+            }
+        }
+        return;
+    }
+
+    for (int i = 0; i < a->rows; i++) {
+        const double *ar = MATRIX_ROW(a, i);
+        double *cr = MATRIX_ROW(c, i);
+        for (int k = 0; k < a->cols; k++) {
+            const double aik = alpha * ar[k];
+            const double *br = MATRIX_ROW(b, k);
+            for (int j = 0; j < b->cols; j++) {
+                cr[j] += aik * br[j];
+            }
+        }
+    }
+}
+
+// Blocked product of one C block: c += alpha * a * b
+static int gemm_blocked(double alpha, const Matrix *m1, const Matrix *m2,
+                        Matrix *result) {
+    const int m = m1->rows;
+    const int n = m2->cols;
+    const int k = m1->cols;
+
+    if ((double)m * n * k <= GEMM_SMALL_WORK) {
+        gemm_small(alpha, m1, m2, result);
+        return SUCCESS;
+    }
+
+    // Size the packing buffers to the problem, capped at one block each
+    int mc_max = m < GEMM_MC ? m : GEMM_MC;
+    int nc_max = n < GEMM_NC ? n : GEMM_NC;
+    int kc_max = k < GEMM_KC ? k : GEMM_KC;
+    size_t a_size = (size_t)(mc_max + GEMM_MR - 1) / GEMM_MR * GEMM_MR * kc_max;
+    size_t b_size = (size_t)(nc_max + GEMM_NR - 1) / GEMM_NR * GEMM_NR * kc_max;
+
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, MATRIX_ALIGNMENT,
+                       (a_size + b_size) * sizeof(double)) != 0) {
+        return ERROR_NULL_POINTER;
+    }
+    double *packed_a = (double *)buffer;
+    double *packed_b = packed_a + a_size;
+
+    GemmMicroKernel kernel = gemm_select_kernel();
+
+    for (int jc = 0; jc < n; jc += GEMM_NC) {
+        int nc = n - jc < GEMM_NC ? n - jc : GEMM_NC;
+
+        for (int pc = 0; pc < k; pc += GEMM_KC) {
+            int kc = k - pc < GEMM_KC ? k - pc : GEMM_KC;
+            gemm_pack_b(kc, nc, gemm_elem(m2, pc, jc), m2->stride,
+                        MATRIX_IS_TRANSPOSED(m2), packed_b);
+
+            for (int ic = 0; ic < m; ic += GEMM_MC) {
+                int mc = m - ic < GEMM_MC ? m - ic : GEMM_MC;
+                gemm_pack_a(mc, kc, gemm_elem(m1, ic, pc), m1->stride,
+                            MATRIX_IS_TRANSPOSED(m1), alpha, packed_a);
+                gemm_macro_kernel(kernel, mc, nc, kc, packed_a, packed_b,
+                                  MATRIX_ROW(result, ic) + jc, result->stride);
+            }
+        }
+    }
+
+    free(buffer);
+    return SUCCESS;
+}
+
+// Parallel split of C into row panels (split_rows) or column panels
+typedef struct {
+    double alpha;
+    const Matrix *a;
+    const Matrix *b;
+    Matrix *c;
+    int split_rows;
+    atomic_int status;
+} GemmTask;
+
+static void gemm_task(void *ctx, int begin, int end) {
+    GemmTask *task = (GemmTask *)ctx;
+    const Matrix *a = task->a;
+    const Matrix *b = task->b;
+    Matrix *c = task->c;
+    Matrix av, bv, cv;
+    int status;
+
+    if (task->split_rows) {
+        matrix_view(a, begin, 0, end - begin, a->cols, &av);
+        matrix_view(c, begin, 0, end - begin, c->cols, &cv);
+        status = gemm_blocked(task->alpha, &av, b, &cv);
+    } else {
+        matrix_view(b, 0, begin, b->rows, end - begin, &bv);
+        matrix_view(c, 0, begin, c->rows, end - begin, &cv);
+        status = gemm_blocked(task->alpha, a, &bv, &cv);
+    }
+
+    if (status != SUCCESS) {
+        atomic_store(&task->status, status);
+    }
+}
+
+// c += alpha * a * b with the tiled kernel, split across the pool along the
+// longer side of C; panels are kept at least one register tile wide
+static int gemm_run(double alpha, const Matrix *a, const Matrix *b,
+                    Matrix *c) {
+    const int m = a->rows;
+    const int n = b->cols;
+    const int k = a->cols;
+
+    GemmTask task = {alpha, a, b, c, m >= n, SUCCESS};
+    int length = task.split_rows ? m : n;
+    int tile = task.split_rows ? GEMM_MR : GEMM_NR;
+    int grain = parallel_grain((size_t)(task.split_rows ? n : m) * k);
+    if (grain < tile) {
+        grain = tile;
+    }
+
+    parallel_for(0, length, grain, gemm_task, &task);
+    return atomic_load(&task.status);
+}
+
+// ---------------------------------------------------------------------------
+// Strassen-Winograd
+// ---------------------------------------------------------------------------
+
+static int strassen_cutover = MATRIX_STRASSEN_DEFAULT_CUTOVER;
+
+void matrix_set_strassen_cutover(int n) {
+    __atomic_store_n(&strassen_cutover, n > 0 ? n : 0, __ATOMIC_RELAXED);
+}
+
+int matrix_strassen_cutover(void) {
+    return __atomic_load_n(&strassen_cutover, __ATOMIC_RELAXED);
+}
+
+static int strassen(double alpha, const Matrix *a, const Matrix *b,
+                    Matrix *c);
+
+// Keep the first failure
+static void strassen_status(int *status, int result) {
+    if (*status == SUCCESS && result != SUCCESS) {
+        *status = result;
+    }
+}
+
+// Temporaries come from the heap, not the caller's allocator scope. Only
+// the ones products accumulate into need zeroing; the sums overwrite.
+static int strassen_temps(Matrix *t, int count, int rows, int cols,
+                          int zero) {
+    for (int i = 0; i < count; i++) {
+        int status =
+            zero ? matrix_create_with(rows, cols, NULL, &t[i])
+                 : matrix_create_uninitialized_with(rows, cols, NULL, &t[i]);
+        if (status != SUCCESS) {
+            while (i-- > 0) {
+                matrix_free(&t[i]);
+            }
+            return status;
+        }
+    }
+    return SUCCESS;
+}
+
+static void strassen_free(Matrix *t, int count) {
+    for (int i = 0; i < count; i++) {
+        matrix_free(&t[i]);
+    }
+}
+
+typedef struct {
+    double alpha;
+    const Matrix *a;
+    const Matrix *b;
+    Matrix *c;
+    int status;
+} StrassenProduct;
+
+static void strassen_product_task(void *ctx) {
+    StrassenProduct *p = (StrassenProduct *)ctx;
+    p->status = strassen(p->alpha, p->a, p->b, p->c);
+}
+
+// The quadrants of one level. With the Winograd sums
+//     S1 = A21 + A22   S2 = S1 - A11   S3 = A11 - A21   S4 = A12 - S2
+//     T1 = B12 - B11   T2 = B22 - T1   T3 = B22 - B12   T4 = T2 - B21
+// and products
+//     P1 = A11 B11   P2 = A12 B21   P3 = S4 B22   P4 = A22 T4
+//     P5 = S1 T1     P6 = S2 T2     P7 = S3 T3
+// the update is
+//     C11 += P1 + P2             C12 += P1 + P6 + P5 + P3
+//     C21 += P1 + P6 + P7 - P4   C22 += P1 + P6 + P7 + P5
+typedef struct {
+    Matrix a11, a12, a21, a22;
+    Matrix b11, b12, b21, b22;
+    Matrix c11, c12, c21, c22;
+} StrassenLevel;
+
+// Seven products as tasks. P2, P3 and P4 each feed one quadrant of C and
+// go straight into it; the rest land in temporaries and are summed after
+// the join.
+static int strassen_parallel(double alpha, StrassenLevel *q) {
+    const int m2 = q->a11.rows;
+    const int k2 = q->a11.cols;
+    const int n2 = q->b11.cols;
+
+    Matrix s[4], t[4], p[4];
+    int status = strassen_temps(s, 4, m2, k2, 0);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = strassen_temps(t, 4, k2, n2, 0);
+    if (status != SUCCESS) {
+        strassen_free(s, 4);
+        return status;
+    }
+    status = strassen_temps(p, 4, m2, n2, 1);
+    if (status != SUCCESS) {
+        strassen_free(s, 4);
+        strassen_free(t, 4);
+        return status;
+    }
+
+    matrix_add_into(&q->a21, &q->a22, &s[0]);
+    matrix_subtract_into(&s[0], &q->a11, &s[1]);
+    matrix_subtract_into(&q->a11, &q->a21, &s[2]);
+    matrix_subtract_into(&q->a12, &s[1], &s[3]);
+    matrix_subtract_into(&q->b12, &q->b11, &t[0]);
+    matrix_subtract_into(&q->b22, &t[0], &t[1]);
+    matrix_subtract_into(&q->b22, &q->b12, &t[2]);
+    matrix_subtract_into(&t[1], &q->b21, &t[3]);
+
+    // p holds P1, P5, P6 and P7
+    StrassenProduct products[7] = {
+        {alpha, &q->a11, &q->b11, &p[0], SUCCESS},
+        {alpha, &q->a12, &q->b21, &q->c11, SUCCESS},
+        {alpha, &s[3], &q->b22, &q->c12, SUCCESS},
+        {-alpha, &q->a22, &t[3], &q->c21, SUCCESS},
+        {alpha, &s[0], &t[0], &p[1], SUCCESS},
+        {alpha, &s[1], &t[1], &p[2], SUCCESS},
+        {alpha, &s[2], &t[2], &p[3], SUCCESS},
+    };
+    TaskGroup group = TASK_GROUP_INIT;
+    Task tasks[6];
+    for (int i = 0; i < 6; i++) {
+        task_spawn(&group, &tasks[i], strassen_product_task, &products[i]);
+    }
+    strassen_product_task(&products[6]);
+    task_group_wait(&group);
+    for (int i = 0; i < 7; i++) {
+        strassen_status(&status, products[i].status);
+    }
+
+    // P6 becomes U2 = P1 + P6, the sum three quadrants share
+    matrix_axpy(1.0, &p[0], &q->c11);
+    matrix_axpy(1.0, &p[0], &p[2]);
+    matrix_axpy(1.0, &p[2], &q->c12);
+    matrix_axpy(1.0, &p[1], &q->c12);
+    matrix_axpy(1.0, &p[2], &q->c21);
+    matrix_axpy(1.0, &p[3], &q->c21);
+    matrix_axpy(1.0, &p[2], &q->c22);
+    matrix_axpy(1.0, &p[3], &q->c22);
+    matrix_axpy(1.0, &p[1], &q->c22);
+
+    strassen_free(s, 4);
+    strassen_free(t, 4);
+    strassen_free(p, 4);
+    return status;
+}
+
+// One product at a time through three temporaries: S (m/2 x k/2),
+// T (k/2 x n/2) and X (m/2 x n/2), reused in the order Winograd's sums
+// allow
+static int strassen_sequential(double alpha, StrassenLevel *q) {
+    const int m2 = q->a11.rows;
+    const int k2 = q->a11.cols;
+    const int n2 = q->b11.cols;
+
+    Matrix s, t, x;
+    int status = strassen_temps(&s, 1, m2, k2, 0);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = strassen_temps(&t, 1, k2, n2, 0);
+    if (status != SUCCESS) {
+        matrix_free(&s);
+        return status;
+    }
+    status = strassen_temps(&x, 1, m2, n2, 1);
+    if (status != SUCCESS) {
+        matrix_free(&s);
+        matrix_free(&t);
+        return status;
+    }
+
+    // P5 = S1 T1 into C12 and C22
+    matrix_add_into(&q->a21, &q->a22, &s);
+    matrix_subtract_into(&q->b12, &q->b11, &t);
+    strassen_status(&status, strassen(alpha, &s, &t, &x));
+    matrix_axpy(1.0, &x, &q->c12);
+    matrix_axpy(1.0, &x, &q->c22);
+
+    // P1 into C11, then U2 = P1 + P6 into C12, C21 and C22
+    matrix_subtract_into(&s, &q->a11, &s);
+    matrix_subtract_into(&q->b22, &t, &t);
+    gemm_scale_c(&x, 0.0);
+    strassen_status(&status, strassen(alpha, &q->a11, &q->b11, &x));
+    matrix_axpy(1.0, &x, &q->c11);
+    strassen_status(&status, strassen(alpha, &s, &t, &x));
+    matrix_axpy(1.0, &x, &q->c12);
+    matrix_axpy(1.0, &x, &q->c21);
+    matrix_axpy(1.0, &x, &q->c22);
+
+    // P3 = S4 B22 and P4 = A22 T4 each touch one quadrant
+    matrix_subtract_into(&q->a12, &s, &s);
+    strassen_status(&status, strassen(alpha, &s, &q->b22, &q->c12));
+    matrix_subtract_into(&t, &q->b21, &t);
+    strassen_status(&status, strassen(-alpha, &q->a22, &t, &q->c21));
+
+    // P7 = S3 T3 into C21 and C22
+    matrix_subtract_into(&q->a11, &q->a21, &s);
+    matrix_subtract_into(&q->b22, &q->b12, &t);
+    gemm_scale_c(&x, 0.0);
+    strassen_status(&status, strassen(alpha, &s, &t, &x));
+    matrix_axpy(1.0, &x, &q->c21);
+    matrix_axpy(1.0, &x, &q->c22);
+
+    strassen_status(&status, strassen(alpha, &q->a12, &q->b21, &q->c11));
+
+    matrix_free(&s);
+    matrix_free(&t);
+    matrix_free(&x);
+    return status;
+}
+
+// c += alpha * a * b, recursing while every dimension is above the
+// cutover. An odd edge is peeled off, so each level works on the even
+// leading block and the tiled kernel covers the leftover row, column and
+// rank-1 update.
+static int strassen(double alpha, const Matrix *a, const Matrix *b,
+                    Matrix *c) {
+    const int m = a->rows;
+    const int n = b->cols;
+    const int k = a->cols;
+    const int cutover = matrix_strassen_cutover();
+
+    if (cutover == 0 || m <= cutover || n <= cutover || k <= cutover) {
+        return gemm_run(alpha, a, b, c);
+    }
+
+    const int m2 = m / 2;
+    const int n2 = n / 2;
+    const int k2 = k / 2;
+    int status = SUCCESS;
+    Matrix av, bv, cv;
+
+    if (k % 2 != 0) {
+        matrix_view(a, 0, k - 1, 2 * m2, 1, &av);
+        matrix_view(b, k - 1, 0, 1, 2 * n2, &bv);
+        matrix_view(c, 0, 0, 2 * m2, 2 * n2, &cv);
+        strassen_status(&status, gemm_run(alpha, &av, &bv, &cv));
+    }
+    if (n % 2 != 0) {
+        matrix_view(b, 0, n - 1, k, 1, &bv);
+        matrix_view(c, 0, n - 1, m, 1, &cv);
+        strassen_status(&status, gemm_run(alpha, a, &bv, &cv));
+    }
+    if (m % 2 != 0) {
+        matrix_view(a, m - 1, 0, 1, k, &av);
+        matrix_view(b, 0, 0, k, 2 * n2, &bv);
+        matrix_view(c, m - 1, 0, 1, 2 * n2, &cv);
+        strassen_status(&status, gemm_run(alpha, &av, &bv, &cv));
+    }
+
+    StrassenLevel q;
+    matrix_view(a, 0, 0, m2, k2, &q.a11);
+    matrix_view(a, 0, k2, m2, k2, &q.a12);
+    matrix_view(a, m2, 0, m2, k2, &q.a21);
+    matrix_view(a, m2, k2, m2, k2, &q.a22);
+    matrix_view(b, 0, 0, k2, n2, &q.b11);
+    matrix_view(b, 0, n2, k2, n2, &q.b12);
+    matrix_view(b, k2, 0, k2, n2, &q.b21);
+    matrix_view(b, k2, n2, k2, n2, &q.b22);
+    matrix_view(c, 0, 0, m2, n2, &q.c11);
+    matrix_view(c, 0, n2, m2, n2, &q.c12);
+    matrix_view(c, m2, 0, m2, n2, &q.c21);
+    matrix_view(c, m2, n2, m2, n2, &q.c22);
+
+    size_t words = 4 * ((size_t)m2 * k2 + (size_t)k2 * n2 + (size_t)m2 * n2);
+    if (thread_pool_size() > 1 && words <= STRASSEN_PARALLEL_WORDS) {
+        strassen_status(&status, strassen_parallel(alpha, &q));
+    } else {
+        strassen_status(&status, strassen_sequential(alpha, &q));
+    }
+    return status;
+}
+
+int matrix_multiply_into(double alpha, const Matrix *m1, const Matrix *m2,
+                         double beta, Matrix *result) {
+    DEBUG_PRINT("Multiplying matrices into result (alpha=%f, beta=%f)\n",
+                alpha, beta);
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->data == NULL || m2->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->cols != m2->rows || result->rows != m1->rows ||
+        result->cols != m2->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(result);
+    if (MATRIX_IS_TRANSPOSED(result)) {
+        // C^T = B^T * A^T lands in the storage of C without a transpose
+        Matrix at, bt, ct;
+        matrix_transpose_view(m1, &at);
+        matrix_transpose_view(m2, &bt);
+        matrix_transpose_view(result, &ct);
+        return matrix_multiply_into(alpha, &bt, &at, beta, &ct);
+    }
+
+    const int m = m1->rows;
+    const int n = m2->cols;
+    const int k = m1->cols;
+    const uint64_t mn = (uint64_t)m * (uint64_t)n;
+    const uint64_t flops = 2 * mn * (uint64_t)k;
+    const uint64_t bytes = 8 * ((uint64_t)k * (uint64_t)(m + n) + 2 * mn);
+
+    PerfScope scope;
+    perf_begin(&scope);
+    if (blas_backend_use(BLAS_OP_GEMM, flops) &&
+        blas_dgemm(alpha, m1, m2, beta, result) == SUCCESS) {
+        perf_end(&scope, PERF_OP_MATRIX_MULTIPLY, bytes, flops);
+        return SUCCESS;
+    }
+
+    gemm_scale_c(result, beta);
+    if (alpha == 0.0) {
+        perf_end(&scope, PERF_OP_MATRIX_MULTIPLY, 16 * mn, mn);
+        return SUCCESS;
+    }
+
+    int status = strassen(alpha, m1, m2, result);
+    if (status == SUCCESS) {
+        perf_end(&scope, PERF_OP_MATRIX_MULTIPLY, bytes, flops);
+    }
+    return status;
+}
+
+// Checked-once plan; path is 1 when the vendor library takes the product
+static int gemm_plan_run(const MathPlan *plan) {
+    matrix_mark_modified(plan->target);
+    Matrix c = plan->c;
+    if (plan->path && blas_dgemm(plan->alpha, &plan->a, &plan->b, plan->beta,
+                                 &c) == SUCCESS) {
+        return SUCCESS;
+    }
+
+    gemm_scale_c(&c, plan->beta);
+    if (plan->alpha == 0.0) {
+        return SUCCESS;
+    }
+    return strassen(plan->alpha, &plan->a, &plan->b, &c);
+}
+
+int matrix_plan_multiply(MathPlan *plan, double alpha, const Matrix *m1,
+                         const Matrix *m2, double beta, Matrix *result) {
+    DEBUG_PRINT("Planning matrix product (alpha=%f, beta=%f)\n", alpha,
+                beta);
+
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->data == NULL || m2->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->cols != m2->rows || result->rows != m1->rows ||
+        result->cols != m2->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    // A transposed C is planned as C^T = B^T * A^T, as in
+    // matrix_multiply_into
+    if (MATRIX_IS_TRANSPOSED(result)) {
+        matrix_transpose_view(m2, &plan->a);
+        matrix_transpose_view(m1, &plan->b);
+        matrix_transpose_view(result, &plan->c);
+    } else {
+        plan->a = *m1;
+        plan->b = *m2;
+        plan->c = *result;
+    }
+
+    const uint64_t flops = 2 * (uint64_t)plan->a.rows *
+                           (uint64_t)plan->b.cols * (uint64_t)plan->a.cols;
+    plan->alpha = alpha;
+    plan->beta = beta;
+    plan->target = result;
+    plan->path = blas_backend_use(BLAS_OP_GEMM, flops);
+    plan->run = gemm_plan_run;
+    return SUCCESS;
+}
\ No newline at end of file
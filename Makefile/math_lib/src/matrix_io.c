@@ -0,0 +1,613 @@
+#include "../include/matrix_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/perf_counters.h"
+
+_Static_assert(sizeof(MatrixFileHeader) == 64,
+               "MatrixFileHeader is part of the file format");
+
+// matrix_save starts the data on a page boundary so that row panels can be
+// advised, prefetched or read with O_DIRECT without straddling pages
+#define MATRIX_FILE_DATA_OFFSET 4096
+
+// Row padding matches matrix_create so mapped rows are aligned
+static uint64_t matrix_file_stride(int cols) {
+    const uint64_t per_line = MATRIX_ALIGNMENT / sizeof(double);
+    return ((uint64_t)cols + per_line - 1) / per_line * per_line;
+}
+
+// ---------------------------------------------------------------------------
+// Checksum
+// ---------------------------------------------------------------------------
+
+// Four independent 64-bit multiply-rotate lanes (the xxHash64 round) over
+// 32-byte steps, so hashing runs near memory bandwidth. Every row is a
+// multiple of 32 bytes, which lets matrix_save feed rows one at a time.
+
+#define CHECKSUM_PRIME1 0x9E3779B185EBCA87ull
+#define CHECKSUM_PRIME2 0xC2B2AE3D27D4EB4Full
+
+typedef struct {
+    uint64_t lanes[4];
+    uint64_t length;
+} MatrixChecksum;
+
+static uint64_t checksum_rotl(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static void checksum_init(MatrixChecksum *c) {
+    c->lanes[0] = CHECKSUM_PRIME1 + CHECKSUM_PRIME2;
+    c->lanes[1] = CHECKSUM_PRIME2;
+    c->lanes[2] = 0;
+    c->lanes[3] = 0 - CHECKSUM_PRIME1;
+    c->length = 0;
+}
+
+// size must be a multiple of 32
+static void checksum_update(MatrixChecksum *c, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+
+    for (size_t offset = 0; offset < size; offset += 32) {
+        uint64_t words[4];
+        memcpy(words, p + offset, sizeof(words));
+        for (int l = 0; l < 4; l++) {
+            c->lanes[l] = checksum_rotl(
+                              c->lanes[l] + words[l] * CHECKSUM_PRIME2, 31) *
+                          CHECKSUM_PRIME1;
+        }
+    }
+    c->length += size;
+}
+
+static uint64_t checksum_final(const MatrixChecksum *c) {
+    uint64_t h = checksum_rotl(c->lanes[0], 1) + checksum_rotl(c->lanes[1], 7) +
+                 checksum_rotl(c->lanes[2], 12) +
+                 checksum_rotl(c->lanes[3], 18);
+    h ^= c->length;
+    h ^= h >> 33;
+    h *= CHECKSUM_PRIME2;
+    h ^= h >> 29;
+    h *= CHECKSUM_PRIME1;
+    h ^= h >> 32;
+    return h;
+}
+
+// ---------------------------------------------------------------------------
+// Saving
+// ---------------------------------------------------------------------------
+
+// Write size bytes or fail
+static int matrix_file_write(FILE *f, const void *data, size_t size) {
+    return fwrite(data, 1, size, f) == size ? SUCCESS : ERROR_IO;
+}
+
+static int matrix_save_to(const Matrix *m, FILE *f) {
+    MatrixFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MATRIX_FILE_MAGIC, sizeof(header.magic));
+    header.version = MATRIX_FILE_VERSION;
+    header.endian_tag = MATRIX_FILE_ENDIAN_TAG;
+    header.dtype = MATRIX_FILE_DTYPE_F64;
+    header.rows = (uint64_t)m->rows;
+    header.cols = (uint64_t)m->cols;
+    header.stride = matrix_file_stride(m->cols);
+    header.data_offset = MATRIX_FILE_DATA_OFFSET;
+
+    // The header is written last, once the checksum is known
+    static const unsigned char zeros[MATRIX_FILE_DATA_OFFSET];
+    int status = matrix_file_write(f, zeros, sizeof(zeros));
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    size_t row_bytes = (size_t)header.stride * sizeof(double);
+    double *row = (double *)calloc(1, row_bytes);
+    if (row == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixChecksum checksum;
+    checksum_init(&checksum);
+    for (int i = 0; i < m->rows && status == SUCCESS; i++) {
+        if (MATRIX_IS_TRANSPOSED(m)) {
+            for (int j = 0; j < m->cols; j++) {
+                row[j] = MATRIX_ELEM(m, i, j);
+            }
+        } else {
+            memcpy(row, MATRIX_ROW(m, i), (size_t)m->cols * sizeof(double));
+        }
+        checksum_update(&checksum, row, row_bytes);
+        status = matrix_file_write(f, row, row_bytes);
+    }
+    free(row);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    header.checksum = checksum_final(&checksum);
+    if (fseek(f, 0, SEEK_SET) != 0) {
+        return ERROR_IO;
+    }
+    return matrix_file_write(f, &header, sizeof(header));
+}
+
+int matrix_save(const Matrix *m, const char *path) {
+    DEBUG_PRINT("Saving %dx%d matrix to %s\n", m ? m->rows : 0,
+                m ? m->cols : 0, path ? path : "(null)");
+
+    if (m == NULL || m->data == NULL || path == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    // Write a sibling file and rename it over path, so a reader never maps
+    // a half-written matrix
+    size_t length = strlen(path);
+    char *temp = (char *)malloc(length + sizeof(".tmp"));
+    if (temp == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memcpy(temp, path, length);
+    memcpy(temp + length, ".tmp", sizeof(".tmp"));
+
+    FILE *f = fopen(temp, "wb");
+    if (f == NULL) {
+        free(temp);
+        return ERROR_IO;
+    }
+
+    int status = matrix_save_to(m, f);
+    if (fclose(f) != 0 && status == SUCCESS) {
+        status = ERROR_IO;
+    }
+    if (status == SUCCESS && rename(temp, path) != 0) {
+        status = ERROR_IO;
+    }
+    if (status != SUCCESS) {
+        remove(temp);
+    }
+
+    free(temp);
+    return status;
+}
+
+// ---------------------------------------------------------------------------
+// Mapping
+// ---------------------------------------------------------------------------
+
+// Bytes of the data region, or 0 if that overflows
+static size_t matrix_file_data_bytes(const MatrixFileHeader *header) {
+    if (header->stride > SIZE_MAX / sizeof(double) / header->rows) {
+        return 0;
+    }
+    return (size_t)(header->rows * header->stride * sizeof(double));
+}
+
+static int matrix_file_check_header(const MatrixFileHeader *header,
+                                    uint64_t file_size) {
+    if (memcmp(header->magic, MATRIX_FILE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != MATRIX_FILE_VERSION ||
+        header->endian_tag != MATRIX_FILE_ENDIAN_TAG ||
+        header->dtype != MATRIX_FILE_DTYPE_F64) {
+        return ERROR_INVALID_FORMAT;
+    }
+
+    const uint64_t per_line = MATRIX_ALIGNMENT / sizeof(double);
+    if (header->rows == 0 || header->rows > INT_MAX || header->cols == 0 ||
+        header->stride < header->cols || header->stride > INT_MAX ||
+        header->stride % per_line != 0 ||
+        header->data_offset < sizeof(MatrixFileHeader) ||
+        header->data_offset % MATRIX_ALIGNMENT != 0) {
+        return ERROR_INVALID_FORMAT;
+    }
+
+    size_t bytes = matrix_file_data_bytes(header);
+    if (bytes == 0 || header->data_offset > file_size ||
+        bytes > file_size - header->data_offset) {
+        return ERROR_INVALID_FORMAT;
+    }
+
+    return SUCCESS;
+}
+
+// Reads and validates the header of an open file
+static int matrix_file_header_from(int fd, MatrixFileHeader *header) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return ERROR_IO;
+    }
+
+    ssize_t got;
+    do {
+        got = pread(fd, header, sizeof(*header), 0);
+    } while (got < 0 && errno == EINTR);
+    if (got < 0) {
+        return ERROR_IO;
+    }
+    if ((size_t)got != sizeof(*header)) {
+        return ERROR_INVALID_FORMAT;
+    }
+
+    return matrix_file_check_header(header, (uint64_t)st.st_size);
+}
+
+int matrix_file_read_header(const char *path, MatrixFileHeader *header) {
+    DEBUG_PRINT("Reading matrix file header from %s\n",
+                path ? path : "(null)");
+
+    if (path == NULL || header == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return ERROR_IO;
+    }
+
+    int status = matrix_file_header_from(fd, header);
+    close(fd);
+    return status;
+}
+
+// A mapped Matrix owns one of these through its allocator; matrix_free
+// ends up in mapping_free, which unmaps the whole file and releases the
+// record itself
+typedef struct {
+    Allocator allocator;
+    void *base;
+    size_t length;
+} MatrixMapping;
+
+static void *mapping_alloc(void *ctx, size_t size, size_t alignment) {
+    (void)ctx;
+    (void)size;
+    (void)alignment;
+    return NULL;
+}
+
+static void mapping_free(void *ctx, void *ptr, size_t size) {
+    MatrixMapping *mapping = (MatrixMapping *)ctx;
+    (void)ptr;
+    (void)size;
+    munmap(mapping->base, mapping->length);
+    free(mapping);
+}
+
+int matrix_map_file(const char *path, int flags, Matrix *result) {
+    DEBUG_PRINT("Mapping matrix file %s\n", path ? path : "(null)");
+
+    if (path == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int shared = (flags & MATRIX_MAP_SHARED) != 0;
+    int fd = open(path, shared ? O_RDWR : O_RDONLY);
+    if (fd < 0) {
+        return ERROR_IO;
+    }
+
+    MatrixFileHeader header;
+    int status = matrix_file_header_from(fd, &header);
+    if (status != SUCCESS) {
+        close(fd);
+        return status;
+    }
+
+    size_t bytes = matrix_file_data_bytes(&header);
+    size_t length = (size_t)header.data_offset + bytes;
+    int map_flags = shared ? MAP_SHARED : MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    if (flags & MATRIX_MAP_POPULATE) {
+        map_flags |= MAP_POPULATE;
+    }
+#endif
+
+    // The mapping keeps its own reference to the file
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE, map_flags, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        return ERROR_IO;
+    }
+
+    unsigned char *data = (unsigned char *)base + header.data_offset;
+    if (flags & MATRIX_MAP_VERIFY) {
+        MatrixChecksum checksum;
+        checksum_init(&checksum);
+        checksum_update(&checksum, data, bytes);
+        if (checksum_final(&checksum) != header.checksum) {
+            munmap(base, length);
+            return ERROR_INVALID_FORMAT;
+        }
+    }
+
+    MatrixMapping *mapping = (MatrixMapping *)malloc(sizeof(MatrixMapping));
+    if (mapping == NULL) {
+        munmap(base, length);
+        return ERROR_NULL_POINTER;
+    }
+    mapping->allocator.alloc = mapping_alloc;
+    mapping->allocator.free = mapping_free;
+    mapping->allocator.ctx = mapping;
+    mapping->allocator.zeroed = 0;
+    mapping->base = base;
+    mapping->length = length;
+
+    result->rows = (int)header.rows;
+    result->cols = (int)header.cols;
+    result->stride = (int)header.stride;
+    result->data = (double *)data;
+    result->allocator = &mapping->allocator;
+    result->flags = 0;
+    // The file may change underneath a shared mapping, so mapped matrices
+    // stay out of result caches
+    result->id = 0;
+    result->version = 0;
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Streaming
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    int fd;
+    MatrixFileHeader header;
+    size_t row_bytes;
+    int panel_rows;
+    int panel_count;
+    size_t buffer_bytes;
+    double *buffers[2];
+} MatrixStream;
+
+typedef struct {
+    const MatrixStream *stream;
+    int panel;
+    double *buffer;
+    int status;
+} MatrixStreamRead;
+
+// Multiplies one panel; row is the file row the panel starts at
+typedef int (*MatrixStreamFn)(void *ctx, const Matrix *panel, int row);
+
+static int matrix_stream_rows(const MatrixStream *s, int panel) {
+    int row = panel * s->panel_rows;
+    int rows = (int)s->header.rows - row;
+    return rows < s->panel_rows ? rows : s->panel_rows;
+}
+
+static off_t matrix_stream_offset(const MatrixStream *s, int panel) {
+    return (off_t)s->header.data_offset +
+           (off_t)panel * s->panel_rows * (off_t)s->row_bytes;
+}
+
+static void *matrix_stream_read(void *arg) {
+    MatrixStreamRead *read = (MatrixStreamRead *)arg;
+    const MatrixStream *s = read->stream;
+    unsigned char *p = (unsigned char *)read->buffer;
+    size_t left = (size_t)matrix_stream_rows(s, read->panel) * s->row_bytes;
+    off_t offset = matrix_stream_offset(s, read->panel);
+
+    read->status = SUCCESS;
+    while (left > 0) {
+        ssize_t got = pread(s->fd, p, left, offset);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            read->status = ERROR_IO;
+            break;
+        }
+        p += got;
+        offset += got;
+        left -= (size_t)got;
+    }
+
+    return NULL;
+}
+
+static void matrix_stream_close(MatrixStream *s) {
+    for (int b = 0; b < 2; b++) {
+        allocator_free(NULL, s->buffers[b], s->buffer_bytes);
+    }
+    close(s->fd);
+}
+
+static int matrix_stream_open(const char *path, size_t panel_bytes,
+                              MatrixStream *s) {
+    s->fd = open(path, O_RDONLY);
+    if (s->fd < 0) {
+        return ERROR_IO;
+    }
+
+    int status = matrix_file_header_from(s->fd, &s->header);
+    if (status != SUCCESS) {
+        close(s->fd);
+        return status;
+    }
+
+    if (panel_bytes == 0) {
+        panel_bytes = MATRIX_STREAM_PANEL_BYTES;
+    }
+    s->row_bytes = (size_t)s->header.stride * sizeof(double);
+    size_t panel_rows = panel_bytes / s->row_bytes;
+    if (panel_rows == 0) {
+        panel_rows = 1;
+    }
+    if (panel_rows > s->header.rows) {
+        panel_rows = (size_t)s->header.rows;
+    }
+    s->panel_rows = (int)panel_rows;
+    s->panel_count = (int)((s->header.rows + panel_rows - 1) / panel_rows);
+    s->buffer_bytes = panel_rows * s->row_bytes;
+
+    for (int b = 0; b < 2; b++) {
+        s->buffers[b] = (double *)allocator_alloc(NULL, s->buffer_bytes);
+    }
+    if (s->buffers[0] == NULL || s->buffers[1] == NULL) {
+        matrix_stream_close(s);
+        return ERROR_NULL_POINTER;
+    }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+    posix_fadvise(s->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return SUCCESS;
+}
+
+// Panel p is multiplied out of buffers[p % 2] while a reader thread fills
+// the other buffer with panel p + 1. If the thread cannot be started the
+// read happens after the multiply instead.
+static int matrix_stream_run(MatrixStream *s, MatrixStreamFn fn, void *ctx) {
+    MatrixStreamRead next = {s, 0, s->buffers[0], SUCCESS};
+    matrix_stream_read(&next);
+    int status = next.status;
+
+    for (int p = 0; p < s->panel_count && status == SUCCESS; p++) {
+        int prefetch = p + 1 < s->panel_count;
+        int threaded = 0;
+        pthread_t reader;
+
+        next.panel = p + 1;
+        next.buffer = s->buffers[(p + 1) % 2];
+        if (prefetch) {
+            threaded =
+                pthread_create(&reader, NULL, matrix_stream_read, &next) == 0;
+        }
+
+        Matrix panel = {matrix_stream_rows(s, p), (int)s->header.cols,
+                        (int)s->header.stride, s->buffers[p % 2], NULL,
+                        MATRIX_FLAG_VIEW, 0, 0};
+        status = fn(ctx, &panel, p * s->panel_rows);
+
+        if (threaded) {
+            pthread_join(reader, NULL);
+        } else if (prefetch && status == SUCCESS) {
+            matrix_stream_read(&next);
+        }
+        if (prefetch && status == SUCCESS) {
+            status = next.status;
+        }
+
+#ifdef POSIX_FADV_DONTNEED
+        posix_fadvise(s->fd, matrix_stream_offset(s, p),
+                      (off_t)panel.rows * (off_t)s->row_bytes,
+                      POSIX_FADV_DONTNEED);
+#endif
+    }
+
+    return status;
+}
+
+typedef struct {
+    const Vector *v;
+    Vector *result;
+} MatrixStreamGemv;
+
+static int matrix_stream_gemv(void *ctx, const Matrix *panel, int row) {
+    MatrixStreamGemv *task = (MatrixStreamGemv *)ctx;
+    Vector rows = {panel->rows, task->result->data + row, NULL};
+    return matrix_vector_multiply_into(panel, task->v, &rows);
+}
+
+typedef struct {
+    const Matrix *b;
+    Matrix *result;
+} MatrixStreamGemm;
+
+static int matrix_stream_gemm(void *ctx, const Matrix *panel, int row) {
+    MatrixStreamGemm *task = (MatrixStreamGemm *)ctx;
+    Matrix rows;
+    int status = matrix_view(task->result, row, 0, panel->rows,
+                             task->result->cols, &rows);
+    if (status != SUCCESS) {
+        return status;
+    }
+    return matrix_multiply_into(1.0, panel, task->b, 0.0, &rows);
+}
+
+int matrix_file_vector_multiply(const char *path, size_t panel_bytes,
+                                const Vector *v, Vector *result) {
+    DEBUG_PRINT("Streaming matrix file %s by vector\n",
+                path ? path : "(null)");
+
+    if (path == NULL || v == NULL || v->data == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixStream stream;
+    int status = matrix_stream_open(path, panel_bytes, &stream);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if ((uint64_t)v->size != stream.header.cols) {
+        matrix_stream_close(&stream);
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    status = vector_create_uninitialized((int)stream.header.rows, result);
+    if (status == SUCCESS) {
+        PerfScope scope;
+        perf_begin(&scope);
+        MatrixStreamGemv task = {v, result};
+        status = matrix_stream_run(&stream, matrix_stream_gemv, &task);
+        if (status == SUCCESS) {
+            uint64_t elements = stream.header.rows * stream.header.cols;
+            perf_end(&scope, PERF_OP_FILE_VECTOR_MULTIPLY, 8 * elements,
+                     2 * elements);
+        } else {
+            vector_free(result);
+        }
+    }
+
+    matrix_stream_close(&stream);
+    return status;
+}
+
+int matrix_file_multiply(const char *path, size_t panel_bytes,
+                         const Matrix *b, Matrix *result) {
+    DEBUG_PRINT("Streaming matrix file %s by matrix\n",
+                path ? path : "(null)");
+
+    if (path == NULL || b == NULL || b->data == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixStream stream;
+    int status = matrix_stream_open(path, panel_bytes, &stream);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if ((uint64_t)b->rows != stream.header.cols) {
+        matrix_stream_close(&stream);
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    status = matrix_create_uninitialized((int)stream.header.rows, b->cols,
+                                         result);
+    if (status == SUCCESS) {
+        PerfScope scope;
+        perf_begin(&scope);
+        MatrixStreamGemm task = {b, result};
+        status = matrix_stream_run(&stream, matrix_stream_gemm, &task);
+        if (status == SUCCESS) {
+            uint64_t elements = stream.header.rows * stream.header.cols;
+            perf_end(&scope, PERF_OP_FILE_MULTIPLY, 8 * elements,
+                     2 * elements * (uint64_t)b->cols);
+        } else {
+            matrix_free(result);
+        }
+    }
+
+    matrix_stream_close(&stream);
+    return status;
+}
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "../include/matrix_lu.h"
+
+#include <string.h>
+
+#include "../include/blas_backend.h"
+#include "../include/matrix_cache.h"
+#include "../include/perf_counters.h"
+#include "../include/vector_kernels.h"
+
+// Panel width of the blocked factorization; the trailing update is a GEMM
+// of this depth
+#define LU_BLOCK_SIZE 64
+
+static void lu_swap_rows(Matrix *m, int r1, int r2) {
+    double *a = MATRIX_ROW(m, r1);
+    double *b = MATRIX_ROW(m, r2);
+    for (int j = 0; j < m->cols; j++) {
+        double t = a[j];
+        a[j] = b[j];
+        b[j] = t;
+    }
+}
+
+// Unblocked factorization of columns [k, k + kb) over rows [k, n), swapping
+// whole rows as pivots are chosen
+static void lu_factor_panel(Matrix *a, int k, int kb, int *pivots,
+                            int *sign) {
+    const int n = a->rows;
+
+    for (int j = k; j < k + kb; j++) {
+        // Partial pivoting: largest magnitude in column j
+        int p = j;
+        double best = fabs(MATRIX_AT(a, j, j));
+        for (int i = j + 1; i < n; i++) {
+            double v = fabs(MATRIX_AT(a, i, j));
+            if (v > best) {
+                best = v;
+                p = i;
+            }
+        }
+
+        pivots[j] = p;
+        if (p != j) {
+            lu_swap_rows(a, j, p);
+            *sign = -*sign;
+        }
+
+        const double pivot = MATRIX_AT(a, j, j);
+        if (pivot == 0.0) {
+            // Singular column: nothing to eliminate
+            continue;
+        }
+
+        const double *uj = MATRIX_ROW(a, j);
+        for (int i = j + 1; i < n; i++) {
+            double *ai = MATRIX_ROW(a, i);
+            double l = ai[j] / pivot;
+            ai[j] = l;
+            for (int c = j + 1; c < k + kb; c++) {
+                ai[c] -= l * uj[c];
+            }
+        }
+    }
+}
+
+// U12 = L11^-1 * A12 for the kb x (n - k - kb) block right of the panel
+static void lu_solve_u12(Matrix *a, int k, int kb) {
+    const int first = k + kb;
+    const int width = a->cols - first;
+    const VectorKernels *kernels = vector_kernels();
+
+    for (int i = k + 1; i < k + kb; i++) {
+        double *ui = MATRIX_ROW(a, i);
+        for (int j = k; j < i; j++) {
+            kernels->axpy(-ui[j], MATRIX_ROW(a, j) + first, ui + first,
+                          (size_t)width);
+        }
+    }
+}
+
+// X = U^-1 L^-1 X for an already permuted X. Row-oriented substitution:
+// every update is a contiguous axpy over all right-hand sides.
+static void lu_substitute_rows(const MatrixLU *lu, Matrix *x) {
+    const VectorKernels *kernels = vector_kernels();
+    const int n = lu->lu.rows;
+    const size_t width = (size_t)x->cols;
+
+    for (int i = 1; i < n; i++) {
+        const double *l = MATRIX_ROW(&lu->lu, i);
+        double *xi = MATRIX_ROW(x, i);
+        for (int j = 0; j < i; j++) {
+            if (l[j] != 0.0) {
+                kernels->axpy(-l[j], MATRIX_ROW(x, j), xi, width);
+            }
+        }
+    }
+
+    for (int i = n - 1; i >= 0; i--) {
+        const double *u = MATRIX_ROW(&lu->lu, i);
+        double *xi = MATRIX_ROW(x, i);
+        for (int j = i + 1; j < n; j++) {
+            if (u[j] != 0.0) {
+                kernels->axpy(-u[j], MATRIX_ROW(x, j), xi, width);
+            }
+        }
+        kernels->scale(xi, 1.0 / u[i], xi, width);
+    }
+}
+
+int matrix_lu_create(int n, MatrixLU *result) {
+    DEBUG_PRINT("Creating LU factor object of size %d\n", n);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_create(n, n, &result->lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    result->pivots = (int *)allocator_alloc(result->lu.allocator,
+                                            (size_t)n * sizeof(int));
+    if (result->pivots == NULL) {
+        matrix_free(&result->lu);
+        return ERROR_NULL_POINTER;
+    }
+
+    result->sign = 1;
+    return SUCCESS;
+}
+
+void matrix_lu_free(MatrixLU *lu) {
+    DEBUG_PRINT("Freeing LU factor object\n");
+
+    if (lu == NULL) {
+        return;
+    }
+
+    allocator_free(lu->lu.allocator, lu->pivots,
+                   (size_t)lu->lu.rows * sizeof(int));
+    lu->pivots = NULL;
+    matrix_free(&lu->lu);
+}
+
+int matrix_lu(const Matrix *m, MatrixLU *result) {
+    DEBUG_PRINT("Computing LU factorization\n");
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->rows != m->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = matrix_lu_create(m->rows, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_into(m, result);
+    if (status != SUCCESS) {
+        matrix_lu_free(result);
+    }
+
+    return status;
+}
+
+int matrix_lu_into(const Matrix *m, MatrixLU *lu) {
+    DEBUG_PRINT("Computing LU factorization into factor object\n");
+
+    if (m == NULL || lu == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->rows != m->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    int status = matrix_copy(m, &lu->lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    Matrix *a = &lu->lu;
+    const int n = a->rows;
+    const uint64_t n2 = (uint64_t)n * (uint64_t)n;
+    const uint64_t flops = 2 * n2 * (uint64_t)n / 3;
+    if (blas_backend_use(BLAS_OP_GETRF, flops) &&
+        blas_dgetrf(a, lu->pivots, &lu->sign) == SUCCESS) {
+        perf_end(&scope, PERF_OP_MATRIX_LU, 16 * n2, flops);
+        return SUCCESS;
+    }
+
+    lu->sign = 1;
+
+    // Right-looking blocked LU: factor a panel, form the U12 block row,
+    // then update the trailing matrix with one GEMM
+    for (int k = 0; k < n; k += LU_BLOCK_SIZE) {
+        int kb = n - k < LU_BLOCK_SIZE ? n - k : LU_BLOCK_SIZE;
+        int rest = n - k - kb;
+
+        lu_factor_panel(a, k, kb, lu->pivots, &lu->sign);
+        if (rest == 0) {
+            break;
+        }
+
+        lu_solve_u12(a, k, kb);
+
+        Matrix l21, u12, a22;
+        matrix_view(a, k + kb, k, rest, kb, &l21);
+        matrix_view(a, k, k + kb, kb, rest, &u12);
+        matrix_view(a, k + kb, k + kb, rest, rest, &a22);
+        status = matrix_multiply_into(-1.0, &l21, &u12, 1.0, &a22);
+        if (status != SUCCESS) {
+            return status;
+        }
+    }
+
+    perf_end(&scope, PERF_OP_MATRIX_LU, 16 * n2, flops);
+    return SUCCESS;
+}
+
+int matrix_lu_determinant(const MatrixLU *lu, double *result) {
+    DEBUG_PRINT("Calculating determinant from LU factors\n");
+
+    if (lu == NULL || result == NULL || lu->lu.data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    double det = (double)lu->sign;
+    for (int i = 0; i < lu->lu.rows; i++) {
+        det *= MATRIX_AT(&lu->lu, i, i);
+    }
+
+    *result = det;
+    return SUCCESS;
+}
+
+static int lu_check_nonsingular(const MatrixLU *lu) {
+    for (int i = 0; i < lu->lu.rows; i++) {
+        if (MATRIX_AT(&lu->lu, i, i) == 0.0) {
+            return ERROR_SINGULAR_MATRIX;
+        }
+    }
+    return SUCCESS;
+}
+
+int matrix_lu_solve(const MatrixLU *lu, const Vector *b, Vector *x) {
+    DEBUG_PRINT("Solving linear system from LU factors\n");
+
+    if (lu == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (b->size != lu->lu.rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = vector_create_uninitialized(b->size, x);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_solve_into(lu, b, x);
+    if (status != SUCCESS) {
+        vector_free(x);
+    }
+
+    return status;
+}
+
+int matrix_lu_solve_into(const MatrixLU *lu, const Vector *b, Vector *x) {
+    DEBUG_PRINT("Solving linear system from LU factors into result\n");
+
+    if (lu == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (lu->lu.data == NULL || b->data == NULL || x->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    const int n = lu->lu.rows;
+    if (b->size != n || x->size != n) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = lu_check_nonsingular(lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    const VectorKernels *kernels = vector_kernels();
+    double *y = x->data;
+
+    // y = P * b
+    if (y != b->data) {
+        memcpy(y, b->data, (size_t)n * sizeof(double));
+    }
+    for (int i = 0; i < n; i++) {
+        int p = lu->pivots[i];
+        if (p != i) {
+            double t = y[i];
+            y[i] = y[p];
+            y[p] = t;
+        }
+    }
+
+    // Forward substitution with unit lower L
+    for (int i = 1; i < n; i++) {
+        y[i] -= kernels->dot(MATRIX_ROW(&lu->lu, i), y, (size_t)i);
+    }
+
+    // Back substitution with U
+    for (int i = n - 1; i >= 0; i--) {
+        const double *u = MATRIX_ROW(&lu->lu, i);
+        double sum = kernels->dot(u + i + 1, y + i + 1, (size_t)(n - i - 1));
+        y[i] = (y[i] - sum) / u[i];
+    }
+
+    const uint64_t n2 = (uint64_t)n * (uint64_t)n;
+    perf_end(&scope, PERF_OP_MATRIX_LU_SOLVE, 8 * (n2 + 2 * (uint64_t)n),
+             2 * n2);
+    return SUCCESS;
+}
+
+int matrix_lu_solve_matrix(const MatrixLU *lu, const Matrix *b, Matrix *x) {
+    DEBUG_PRINT("Solving linear systems from LU factors\n");
+
+    if (lu == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (b->rows != lu->lu.rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = matrix_create_uninitialized(b->rows, b->cols, x);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_solve_matrix_into(lu, b, x);
+    if (status != SUCCESS) {
+        matrix_free(x);
+    }
+
+    return status;
+}
+
+int matrix_lu_solve_matrix_into(const MatrixLU *lu, const Matrix *b,
+                                Matrix *x) {
+    DEBUG_PRINT("Solving linear systems from LU factors into result\n");
+
+    if (lu == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (lu->lu.data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    const int n = lu->lu.rows;
+    if (b->rows != n) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    int status = matrix_copy(b, x);
+    if (status != SUCCESS) {
+        return status;
+    }
+    matrix_mark_modified(x);
+
+    status = lu_check_nonsingular(lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    const size_t width = (size_t)x->cols;
+
+    // X = P * B
+    for (int i = 0; i < n; i++) {
+        if (lu->pivots[i] != i) {
+            lu_swap_rows(x, i, lu->pivots[i]);
+        }
+    }
+
+    const uint64_t n2 = (uint64_t)n * (uint64_t)n;
+    const uint64_t flops = 2 * n2 * width;
+    if (!blas_backend_use(BLAS_OP_TRSM, flops) ||
+        blas_lu_trsm(&lu->lu, x) != SUCCESS) {
+        lu_substitute_rows(lu, x);
+    }
+
+    perf_end(&scope, PERF_OP_MATRIX_LU_SOLVE,
+             8 * (n2 + 2 * (uint64_t)n * width), flops);
+    return SUCCESS;
+}
+
+int matrix_solve(const Matrix *a, const Vector *b, Vector *x) {
+    DEBUG_PRINT("Solving linear system\n");
+
+    if (a == NULL || b == NULL || x == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixCache *cache = matrix_cache_for(a);
+    if (cache != NULL) {
+        return matrix_cache_solve(cache, a, b, x);
+    }
+
+    MatrixLU lu;
+    int status = matrix_lu(a, &lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_solve(&lu, b, x);
+    matrix_lu_free(&lu);
+    return status;
+}
+
+int matrix_inverse(const Matrix *m, Matrix *result) {
+    DEBUG_PRINT("Inverting matrix\n");
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    MatrixCache *cache = matrix_cache_for(m);
+    if (cache != NULL) {
+        return matrix_cache_inverse(cache, m, result);
+    }
+
+    MatrixLU lu;
+    int status = matrix_lu(m, &lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    Matrix identity;
+    status = matrix_create(m->rows, m->rows, &identity);
+    if (status != SUCCESS) {
+        matrix_lu_free(&lu);
+        return status;
+    }
+
+    for (int i = 0; i < m->rows; i++) {
+        MATRIX_AT(&identity, i, i) = 1.0;
+    }
+
+    status = matrix_lu_solve_matrix(&lu, &identity, result);
+    matrix_free(&identity);
+    matrix_lu_free(&lu);
+    return status;
+}
\ No newline at end of file
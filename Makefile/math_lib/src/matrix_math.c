@@ -1,8 +1,58 @@
 #include "../include/matrix_math.h"
 
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/blas_backend.h"
+#include "../include/math_plan.h"
+#include "../include/matrix_cache.h"
+#include "../include/matrix_lu.h"
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+#include "../include/vector_kernels.h"
+
+// Round the row length up so that every row starts on a MATRIX_ALIGNMENT
+// boundary
+static int matrix_stride_for(int cols) {
+    const int per_line = MATRIX_ALIGNMENT / (int)sizeof(double);
+    return (cols + per_line - 1) / per_line * per_line;
+}
+
+// Zero rows [begin, end) of a new matrix
+static void matrix_zero_rows(void *ctx, int begin, int end) {
+    Matrix *m = (Matrix *)ctx;
+    memset(MATRIX_ROW(m, begin), 0,
+           (size_t)(end - begin) * (size_t)m->stride * sizeof(double));
+}
+
+// Write the first byte of every page that starts in rows [begin, end) of a
+// page-backed matrix. The pages are already zero; the store only makes the
+// worker the first to touch them, so the kernel places them on its node.
+// Each page start lies in exactly one row range, so no byte is written
+// twice.
+static void matrix_touch_rows(void *ctx, int begin, int end) {
+    Matrix *m = (Matrix *)ctx;
+    const uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)MATRIX_ROW(m, begin);
+    uintptr_t stop = (uintptr_t)MATRIX_ROW(m, end);
+
+    for (uintptr_t p = (start + page - 1) & ~(page - 1); p < stop;
+         p += page) {
+        *(volatile char *)p = 0;
+    }
+}
+
 int matrix_create(int rows, int cols, Matrix *result) {
-    DEBUG_PRINT("Creating %dx%d matrix\n", rows, cols);
+    return matrix_create_with(rows, cols, allocator_current(), result);
+}
 
+// Source of Matrix ids; 0 is never handed out
+static uint64_t matrix_next_id;
+
+// Shared by the zeroed and uninitialized constructors
+static int matrix_create_common(int rows, int cols, Allocator *allocator,
+                                int zero, Matrix *result) {
     if (result == NULL) {
         return ERROR_NULL_POINTER;
     }
@@ -11,37 +61,66 @@ int matrix_create(int rows, int cols, Matrix *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    result->rows = rows;
-    result->cols = cols;
+    int stride = matrix_stride_for(cols);
+    if ((size_t)rows > SIZE_MAX / sizeof(double) / (size_t)stride) {
+        return ERROR_INVALID_DIMENSION;
+    }
 
-    // Allocate memory for rows
-    result->data = (double **)malloc(rows * sizeof(double *));
-    if (result->data == NULL) {
+    // One aligned allocation holds every row. Large zeroed heap matrices
+    // come from fresh pages, which need no fill.
+    size_t bytes = (size_t)rows * (size_t)stride * sizeof(double);
+    if (zero && allocator == NULL && bytes >= ALLOCATOR_PAGES_THRESHOLD) {
+        allocator = allocator_pages();
+    }
+    double *buffer = (double *)allocator_alloc(allocator, bytes);
+    if (buffer == NULL) {
+        result->data = NULL;
         return ERROR_NULL_POINTER;
     }
 
-    // Allocate memory for columns
-    for (int i = 0; i < rows; i++) {
-        result->data[i] = (double *)malloc(cols * sizeof(double));
-        if (result->data[i] == NULL) {
-            // Free already allocated memory
-            for (int j = 0; j < i; j++) {
-                free(result->data[j]);
-            }
-            free(result->data);
-            result->data = NULL;
-            return ERROR_NULL_POINTER;
-        }
+    result->rows = rows;
+    result->cols = cols;
+    result->stride = stride;
+    result->data = buffer;
+    result->allocator = allocator;
+    result->flags = 0;
+    result->id = __atomic_add_fetch(&matrix_next_id, 1, __ATOMIC_RELAXED);
+    result->version = 0;
+    perf_alloc(1, bytes);
 
-        // Initialize to zeros
-        for (int j = 0; j < cols; j++) {
-            result->data[i][j] = 0.0;
-        }
+    // Initialize to zeros (padding included). The parallel fill is also
+    // the first touch of fresh pages, which spreads a large matrix's row
+    // panels over the NUMA nodes of the workers instead of the caller's.
+    // Page-backed matrices are already zero and get the same row split
+    // with one store per page.
+    if (zero && (allocator == NULL || !allocator->zeroed)) {
+        parallel_for(0, rows, parallel_grain((size_t)stride),
+                     matrix_zero_rows, result);
+    } else if (zero && allocator == allocator_pages()) {
+        parallel_for(0, rows, parallel_grain((size_t)stride),
+                     matrix_touch_rows, result);
     }
 
     return SUCCESS;
 }
 
+int matrix_create_with(int rows, int cols, Allocator *allocator,
+                       Matrix *result) {
+    DEBUG_PRINT("Creating %dx%d matrix\n", rows, cols);
+    return matrix_create_common(rows, cols, allocator, 1, result);
+}
+
+int matrix_create_uninitialized(int rows, int cols, Matrix *result) {
+    return matrix_create_uninitialized_with(rows, cols, allocator_current(),
+                                            result);
+}
+
+int matrix_create_uninitialized_with(int rows, int cols, Allocator *allocator,
+                                     Matrix *result) {
+    DEBUG_PRINT("Creating uninitialized %dx%d matrix\n", rows, cols);
+    return matrix_create_common(rows, cols, allocator, 0, result);
+}
+
 void matrix_free(Matrix *m) {
     DEBUG_PRINT("Freeing matrix\n");
 
@@ -49,16 +128,17 @@ void matrix_free(Matrix *m) {
         return;
     }
 
-    for (int i = 0; i < m->rows; i++) {
-        if (m->data[i] != NULL) {
-            free(m->data[i]);
-        }
+    if ((m->flags & MATRIX_FLAG_VIEW) == 0) {
+        allocator_free(m->allocator, m->data,
+                       (size_t)m->rows * (size_t)m->stride * sizeof(double));
     }
-
-    free(m->data);
     m->data = NULL;
     m->rows = 0;
     m->cols = 0;
+    m->stride = 0;
+    m->flags = 0;
+    m->id = 0;
+    m->version = 0;
 }
 
 int matrix_add(const Matrix *m1, const Matrix *m2, Matrix *result) {
@@ -72,18 +152,12 @@ int matrix_add(const Matrix *m1, const Matrix *m2, Matrix *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    int status = matrix_create(m1->rows, m1->cols, result);
+    int status = matrix_create_uninitialized(m1->rows, m1->cols, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < m1->rows; i++) {
-        for (int j = 0; j < m1->cols; j++) {
-            result->data[i][j] = m1->data[i][j] + m2->data[i][j];
-        }
-    }
-
-    return SUCCESS;
+    return matrix_add_into(m1, m2, result);
 }
 
 int matrix_subtract(const Matrix *m1, const Matrix *m2, Matrix *result) {
@@ -97,18 +171,12 @@ int matrix_subtract(const Matrix *m1, const Matrix *m2, Matrix *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    int status = matrix_create(m1->rows, m1->cols, result);
+    int status = matrix_create_uninitialized(m1->rows, m1->cols, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < m1->rows; i++) {
-        for (int j = 0; j < m1->cols; j++) {
-            result->data[i][j] = m1->data[i][j] - m2->data[i][j];
-        }
-    }
-
-    return SUCCESS;
+    return matrix_subtract_into(m1, m2, result);
 }
 
 int matrix_multiply(const Matrix *m1, const Matrix *m2, Matrix *result) {
@@ -127,16 +195,13 @@ int matrix_multiply(const Matrix *m1, const Matrix *m2, Matrix *result) {
         return status;
     }
 
-    for (int i = 0; i < m1->rows; i++) {
-        for (int j = 0; j < m2->cols; j++) {
-            result->data[i][j] = 0;
-            for (int k = 0; k < m1->cols; k++) {
-                result->data[i][j] += m1->data[i][k] * m2->data[k][j];
-            }
-        }
+    // The result is already zero, so accumulating skips a clearing pass
+    status = matrix_multiply_into(1.0, m1, m2, 1.0, result);
+    if (status != SUCCESS) {
+        matrix_free(result);
     }
 
-    return SUCCESS;
+    return status;
 }
 
 int matrix_scale(const Matrix *m, double scalar, Matrix *result) {
@@ -146,18 +211,12 @@ int matrix_scale(const Matrix *m, double scalar, Matrix *result) {
         return ERROR_NULL_POINTER;
     }
 
-    int status = matrix_create(m->rows, m->cols, result);
+    int status = matrix_create_uninitialized(m->rows, m->cols, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < m->rows; i++) {
-        for (int j = 0; j < m->cols; j++) {
-            result->data[i][j] = m->data[i][j] * scalar;
-        }
-    }
-
-    return SUCCESS;
+    return matrix_scale_into(m, scalar, result);
 }
 
 int matrix_transpose(const Matrix *m, Matrix *result) {
@@ -167,18 +226,12 @@ int matrix_transpose(const Matrix *m, Matrix *result) {
         return ERROR_NULL_POINTER;
     }
 
-    int status = matrix_create(m->cols, m->rows, result);
+    int status = matrix_create_uninitialized(m->cols, m->rows, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < m->rows; i++) {
-        for (int j = 0; j < m->cols; j++) {
-            result->data[j][i] = m->data[i][j];
-        }
-    }
-
-    return SUCCESS;
+    return matrix_transpose_into(m, result);
 }
 
 int matrix_determinant(const Matrix *m, double *result) {
@@ -192,21 +245,39 @@ int matrix_determinant(const Matrix *m, double *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    // For simplicity, only implement 2x2 and 3x3 determinants
-    if (m->rows == 2) {
-        *result = m->data[0][0] * m->data[1][1] - m->data[0][1] * m->data[1][0];
+    // Closed forms for small sizes, LU factorization otherwise
+    if (m->rows == 1) {
+        *result = MATRIX_AT(m, 0, 0);
+        return SUCCESS;
+    } else if (m->rows == 2) {
+        const double *r0 = MATRIX_ROW(m, 0);
+        const double *r1 = MATRIX_ROW(m, 1);
+        *result = r0[0] * r1[1] - r0[1] * r1[0];
         return SUCCESS;
     } else if (m->rows == 3) {
-        *result = m->data[0][0] * (m->data[1][1] * m->data[2][2] -
-                                   m->data[1][2] * m->data[2][1]) -
-                  m->data[0][1] * (m->data[1][0] * m->data[2][2] -
-                                   m->data[1][2] * m->data[2][0]) +
-                  m->data[0][2] * (m->data[1][0] * m->data[2][1] -
-                                   m->data[1][1] * m->data[2][0]);
+        const double *r0 = MATRIX_ROW(m, 0);
+        const double *r1 = MATRIX_ROW(m, 1);
+        const double *r2 = MATRIX_ROW(m, 2);
+        *result = r0[0] * (r1[1] * r2[2] - r1[2] * r2[1]) -
+                  r0[1] * (r1[0] * r2[2] - r1[2] * r2[0]) +
+                  r0[2] * (r1[0] * r2[1] - r1[1] * r2[0]);
         return SUCCESS;
-    } else {
-        return ERROR_INVALID_DIMENSION;  // Not implemented for larger matrices
     }
+
+    MatrixCache *cache = matrix_cache_for(m);
+    if (cache != NULL) {
+        return matrix_cache_determinant(cache, m, result);
+    }
+
+    MatrixLU lu;
+    int status = matrix_lu(m, &lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = matrix_lu_determinant(&lu, result);
+    matrix_lu_free(&lu);
+    return status;
 }
 
 int matrix_vector_multiply(const Matrix *m, const Vector *v, Vector *result) {
@@ -220,17 +291,792 @@ int matrix_vector_multiply(const Matrix *m, const Vector *v, Vector *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    int status = vector_create(m->rows, result);
+    int status = vector_create_uninitialized(m->rows, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return matrix_vector_multiply_into(m, v, result);
+}
+
+// In-place and output-parameter variants
+
+// Edge length of the square tiles used by the transpose kernels
+#define TRANSPOSE_TILE 32
+
+// Shape of the stored buffer, which differs from the logical shape for
+// transposed views
+static int storage_rows(const Matrix *m) {
+    return MATRIX_IS_TRANSPOSED(m) ? m->cols : m->rows;
+}
+
+static int storage_cols(const Matrix *m) {
+    return MATRIX_IS_TRANSPOSED(m) ? m->rows : m->cols;
+}
+
+// Element count for the performance counters
+static uint64_t matrix_elements(const Matrix *m) {
+    return (uint64_t)m->rows * (uint64_t)m->cols;
+}
+
+// Both matrices must be created and have the same shape
+static int matrix_check_same_shape(const Matrix *a, const Matrix *b) {
+    if (a->data == NULL || b->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (a->rows != b->rows || a->cols != b->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+// Element-wise kernels walk contiguous storage rows when every operand
+// shares one orientation
+static int matrix_same_layout(const Matrix *a, const Matrix *b) {
+    return MATRIX_IS_TRANSPOSED(a) == MATRIX_IS_TRANSPOSED(b);
+}
+
+// dst[j][i] = src[i][j] (storage coordinates) for columns [col_begin,
+// col_end) of src, one tile at a time so both sides stay in cache
+static void transpose_tiles(const Matrix *src, Matrix *dst, int col_begin,
+                            int col_end) {
+    const int rows = storage_rows(src);
+
+    for (int ib = 0; ib < rows; ib += TRANSPOSE_TILE) {
+        int ie = rows - ib < TRANSPOSE_TILE ? rows : ib + TRANSPOSE_TILE;
+        for (int jb = col_begin; jb < col_end; jb += TRANSPOSE_TILE) {
+            int je =
+                col_end - jb < TRANSPOSE_TILE ? col_end : jb + TRANSPOSE_TILE;
+            for (int i = ib; i < ie; i++) {
+                const double *s = MATRIX_ROW(src, i);
+                for (int j = jb; j < je; j++) {
+                    MATRIX_AT(dst, j, i) = s[j];
+                }
+            }
+        }
+    }
+}
+
+// Transpose square tile row [tile_begin, tile_end) of m in place: each
+// diagonal tile is transposed within itself and each tile right of the
+// diagonal is swapped with its mirror
+static void transpose_inplace_tiles(Matrix *m, int tile_begin, int tile_end) {
+    const int n = m->rows;
+
+    for (int t = tile_begin; t < tile_end; t++) {
+        int ib = t * TRANSPOSE_TILE;
+        int ie = n - ib < TRANSPOSE_TILE ? n : ib + TRANSPOSE_TILE;
+
+        for (int jb = ib; jb < n; jb += TRANSPOSE_TILE) {
+            int je = n - jb < TRANSPOSE_TILE ? n : jb + TRANSPOSE_TILE;
+            for (int i = ib; i < ie; i++) {
+                for (int j = jb == ib ? i + 1 : jb; j < je; j++) {
+                    double tmp = MATRIX_AT(m, i, j);
+                    MATRIX_AT(m, i, j) = MATRIX_AT(m, j, i);
+                    MATRIX_AT(m, j, i) = tmp;
+                }
+            }
+        }
+    }
+}
+
+// Row-parallel driver for the element-wise, matrix-vector and transpose
+// kernels; every index refers to a storage row unless noted otherwise
+typedef enum {
+    ROW_OP_COPY,
+    ROW_OP_ADD,
+    ROW_OP_SUBTRACT,
+    ROW_OP_SCALE,
+    ROW_OP_AXPY,
+    ROW_OP_GEMV,
+    ROW_OP_GEMV_TRANSPOSED,
+    ROW_OP_TRANSPOSE,
+    ROW_OP_TRANSPOSE_INPLACE,
+} RowOp;
+
+typedef struct {
+    RowOp op;
+    const Matrix *a;
+    const Matrix *b;
+    Matrix *c;
+    const double *x;
+    double *y;
+    double scalar;
+} RowTask;
+
+static void row_task(void *ctx, int begin, int end) {
+    const RowTask *task = (const RowTask *)ctx;
+    const VectorKernels *kernels = vector_kernels();
+    const Matrix *a = task->a;
+    const size_t cols = (size_t)storage_cols(a);
+
+    switch (task->op) {
+        case ROW_OP_GEMV_TRANSPOSED:
+            // Indices are outputs (columns of the storage): y = S^T x as a
+            // sweep of contiguous axpys over the stored rows
+            memset(task->y + begin, 0, (size_t)(end - begin) * sizeof(double));
+            for (int r = 0; r < storage_rows(a); r++) {
+                kernels->axpy(task->x[r], MATRIX_ROW(a, r) + begin,
+                              task->y + begin, (size_t)(end - begin));
+            }
+            return;
+        case ROW_OP_TRANSPOSE:
+            // Indices are storage columns of a (storage rows of c)
+            transpose_tiles(a, task->c, begin, end);
+            return;
+        case ROW_OP_TRANSPOSE_INPLACE:
+            // Indices are tile rows
+            transpose_inplace_tiles(task->c, begin, end);
+            return;
+        default:
+            break;
+    }
+
+    for (int i = begin; i < end; i++) {
+        switch (task->op) {
+            case ROW_OP_COPY:
+                memcpy(MATRIX_ROW(task->c, i), MATRIX_ROW(a, i),
+                       cols * sizeof(double));
+                break;
+            case ROW_OP_ADD:
+                kernels->add(MATRIX_ROW(a, i), MATRIX_ROW(task->b, i),
+                             MATRIX_ROW(task->c, i), cols);
+                break;
+            case ROW_OP_SUBTRACT:
+                kernels->subtract(MATRIX_ROW(a, i), MATRIX_ROW(task->b, i),
+                                  MATRIX_ROW(task->c, i), cols);
+                break;
+            case ROW_OP_SCALE:
+                kernels->scale(MATRIX_ROW(a, i), task->scalar,
+                               MATRIX_ROW(task->c, i), cols);
+                break;
+            case ROW_OP_AXPY:
+                kernels->axpy(task->scalar, MATRIX_ROW(a, i),
+                              MATRIX_ROW(task->c, i), cols);
+                break;
+            case ROW_OP_GEMV:
+                task->y[i] = kernels->dot(MATRIX_ROW(a, i), task->x, cols);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+static void row_task_run(RowTask *task, int rows, size_t work_per_row) {
+    parallel_for(0, rows, parallel_grain(work_per_row), row_task, task);
+}
+
+// Operands in mixed orientations: walk logical rows of the destination
+// with strided element access
+static void row_task_mixed(void *ctx, int begin, int end) {
+    const RowTask *task = (const RowTask *)ctx;
+    const Matrix *a = task->a;
+    const Matrix *b = task->b;
+    Matrix *c = task->c;
+
+    for (int i = begin; i < end; i++) {
+        for (int j = 0; j < c->cols; j++) {
+            switch (task->op) {
+                case ROW_OP_ADD:
+                    MATRIX_ELEM(c, i, j) =
+                        MATRIX_ELEM(a, i, j) + MATRIX_ELEM(b, i, j);
+                    break;
+                case ROW_OP_SUBTRACT:
+                    MATRIX_ELEM(c, i, j) =
+                        MATRIX_ELEM(a, i, j) - MATRIX_ELEM(b, i, j);
+                    break;
+                case ROW_OP_SCALE:
+                    MATRIX_ELEM(c, i, j) = task->scalar * MATRIX_ELEM(a, i, j);
+                    break;
+                case ROW_OP_AXPY:
+                    MATRIX_ELEM(c, i, j) += task->scalar * MATRIX_ELEM(a, i, j);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static int row_task_same_layout(const RowTask *task) {
+    return matrix_same_layout(task->a, task->c) &&
+           (task->b == NULL || matrix_same_layout(task->b, task->c));
+}
+
+static void row_task_run_layout(RowTask *task, int same) {
+    if (same) {
+        row_task_run(task, storage_rows(task->c),
+                     (size_t)storage_cols(task->c));
+    } else {
+        parallel_for(0, task->c->rows, parallel_grain((size_t)task->c->cols),
+                     row_task_mixed, task);
+    }
+}
+
+static void row_task_run_elementwise(RowTask *task) {
+    row_task_run_layout(task, row_task_same_layout(task));
+}
+
+int matrix_view(const Matrix *m, int row, int col, int rows, int cols,
+                Matrix *view) {
+    DEBUG_PRINT("Creating %dx%d view at (%d, %d)\n", rows, cols, row, col);
+
+    if (m == NULL || view == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (row < 0 || col < 0 || rows <= 0 || cols <= 0 ||
+        rows > m->rows - row || cols > m->cols - col) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    *view = *m;
+    view->rows = rows;
+    view->cols = cols;
+    view->data = MATRIX_IS_TRANSPOSED(m) ? MATRIX_ROW(m, col) + row
+                                         : MATRIX_ROW(m, row) + col;
+    view->allocator = NULL;
+    view->flags |= MATRIX_FLAG_VIEW;
+    view->id = 0;
+    return SUCCESS;
+}
+
+int matrix_transpose_view(const Matrix *m, Matrix *view) {
+    DEBUG_PRINT("Creating transposed view\n");
+
+    if (m == NULL || view == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    *view = *m;
+    view->rows = m->cols;
+    view->cols = m->rows;
+    view->allocator = NULL;
+    view->flags = (m->flags ^ MATRIX_FLAG_TRANSPOSED) | MATRIX_FLAG_VIEW;
+    view->id = 0;
+    return SUCCESS;
+}
+
+// Shared by matrix_copy and matrix_transpose_into, which count the work
+// under their own op
+static int matrix_copy_as(const Matrix *src, Matrix *dst, PerfOp op) {
+    int status = matrix_check_same_shape(src, dst);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (src->data == dst->data && src->flags == dst->flags) {
+        return SUCCESS;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(dst);
+
+    // Same orientation copies storage rows; opposite orientations
+    // materialize the transpose
+    if (matrix_same_layout(src, dst)) {
+        RowTask task = {ROW_OP_COPY, src, NULL, dst, NULL, NULL, 0.0};
+        row_task_run(&task, storage_rows(src), (size_t)storage_cols(src));
+    } else {
+        RowTask task = {ROW_OP_TRANSPOSE, src, NULL, dst, NULL, NULL, 0.0};
+        row_task_run(&task, storage_cols(src), (size_t)storage_rows(src));
+    }
+
+    perf_end(&scope, op, 16 * matrix_elements(src), 0);
+
+    return SUCCESS;
+}
+
+int matrix_copy(const Matrix *src, Matrix *dst) {
+    DEBUG_PRINT("Copying matrix\n");
+
+    if (src == NULL || dst == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    return matrix_copy_as(src, dst, PERF_OP_MATRIX_COPY);
+}
+
+int matrix_add_into(const Matrix *m1, const Matrix *m2, Matrix *result) {
+    DEBUG_PRINT("Adding matrices into result\n");
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_check_same_shape(m1, m2);
+    if (status == SUCCESS) {
+        status = matrix_check_same_shape(m1, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(result);
+    RowTask task = {ROW_OP_ADD, m1, m2, result, NULL, NULL, 0.0};
+    row_task_run_elementwise(&task);
+    perf_end(&scope, PERF_OP_MATRIX_ADD, 24 * matrix_elements(m1),
+             matrix_elements(m1));
+
+    return SUCCESS;
+}
+
+int matrix_subtract_into(const Matrix *m1, const Matrix *m2, Matrix *result) {
+    DEBUG_PRINT("Subtracting matrices into result\n");
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_check_same_shape(m1, m2);
+    if (status == SUCCESS) {
+        status = matrix_check_same_shape(m1, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(result);
+    RowTask task = {ROW_OP_SUBTRACT, m1, m2, result, NULL, NULL, 0.0};
+    row_task_run_elementwise(&task);
+    perf_end(&scope, PERF_OP_MATRIX_SUBTRACT, 24 * matrix_elements(m1),
+             matrix_elements(m1));
+
+    return SUCCESS;
+}
+
+int matrix_scale_into(const Matrix *m, double scalar, Matrix *result) {
+    DEBUG_PRINT("Scaling matrix by %f into result\n", scalar);
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_check_same_shape(m, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(result);
+    RowTask task = {ROW_OP_SCALE, m, NULL, result, NULL, NULL, scalar};
+    row_task_run_elementwise(&task);
+    perf_end(&scope, PERF_OP_MATRIX_SCALE, 16 * matrix_elements(m),
+             matrix_elements(m));
+
+    return SUCCESS;
+}
+
+int matrix_scale_inplace(Matrix *m, double scalar) {
+    return matrix_scale_into(m, scalar, m);
+}
+
+int matrix_axpy(double alpha, const Matrix *x, Matrix *y) {
+    DEBUG_PRINT("Computing Y += %f * X\n", alpha);
+
+    if (x == NULL || y == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_check_same_shape(x, y);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < m->rows; i++) {
-        result->data[i] = 0;
-        for (int j = 0; j < m->cols; j++) {
-            result->data[i] += m->data[i][j] * v->data[j];
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(y);
+    RowTask task = {ROW_OP_AXPY, x, NULL, y, NULL, NULL, alpha};
+    row_task_run_elementwise(&task);
+    perf_end(&scope, PERF_OP_MATRIX_AXPY, 24 * matrix_elements(x),
+             2 * matrix_elements(x));
+
+    return SUCCESS;
+}
+
+int matrix_transpose_into(const Matrix *m, Matrix *result) {
+    DEBUG_PRINT("Transposing matrix into result\n");
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    // Materializing a transposed view is a copy with a layout change
+    Matrix view;
+    int status = matrix_transpose_view(m, &view);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return matrix_copy_as(&view, result, PERF_OP_MATRIX_TRANSPOSE);
+}
+
+int matrix_transpose_inplace(Matrix *m) {
+    DEBUG_PRINT("Transposing matrix in place\n");
+
+    if (m == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->rows != m->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int tiles = (m->rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    PerfScope scope;
+    perf_begin(&scope);
+    matrix_mark_modified(m);
+    RowTask task = {ROW_OP_TRANSPOSE_INPLACE, m, NULL, m, NULL, NULL, 0.0};
+    parallel_for(0, tiles,
+                 parallel_grain((size_t)m->rows * TRANSPOSE_TILE / 2 + 1),
+                 row_task, &task);
+    perf_end(&scope, PERF_OP_MATRIX_TRANSPOSE, 16 * matrix_elements(m), 0);
+
+    return SUCCESS;
+}
+
+int matrix_vector_multiply_into(const Matrix *m, const Vector *v,
+                                Vector *result) {
+    DEBUG_PRINT("Multiplying matrix by vector into result\n");
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->data == NULL || v->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->cols != v->size || result->size != m->rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    if (blas_backend_use(BLAS_OP_GEMV, 2 * matrix_elements(m)) &&
+        blas_dgemv(m, v->data, result->data) == SUCCESS) {
+        // Done by the vendor library
+    } else if (MATRIX_IS_TRANSPOSED(m)) {
+        // Consume the stored matrix row by row instead of walking columns
+        RowTask task = {ROW_OP_GEMV_TRANSPOSED, m, NULL, NULL,
+                        v->data,                result->data, 0.0};
+        row_task_run(&task, m->rows, (size_t)m->cols);
+    } else {
+        RowTask task = {ROW_OP_GEMV, m, NULL, NULL, v->data, result->data, 0.0};
+        row_task_run(&task, m->rows, (size_t)m->cols);
+    }
+    perf_end(&scope, PERF_OP_MATRIX_VECTOR_MULTIPLY,
+             8 * (matrix_elements(m) + (uint64_t)m->rows + (uint64_t)m->cols),
+             2 * matrix_elements(m));
+
+    return SUCCESS;
+}
+
+// Multiple right-hand sides
+
+// Bytes of matrix rows (or of result tiles, in the transposed sweep) kept
+// in L2 while a pass runs over them
+#define GEMV_MANY_BLOCK_BYTES ((size_t)128 << 10)
+
+typedef struct {
+    const Matrix *m;
+    const Vector *v;
+    Vector *result;
+    int count;
+} GemvMany;
+
+// Indices are rows of m. Each block of rows is read from memory once and
+// then from L2 by every group of vectors.
+static void gemv_many_rows(void *ctx, int begin, int end) {
+    const GemvMany *task = (const GemvMany *)ctx;
+    const VectorKernels *kernels = vector_kernels();
+    const Matrix *m = task->m;
+    const size_t cols = (size_t)m->cols;
+    size_t rows = GEMV_MANY_BLOCK_BYTES / (cols * sizeof(double));
+    const int block = rows > 1 ? (int)rows : 1;
+
+    for (int i0 = begin; i0 < end; i0 += block) {
+        int i1 = end - i0 < block ? end : i0 + block;
+        for (int k0 = 0; k0 < task->count; k0 += MATRIX_GEMV_GROUP) {
+            int k1 = task->count - k0 < MATRIX_GEMV_GROUP
+                         ? task->count
+                         : k0 + MATRIX_GEMV_GROUP;
+            for (int i = i0; i < i1; i++) {
+                const double *row = MATRIX_ROW(m, i);
+                for (int k = k0; k < k1; k++) {
+                    task->result[k].data[i] =
+                        kernels->dot(row, task->v[k].data, cols);
+                }
+            }
+        }
+    }
+}
+
+// Indices are rows of m, which are columns of its storage. Like the single
+// transposed product, each stored row is swept with contiguous axpys, here
+// into a tile of every result at once so the storage is read once.
+static void gemv_many_transposed(void *ctx, int begin, int end) {
+    const GemvMany *task = (const GemvMany *)ctx;
+    const VectorKernels *kernels = vector_kernels();
+    const Matrix *m = task->m;
+    size_t width = GEMV_MANY_BLOCK_BYTES / sizeof(double) /
+                   (size_t)task->count / 8 * 8;
+    const int tile = width > 8 ? (int)width : 8;
+
+    for (int j0 = begin; j0 < end; j0 += tile) {
+        const size_t w = (size_t)(end - j0 < tile ? end - j0 : tile);
+        for (int k = 0; k < task->count; k++) {
+            memset(task->result[k].data + j0, 0, w * sizeof(double));
+        }
+        for (int r = 0; r < m->cols; r++) {
+            const double *s = MATRIX_ROW(m, r) + j0;
+            for (int k = 0; k < task->count; k++) {
+                kernels->axpy(task->v[k].data[r], s,
+                              task->result[k].data + j0, w);
+            }
+        }
+    }
+}
+
+int matrix_vector_multiply_many(const Matrix *m, const Vector *v,
+                                Vector *result, int count) {
+    DEBUG_PRINT("Multiplying matrix by %d vectors\n", count);
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (count < 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int k = 0; k < count; k++) {
+        if (v[k].size != m->cols) {
+            return ERROR_INVALID_DIMENSION;
+        }
+    }
+
+    int status = SUCCESS;
+    int created = 0;
+    while (created < count && status == SUCCESS) {
+        status = vector_create_uninitialized(m->rows, &result[created]);
+        created += status == SUCCESS;
+    }
+    if (status == SUCCESS) {
+        status = matrix_vector_multiply_many_into(m, v, result, count);
+    }
+    if (status != SUCCESS) {
+        for (int k = 0; k < created; k++) {
+            vector_free(&result[k]);
+        }
+    }
+
+    return status;
+}
+
+int matrix_vector_multiply_many_into(const Matrix *m, const Vector *v,
+                                     Vector *result, int count) {
+    DEBUG_PRINT("Multiplying matrix by %d vectors into results\n", count);
+
+    if (m == NULL || v == NULL || result == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (count < 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int k = 0; k < count; k++) {
+        if (v[k].data == NULL || result[k].data == NULL) {
+            return ERROR_NULL_POINTER;
+        }
+        if (v[k].size != m->cols || result[k].size != m->rows) {
+            return ERROR_INVALID_DIMENSION;
         }
     }
 
+    if (count <= 1) {
+        return count == 1 ? matrix_vector_multiply_into(m, v, result)
+                          : SUCCESS;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    GemvMany task = {m, v, result, count};
+    const int grain = parallel_grain((size_t)m->cols * (size_t)count);
+    if (MATRIX_IS_TRANSPOSED(m)) {
+        parallel_for(0, m->rows, grain, gemv_many_transposed, &task);
+    } else {
+        parallel_for(0, m->rows, grain, gemv_many_rows, &task);
+    }
+    perf_end(&scope, PERF_OP_MATRIX_VECTOR_MULTIPLY,
+             8 * (matrix_elements(m) +
+                  (uint64_t)count * ((uint64_t)m->rows + (uint64_t)m->cols)),
+             2 * matrix_elements(m) * (uint64_t)count);
+
+    return SUCCESS;
+}
+
+int matrix_transpose_vector_multiply(const Matrix *m, const Vector *v,
+                                     Vector *result) {
+    DEBUG_PRINT("Multiplying transposed matrix by vector\n");
+
+    Matrix t;
+    int status = matrix_transpose_view(m, &t);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return matrix_vector_multiply(&t, v, result);
+}
+
+int matrix_transpose_vector_multiply_into(const Matrix *m, const Vector *v,
+                                          Vector *result) {
+    DEBUG_PRINT("Multiplying transposed matrix by vector into result\n");
+
+    Matrix t;
+    int status = matrix_transpose_view(m, &t);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return matrix_vector_multiply_into(&t, v, result);
+}
+
+int matrix_transpose_vector_multiply_many_into(const Matrix *m,
+                                               const Vector *v,
+                                               Vector *result, int count) {
+    DEBUG_PRINT("Multiplying transposed matrix by %d vectors into results\n",
+                count);
+
+    Matrix t;
+    int status = matrix_transpose_view(m, &t);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return matrix_vector_multiply_many_into(&t, v, result, count);
+}
+
+// Checked-once plans
+
+// path is 1 when every operand shares the destination's orientation
+static int matrix_plan_run_elementwise(const MathPlan *plan) {
+    matrix_mark_modified(plan->target);
+    RowTask task = {(RowOp)plan->op, &plan->a,
+                    plan->b.data != NULL ? &plan->b : NULL,
+                    plan->target, NULL, NULL, plan->alpha};
+    row_task_run_layout(&task, plan->path);
+    return SUCCESS;
+}
+
+static int matrix_plan_elementwise(MathPlan *plan, RowOp op,
+                                   const Matrix *m1, const Matrix *m2,
+                                   double scalar, Matrix *result) {
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    const int binary = op == ROW_OP_ADD || op == ROW_OP_SUBTRACT;
+    if (m1 == NULL || result == NULL || (binary && m2 == NULL)) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_check_same_shape(m1, result);
+    if (status == SUCCESS && m2 != NULL) {
+        status = matrix_check_same_shape(m2, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    plan->op = op;
+    plan->alpha = scalar;
+    plan->a = *m1;
+    if (m2 != NULL) {
+        plan->b = *m2;
+    }
+    plan->target = result;
+    RowTask task = {op, m1, m2, result, NULL, NULL, scalar};
+    plan->path = row_task_same_layout(&task);
+    plan->run = matrix_plan_run_elementwise;
+    return SUCCESS;
+}
+
+int matrix_plan_add(MathPlan *plan, const Matrix *m1, const Matrix *m2,
+                    Matrix *result) {
+    DEBUG_PRINT("Planning matrix addition\n");
+    return matrix_plan_elementwise(plan, ROW_OP_ADD, m1, m2, 0.0, result);
+}
+
+int matrix_plan_subtract(MathPlan *plan, const Matrix *m1, const Matrix *m2,
+                         Matrix *result) {
+    DEBUG_PRINT("Planning matrix subtraction\n");
+    return matrix_plan_elementwise(plan, ROW_OP_SUBTRACT, m1, m2, 0.0,
+                                   result);
+}
+
+int matrix_plan_scale(MathPlan *plan, const Matrix *m, double scalar,
+                      Matrix *result) {
+    DEBUG_PRINT("Planning matrix scaling by %f\n", scalar);
+    return matrix_plan_elementwise(plan, ROW_OP_SCALE, m, NULL, scalar,
+                                   result);
+}
+
+int matrix_plan_axpy(MathPlan *plan, double alpha, const Matrix *x,
+                     Matrix *y) {
+    DEBUG_PRINT("Planning Y += %f * X\n", alpha);
+    return matrix_plan_elementwise(plan, ROW_OP_AXPY, x, NULL, alpha, y);
+}
+
+// path is 1 when the vendor library takes the product
+static int matrix_plan_run_gemv(const MathPlan *plan) {
+    if (plan->path && blas_dgemv(&plan->a, plan->x, plan->out) == SUCCESS) {
+        return SUCCESS;
+    }
+
+    RowTask task = {(RowOp)plan->op, &plan->a, NULL, NULL,
+                    plan->x,         plan->out, 0.0};
+    row_task_run(&task, plan->a.rows, (size_t)plan->a.cols);
+    return SUCCESS;
+}
+
+int matrix_plan_vector_multiply(MathPlan *plan, const Matrix *m,
+                                const Vector *v, Vector *result) {
+    DEBUG_PRINT("Planning matrix-vector product\n");
+
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->data == NULL || v->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->cols != v->size || result->size != m->rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    plan->op = MATRIX_IS_TRANSPOSED(m) ? ROW_OP_GEMV_TRANSPOSED : ROW_OP_GEMV;
+    plan->a = *m;
+    plan->x = v->data;
+    plan->out = result->data;
+    plan->path = blas_backend_use(BLAS_OP_GEMV, 2 * matrix_elements(m));
+    plan->run = matrix_plan_run_gemv;
     return SUCCESS;
 }
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "../include/perf_counters.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define PERF_HAVE_EVENTS 1
+#else
+#define PERF_HAVE_EVENTS 0
+#endif
+
+int perf_active = 0;
+static int perf_hardware_active = 0;
+
+// Snapshots are summed and subtracted as flat arrays of counters
+#define PERF_WORDS (sizeof(PerfSnapshot) / sizeof(uint64_t))
+_Static_assert(sizeof(PerfSnapshot) % sizeof(uint64_t) == 0,
+               "PerfSnapshot must hold uint64_t counters only");
+
+// Each thread owns one PerfThread and is the only writer of its counters
+// (relaxed atomic stores, so snapshots can read them concurrently). Blocks
+// live on a global list and are folded into perf_retired when their thread
+// exits.
+typedef struct PerfThread {
+    PerfSnapshot counts;
+    int hardware_tried;
+    int hardware_fds[PERF_HW_COUNT];
+    struct PerfThread *next;
+} PerfThread;
+
+static pthread_mutex_t perf_lock = PTHREAD_MUTEX_INITIALIZER;
+static PerfThread *perf_threads = NULL;
+static PerfSnapshot perf_retired;
+// perf_reset records the totals here instead of writing to counters that
+// other threads own; snapshots subtract it
+static PerfSnapshot perf_baseline;
+static pthread_key_t perf_key;
+static pthread_once_t perf_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local PerfThread *perf_self = NULL;
+
+static uint64_t perf_ticks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t t;
+    __asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(t));
+    return t;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void perf_add(uint64_t *counter, uint64_t value) {
+    uint64_t current = __atomic_load_n(counter, __ATOMIC_RELAXED);
+    __atomic_store_n(counter, current + value, __ATOMIC_RELAXED);
+}
+
+// ---------------------------------------------------------------------------
+// Hardware events
+// ---------------------------------------------------------------------------
+
+static void perf_hardware_close(PerfThread *t) {
+    for (int e = 0; e < PERF_HW_COUNT; e++) {
+        if (t->hardware_fds[e] >= 0) {
+            close(t->hardware_fds[e]);
+            t->hardware_fds[e] = -1;
+        }
+    }
+}
+
+// Opens one event group (user space only) for the calling thread
+static int perf_hardware_open(PerfThread *t) {
+#if PERF_HAVE_EVENTS
+    static const uint64_t configs[PERF_HW_COUNT] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES};
+
+    for (int e = 0; e < PERF_HW_COUNT; e++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[e];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP;
+
+        int leader = e == 0 ? -1 : t->hardware_fds[0];
+        t->hardware_fds[e] =
+            (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if (t->hardware_fds[e] < 0) {
+            perf_hardware_close(t);
+            return ERROR_UNSUPPORTED;
+        }
+    }
+
+    return SUCCESS;
+#else
+    (void)t;
+    return ERROR_UNSUPPORTED;
+#endif
+}
+
+static int perf_hardware_read(const PerfThread *t,
+                              uint64_t values[PERF_HW_COUNT]) {
+    struct {
+        uint64_t count;
+        uint64_t values[PERF_HW_COUNT];
+    } group;
+
+    if (t->hardware_fds[0] < 0 ||
+        read(t->hardware_fds[0], &group, sizeof(group)) !=
+            (ssize_t)sizeof(group)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    memcpy(values, group.values, sizeof(group.values));
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Thread registry
+// ---------------------------------------------------------------------------
+
+static void perf_sum_into(PerfSnapshot *total, const PerfSnapshot *counts) {
+    uint64_t *dst = (uint64_t *)total;
+    const uint64_t *src = (const uint64_t *)counts;
+    for (size_t w = 0; w < PERF_WORDS; w++) {
+        dst[w] += __atomic_load_n(&src[w], __ATOMIC_RELAXED);
+    }
+}
+
+static void perf_thread_exit(void *arg) {
+    PerfThread *t = (PerfThread *)arg;
+
+    pthread_mutex_lock(&perf_lock);
+    PerfThread **link = &perf_threads;
+    while (*link != t) {
+        link = &(*link)->next;
+    }
+    *link = t->next;
+    perf_sum_into(&perf_retired, &t->counts);
+    pthread_mutex_unlock(&perf_lock);
+
+    perf_hardware_close(t);
+    free(t);
+}
+
+static void perf_key_create(void) {
+    pthread_key_create(&perf_key, perf_thread_exit);
+}
+
+static PerfThread *perf_thread(void) {
+    if (perf_self != NULL) {
+        return perf_self;
+    }
+
+    PerfThread *t = (PerfThread *)calloc(1, sizeof(PerfThread));
+    if (t == NULL) {
+        return NULL;
+    }
+    for (int e = 0; e < PERF_HW_COUNT; e++) {
+        t->hardware_fds[e] = -1;
+    }
+
+    pthread_once(&perf_key_once, perf_key_create);
+    pthread_mutex_lock(&perf_lock);
+    t->next = perf_threads;
+    perf_threads = t;
+    pthread_mutex_unlock(&perf_lock);
+    pthread_setspecific(perf_key, t);
+
+    perf_self = t;
+    return t;
+}
+
+// Sum of every thread, live or exited, ignoring the reset baseline
+static void perf_totals(PerfSnapshot *total) {
+    *total = perf_retired;
+    for (PerfThread *t = perf_threads; t != NULL; t = t->next) {
+        perf_sum_into(total, &t->counts);
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Recording
+// ---------------------------------------------------------------------------
+
+void perf_scope_start(PerfScope *scope) {
+    scope->has_hardware = 0;
+    if (__atomic_load_n(&perf_hardware_active, __ATOMIC_RELAXED)) {
+        PerfThread *t = perf_thread();
+        if (t != NULL && !t->hardware_tried) {
+            t->hardware_tried = 1;
+            perf_hardware_open(t);
+        }
+        scope->has_hardware =
+            t != NULL && perf_hardware_read(t, scope->hardware) == SUCCESS;
+    }
+
+    // Read last so the counter setup above is not charged to the op
+    uint64_t start = perf_ticks();
+    scope->start = start != 0 ? start : 1;
+}
+
+void perf_scope_stop(const PerfScope *scope, PerfOp op, uint64_t bytes,
+                     uint64_t flops) {
+    uint64_t end = perf_ticks();
+    uint64_t hardware[PERF_HW_COUNT];
+    int has_hardware = 0;
+
+    PerfThread *t = perf_thread();
+    if (t == NULL) {
+        return;
+    }
+    if (scope->has_hardware) {
+        has_hardware = perf_hardware_read(t, hardware) == SUCCESS;
+    }
+
+    PerfOpCounters *c = &t->counts.ops[op];
+    perf_add(&c->calls, 1);
+    perf_add(&c->bytes, bytes);
+    perf_add(&c->flops, flops);
+    perf_add(&c->ticks, end > scope->start ? end - scope->start : 0);
+    if (has_hardware) {
+        for (int e = 0; e < PERF_HW_COUNT; e++) {
+            perf_add(&c->hardware[e], hardware[e] - scope->hardware[e]);
+        }
+    }
+}
+
+void perf_record_alloc(int matrix, uint64_t bytes) {
+    PerfThread *t = perf_thread();
+    if (t == NULL) {
+        return;
+    }
+
+    perf_add(matrix ? &t->counts.matrix_allocs : &t->counts.vector_allocs, 1);
+    perf_add(&t->counts.alloc_bytes, bytes);
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+void perf_counters_enable(int enabled) {
+    DEBUG_PRINT("%s performance counters\n",
+                enabled ? "Enabling" : "Disabling");
+    __atomic_store_n(&perf_active, enabled != 0, __ATOMIC_RELAXED);
+}
+
+int perf_counters_enabled(void) {
+    return __atomic_load_n(&perf_active, __ATOMIC_RELAXED);
+}
+
+int perf_hardware_enable(int enabled) {
+    DEBUG_PRINT("%s hardware counters\n", enabled ? "Enabling" : "Disabling");
+
+    if (enabled) {
+        // Probe on the calling thread so an unsupported system is reported
+        // here rather than silently producing zeros
+        PerfThread *t = perf_thread();
+        if (t == NULL) {
+            return ERROR_NULL_POINTER;
+        }
+        if (!t->hardware_tried) {
+            t->hardware_tried = 1;
+            perf_hardware_open(t);
+        }
+        if (t->hardware_fds[0] < 0) {
+            return ERROR_UNSUPPORTED;
+        }
+    }
+
+    __atomic_store_n(&perf_hardware_active, enabled != 0, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+int perf_snapshot(PerfSnapshot *snapshot) {
+    DEBUG_PRINT("Taking performance counter snapshot\n");
+
+    if (snapshot == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    pthread_mutex_lock(&perf_lock);
+    perf_totals(snapshot);
+    uint64_t *dst = (uint64_t *)snapshot;
+    const uint64_t *base = (const uint64_t *)&perf_baseline;
+    for (size_t w = 0; w < PERF_WORDS; w++) {
+        dst[w] -= base[w];
+    }
+    pthread_mutex_unlock(&perf_lock);
+
+    return SUCCESS;
+}
+
+void perf_reset(void) {
+    DEBUG_PRINT("Resetting performance counters\n");
+
+    pthread_mutex_lock(&perf_lock);
+    perf_totals(&perf_baseline);
+    pthread_mutex_unlock(&perf_lock);
+}
+
+const char *perf_op_name(PerfOp op) {
+    static const char *const names[PERF_OP_COUNT] = {
+#define PERF_OP_NAME(name, label) label,
+        PERF_OP_LIST(PERF_OP_NAME)
+#undef PERF_OP_NAME
+    };
+
+    if ((int)op < 0 || op >= PERF_OP_COUNT) {
+        return "unknown";
+    }
+    return names[op];
+}
+
+static double perf_ticks_rate = 0.0;
+static pthread_once_t perf_rate_once = PTHREAD_ONCE_INIT;
+
+static double perf_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void perf_measure_rate(void) {
+#if defined(__aarch64__)
+    uint64_t frequency;
+    __asm__ __volatile__("mrs %0, cntfrq_el0" : "=r"(frequency));
+    perf_ticks_rate = (double)frequency;
+#elif defined(__x86_64__) || defined(__i386__)
+    // Time 20 ms of TSC against the monotonic clock
+    struct timespec pause = {0, 20000000};
+    double t0 = perf_now();
+    uint64_t c0 = perf_ticks();
+    nanosleep(&pause, NULL);
+    uint64_t c1 = perf_ticks();
+    double t1 = perf_now();
+    perf_ticks_rate = (double)(c1 - c0) / (t1 - t0);
+#else
+    perf_ticks_rate = 1e9;
+#endif
+}
+
+double perf_ticks_per_second(void) {
+    pthread_once(&perf_rate_once, perf_measure_rate);
+    return perf_ticks_rate;
+}
+
+int perf_snapshot_print(const PerfSnapshot *snapshot, FILE *out) {
+    DEBUG_PRINT("Printing performance counter snapshot\n");
+
+    if (snapshot == NULL || out == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    double rate = perf_ticks_per_second();
+    fprintf(out, "%-32s %10s %12s %10s %10s %8s %7s %10s\n", "op", "calls",
+            "seconds", "GFLOP/s", "GB/s", "IPC", "miss/KB", "cache_miss");
+    for (int op = 0; op < PERF_OP_COUNT; op++) {
+        const PerfOpCounters *c = &snapshot->ops[op];
+        if (c->calls == 0) {
+            continue;
+        }
+
+        double seconds = (double)c->ticks / rate;
+        double per_ns = seconds > 0 ? 1.0 / (seconds * 1e9) : 0.0;
+        uint64_t cycles = c->hardware[PERF_HW_CYCLES];
+        double ipc = cycles ? (double)c->hardware[PERF_HW_INSTRUCTIONS] /
+                                  (double)cycles
+                            : 0.0;
+        double misses = c->bytes ? (double)c->hardware[PERF_HW_CACHE_MISSES] *
+                                       1024.0 / (double)c->bytes
+                                 : 0.0;
+        fprintf(out, "%-32s %10llu %12.6f %10.3f %10.3f %8.2f %7.2f %10llu\n",
+                perf_op_name((PerfOp)op), (unsigned long long)c->calls,
+                seconds, (double)c->flops * per_ns, (double)c->bytes * per_ns,
+                ipc, misses,
+                (unsigned long long)c->hardware[PERF_HW_CACHE_MISSES]);
+    }
+    fprintf(out, "allocations: %llu vectors, %llu matrices, %llu bytes\n",
+            (unsigned long long)snapshot->vector_allocs,
+            (unsigned long long)snapshot->matrix_allocs,
+            (unsigned long long)snapshot->alloc_bytes);
+
+    return SUCCESS;
+}
\ No newline at end of file
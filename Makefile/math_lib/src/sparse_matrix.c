@@ -0,0 +1,458 @@
+#include "../include/matrix_math.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+#include "../include/vector_kernels.h"
+
+// Number of compressed rows (CSR) or columns (CSC)
+static int sparse_major(const SparseMatrix *m) {
+    return m->format == SPARSE_CSR ? m->rows : m->cols;
+}
+
+static size_t sparse_offsets_bytes(const SparseMatrix *m) {
+    return (size_t)(sparse_major(m) + 1) * sizeof(int);
+}
+
+// Entry arrays always hold at least one slot so an empty matrix still has
+// valid pointers
+static size_t sparse_entries(int nnz) { return nnz > 0 ? (size_t)nnz : 1; }
+
+int sparse_matrix_create(int rows, int cols, int nnz, SparseFormat format,
+                         SparseMatrix *result) {
+    DEBUG_PRINT("Creating %dx%d sparse matrix with %d nonzeros\n", rows, cols,
+                nnz);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (rows <= 0 || cols <= 0 || nnz < 0 ||
+        (format != SPARSE_CSR && format != SPARSE_CSC)) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    Allocator *allocator = allocator_current();
+    result->rows = rows;
+    result->cols = cols;
+    result->nnz = nnz;
+    result->format = format;
+    result->allocator = allocator;
+
+    size_t entries = sparse_entries(nnz);
+    result->offsets =
+        (int *)allocator_alloc(allocator, sparse_offsets_bytes(result));
+    result->indices = (int *)allocator_alloc(allocator, entries * sizeof(int));
+    result->values =
+        (double *)allocator_alloc(allocator, entries * sizeof(double));
+
+    if (result->offsets == NULL || result->indices == NULL ||
+        result->values == NULL) {
+        sparse_matrix_free(result);
+        return ERROR_NULL_POINTER;
+    }
+
+    memset(result->offsets, 0, sparse_offsets_bytes(result));
+    return SUCCESS;
+}
+
+void sparse_matrix_free(SparseMatrix *m) {
+    DEBUG_PRINT("Freeing sparse matrix\n");
+
+    if (m == NULL) {
+        return;
+    }
+
+    size_t entries = sparse_entries(m->nnz);
+    if (m->offsets != NULL) {
+        allocator_free(m->allocator, m->offsets, sparse_offsets_bytes(m));
+    }
+    allocator_free(m->allocator, m->indices, entries * sizeof(int));
+    allocator_free(m->allocator, m->values, entries * sizeof(double));
+
+    m->offsets = NULL;
+    m->indices = NULL;
+    m->values = NULL;
+    m->rows = 0;
+    m->cols = 0;
+    m->nnz = 0;
+}
+
+// Dense element at (outer, inner) in the traversal order of format
+static double sparse_dense_at(const Matrix *m, SparseFormat format, int outer,
+                              int inner) {
+    return format == SPARSE_CSR ? MATRIX_ELEM(m, outer, inner)
+                                : MATRIX_ELEM(m, inner, outer);
+}
+
+int sparse_matrix_from_dense(const Matrix *m, SparseFormat format,
+                             SparseMatrix *result) {
+    DEBUG_PRINT("Converting dense matrix to sparse\n");
+
+    if (m == NULL || result == NULL || m->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    const int outer_count = format == SPARSE_CSR ? m->rows : m->cols;
+    const int inner_count = format == SPARSE_CSR ? m->cols : m->rows;
+
+    // First pass sizes the arrays, second pass fills them
+    int nnz = 0;
+    for (int o = 0; o < outer_count; o++) {
+        for (int i = 0; i < inner_count; i++) {
+            if (sparse_dense_at(m, format, o, i) != 0.0) {
+                if (nnz == INT_MAX) {
+                    return ERROR_INVALID_DIMENSION;
+                }
+                nnz++;
+            }
+        }
+    }
+
+    int status = sparse_matrix_create(m->rows, m->cols, nnz, format, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    int p = 0;
+    for (int o = 0; o < outer_count; o++) {
+        result->offsets[o] = p;
+        for (int i = 0; i < inner_count; i++) {
+            double v = sparse_dense_at(m, format, o, i);
+            if (v != 0.0) {
+                result->indices[p] = i;
+                result->values[p] = v;
+                p++;
+            }
+        }
+    }
+    result->offsets[outer_count] = p;
+
+    return SUCCESS;
+}
+
+// Zero every stored element of m, whatever its orientation
+static void sparse_zero_dense(Matrix *m) {
+    int rows = MATRIX_IS_TRANSPOSED(m) ? m->cols : m->rows;
+    int cols = MATRIX_IS_TRANSPOSED(m) ? m->rows : m->cols;
+
+    for (int i = 0; i < rows; i++) {
+        memset(MATRIX_ROW(m, i), 0, (size_t)cols * sizeof(double));
+    }
+}
+
+int sparse_matrix_to_dense(const SparseMatrix *m, Matrix *result) {
+    DEBUG_PRINT("Converting sparse matrix to dense\n");
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = matrix_create(m->rows, m->cols, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = sparse_matrix_to_dense_into(m, result);
+    if (status != SUCCESS) {
+        matrix_free(result);
+    }
+
+    return status;
+}
+
+int sparse_matrix_to_dense_into(const SparseMatrix *m, Matrix *result) {
+    DEBUG_PRINT("Converting sparse matrix to dense into result\n");
+
+    if (m == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->offsets == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (result->rows != m->rows || result->cols != m->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(result);
+    sparse_zero_dense(result);
+
+    for (int o = 0; o < sparse_major(m); o++) {
+        for (int p = m->offsets[o]; p < m->offsets[o + 1]; p++) {
+            if (m->format == SPARSE_CSR) {
+                MATRIX_ELEM(result, o, m->indices[p]) = m->values[p];
+            } else {
+                MATRIX_ELEM(result, m->indices[p], o) = m->values[p];
+            }
+        }
+    }
+
+    return SUCCESS;
+}
+
+int sparse_matrix_convert(const SparseMatrix *m, SparseFormat format,
+                          SparseMatrix *result) {
+    DEBUG_PRINT("Converting sparse matrix format\n");
+
+    if (m == NULL || result == NULL || m->offsets == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = sparse_matrix_create(m->rows, m->cols, m->nnz, format, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (format == m->format) {
+        memcpy(result->offsets, m->offsets, sparse_offsets_bytes(m));
+        memcpy(result->indices, m->indices, (size_t)m->nnz * sizeof(int));
+        memcpy(result->values, m->values, (size_t)m->nnz * sizeof(double));
+        return SUCCESS;
+    }
+
+    // Counting sort on the minor index; walking the source in major order
+    // keeps the new minor indices sorted
+    const int major = sparse_major(m);
+    const int minor = sparse_major(result);
+    int *next = result->offsets;
+
+    for (int p = 0; p < m->nnz; p++) {
+        next[m->indices[p] + 1]++;
+    }
+    for (int i = 0; i < minor; i++) {
+        next[i + 1] += next[i];
+    }
+
+    for (int o = 0; o < major; o++) {
+        for (int p = m->offsets[o]; p < m->offsets[o + 1]; p++) {
+            int q = next[m->indices[p]]++;
+            result->indices[q] = o;
+            result->values[q] = m->values[p];
+        }
+    }
+
+    // Each slot now holds the start of the following one; shift back
+    memmove(next + 1, next, (size_t)minor * sizeof(int));
+    next[0] = 0;
+
+    return SUCCESS;
+}
+
+int sparse_matrix_vector_multiply(const SparseMatrix *m, const Vector *v,
+                                  Vector *result) {
+    DEBUG_PRINT("Multiplying sparse matrix by vector\n");
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->cols != v->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = vector_create_uninitialized(m->rows, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    status = sparse_matrix_vector_multiply_into(m, v, result);
+    if (status != SUCCESS) {
+        vector_free(result);
+    }
+
+    return status;
+}
+
+typedef struct {
+    double alpha;
+    const SparseMatrix *a;
+    const Matrix *b;
+    Matrix *c;
+    const double *x;
+    double *y;
+} SparseTask;
+
+// y[i] = row i of a CSR matrix dotted with x
+static void sparse_gemv_rows(void *ctx, int begin, int end) {
+    const SparseTask *task = (const SparseTask *)ctx;
+    const SparseMatrix *a = task->a;
+
+    for (int i = begin; i < end; i++) {
+        double sum = 0.0;
+        for (int p = a->offsets[i]; p < a->offsets[i + 1]; p++) {
+            sum += a->values[p] * task->x[a->indices[p]];
+        }
+        task->y[i] = sum;
+    }
+}
+
+int sparse_matrix_vector_multiply_into(const SparseMatrix *m, const Vector *v,
+                                       Vector *result) {
+    DEBUG_PRINT("Multiplying sparse matrix by vector into result\n");
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->offsets == NULL || v->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->cols != v->size || result->size != m->rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    if (m->format == SPARSE_CSR) {
+        SparseTask task = {1.0, m, NULL, NULL, v->data, result->data};
+        size_t per_row = (size_t)m->nnz / (size_t)m->rows + 1;
+        parallel_for(0, m->rows, parallel_grain(per_row), sparse_gemv_rows,
+                     &task);
+    } else {
+        // CSC scatters each column into y, which does not split by rows
+        double *y = result->data;
+        memset(y, 0, (size_t)m->rows * sizeof(double));
+        for (int j = 0; j < m->cols; j++) {
+            const double xj = v->data[j];
+            if (xj == 0.0) {
+                continue;
+            }
+            for (int p = m->offsets[j]; p < m->offsets[j + 1]; p++) {
+                y[m->indices[p]] += m->values[p] * xj;
+            }
+        }
+    }
+
+    // Values and indices once, offsets, x and y
+    uint64_t nnz = (uint64_t)m->nnz;
+    uint64_t bytes = 12 * nnz + 4 * (uint64_t)sparse_major(m) +
+                     8 * ((uint64_t)m->rows + (uint64_t)m->cols);
+    perf_end(&scope, PERF_OP_SPARSE_VECTOR_MULTIPLY, bytes, 2 * nnz);
+    return SUCCESS;
+}
+
+int sparse_matrix_multiply(const SparseMatrix *m1, const Matrix *m2,
+                           Matrix *result) {
+    DEBUG_PRINT("Multiplying sparse matrix by dense matrix\n");
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->cols != m2->rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = matrix_create(m1->rows, m2->cols, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    // The result is already zero, so accumulating skips a clearing pass
+    status = sparse_matrix_multiply_into(1.0, m1, m2, 1.0, result);
+    if (status != SUCCESS) {
+        matrix_free(result);
+    }
+
+    return status;
+}
+
+// Row i of C, columns [begin, end), += v * row k of B
+static void sparse_row_update(const VectorKernels *kernels, Matrix *c, int i,
+                              double v, const Matrix *b, int k, int begin,
+                              int end) {
+    if (!MATRIX_IS_TRANSPOSED(b) && !MATRIX_IS_TRANSPOSED(c)) {
+        kernels->axpy(v, MATRIX_ROW(b, k) + begin, MATRIX_ROW(c, i) + begin,
+                      (size_t)(end - begin));
+        return;
+    }
+
+    for (int j = begin; j < end; j++) {
+        MATRIX_ELEM(c, i, j) += v * MATRIX_ELEM(b, k, j);
+    }
+}
+
+// CSR: each row of C is a combination of rows of B, so rows split cleanly
+static void sparse_gemm_rows(void *ctx, int begin, int end) {
+    const SparseTask *task = (const SparseTask *)ctx;
+    const SparseMatrix *a = task->a;
+    const VectorKernels *kernels = vector_kernels();
+    const int n = task->b->cols;
+
+    for (int i = begin; i < end; i++) {
+        for (int p = a->offsets[i]; p < a->offsets[i + 1]; p++) {
+            sparse_row_update(kernels, task->c, i, task->alpha * a->values[p],
+                              task->b, a->indices[p], 0, n);
+        }
+    }
+}
+
+// CSC: columns of A scatter into arbitrary rows of C, so split the columns
+// of B and C instead
+static void sparse_gemm_cols(void *ctx, int begin, int end) {
+    const SparseTask *task = (const SparseTask *)ctx;
+    const SparseMatrix *a = task->a;
+    const VectorKernels *kernels = vector_kernels();
+
+    for (int k = 0; k < a->cols; k++) {
+        for (int p = a->offsets[k]; p < a->offsets[k + 1]; p++) {
+            sparse_row_update(kernels, task->c, a->indices[p],
+                              task->alpha * a->values[p], task->b, k, begin,
+                              end);
+        }
+    }
+}
+
+int sparse_matrix_multiply_into(double alpha, const SparseMatrix *m1,
+                                const Matrix *m2, double beta, Matrix *result) {
+    DEBUG_PRINT("Multiplying sparse matrix by dense matrix into result\n");
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->offsets == NULL || m2->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->cols != m2->rows || result->rows != m1->rows ||
+        result->cols != m2->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(result);
+    if (beta == 0.0) {
+        sparse_zero_dense(result);
+    } else if (beta != 1.0) {
+        matrix_scale_inplace(result, beta);
+    }
+
+    if (alpha == 0.0 || m1->nnz == 0) {
+        return SUCCESS;
+    }
+
+    PerfScope scope;
+    perf_begin(&scope);
+    SparseTask task = {alpha, m1, m2, result, NULL, NULL};
+    const size_t n = (size_t)m2->cols;
+
+    if (m1->format == SPARSE_CSR) {
+        size_t per_row = ((size_t)m1->nnz / (size_t)m1->rows + 1) * n;
+        parallel_for(0, m1->rows, parallel_grain(per_row), sparse_gemm_rows,
+                     &task);
+    } else {
+        parallel_for(0, m2->cols, parallel_grain((size_t)m1->nnz),
+                     sparse_gemm_cols, &task);
+    }
+
+    uint64_t nnz = (uint64_t)m1->nnz;
+    uint64_t dense = (uint64_t)m2->rows * n + 2 * (uint64_t)m1->rows * n;
+    perf_end(&scope, PERF_OP_SPARSE_MULTIPLY, 12 * nnz + 8 * dense,
+             2 * nnz * n);
+    return SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,570 @@
+#define _GNU_SOURCE
+
+#include "../include/thread_pool.h"
+
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "../include/allocator.h"
+#include "../include/common.h"
+
+// Upper bound on pool size
+#define THREAD_POOL_MAX_THREADS 256
+
+// Tasks a worker can hold before task_spawn runs them inline; a power of
+// two. Recursive splitting only keeps its depth queued, so this is rarely
+// reached outside of flat loops of spawns.
+#define TASK_DEQUE_CAPACITY 4096
+
+// Rounds of looking for work (yielding in between) before an idle thread
+// sleeps
+#define THREAD_POOL_IDLE_ROUNDS 32
+
+// Chase-Lev work-stealing deque. The owning worker pushes and pops at
+// bottom; other threads steal from top.
+typedef struct {
+    _Alignas(64) atomic_long top;
+    _Alignas(64) atomic_long bottom;
+    _Atomic(Task *) slots[TASK_DEQUE_CAPACITY];
+} TaskDeque;
+
+typedef struct {
+    pthread_t *threads;
+    // Deque i belongs to worker i. Deques outlive the workers so a late
+    // thief never touches freed memory; init reuses them.
+    TaskDeque *deques[THREAD_POOL_MAX_THREADS];
+    int allocated;
+    atomic_int num_workers;
+    atomic_int running;
+
+    // Serializes init and shutdown
+    pthread_mutex_t admin_lock;
+
+    // Tasks spawned by threads outside the pool, oldest first
+    pthread_mutex_t inject_lock;
+    Task *inject_head;
+    Task *inject_tail;
+    atomic_int inject_count;
+
+    // Idle threads (workers without work and threads blocked in
+    // task_group_wait) sleep on wake until events changes
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    atomic_int idle;
+    atomic_ulong events;
+    atomic_int shutdown;
+} ThreadPool;
+
+static ThreadPool pool = {
+    .admin_lock = PTHREAD_MUTEX_INITIALIZER,
+    .inject_lock = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+static size_t min_work = THREAD_POOL_DEFAULT_MIN_WORK;
+
+// Index of the calling thread's deque, or -1 outside the pool
+static _Thread_local int worker_index = -1;
+// Victim selection state
+static _Thread_local uint32_t steal_seed = 0;
+
+// ---------------------------------------------------------------------------
+// Deque
+// ---------------------------------------------------------------------------
+
+// Owner only; returns 0 when the deque is full
+static int deque_push(TaskDeque *d, Task *task) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= TASK_DEQUE_CAPACITY) {
+        return 0;
+    }
+
+    atomic_store_explicit(&d->slots[b & (TASK_DEQUE_CAPACITY - 1)], task,
+                          memory_order_relaxed);
+    // Release publishes the task's fields to the thief that acquires bottom
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return 1;
+}
+
+// Owner only; takes the newest task
+static Task *deque_pop(TaskDeque *d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    Task *task = atomic_load_explicit(&d->slots[b & (TASK_DEQUE_CAPACITY - 1)],
+                                      memory_order_relaxed);
+    if (t == b) {
+        // Last task: race the thieves for it
+        if (!atomic_compare_exchange_strong_explicit(
+                &d->top, &t, t + 1, memory_order_seq_cst,
+                memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// Any thread; takes the oldest task. NULL when empty or when another
+// thread won the race.
+static Task *deque_steal(TaskDeque *d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    if (t >= b) {
+        return NULL;
+    }
+
+    Task *task = atomic_load_explicit(&d->slots[t & (TASK_DEQUE_CAPACITY - 1)],
+                                      memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+static int deque_empty(TaskDeque *d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+    return t >= b;
+}
+
+// ---------------------------------------------------------------------------
+// Scheduling
+// ---------------------------------------------------------------------------
+
+static void inject_push(Task *task) {
+    pthread_mutex_lock(&pool.inject_lock);
+    task->next = NULL;
+    if (pool.inject_tail != NULL) {
+        pool.inject_tail->next = task;
+    } else {
+        pool.inject_head = task;
+    }
+    pool.inject_tail = task;
+    atomic_fetch_add(&pool.inject_count, 1);
+    pthread_mutex_unlock(&pool.inject_lock);
+}
+
+static Task *inject_pop(void) {
+    if (atomic_load_explicit(&pool.inject_count, memory_order_relaxed) == 0) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&pool.inject_lock);
+    Task *task = pool.inject_head;
+    if (task != NULL) {
+        pool.inject_head = task->next;
+        if (pool.inject_head == NULL) {
+            pool.inject_tail = NULL;
+        }
+        atomic_fetch_sub(&pool.inject_count, 1);
+    }
+    pthread_mutex_unlock(&pool.inject_lock);
+    return task;
+}
+
+// Own deque first (newest, still hot in cache), then tasks from outside the
+// pool, then the oldest task of another worker starting at a random victim
+static Task *thread_pool_find_task(void) {
+    Task *task;
+    if (worker_index >= 0 &&
+        (task = deque_pop(pool.deques[worker_index])) != NULL) {
+        return task;
+    }
+
+    if ((task = inject_pop()) != NULL) {
+        return task;
+    }
+
+    int workers = atomic_load_explicit(&pool.num_workers,
+                                       memory_order_acquire);
+    if (workers == 0) {
+        return NULL;
+    }
+
+    // xorshift32; the seed is never zero once set
+    uint32_t x = steal_seed;
+    if (x == 0) {
+        x = (uint32_t)(uintptr_t)&steal_seed | 1u;
+    }
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    steal_seed = x;
+
+    int start = (int)(x % (uint32_t)workers);
+    for (int i = 0; i < workers; i++) {
+        int victim = (start + i) % workers;
+        if (victim != worker_index &&
+            (task = deque_steal(pool.deques[victim])) != NULL) {
+            return task;
+        }
+    }
+    return NULL;
+}
+
+static int thread_pool_has_work(void) {
+    if (atomic_load(&pool.inject_count) > 0) {
+        return 1;
+    }
+
+    int workers = atomic_load_explicit(&pool.num_workers,
+                                       memory_order_acquire);
+    for (int i = 0; i < workers; i++) {
+        if (!deque_empty(pool.deques[i])) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Wake idle threads after new work or a finished group. The fence orders
+// the caller's update before the idle check; thread_pool_sleep pairs with
+// it by registering as idle before its last look for work.
+static void thread_pool_notify(int all) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&pool.idle) == 0) {
+        return;
+    }
+
+    atomic_fetch_add(&pool.events, 1);
+    pthread_mutex_lock(&pool.lock);
+    if (all) {
+        pthread_cond_broadcast(&pool.wake);
+    } else {
+        pthread_cond_signal(&pool.wake);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+// Block until something changes: new work, a finished group, or shutdown.
+// Returns at once if group (when given) is already done or work showed up.
+static void thread_pool_sleep(const TaskGroup *group) {
+    atomic_fetch_add(&pool.idle, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    unsigned long seen = atomic_load(&pool.events);
+
+    if (!thread_pool_has_work() && !atomic_load(&pool.shutdown) &&
+        (group == NULL || __atomic_load_n(&group->pending,
+                                          __ATOMIC_SEQ_CST) != 0)) {
+        pthread_mutex_lock(&pool.lock);
+        while (atomic_load(&pool.events) == seen &&
+               !atomic_load(&pool.shutdown)) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+
+    atomic_fetch_sub(&pool.idle, 1);
+}
+
+static void task_run(Task *task) {
+    // The group is read first: once pending drops, the waiter may return
+    // and release both the task and the group
+    TaskGroup *group = task->group;
+
+    // A stolen task must not inherit the thief's allocator scope
+    Allocator *scoped = allocator_set_current(NULL);
+    task->fn(task->ctx);
+    allocator_set_current(scoped);
+
+    if (__atomic_sub_fetch(&group->pending, 1, __ATOMIC_SEQ_CST) == 0) {
+        thread_pool_notify(1);
+    }
+}
+
+static void *thread_pool_worker(void *arg) {
+    worker_index = (int)(intptr_t)arg;
+    steal_seed = 2654435761u * (uint32_t)(worker_index + 1);
+
+    int rounds = 0;
+    for (;;) {
+        Task *task = thread_pool_find_task();
+        if (task != NULL) {
+            task_run(task);
+            rounds = 0;
+            continue;
+        }
+
+        // Workers leave only once nothing is queued anywhere
+        if (atomic_load(&pool.shutdown)) {
+            break;
+        }
+
+        if (++rounds < THREAD_POOL_IDLE_ROUNDS) {
+            sched_yield();
+            continue;
+        }
+        rounds = 0;
+        thread_pool_sleep(NULL);
+    }
+
+    worker_index = -1;
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------
+// Pool lifetime
+// ---------------------------------------------------------------------------
+
+static void thread_pool_pin(pthread_t thread, int index) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(index % cpus, &set);
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+}
+
+int thread_pool_init(int num_threads, int pin) {
+    DEBUG_PRINT("Starting thread pool with %d threads\n", num_threads);
+
+    if (num_threads < 0 || num_threads > THREAD_POOL_MAX_THREADS) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    if (num_threads == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cpus > 0 ? (int)cpus : 1;
+        if (num_threads > THREAD_POOL_MAX_THREADS) {
+            num_threads = THREAD_POOL_MAX_THREADS;
+        }
+    }
+
+    pthread_mutex_lock(&pool.admin_lock);
+    if (atomic_load(&pool.running)) {
+        pthread_mutex_unlock(&pool.admin_lock);
+        return SUCCESS;
+    }
+
+    int workers = num_threads - 1;
+    pool.threads = (pthread_t *)malloc(
+        (size_t)(workers > 0 ? workers : 1) * sizeof(pthread_t));
+    if (pool.threads == NULL) {
+        pthread_mutex_unlock(&pool.admin_lock);
+        return ERROR_NULL_POINTER;
+    }
+
+    atomic_store(&pool.shutdown, 0);
+    for (int i = 0; i < workers; i++) {
+        if (i == pool.allocated) {
+            TaskDeque *d = (TaskDeque *)aligned_alloc(64, sizeof(TaskDeque));
+            if (d == NULL) {
+                break;
+            }
+            atomic_init(&d->top, 0);
+            atomic_init(&d->bottom, 0);
+            pool.deques[pool.allocated++] = d;
+        }
+
+        if (pthread_create(&pool.threads[i], NULL, thread_pool_worker,
+                           (void *)(intptr_t)i) != 0) {
+            break;
+        }
+        if (pin) {
+            thread_pool_pin(pool.threads[i], i + 1);
+        }
+        atomic_fetch_add_explicit(&pool.num_workers, 1,
+                                  memory_order_release);
+    }
+
+    atomic_store(&pool.running, 1);
+    pthread_mutex_unlock(&pool.admin_lock);
+    return SUCCESS;
+}
+
+void thread_pool_shutdown(void) {
+    DEBUG_PRINT("Stopping thread pool\n");
+
+    pthread_mutex_lock(&pool.admin_lock);
+    if (!atomic_load(&pool.running)) {
+        pthread_mutex_unlock(&pool.admin_lock);
+        return;
+    }
+
+    // New spawns run inline from here on; workers finish what is queued
+    atomic_store(&pool.running, 0);
+    pthread_mutex_lock(&pool.lock);
+    atomic_store(&pool.shutdown, 1);
+    atomic_fetch_add(&pool.events, 1);
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    int workers = atomic_load(&pool.num_workers);
+    for (int i = 0; i < workers; i++) {
+        pthread_join(pool.threads[i], NULL);
+    }
+
+    free(pool.threads);
+    pool.threads = NULL;
+    atomic_store(&pool.num_workers, 0);
+    pthread_mutex_unlock(&pool.admin_lock);
+}
+
+int thread_pool_size(void) {
+    return atomic_load(&pool.running) ? atomic_load(&pool.num_workers) + 1
+                                      : 1;
+}
+
+void thread_pool_set_min_work(size_t work) { min_work = work > 0 ? work : 1; }
+
+size_t thread_pool_min_work(void) { return min_work; }
+
+// ---------------------------------------------------------------------------
+// Tasks
+// ---------------------------------------------------------------------------
+
+void task_group_init(TaskGroup *group) {
+    __atomic_store_n(&group->pending, 0, __ATOMIC_RELAXED);
+}
+
+void task_spawn(TaskGroup *group, Task *task, TaskFn fn, void *ctx) {
+    task->fn = fn;
+    task->ctx = ctx;
+    task->group = group;
+    task->next = NULL;
+
+    if (!atomic_load_explicit(&pool.running, memory_order_relaxed) ||
+        atomic_load_explicit(&pool.num_workers, memory_order_relaxed) == 0) {
+        fn(ctx);
+        return;
+    }
+
+    __atomic_add_fetch(&group->pending, 1, __ATOMIC_RELAXED);
+    if (worker_index >= 0) {
+        if (!deque_push(pool.deques[worker_index], task)) {
+            task_run(task);
+            return;
+        }
+    } else {
+        inject_push(task);
+    }
+    thread_pool_notify(0);
+}
+
+void task_group_wait(TaskGroup *group) {
+    int rounds = 0;
+    while (__atomic_load_n(&group->pending, __ATOMIC_ACQUIRE) != 0) {
+        // Help instead of blocking; this is also what keeps nested waits
+        // on workers from deadlocking the pool
+        Task *task = thread_pool_find_task();
+        if (task != NULL) {
+            task_run(task);
+            rounds = 0;
+            continue;
+        }
+
+        if (++rounds < THREAD_POOL_IDLE_ROUNDS) {
+            sched_yield();
+            continue;
+        }
+        rounds = 0;
+        thread_pool_sleep(group);
+    }
+}
+
+void parallel_invoke(TaskFn a, void *a_ctx, TaskFn b, void *b_ctx) {
+    TaskGroup group = TASK_GROUP_INIT;
+    Task task;
+    task_spawn(&group, &task, b, b_ctx);
+    a(a_ctx);
+    task_group_wait(&group);
+}
+
+// ---------------------------------------------------------------------------
+// Parallel loops
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    ParallelForFn fn;
+    void *ctx;
+    int grain;
+} ParallelLoop;
+
+typedef struct {
+    Task task;
+    const ParallelLoop *loop;
+    int begin;
+    int end;
+} ParallelRange;
+
+static void parallel_range(const ParallelLoop *loop, int begin, int end);
+
+static void parallel_range_task(void *ctx) {
+    const ParallelRange *range = (const ParallelRange *)ctx;
+    parallel_range(range->loop, range->begin, range->end);
+}
+
+// Offer the upper half to thieves and keep splitting the lower half, so
+// chunks are only created as fast as idle threads take them and each one
+// holds between grain and 2 * grain indices
+static void parallel_range(const ParallelLoop *loop, int begin, int end) {
+    if (end - begin - loop->grain < loop->grain) {
+        loop->fn(loop->ctx, begin, end);
+        return;
+    }
+
+    TaskGroup group = TASK_GROUP_INIT;
+    ParallelRange upper = {.loop = loop,
+                           .begin = begin + (end - begin) / 2,
+                           .end = end};
+    task_spawn(&group, &upper.task, parallel_range_task, &upper);
+    parallel_range(loop, begin, upper.begin);
+    task_group_wait(&group);
+}
+
+int parallel_grain(size_t work_per_index) {
+    if (work_per_index == 0) {
+        work_per_index = 1;
+    }
+
+    size_t grain = (min_work + work_per_index - 1) / work_per_index;
+    return grain > (size_t)INT_MAX ? INT_MAX : (int)grain;
+}
+
+void parallel_for(int begin, int end, int grain, ParallelForFn fn,
+                  void *ctx) {
+    if (begin >= end) {
+        return;
+    }
+
+    if (grain < 1) {
+        grain = 1;
+    }
+
+    int workers = atomic_load_explicit(&pool.num_workers,
+                                       memory_order_relaxed);
+    if (!atomic_load_explicit(&pool.running, memory_order_relaxed) ||
+        workers == 0 || end - begin <= grain) {
+        fn(ctx, begin, end);
+        return;
+    }
+
+    // Aim for a few chunks per thread so uneven chunks balance out
+    int threads = workers + 1;
+    int balanced = (end - begin + 4 * threads - 1) / (4 * threads);
+    if (balanced > grain) {
+        grain = balanced;
+    }
+
+    ParallelLoop loop = {fn, ctx, grain};
+    parallel_range(&loop, begin, end);
+}
\ No newline at end of file
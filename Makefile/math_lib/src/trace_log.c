@@ -0,0 +1,210 @@
+#include "../include/trace_log.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+// Trace points in this file would record into the rings they maintain, so
+// it has none
+
+#ifdef DEBUG
+int trace_active = 1;
+#else
+int trace_active = 0;
+#endif
+
+#define TRACE_TEXT_WORDS (TRACE_TEXT_BYTES / sizeof(uint64_t))
+_Static_assert(TRACE_TEXT_BYTES % sizeof(uint64_t) == 0,
+               "TRACE_TEXT_BYTES must be a whole number of words");
+
+typedef union {
+    char text[TRACE_TEXT_BYTES];
+    uint64_t words[TRACE_TEXT_WORDS];
+} TraceText;
+
+// seq is 0 while the record is being written and n + 1 once record n of
+// its ring is complete. Every field is accessed atomically, so a reader
+// copies a record and keeps it only when seq is unchanged afterwards.
+typedef struct {
+    uint64_t seq;
+    uint64_t time_ns;
+    uint64_t tid;
+    TraceText line;
+} TraceRecord;
+
+// Written only by the owning thread. Rings are never freed: the list only
+// grows, so readers walk it without the lock.
+typedef struct TraceRing {
+    struct TraceRing *next;
+    int owned;
+    // Records written; record n lives at records[n % TRACE_RING_RECORDS]
+    uint64_t head;
+    // Records below this were dropped by trace_clear
+    uint64_t cleared;
+    TraceRecord records[TRACE_RING_RECORDS];
+} TraceRing;
+
+TraceRing *trace_rings = NULL;
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_key_t trace_key;
+static pthread_once_t trace_key_once = PTHREAD_ONCE_INIT;
+static _Thread_local TraceRing *trace_self = NULL;
+static _Thread_local uint64_t trace_tid = 0;
+// Set once the thread's ring is released; later records are dropped
+static _Thread_local int trace_exited = 0;
+
+__attribute__((constructor)) static void trace_init(void) {
+    const char *env = getenv("MATHLIB_TRACE");
+    if (env != NULL && env[0] != '\0') {
+        trace_enable(strcmp(env, "0") != 0);
+    }
+}
+
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// The ring goes back to the pool; its records stay until overwritten.
+// Runs on the exiting thread, where later TLS destructors may still trace:
+// those records are dropped rather than written into a ring another thread
+// may already have claimed, or into a new ring nothing would release.
+static void trace_thread_exit(void *arg) {
+    TraceRing *ring = (TraceRing *)arg;
+
+    trace_self = NULL;
+    trace_exited = 1;
+    pthread_mutex_lock(&trace_lock);
+    ring->owned = 0;
+    pthread_mutex_unlock(&trace_lock);
+}
+
+static void trace_key_create(void) {
+    pthread_key_create(&trace_key, trace_thread_exit);
+}
+
+static TraceRing *trace_ring(void) {
+    if (trace_self != NULL || trace_exited) {
+        return trace_self;
+    }
+
+    pthread_once(&trace_key_once, trace_key_create);
+    pthread_mutex_lock(&trace_lock);
+    TraceRing *ring = trace_rings;
+    while (ring != NULL && ring->owned) {
+        ring = ring->next;
+    }
+    if (ring == NULL) {
+        ring = (TraceRing *)calloc(1, sizeof(TraceRing));
+        if (ring != NULL) {
+            ring->next = trace_rings;
+            __atomic_store_n(&trace_rings, ring, __ATOMIC_RELEASE);
+        }
+    }
+    if (ring != NULL) {
+        ring->owned = 1;
+    }
+    pthread_mutex_unlock(&trace_lock);
+    if (ring == NULL) {
+        return NULL;
+    }
+
+    pthread_setspecific(trace_key, ring);
+    trace_tid = (uint64_t)syscall(SYS_gettid);
+    trace_self = ring;
+    return ring;
+}
+
+void trace_enable(int enabled) {
+    __atomic_store_n(&trace_active, enabled != 0, __ATOMIC_RELAXED);
+}
+
+int trace_enabled(void) {
+    return __atomic_load_n(&trace_active, __ATOMIC_RELAXED);
+}
+
+void trace_record(const char *fmt, ...) {
+    TraceRing *ring = trace_ring();
+    if (ring == NULL) {
+        return;
+    }
+
+    TraceText line = {{0}};
+    va_list args;
+    va_start(args, fmt);
+    int length = vsnprintf(line.text, sizeof(line.text), fmt, args);
+    va_end(args);
+    if (length > (int)sizeof(line.text) - 1) {
+        length = (int)sizeof(line.text) - 1;
+    }
+    if (length > 0 && line.text[length - 1] == '\n') {
+        line.text[length - 1] = '\0';
+    }
+
+    const uint64_t n = ring->head;
+    TraceRecord *r = &ring->records[n % TRACE_RING_RECORDS];
+    __atomic_store_n(&r->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&r->time_ns, trace_now(), __ATOMIC_RELAXED);
+    __atomic_store_n(&r->tid, trace_tid, __ATOMIC_RELAXED);
+    for (size_t w = 0; w < TRACE_TEXT_WORDS; w++) {
+        __atomic_store_n(&r->line.words[w], line.words[w], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&r->seq, n + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+}
+
+int trace_dump(FILE *out) {
+    if (out == NULL) {
+        return 0;
+    }
+
+    int written = 0;
+    TraceRing *ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        const uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t n = __atomic_load_n(&ring->cleared, __ATOMIC_RELAXED);
+        if (head - n > TRACE_RING_RECORDS) {
+            n = head - TRACE_RING_RECORDS;
+        }
+
+        for (; n < head; n++) {
+            const TraceRecord *r = &ring->records[n % TRACE_RING_RECORDS];
+            const uint64_t seq = __atomic_load_n(&r->seq, __ATOMIC_ACQUIRE);
+            TraceText line;
+            uint64_t time_ns = __atomic_load_n(&r->time_ns, __ATOMIC_RELAXED);
+            uint64_t tid = __atomic_load_n(&r->tid, __ATOMIC_RELAXED);
+            for (size_t w = 0; w < TRACE_TEXT_WORDS; w++) {
+                line.words[w] =
+                    __atomic_load_n(&r->line.words[w], __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (seq != n + 1 ||
+                __atomic_load_n(&r->seq, __ATOMIC_RELAXED) != seq) {
+                continue;
+            }
+
+            line.text[TRACE_TEXT_BYTES - 1] = '\0';
+            fprintf(out, "[%llu] %.6f %s\n", (unsigned long long)tid,
+                    (double)time_ns * 1e-9, line.text);
+            written++;
+        }
+    }
+
+    return written;
+}
+
+void trace_clear(void) {
+    TraceRing *ring = __atomic_load_n(&trace_rings, __ATOMIC_ACQUIRE);
+    for (; ring != NULL; ring = ring->next) {
+        __atomic_store_n(&ring->cleared,
+                         __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE),
+                         __ATOMIC_RELAXED);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include "../include/typed_math.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../include/thread_pool.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TYPED_MATH_X86 1
+#else
+#define TYPED_MATH_X86 0
+#endif
+
+#define TYPED_ROW(m, i) ((m)->data + (size_t)(i) * (size_t)(m)->stride)
+
+typedef enum {
+    TYPED_OP_ADD,
+    TYPED_OP_SUBTRACT,
+    TYPED_OP_SCALE,
+    TYPED_OP_GEMV,
+    TYPED_OP_GEMM,
+} TypedOp;
+
+// ---------------------------------------------------------------------------
+// Float GEMM core
+// ---------------------------------------------------------------------------
+
+// Every element type packs its operands into float panels, so one float
+// micro-kernel serves all of them and conversions happen only while
+// packing. Same blocking scheme as matrix_gemm.c, except that a whole
+// MC x NC block of C is accumulated in float over the full depth and
+// rounded to storage once. Each NC column block of B is packed for every
+// depth panel once, before its rows are split across the pool.
+#define TYPED_GEMM_MR 6
+#define TYPED_GEMM_NR 16
+#define TYPED_GEMM_KC 256
+#define TYPED_GEMM_MC 96
+#define TYPED_GEMM_NC 512
+
+// Eight float lanes; the micro-kernel is written with GCC vector types
+// because the auto-vectorizer shuffles a float accumulator tile between
+// registers instead of keeping it in place
+typedef float TypedFloat8 __attribute__((vector_size(32)));
+
+#define TYPED_GEMM_VECTORS (TYPED_GEMM_NR / 8)
+
+// C[MR x NR] += A_panel * B_panel over kc steps
+// a is packed MR values per step, b is packed NR values per step
+static inline __attribute__((always_inline)) void typed_micro_kernel_body(
+    int kc, const float *restrict a, const float *restrict b,
+    float *restrict c, int ldc) {
+    TypedFloat8 acc[TYPED_GEMM_MR][TYPED_GEMM_VECTORS];
+    for (int i = 0; i < TYPED_GEMM_MR; i++) {
+        for (int v = 0; v < TYPED_GEMM_VECTORS; v++) {
+            acc[i][v] = (TypedFloat8){0.0f};
+        }
+    }
+
+    for (int p = 0; p < kc; p++) {
+        TypedFloat8 bv[TYPED_GEMM_VECTORS];
+        for (int v = 0; v < TYPED_GEMM_VECTORS; v++) {
+            memcpy(&bv[v], b + 8 * v, sizeof(bv[v]));
+        }
+        for (int i = 0; i < TYPED_GEMM_MR; i++) {
+            for (int v = 0; v < TYPED_GEMM_VECTORS; v++) {
+                acc[i][v] += a[i] * bv[v];
+            }
+        }
+        a += TYPED_GEMM_MR;
+        b += TYPED_GEMM_NR;
+    }
+
+    for (int i = 0; i < TYPED_GEMM_MR; i++) {
+        float *ci = c + (size_t)i * ldc;
+        for (int v = 0; v < TYPED_GEMM_VECTORS; v++) {
+            TypedFloat8 cv;
+            memcpy(&cv, ci + 8 * v, sizeof(cv));
+            cv += acc[i][v];
+            memcpy(ci + 8 * v, &cv, sizeof(cv));
+        }
+    }
+}
+
+static void typed_micro_kernel_generic(int kc, const float *a, const float *b,
+                                       float *c, int ldc) {
+    typed_micro_kernel_body(kc, a, b, c, ldc);
+}
+
+#if TYPED_MATH_X86
+__attribute__((target("avx2,fma"))) static void typed_micro_kernel_avx2(
+    int kc, const float *a, const float *b, float *c, int ldc) {
+    typed_micro_kernel_body(kc, a, b, c, ldc);
+}
+#endif
+
+typedef void (*TypedMicroKernel)(int kc, const float *a, const float *b,
+                                 float *c, int ldc);
+
+static TypedMicroKernel typed_select_micro_kernel(void) {
+    static _Atomic(TypedMicroKernel) selected = NULL;
+
+    TypedMicroKernel kernel =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernel == NULL) {
+        kernel = typed_micro_kernel_generic;
+#if TYPED_MATH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernel = typed_micro_kernel_avx2;
+        }
+#endif
+        atomic_store_explicit(&selected, kernel, memory_order_release);
+    }
+
+    return kernel;
+}
+
+// Multiply one packed A block by one packed B block into the float block c
+static void typed_macro_kernel(TypedMicroKernel kernel, int mc, int nc,
+                               int kc, const float *packed_a,
+                               const float *packed_b, float *c, int ldc) {
+    float edge[TYPED_GEMM_MR * TYPED_GEMM_NR];
+
+    for (int j = 0; j < nc; j += TYPED_GEMM_NR) {
+        int cols = nc - j < TYPED_GEMM_NR ? nc - j : TYPED_GEMM_NR;
+        const float *b = packed_b + (size_t)j * kc;
+
+        for (int i = 0; i < mc; i += TYPED_GEMM_MR) {
+            int rows = mc - i < TYPED_GEMM_MR ? mc - i : TYPED_GEMM_MR;
+            const float *a = packed_a + (size_t)i * kc;
+            float *ct = c + (size_t)i * ldc + j;
+
+            if (rows == TYPED_GEMM_MR && cols == TYPED_GEMM_NR) {
+                kernel(kc, a, b, ct, ldc);
+                continue;
+            }
+
+            memset(edge, 0, sizeof(edge));
+            kernel(kc, a, b, edge, TYPED_GEMM_NR);
+            for (int r = 0; r < rows; r++) {
+                for (int s = 0; s < cols; s++) {
+                    ct[(size_t)r * ldc + s] += edge[r * TYPED_GEMM_NR + s];
+                }
+            }
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Storage conversions
+// ---------------------------------------------------------------------------
+
+static inline uint32_t float_bits(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static inline float bits_float(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+static inline float load_bf16(bf16_t x) {
+    return bits_float((uint32_t)x << 16);
+}
+
+// Round to nearest-even on the 16 dropped bits; NaNs stay quiet NaNs
+static inline bf16_t store_bf16(float x) {
+    uint32_t u = float_bits(x);
+    uint32_t nan = u >> 16 | 0x40u;
+    uint32_t rounded = (u + 0x7fffu + (u >> 16 & 1u)) >> 16;
+    return (bf16_t)((u & 0x7fffffffu) > 0x7f800000u ? nan : rounded);
+}
+
+// Branch-free binary16 conversions (selects are done with masks) so the row
+// kernels vectorize. Subnormals are renormalized, and rounded on the way
+// back, by a float add against a magic constant, which relies on the
+// default round-to-nearest-even mode.
+static inline uint32_t select_mask(int condition) {
+    return (uint32_t)0 - (uint32_t)(condition != 0);
+}
+
+static inline float load_f16(f16_t h) {
+    const uint32_t shifted_exponent = 0x7c00u << 13;
+    uint32_t u = (uint32_t)(h & 0x7fffu) << 13;
+    uint32_t exponent = u & shifted_exponent;
+
+    u += (127u - 15u) << 23;
+    uint32_t special = u + ((128u - 16u) << 23);
+    uint32_t subnormal =
+        float_bits(bits_float(u + (1u << 23)) - bits_float(113u << 23));
+
+    uint32_t is_special = select_mask(exponent == shifted_exponent);
+    uint32_t is_subnormal = select_mask(exponent == 0);
+    uint32_t bits = (special & is_special) | (subnormal & is_subnormal) |
+                    (u & ~(is_special | is_subnormal));
+    return bits_float(bits | (uint32_t)(h & 0x8000u) << 16);
+}
+
+static inline f16_t store_f16(float x) {
+    const uint32_t infinity = 255u << 23;
+    const uint32_t overflow = (127u + 16u) << 23;
+    const uint32_t smallest_normal = 113u << 23;
+    const uint32_t denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t u = float_bits(x);
+    uint32_t sign = u >> 16 & 0x8000u;
+    u &= 0x7fffffffu;
+
+    // Infinity, NaN (kept quiet) or too large for a finite half
+    uint32_t special = 0x7c00u | (select_mask(u > infinity) & 0x200u);
+    uint32_t subnormal =
+        float_bits(bits_float(u) + bits_float(denorm_magic)) - denorm_magic;
+    uint32_t normal =
+        (u + ((uint32_t)(15 - 127) << 23) + 0xfffu + (u >> 13 & 1u)) >> 13;
+
+    uint32_t is_special = select_mask(u >= overflow);
+    uint32_t is_subnormal = select_mask(u < smallest_normal);
+    uint32_t h = (special & is_special) | (subnormal & is_subnormal) |
+                 (normal & ~(is_special | is_subnormal));
+    return (f16_t)(h | sign);
+}
+
+float bf16_to_float(bf16_t x) { return load_bf16(x); }
+
+bf16_t float_to_bf16(float x) { return store_bf16(x); }
+
+float f16_to_float(f16_t x) { return load_f16(x); }
+
+f16_t float_to_f16(float x) { return store_f16(x); }
+
+// ---------------------------------------------------------------------------
+// Instantiations
+// ---------------------------------------------------------------------------
+
+#define TYPED_NAME F32
+#define TYPED_PREFIX f32
+#define TYPED_ELEM float
+#define TYPED_LOAD(x) (x)
+#define TYPED_STORE(x) (x)
+#include "typed_math_impl.h"
+#undef TYPED_NAME
+#undef TYPED_PREFIX
+#undef TYPED_ELEM
+#undef TYPED_LOAD
+#undef TYPED_STORE
+
+#define TYPED_NAME BF16
+#define TYPED_PREFIX bf16
+#define TYPED_ELEM bf16_t
+#define TYPED_LOAD(x) load_bf16(x)
+#define TYPED_STORE(x) store_bf16(x)
+#include "typed_math_impl.h"
+#undef TYPED_NAME
+#undef TYPED_PREFIX
+#undef TYPED_ELEM
+#undef TYPED_LOAD
+#undef TYPED_STORE
+
+#define TYPED_NAME F16
+#define TYPED_PREFIX f16
+#define TYPED_ELEM f16_t
+#define TYPED_LOAD(x) load_f16(x)
+#define TYPED_STORE(x) store_f16(x)
+#include "typed_math_impl.h"
+#undef TYPED_NAME
+#undef TYPED_PREFIX
+#undef TYPED_ELEM
+#undef TYPED_LOAD
+#undef TYPED_STORE
\ No newline at end of file
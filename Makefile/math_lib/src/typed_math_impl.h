@@ -0,0 +1,603 @@
+// Implementation of one element type of typed_math.h
+// Included by typed_math.c with the TYPED_* type parameters plus
+// TYPED_LOAD(x) (storage -> float) and TYPED_STORE(x) (float -> storage)
+// defined; there is deliberately no include guard.
+
+#define TYPED_KERNELS TYPED_CAT(TYPED_NAME, Kernels)
+#define TYPED_TASK TYPED_CAT(TYPED_NAME, Task)
+#define TYPED_FN(name) TYPED_CAT(TYPED_PREFIX, _##name)
+
+typedef struct {
+    void (*add)(const TYPED_ELEM *a, const TYPED_ELEM *b, TYPED_ELEM *out,
+                size_t n);
+    void (*subtract)(const TYPED_ELEM *a, const TYPED_ELEM *b,
+                     TYPED_ELEM *out, size_t n);
+    void (*scale)(const TYPED_ELEM *a, float scalar, TYPED_ELEM *out,
+                  size_t n);
+    void (*axpy)(float alpha, const TYPED_ELEM *x, TYPED_ELEM *y, size_t n);
+    float (*dot)(const TYPED_ELEM *a, const TYPED_ELEM *b, size_t n);
+} TYPED_KERNELS;
+
+#define TYPED_ISA generic
+#define TYPED_TARGET
+#include "typed_math_kernels.h"
+#undef TYPED_ISA
+#undef TYPED_TARGET
+
+#if TYPED_MATH_X86
+#define TYPED_ISA avx2
+#define TYPED_TARGET __attribute__((target("avx2,fma")))
+#include "typed_math_kernels.h"
+#undef TYPED_ISA
+#undef TYPED_TARGET
+#endif
+
+static const TYPED_KERNELS *TYPED_FN(kernels)(void) {
+    static _Atomic(const TYPED_KERNELS *) selected = NULL;
+
+    const TYPED_KERNELS *kernels =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernels == NULL) {
+        kernels = &TYPED_FN(kernels_generic);
+#if TYPED_MATH_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernels = &TYPED_FN(kernels_avx2);
+        }
+#endif
+        atomic_store_explicit(&selected, kernels, memory_order_release);
+    }
+
+    return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// Vectors
+// ---------------------------------------------------------------------------
+
+int TYPED_VFN(create)(int size, TYPED_VECTOR *result) {
+    DEBUG_PRINT("Creating typed vector of size %d\n", size);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (size <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    Allocator *allocator = allocator_current();
+    size_t bytes = (size_t)size * sizeof(TYPED_ELEM);
+    result->size = size;
+    result->allocator = allocator;
+    result->data = (TYPED_ELEM *)allocator_alloc(allocator, bytes);
+
+    if (result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    memset(result->data, 0, bytes);
+    return SUCCESS;
+}
+
+void TYPED_VFN(free)(TYPED_VECTOR *v) {
+    DEBUG_PRINT("Freeing typed vector\n");
+
+    if (v != NULL && v->data != NULL) {
+        allocator_free(v->allocator, v->data,
+                       (size_t)v->size * sizeof(TYPED_ELEM));
+        v->data = NULL;
+        v->size = 0;
+    }
+}
+
+int TYPED_VFN(from_double)(const Vector *src, TYPED_VECTOR *dst) {
+    DEBUG_PRINT("Converting vector from double\n");
+
+    if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (src->size != dst->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < src->size; i++) {
+        dst->data[i] = TYPED_STORE((float)src->data[i]);
+    }
+
+    return SUCCESS;
+}
+
+int TYPED_VFN(to_double)(const TYPED_VECTOR *src, Vector *dst) {
+    DEBUG_PRINT("Converting vector to double\n");
+
+    if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (src->size != dst->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < src->size; i++) {
+        dst->data[i] = (double)TYPED_LOAD(src->data[i]);
+    }
+
+    return SUCCESS;
+}
+
+// Both vectors must be created and have the same size
+static int TYPED_FN(check_vectors)(const TYPED_VECTOR *a,
+                                   const TYPED_VECTOR *b) {
+    if (a == NULL || b == NULL || a->data == NULL || b->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (a->size != b->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+int TYPED_VFN(add_into)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                        TYPED_VECTOR *result) {
+    DEBUG_PRINT("Adding typed vectors into result\n");
+
+    int status = TYPED_FN(check_vectors)(v1, v2);
+    if (status == SUCCESS) {
+        status = TYPED_FN(check_vectors)(v1, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    TYPED_FN(kernels)()->add(v1->data, v2->data, result->data,
+                             (size_t)v1->size);
+    return SUCCESS;
+}
+
+int TYPED_VFN(subtract_into)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                             TYPED_VECTOR *result) {
+    DEBUG_PRINT("Subtracting typed vectors into result\n");
+
+    int status = TYPED_FN(check_vectors)(v1, v2);
+    if (status == SUCCESS) {
+        status = TYPED_FN(check_vectors)(v1, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    TYPED_FN(kernels)()->subtract(v1->data, v2->data, result->data,
+                                  (size_t)v1->size);
+    return SUCCESS;
+}
+
+int TYPED_VFN(scale_into)(const TYPED_VECTOR *v, float scalar,
+                          TYPED_VECTOR *result) {
+    DEBUG_PRINT("Scaling typed vector by %f into result\n", scalar);
+
+    int status = TYPED_FN(check_vectors)(v, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    TYPED_FN(kernels)()->scale(v->data, scalar, result->data, (size_t)v->size);
+    return SUCCESS;
+}
+
+int TYPED_VFN(axpy)(float alpha, const TYPED_VECTOR *x, TYPED_VECTOR *y) {
+    DEBUG_PRINT("Computing typed y += %f * x\n", alpha);
+
+    int status = TYPED_FN(check_vectors)(x, y);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    TYPED_FN(kernels)()->axpy(alpha, x->data, y->data, (size_t)x->size);
+    return SUCCESS;
+}
+
+int TYPED_VFN(dot_product)(const TYPED_VECTOR *v1, const TYPED_VECTOR *v2,
+                           float *result) {
+    DEBUG_PRINT("Calculating typed dot product\n");
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = TYPED_FN(check_vectors)(v1, v2);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    *result = TYPED_FN(kernels)()->dot(v1->data, v2->data, (size_t)v1->size);
+    return SUCCESS;
+}
+
+// ---------------------------------------------------------------------------
+// Matrices
+// ---------------------------------------------------------------------------
+
+int TYPED_MFN(create)(int rows, int cols, TYPED_MATRIX *result) {
+    DEBUG_PRINT("Creating %dx%d typed matrix\n", rows, cols);
+
+    if (result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (rows <= 0 || cols <= 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    const int per_line = MATRIX_ALIGNMENT / (int)sizeof(TYPED_ELEM);
+    int stride = (cols + per_line - 1) / per_line * per_line;
+    if ((size_t)rows > SIZE_MAX / sizeof(TYPED_ELEM) / (size_t)stride) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    Allocator *allocator = allocator_current();
+    size_t bytes = (size_t)rows * (size_t)stride * sizeof(TYPED_ELEM);
+    TYPED_ELEM *buffer = (TYPED_ELEM *)allocator_alloc(allocator, bytes);
+    if (buffer == NULL) {
+        result->data = NULL;
+        return ERROR_NULL_POINTER;
+    }
+
+    result->rows = rows;
+    result->cols = cols;
+    result->stride = stride;
+    result->data = buffer;
+    result->allocator = allocator;
+
+    memset(result->data, 0, bytes);
+    return SUCCESS;
+}
+
+void TYPED_MFN(free)(TYPED_MATRIX *m) {
+    DEBUG_PRINT("Freeing typed matrix\n");
+
+    if (m == NULL || m->data == NULL) {
+        return;
+    }
+
+    allocator_free(m->allocator, m->data,
+                   (size_t)m->rows * (size_t)m->stride * sizeof(TYPED_ELEM));
+    m->data = NULL;
+    m->rows = 0;
+    m->cols = 0;
+    m->stride = 0;
+}
+
+int TYPED_MFN(from_double)(const Matrix *src, TYPED_MATRIX *dst) {
+    DEBUG_PRINT("Converting matrix from double\n");
+
+    if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (src->rows != dst->rows || src->cols != dst->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < src->rows; i++) {
+        TYPED_ELEM *row = TYPED_ROW(dst, i);
+        for (int j = 0; j < src->cols; j++) {
+            row[j] = TYPED_STORE((float)MATRIX_ELEM(src, i, j));
+        }
+    }
+
+    return SUCCESS;
+}
+
+int TYPED_MFN(to_double)(const TYPED_MATRIX *src, Matrix *dst) {
+    DEBUG_PRINT("Converting matrix to double\n");
+
+    if (src == NULL || dst == NULL || src->data == NULL || dst->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (src->rows != dst->rows || src->cols != dst->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    matrix_mark_modified(dst);
+    for (int i = 0; i < src->rows; i++) {
+        const TYPED_ELEM *row = TYPED_ROW(src, i);
+        for (int j = 0; j < src->cols; j++) {
+            MATRIX_ELEM(dst, i, j) = (double)TYPED_LOAD(row[j]);
+        }
+    }
+
+    return SUCCESS;
+}
+
+// Row-parallel driver shared by the matrix operations
+typedef struct {
+    TypedOp op;
+    const TYPED_KERNELS *kernels;
+    const TYPED_MATRIX *a;
+    const TYPED_MATRIX *b;
+    TYPED_MATRIX *c;
+    const TYPED_ELEM *x;
+    TYPED_ELEM *y;
+    float alpha;
+    float beta;
+    atomic_int *status;
+    const float *packed_b;  // GEMM: B columns [jc, jc + nc), all depths
+    int jc;
+    int nc;
+} TYPED_TASK;
+
+// Pack an mc x kc block of A, widened to float and scaled by alpha, into
+// MR-row slivers with the last sliver zero-padded
+static void TYPED_FN(pack_a)(int mc, int kc, const TYPED_MATRIX *a, int row,
+                             int col, float alpha, float *packed) {
+    for (int i = 0; i < mc; i += TYPED_GEMM_MR) {
+        int rows = mc - i < TYPED_GEMM_MR ? mc - i : TYPED_GEMM_MR;
+        for (int p = 0; p < kc; p++) {
+            for (int r = 0; r < rows; r++) {
+                packed[r] =
+                    alpha * TYPED_LOAD(TYPED_ROW(a, row + i + r)[col + p]);
+            }
+            for (int r = rows; r < TYPED_GEMM_MR; r++) {
+                packed[r] = 0.0f;
+            }
+            packed += TYPED_GEMM_MR;
+        }
+    }
+}
+
+// Pack a kc x nc block of B, widened to float, into NR-column slivers
+static void TYPED_FN(pack_b)(int kc, int nc, const TYPED_MATRIX *b, int row,
+                             int col, float *packed) {
+    for (int j = 0; j < nc; j += TYPED_GEMM_NR) {
+        int cols = nc - j < TYPED_GEMM_NR ? nc - j : TYPED_GEMM_NR;
+        for (int p = 0; p < kc; p++) {
+            const TYPED_ELEM *src = TYPED_ROW(b, row + p) + col + j;
+            for (int c = 0; c < cols; c++) {
+                packed[c] = TYPED_LOAD(src[c]);
+            }
+            for (int c = cols; c < TYPED_GEMM_NR; c++) {
+                packed[c] = 0.0f;
+            }
+            packed += TYPED_GEMM_NR;
+        }
+    }
+}
+
+// Pack B columns [jc, jc + nc) for every depth panel, one panel after
+// another, so the row tasks of a column block share one conversion of B
+static void TYPED_FN(pack_b_panels)(const TYPED_MATRIX *b, int jc, int nc,
+                                    float *packed) {
+    const int k = b->rows;
+    size_t panel =
+        (size_t)(nc + TYPED_GEMM_NR - 1) / TYPED_GEMM_NR * TYPED_GEMM_NR;
+
+    for (int pc = 0; pc < k; pc += TYPED_GEMM_KC) {
+        int kc = k - pc < TYPED_GEMM_KC ? k - pc : TYPED_GEMM_KC;
+        TYPED_FN(pack_b)(kc, nc, b, pc, jc, packed + (size_t)pc * panel);
+    }
+}
+
+// C rows [begin, end), columns [jc, jc + nc) = alpha * A * B + beta * C
+// with B already packed by the caller
+static int TYPED_FN(gemm_rows)(const TYPED_TASK *task, int begin, int end) {
+    const TYPED_MATRIX *a = task->a;
+    TYPED_MATRIX *c = task->c;
+    const int k = a->cols;
+    const int jc = task->jc;
+    const int nc = task->nc;
+    size_t panel =
+        (size_t)(nc + TYPED_GEMM_NR - 1) / TYPED_GEMM_NR * TYPED_GEMM_NR;
+
+    int kc_max = k < TYPED_GEMM_KC ? k : TYPED_GEMM_KC;
+    size_t a_size = (size_t)(TYPED_GEMM_MC + TYPED_GEMM_MR - 1) /
+                    TYPED_GEMM_MR * TYPED_GEMM_MR * (size_t)kc_max;
+    size_t c_size = (size_t)TYPED_GEMM_MC * (size_t)nc;
+
+    void *buffer = NULL;
+    if (posix_memalign(&buffer, MATRIX_ALIGNMENT,
+                       (a_size + c_size) * sizeof(float)) != 0) {
+        return ERROR_NULL_POINTER;
+    }
+    float *packed_a = (float *)buffer;
+    float *acc = packed_a + a_size;
+
+    TypedMicroKernel kernel = typed_select_micro_kernel();
+
+    for (int ic = begin; ic < end; ic += TYPED_GEMM_MC) {
+        int mc = end - ic < TYPED_GEMM_MC ? end - ic : TYPED_GEMM_MC;
+        memset(acc, 0, (size_t)mc * (size_t)nc * sizeof(float));
+
+        for (int pc = 0; pc < k; pc += TYPED_GEMM_KC) {
+            int kc = k - pc < TYPED_GEMM_KC ? k - pc : TYPED_GEMM_KC;
+            TYPED_FN(pack_a)(mc, kc, a, ic, pc, task->alpha, packed_a);
+            typed_macro_kernel(kernel, mc, nc, kc, packed_a,
+                               task->packed_b + (size_t)pc * panel, acc, nc);
+        }
+
+        // beta == 0 overwrites C, as in matrix_multiply_into
+        for (int r = 0; r < mc; r++) {
+            TYPED_ELEM *cr = TYPED_ROW(c, ic + r) + jc;
+            const float *acc_r = acc + (size_t)r * nc;
+            for (int j = 0; j < nc; j++) {
+                float prior = task->beta == 0.0f
+                                  ? 0.0f
+                                  : task->beta * TYPED_LOAD(cr[j]);
+                cr[j] = TYPED_STORE(acc_r[j] + prior);
+            }
+        }
+    }
+
+    free(buffer);
+    return SUCCESS;
+}
+
+static void TYPED_FN(task)(void *ctx, int begin, int end) {
+    const TYPED_TASK *task = (const TYPED_TASK *)ctx;
+    const TYPED_KERNELS *kernels = task->kernels;
+    const TYPED_MATRIX *a = task->a;
+    const size_t cols = (size_t)a->cols;
+
+    if (task->op == TYPED_OP_GEMM) {
+        if (TYPED_FN(gemm_rows)(task, begin, end) != SUCCESS) {
+            atomic_store(task->status, ERROR_NULL_POINTER);
+        }
+        return;
+    }
+
+    for (int i = begin; i < end; i++) {
+        switch (task->op) {
+            case TYPED_OP_ADD:
+                kernels->add(TYPED_ROW(a, i), TYPED_ROW(task->b, i),
+                             TYPED_ROW(task->c, i), cols);
+                break;
+            case TYPED_OP_SUBTRACT:
+                kernels->subtract(TYPED_ROW(a, i), TYPED_ROW(task->b, i),
+                                  TYPED_ROW(task->c, i), cols);
+                break;
+            case TYPED_OP_SCALE:
+                kernels->scale(TYPED_ROW(a, i), task->alpha,
+                               TYPED_ROW(task->c, i), cols);
+                break;
+            case TYPED_OP_GEMV:
+                task->y[i] =
+                    TYPED_STORE(kernels->dot(TYPED_ROW(a, i), task->x, cols));
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Both matrices must be created and have the same shape
+static int TYPED_FN(check_matrices)(const TYPED_MATRIX *a,
+                                    const TYPED_MATRIX *b) {
+    if (a == NULL || b == NULL || a->data == NULL || b->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (a->rows != b->rows || a->cols != b->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+static int TYPED_FN(elementwise)(TypedOp op, const TYPED_MATRIX *m1,
+                                 const TYPED_MATRIX *m2, float scalar,
+                                 TYPED_MATRIX *result) {
+    int status = TYPED_FN(check_matrices)(m1, m2);
+    if (status == SUCCESS) {
+        status = TYPED_FN(check_matrices)(m1, result);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    TYPED_TASK task = {op,   TYPED_FN(kernels)(), m1,     m2,   result,
+                       NULL, NULL,                scalar, 0.0f, NULL,
+                       NULL, 0,                   0};
+    parallel_for(0, m1->rows, parallel_grain((size_t)m1->cols), TYPED_FN(task),
+                 &task);
+    return SUCCESS;
+}
+
+int TYPED_MFN(add_into)(const TYPED_MATRIX *m1, const TYPED_MATRIX *m2,
+                        TYPED_MATRIX *result) {
+    DEBUG_PRINT("Adding typed matrices into result\n");
+    return TYPED_FN(elementwise)(TYPED_OP_ADD, m1, m2, 0.0f, result);
+}
+
+int TYPED_MFN(subtract_into)(const TYPED_MATRIX *m1, const TYPED_MATRIX *m2,
+                             TYPED_MATRIX *result) {
+    DEBUG_PRINT("Subtracting typed matrices into result\n");
+    return TYPED_FN(elementwise)(TYPED_OP_SUBTRACT, m1, m2, 0.0f, result);
+}
+
+int TYPED_MFN(scale_into)(const TYPED_MATRIX *m, float scalar,
+                          TYPED_MATRIX *result) {
+    DEBUG_PRINT("Scaling typed matrix by %f into result\n", scalar);
+    return TYPED_FN(elementwise)(TYPED_OP_SCALE, m, m, scalar, result);
+}
+
+int TYPED_MFN(multiply_into)(float alpha, const TYPED_MATRIX *m1,
+                             const TYPED_MATRIX *m2, float beta,
+                             TYPED_MATRIX *result) {
+    DEBUG_PRINT("Multiplying typed matrices into result\n");
+
+    if (m1 == NULL || m2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->data == NULL || m2->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m1->cols != m2->rows || result->rows != m1->rows ||
+        result->cols != m2->cols) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    // B is widened and packed once per column block, before the row
+    // split, so every task reads the same panels
+    const int n = m2->cols;
+    const int nc_max = n < TYPED_GEMM_NC ? n : TYPED_GEMM_NC;
+    size_t panel_size = (size_t)(nc_max + TYPED_GEMM_NR - 1) / TYPED_GEMM_NR *
+                        TYPED_GEMM_NR * (size_t)m2->rows;
+    void *packed_b = NULL;
+    if (posix_memalign(&packed_b, MATRIX_ALIGNMENT,
+                       panel_size * sizeof(float)) != 0) {
+        return ERROR_NULL_POINTER;
+    }
+
+    atomic_int status = SUCCESS;
+    TYPED_TASK task = {TYPED_OP_GEMM, TYPED_FN(kernels)(), m1,    m2,
+                       result,        NULL,                NULL,  alpha,
+                       beta,          &status,             packed_b,
+                       0,             0};
+    int grain = parallel_grain((size_t)m1->cols * (size_t)nc_max);
+    for (int jc = 0; jc < n; jc += TYPED_GEMM_NC) {
+        task.jc = jc;
+        task.nc = n - jc < TYPED_GEMM_NC ? n - jc : TYPED_GEMM_NC;
+        TYPED_FN(pack_b_panels)(m2, jc, task.nc, (float *)packed_b);
+        parallel_for(0, m1->rows,
+                     grain < TYPED_GEMM_MR ? TYPED_GEMM_MR : grain,
+                     TYPED_FN(task), &task);
+    }
+
+    free(packed_b);
+    return atomic_load(&status);
+}
+
+int TYPED_MFN(vector_multiply_into)(const TYPED_MATRIX *m,
+                                    const TYPED_VECTOR *v,
+                                    TYPED_VECTOR *result) {
+    DEBUG_PRINT("Multiplying typed matrix by vector into result\n");
+
+    if (m == NULL || v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->data == NULL || v->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (m->cols != v->size || result->size != m->rows) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    TYPED_TASK task = {TYPED_OP_GEMV, TYPED_FN(kernels)(), m,    NULL, NULL,
+                       v->data,       result->data,        0.0f, 0.0f, NULL,
+                       NULL,          0,                   0};
+    parallel_for(0, m->rows, parallel_grain((size_t)m->cols), TYPED_FN(task),
+                 &task);
+    return SUCCESS;
+}
+
+#undef TYPED_KERNELS
+#undef TYPED_TASK
+#undef TYPED_FN
\ No newline at end of file
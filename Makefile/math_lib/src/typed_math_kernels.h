@@ -0,0 +1,70 @@
+// Row kernels for one element type and one instruction set
+// Included by typed_math_impl.h with TYPED_ISA (name suffix) and
+// TYPED_TARGET (function attributes) defined on top of the element type
+// parameters. Loops are written so the compiler can vectorize them for
+// the selected target; reductions keep 16 independent float lanes.
+
+#define TYPED_K(op) TYPED_CAT(TYPED_CAT(TYPED_PREFIX, _##op##_), TYPED_ISA)
+
+TYPED_TARGET static void TYPED_K(add)(const TYPED_ELEM *a,
+                                      const TYPED_ELEM *b, TYPED_ELEM *out,
+                                      size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = TYPED_STORE(TYPED_LOAD(a[i]) + TYPED_LOAD(b[i]));
+    }
+}
+
+TYPED_TARGET static void TYPED_K(subtract)(const TYPED_ELEM *a,
+                                           const TYPED_ELEM *b,
+                                           TYPED_ELEM *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = TYPED_STORE(TYPED_LOAD(a[i]) - TYPED_LOAD(b[i]));
+    }
+}
+
+TYPED_TARGET static void TYPED_K(scale)(const TYPED_ELEM *a, float scalar,
+                                        TYPED_ELEM *out, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = TYPED_STORE(TYPED_LOAD(a[i]) * scalar);
+    }
+}
+
+TYPED_TARGET static void TYPED_K(axpy)(float alpha, const TYPED_ELEM *x,
+                                       TYPED_ELEM *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] = TYPED_STORE(TYPED_LOAD(y[i]) + alpha * TYPED_LOAD(x[i]));
+    }
+}
+
+TYPED_TARGET static float TYPED_K(dot)(const TYPED_ELEM *a,
+                                       const TYPED_ELEM *b, size_t n) {
+    float lanes[16] = {0.0f};
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        for (int l = 0; l < 16; l++) {
+            lanes[l] += TYPED_LOAD(a[i + l]) * TYPED_LOAD(b[i + l]);
+        }
+    }
+    for (; i < n; i++) {
+        lanes[0] += TYPED_LOAD(a[i]) * TYPED_LOAD(b[i]);
+    }
+
+    for (int width = 8; width > 0; width /= 2) {
+        for (int l = 0; l < width; l++) {
+            lanes[l] += lanes[l + width];
+        }
+    }
+    return lanes[0];
+}
+
+static const TYPED_KERNELS TYPED_CAT(TYPED_CAT(TYPED_PREFIX, _kernels_),
+                                     TYPED_ISA) = {
+    .add = TYPED_K(add),
+    .subtract = TYPED_K(subtract),
+    .scale = TYPED_K(scale),
+    .axpy = TYPED_K(axpy),
+    .dot = TYPED_K(dot),
+};
+
+#undef TYPED_K
\ No newline at end of file
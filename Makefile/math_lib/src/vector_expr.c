@@ -0,0 +1,447 @@
+#include "../include/vector_expr.h"
+
+#include <string.h>
+
+#include "../include/thread_pool.h"
+#include "../include/vector_kernels.h"
+
+// Elements per evaluation block; every live node gets one block of scratch
+// (at most 16 x 256 doubles = 32 KB), so a block stays in L1 while the
+// whole expression runs over it
+#define VECTOR_EXPR_BLOCK 256
+
+// Reductions keep one partial per block and add them in block order, so
+// the result does not depend on how blocks were spread over threads. Up
+// to this many partials live on the stack.
+#define VECTOR_EXPR_STACK_PARTIALS 64
+
+void vector_expr_init(VectorExpr *e) {
+    DEBUG_PRINT("Initializing vector expression\n");
+
+    if (e == NULL) {
+        return;
+    }
+
+    e->size = 0;
+    e->count = 0;
+}
+
+static int vector_expr_push(VectorExpr *e, VectorExprOp op, int a, int b,
+                            double scalar, const double *data) {
+    if (e->count == VECTOR_EXPR_MAX_NODES) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    VectorExprNode *node = &e->nodes[e->count];
+    node->op = op;
+    node->a = a;
+    node->b = b;
+    node->scalar = scalar;
+    node->data = data;
+    return e->count++;
+}
+
+// An operand must be an existing node; errors from nested calls pass
+// through unchanged
+static int vector_expr_check(const VectorExpr *e, int node) {
+    if (node < 0) {
+        return node;
+    }
+
+    if (node >= e->count) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+// The node list as a whole, before evaluation: the builders only produce
+// valid lists, but the struct is public and a hand-built or corrupted one
+// must not index outside it
+static int vector_expr_check_nodes(const VectorExpr *e) {
+    if (e->count < 0 || e->count > VECTOR_EXPR_MAX_NODES || e->size < 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    for (int i = 0; i < e->count; i++) {
+        const VectorExprNode *node = &e->nodes[i];
+        int operands;
+        switch (node->op) {
+            case VECTOR_EXPR_INPUT:
+                if (node->data == NULL) {
+                    return ERROR_NULL_POINTER;
+                }
+                operands = 0;
+                break;
+            case VECTOR_EXPR_CONSTANT:
+                operands = 0;
+                break;
+            case VECTOR_EXPR_SCALE:
+                operands = 1;
+                break;
+            case VECTOR_EXPR_ADD:
+            case VECTOR_EXPR_SUBTRACT:
+            case VECTOR_EXPR_MULTIPLY:
+            case VECTOR_EXPR_DIVIDE:
+                operands = 2;
+                break;
+            default:
+                return ERROR_INVALID_DIMENSION;
+        }
+
+        // Operands precede their users; unused ones are -1
+        if ((operands >= 1 ? node->a < 0 || node->a >= i : node->a != -1) ||
+            (operands >= 2 ? node->b < 0 || node->b >= i : node->b != -1)) {
+            return ERROR_INVALID_DIMENSION;
+        }
+    }
+
+    return SUCCESS;
+}
+
+int vector_expr_input(VectorExpr *e, const Vector *v) {
+    DEBUG_PRINT("Adding vector expression input\n");
+
+    if (e == NULL || v == NULL || v->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (e->size != 0 && v->size != e->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int node = vector_expr_push(e, VECTOR_EXPR_INPUT, -1, -1, 0.0, v->data);
+    if (node >= 0) {
+        e->size = v->size;
+    }
+
+    return node;
+}
+
+int vector_expr_constant(VectorExpr *e, double value) {
+    DEBUG_PRINT("Adding vector expression constant %f\n", value);
+
+    if (e == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    return vector_expr_push(e, VECTOR_EXPR_CONSTANT, -1, -1, value, NULL);
+}
+
+static int vector_expr_binary(VectorExpr *e, VectorExprOp op, int a, int b) {
+    if (e == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_expr_check(e, a);
+    if (status == SUCCESS) {
+        status = vector_expr_check(e, b);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return vector_expr_push(e, op, a, b, 0.0, NULL);
+}
+
+int vector_expr_add(VectorExpr *e, int a, int b) {
+    DEBUG_PRINT("Adding vector expression sum\n");
+    return vector_expr_binary(e, VECTOR_EXPR_ADD, a, b);
+}
+
+int vector_expr_subtract(VectorExpr *e, int a, int b) {
+    DEBUG_PRINT("Adding vector expression difference\n");
+    return vector_expr_binary(e, VECTOR_EXPR_SUBTRACT, a, b);
+}
+
+int vector_expr_multiply(VectorExpr *e, int a, int b) {
+    DEBUG_PRINT("Adding vector expression product\n");
+    return vector_expr_binary(e, VECTOR_EXPR_MULTIPLY, a, b);
+}
+
+int vector_expr_divide(VectorExpr *e, int a, int b) {
+    DEBUG_PRINT("Adding vector expression quotient\n");
+    return vector_expr_binary(e, VECTOR_EXPR_DIVIDE, a, b);
+}
+
+int vector_expr_scale(VectorExpr *e, int a, double scalar) {
+    DEBUG_PRINT("Adding vector expression scale by %f\n", scalar);
+
+    if (e == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_expr_check(e, a);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    return vector_expr_push(e, VECTOR_EXPR_SCALE, a, -1, scalar, NULL);
+}
+
+// ---------------------------------------------------------------------------
+// Evaluation
+// ---------------------------------------------------------------------------
+
+typedef enum {
+    EXPR_MODE_STORE,
+    EXPR_MODE_SUM,
+    EXPR_MODE_DOT,
+} ExprMode;
+
+typedef struct {
+    const VectorExpr *e;
+    const VectorKernels *kernels;
+    ExprMode mode;
+    int a;
+    int b;
+    // Bit i set when node i contributes to the result
+    unsigned live;
+    int size;
+    double *out;
+    double *partials;
+} ExprTask;
+
+// Nodes reachable from the roots; operands always precede their users, so
+// one backward sweep is enough
+static unsigned expr_live_nodes(const VectorExpr *e, int a, int b) {
+    unsigned live = 1u << a;
+    if (b >= 0) {
+        live |= 1u << b;
+    }
+
+    for (int i = e->count - 1; i >= 0; i--) {
+        const VectorExprNode *node = &e->nodes[i];
+        if ((live >> i & 1u) == 0) {
+            continue;
+        }
+        if (node->a >= 0) {
+            live |= 1u << node->a;
+        }
+        if (node->b >= 0) {
+            live |= 1u << node->b;
+        }
+    }
+
+    return live;
+}
+
+// Run every live node over elements [begin, begin + len). Node root writes
+// to root_out when that is not NULL. values[i] is left pointing at the
+// block of node i.
+static void expr_eval_block(const ExprTask *task, int begin, int len,
+                            int root, double *root_out,
+                            double scratch[][VECTOR_EXPR_BLOCK],
+                            const double **values) {
+    const VectorExpr *e = task->e;
+    const VectorKernels *k = task->kernels;
+    size_t n = (size_t)len;
+
+    for (int i = 0; i < e->count; i++) {
+        if ((task->live >> i & 1u) == 0) {
+            continue;
+        }
+
+        const VectorExprNode *node = &e->nodes[i];
+        if (node->op == VECTOR_EXPR_INPUT && (i != root || root_out == NULL)) {
+            values[i] = node->data + begin;
+            continue;
+        }
+
+        double *out = i == root && root_out != NULL ? root_out : scratch[i];
+        const double *x = node->a >= 0 ? values[node->a] : NULL;
+        const double *y = node->b >= 0 ? values[node->b] : NULL;
+
+        switch (node->op) {
+            case VECTOR_EXPR_INPUT:
+                if (out != node->data + begin) {
+                    memcpy(out, node->data + begin, n * sizeof(double));
+                }
+                break;
+            case VECTOR_EXPR_CONSTANT:
+                for (size_t j = 0; j < n; j++) {
+                    out[j] = node->scalar;
+                }
+                break;
+            case VECTOR_EXPR_ADD:
+                k->add(x, y, out, n);
+                break;
+            case VECTOR_EXPR_SUBTRACT:
+                k->subtract(x, y, out, n);
+                break;
+            case VECTOR_EXPR_MULTIPLY:
+                for (size_t j = 0; j < n; j++) {
+                    out[j] = x[j] * y[j];
+                }
+                break;
+            case VECTOR_EXPR_DIVIDE:
+                for (size_t j = 0; j < n; j++) {
+                    out[j] = x[j] / y[j];
+                }
+                break;
+            case VECTOR_EXPR_SCALE:
+                k->scale(x, node->scalar, out, n);
+                break;
+        }
+        values[i] = out;
+    }
+}
+
+// Four independent accumulators, as in the scalar dot kernel
+static double expr_block_sum(const double *x, int len) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    int k = 0;
+
+    for (; k + 4 <= len; k += 4) {
+        s0 += x[k];
+        s1 += x[k + 1];
+        s2 += x[k + 2];
+        s3 += x[k + 3];
+    }
+    for (; k < len; k++) {
+        s0 += x[k];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+// Body of the parallel loop over blocks [begin, end)
+static void expr_task(void *ctx, int begin, int end) {
+    const ExprTask *task = (const ExprTask *)ctx;
+    double scratch[VECTOR_EXPR_MAX_NODES][VECTOR_EXPR_BLOCK];
+    const double *values[VECTOR_EXPR_MAX_NODES];
+
+    for (int block = begin; block < end; block++) {
+        int first = block * VECTOR_EXPR_BLOCK;
+        int len = task->size - first < VECTOR_EXPR_BLOCK ? task->size - first
+                                                         : VECTOR_EXPR_BLOCK;
+
+        if (task->mode == EXPR_MODE_STORE) {
+            expr_eval_block(task, first, len, task->a, task->out + first,
+                            scratch, values);
+            continue;
+        }
+
+        expr_eval_block(task, first, len, -1, NULL, scratch, values);
+        task->partials[block] =
+            task->mode == EXPR_MODE_DOT
+                ? task->kernels->dot(values[task->a], values[task->b],
+                                     (size_t)len)
+                : expr_block_sum(values[task->a], len);
+    }
+}
+
+static int expr_run(ExprTask *task) {
+    int blocks = (task->size + VECTOR_EXPR_BLOCK - 1) / VECTOR_EXPR_BLOCK;
+    int live = __builtin_popcount(task->live);
+    int grain = parallel_grain((size_t)VECTOR_EXPR_BLOCK * (size_t)live);
+
+    if (task->mode == EXPR_MODE_STORE) {
+        parallel_for(0, blocks, grain, expr_task, task);
+        return SUCCESS;
+    }
+
+    double local[VECTOR_EXPR_STACK_PARTIALS];
+    double *partials = local;
+    if (blocks > VECTOR_EXPR_STACK_PARTIALS) {
+        partials = (double *)malloc((size_t)blocks * sizeof(double));
+        if (partials == NULL) {
+            return ERROR_NULL_POINTER;
+        }
+    }
+
+    task->partials = partials;
+    parallel_for(0, blocks, grain, expr_task, task);
+
+    double sum = 0.0;
+    for (int i = 0; i < blocks; i++) {
+        sum += partials[i];
+    }
+    *task->out = sum;
+
+    if (partials != local) {
+        free(partials);
+    }
+    return SUCCESS;
+}
+
+int vector_expr_eval(const VectorExpr *e, int root, Vector *result) {
+    DEBUG_PRINT("Evaluating vector expression\n");
+
+    if (e == NULL || result == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_expr_check_nodes(e);
+    if (status == SUCCESS) {
+        status = vector_expr_check(e, root);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (e->size != 0 && result->size != e->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    ExprTask task = {e, vector_kernels(),
+                     EXPR_MODE_STORE, root, -1,
+                     expr_live_nodes(e, root, -1),
+                     result->size, result->data, NULL};
+    return expr_run(&task);
+}
+
+int vector_expr_sum(const VectorExpr *e, int root, double *result) {
+    DEBUG_PRINT("Summing vector expression\n");
+
+    if (e == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_expr_check_nodes(e);
+    if (status == SUCCESS) {
+        status = vector_expr_check(e, root);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (e->size == 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    ExprTask task = {e, vector_kernels(),
+                     EXPR_MODE_SUM, root, -1,
+                     expr_live_nodes(e, root, -1),
+                     e->size, result, NULL};
+    return expr_run(&task);
+}
+
+int vector_expr_dot(const VectorExpr *e, int a, int b, double *result) {
+    DEBUG_PRINT("Calculating vector expression dot product\n");
+
+    if (e == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_expr_check_nodes(e);
+    if (status == SUCCESS) {
+        status = vector_expr_check(e, a);
+    }
+    if (status == SUCCESS) {
+        status = vector_expr_check(e, b);
+    }
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (e->size == 0) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    ExprTask task = {e, vector_kernels(),
+                     EXPR_MODE_DOT, a, b,
+                     expr_live_nodes(e, a, b),
+                     e->size, result, NULL};
+    return expr_run(&task);
+}
\ No newline at end of file
@@ -0,0 +1,711 @@
+#include "../include/vector_kernels.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECTOR_KERNELS_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define VECTOR_KERNELS_NEON 1
+#endif
+
+// ---------------------------------------------------------------------------
+// Scalar reference kernels
+// ---------------------------------------------------------------------------
+
+static void scalar_add(const double *a, const double *b, double *out,
+                       size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+static void scalar_subtract(const double *a, const double *b, double *out,
+                            size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = a[i] - b[i];
+    }
+}
+
+static void scalar_scale(const double *a, double scalar, double *out,
+                         size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = a[i] * scalar;
+    }
+}
+
+// Four independent accumulators hide the add latency
+static double scalar_dot(const double *a, const double *b, size_t n) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i] * b[i];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static double scalar_sum_squares(const double *a, size_t n) {
+    return scalar_dot(a, a, n);
+}
+
+static double scalar_sum(const double *a, size_t n) {
+    double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        s0 += a[i];
+        s1 += a[i + 1];
+        s2 += a[i + 2];
+        s3 += a[i + 3];
+    }
+    for (; i < n; i++) {
+        s0 += a[i];
+    }
+
+    return (s0 + s1) + (s2 + s3);
+}
+
+static void scalar_axpy(double alpha, const double *x, double *y, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static const VectorKernels scalar_kernels = {
+    .name = "scalar",
+    .add = scalar_add,
+    .subtract = scalar_subtract,
+    .scale = scalar_scale,
+    .axpy = scalar_axpy,
+    .dot = scalar_dot,
+    .sum_squares = scalar_sum_squares,
+    .sum = scalar_sum,
+};
+
+#ifdef VECTOR_KERNELS_X86
+
+// ---------------------------------------------------------------------------
+// SSE2 kernels (2 doubles per register)
+// ---------------------------------------------------------------------------
+
+__attribute__((target("sse2"))) static void sse2_add(const double *a,
+                                                     const double *b,
+                                                     double *out, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d x0 = _mm_loadu_pd(a + i);
+        __m128d x1 = _mm_loadu_pd(a + i + 2);
+        __m128d y0 = _mm_loadu_pd(b + i);
+        __m128d y1 = _mm_loadu_pd(b + i + 2);
+        _mm_storeu_pd(out + i, _mm_add_pd(x0, y0));
+        _mm_storeu_pd(out + i + 2, _mm_add_pd(x1, y1));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+__attribute__((target("sse2"))) static void sse2_subtract(const double *a,
+                                                          const double *b,
+                                                          double *out,
+                                                          size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d x0 = _mm_loadu_pd(a + i);
+        __m128d x1 = _mm_loadu_pd(a + i + 2);
+        __m128d y0 = _mm_loadu_pd(b + i);
+        __m128d y1 = _mm_loadu_pd(b + i + 2);
+        _mm_storeu_pd(out + i, _mm_sub_pd(x0, y0));
+        _mm_storeu_pd(out + i + 2, _mm_sub_pd(x1, y1));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] - b[i];
+    }
+}
+
+__attribute__((target("sse2"))) static void sse2_scale(const double *a,
+                                                       double scalar,
+                                                       double *out, size_t n) {
+    __m128d s = _mm_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        _mm_storeu_pd(out + i, _mm_mul_pd(_mm_loadu_pd(a + i), s));
+        _mm_storeu_pd(out + i + 2, _mm_mul_pd(_mm_loadu_pd(a + i + 2), s));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] * scalar;
+    }
+}
+
+__attribute__((target("sse2"))) static double sse2_dot(const double *a,
+                                                       const double *b,
+                                                       size_t n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    __m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + i),
+                                       _mm_loadu_pd(b + i)));
+        s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_loadu_pd(a + i + 2),
+                                       _mm_loadu_pd(b + i + 2)));
+        s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_loadu_pd(a + i + 4),
+                                       _mm_loadu_pd(b + i + 4)));
+        s3 = _mm_add_pd(s3, _mm_mul_pd(_mm_loadu_pd(a + i + 6),
+                                       _mm_loadu_pd(b + i + 6)));
+    }
+
+    __m128d s = _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3));
+    double lanes[2];
+    _mm_storeu_pd(lanes, s);
+    double sum = lanes[0] + lanes[1];
+
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
+
+__attribute__((target("sse2"))) static double sse2_sum_squares(const double *a,
+                                                               size_t n) {
+    return sse2_dot(a, a, n);
+}
+
+__attribute__((target("sse2"))) static double sse2_sum(const double *a,
+                                                       size_t n) {
+    __m128d s0 = _mm_setzero_pd(), s1 = _mm_setzero_pd();
+    __m128d s2 = _mm_setzero_pd(), s3 = _mm_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm_add_pd(s0, _mm_loadu_pd(a + i));
+        s1 = _mm_add_pd(s1, _mm_loadu_pd(a + i + 2));
+        s2 = _mm_add_pd(s2, _mm_loadu_pd(a + i + 4));
+        s3 = _mm_add_pd(s3, _mm_loadu_pd(a + i + 6));
+    }
+
+    __m128d s = _mm_add_pd(_mm_add_pd(s0, s1), _mm_add_pd(s2, s3));
+    double lanes[2];
+    _mm_storeu_pd(lanes, s);
+    double sum = lanes[0] + lanes[1];
+
+    for (; i < n; i++) {
+        sum += a[i];
+    }
+
+    return sum;
+}
+
+__attribute__((target("sse2"))) static void sse2_axpy(double alpha,
+                                                      const double *x,
+                                                      double *y, size_t n) {
+    __m128d s = _mm_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d y0 = _mm_add_pd(_mm_loadu_pd(y + i),
+                                _mm_mul_pd(s, _mm_loadu_pd(x + i)));
+        __m128d y1 = _mm_add_pd(_mm_loadu_pd(y + i + 2),
+                                _mm_mul_pd(s, _mm_loadu_pd(x + i + 2)));
+        _mm_storeu_pd(y + i, y0);
+        _mm_storeu_pd(y + i + 2, y1);
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static const VectorKernels sse2_kernels = {
+    .name = "sse2",
+    .add = sse2_add,
+    .subtract = sse2_subtract,
+    .scale = sse2_scale,
+    .axpy = sse2_axpy,
+    .dot = sse2_dot,
+    .sum_squares = sse2_sum_squares,
+    .sum = sse2_sum,
+};
+
+// ---------------------------------------------------------------------------
+// AVX2 + FMA kernels (4 doubles per register)
+// ---------------------------------------------------------------------------
+
+__attribute__((target("avx2,fma"))) static void avx2_add(const double *a,
+                                                         const double *b,
+                                                         double *out,
+                                                         size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d x0 = _mm256_loadu_pd(a + i);
+        __m256d x1 = _mm256_loadu_pd(a + i + 4);
+        __m256d y0 = _mm256_loadu_pd(b + i);
+        __m256d y1 = _mm256_loadu_pd(b + i + 4);
+        _mm256_storeu_pd(out + i, _mm256_add_pd(x0, y0));
+        _mm256_storeu_pd(out + i + 4, _mm256_add_pd(x1, y1));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_subtract(const double *a,
+                                                              const double *b,
+                                                              double *out,
+                                                              size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d x0 = _mm256_loadu_pd(a + i);
+        __m256d x1 = _mm256_loadu_pd(a + i + 4);
+        __m256d y0 = _mm256_loadu_pd(b + i);
+        __m256d y1 = _mm256_loadu_pd(b + i + 4);
+        _mm256_storeu_pd(out + i, _mm256_sub_pd(x0, y0));
+        _mm256_storeu_pd(out + i + 4, _mm256_sub_pd(x1, y1));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] - b[i];
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_scale(const double *a,
+                                                           double scalar,
+                                                           double *out,
+                                                           size_t n) {
+    __m256d s = _mm256_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), s));
+        _mm256_storeu_pd(out + i + 4,
+                         _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), s));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] * scalar;
+    }
+}
+
+__attribute__((target("avx2,fma"))) static double avx2_dot(const double *a,
+                                                           const double *b,
+                                                           size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = _mm256_setzero_pd();
+    __m256d s2 = _mm256_setzero_pd(), s3 = _mm256_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i),
+                             s0);
+        s1 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 4),
+                             _mm256_loadu_pd(b + i + 4), s1);
+        s2 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 8),
+                             _mm256_loadu_pd(b + i + 8), s2);
+        s3 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i + 12),
+                             _mm256_loadu_pd(b + i + 12), s3);
+    }
+    for (; i + 4 <= n; i += 4) {
+        s0 = _mm256_fmadd_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i),
+                             s0);
+    }
+
+    __m256d s = _mm256_add_pd(_mm256_add_pd(s0, s1), _mm256_add_pd(s2, s3));
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(s),
+                           _mm256_extractf128_pd(s, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) static double avx2_sum_squares(
+    const double *a, size_t n) {
+    return avx2_dot(a, a, n);
+}
+
+// Eight accumulators: with one load per add, the adds (two per cycle at
+// four cycles latency) rather than the loads are the limit
+__attribute__((target("avx2,fma"))) static double avx2_sum(const double *a,
+                                                           size_t n) {
+    __m256d s[8];
+    for (int k = 0; k < 8; k++) {
+        s[k] = _mm256_setzero_pd();
+    }
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        for (int k = 0; k < 8; k++) {
+            s[k] = _mm256_add_pd(s[k], _mm256_loadu_pd(a + i + 4 * k));
+        }
+    }
+    for (; i + 4 <= n; i += 4) {
+        s[0] = _mm256_add_pd(s[0], _mm256_loadu_pd(a + i));
+    }
+
+    __m256d t = _mm256_add_pd(
+        _mm256_add_pd(_mm256_add_pd(s[0], s[1]), _mm256_add_pd(s[2], s[3])),
+        _mm256_add_pd(_mm256_add_pd(s[4], s[5]), _mm256_add_pd(s[6], s[7])));
+    __m128d h = _mm_add_pd(_mm256_castpd256_pd128(t),
+                           _mm256_extractf128_pd(t, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(h, _mm_unpackhi_pd(h, h)));
+
+    for (; i < n; i++) {
+        sum += a[i];
+    }
+
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_axpy(double alpha,
+                                                          const double *x,
+                                                          double *y,
+                                                          size_t n) {
+    __m256d s = _mm256_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d y0 = _mm256_fmadd_pd(s, _mm256_loadu_pd(x + i),
+                                     _mm256_loadu_pd(y + i));
+        __m256d y1 = _mm256_fmadd_pd(s, _mm256_loadu_pd(x + i + 4),
+                                     _mm256_loadu_pd(y + i + 4));
+        _mm256_storeu_pd(y + i, y0);
+        _mm256_storeu_pd(y + i + 4, y1);
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static const VectorKernels avx2_kernels = {
+    .name = "avx2",
+    .add = avx2_add,
+    .subtract = avx2_subtract,
+    .scale = avx2_scale,
+    .axpy = avx2_axpy,
+    .dot = avx2_dot,
+    .sum_squares = avx2_sum_squares,
+    .sum = avx2_sum,
+};
+
+// ---------------------------------------------------------------------------
+// AVX-512F kernels (8 doubles per register, masked tails)
+// ---------------------------------------------------------------------------
+
+__attribute__((target("avx512f"))) static void avx512_add(const double *a,
+                                                          const double *b,
+                                                          double *out,
+                                                          size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(out + i, _mm512_add_pd(_mm512_loadu_pd(a + i),
+                                                _mm512_loadu_pd(b + i)));
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        __m512d x = _mm512_maskz_loadu_pd(mask, a + i);
+        __m512d y = _mm512_maskz_loadu_pd(mask, b + i);
+        _mm512_mask_storeu_pd(out + i, mask, _mm512_add_pd(x, y));
+    }
+}
+
+__attribute__((target("avx512f"))) static void avx512_subtract(
+    const double *a, const double *b, double *out, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(out + i, _mm512_sub_pd(_mm512_loadu_pd(a + i),
+                                                _mm512_loadu_pd(b + i)));
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        __m512d x = _mm512_maskz_loadu_pd(mask, a + i);
+        __m512d y = _mm512_maskz_loadu_pd(mask, b + i);
+        _mm512_mask_storeu_pd(out + i, mask, _mm512_sub_pd(x, y));
+    }
+}
+
+__attribute__((target("avx512f"))) static void avx512_scale(const double *a,
+                                                            double scalar,
+                                                            double *out,
+                                                            size_t n) {
+    __m512d s = _mm512_set1_pd(scalar);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(out + i, _mm512_mul_pd(_mm512_loadu_pd(a + i), s));
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        __m512d x = _mm512_maskz_loadu_pd(mask, a + i);
+        _mm512_mask_storeu_pd(out + i, mask, _mm512_mul_pd(x, s));
+    }
+}
+
+__attribute__((target("avx512f"))) static double avx512_dot(const double *a,
+                                                            const double *b,
+                                                            size_t n) {
+    __m512d s0 = _mm512_setzero_pd(), s1 = _mm512_setzero_pd();
+    __m512d s2 = _mm512_setzero_pd(), s3 = _mm512_setzero_pd();
+    size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i),
+                             s0);
+        s1 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 8),
+                             _mm512_loadu_pd(b + i + 8), s1);
+        s2 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 16),
+                             _mm512_loadu_pd(b + i + 16), s2);
+        s3 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i + 24),
+                             _mm512_loadu_pd(b + i + 24), s3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm512_fmadd_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i),
+                             s0);
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        s1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, a + i),
+                             _mm512_maskz_loadu_pd(mask, b + i), s1);
+    }
+
+    __m512d s = _mm512_add_pd(_mm512_add_pd(s0, s1), _mm512_add_pd(s2, s3));
+    return _mm512_reduce_add_pd(s);
+}
+
+__attribute__((target("avx512f"))) static double avx512_sum_squares(
+    const double *a, size_t n) {
+    return avx512_dot(a, a, n);
+}
+
+__attribute__((target("avx512f"))) static double avx512_sum(const double *a,
+                                                            size_t n) {
+    __m512d s[8];
+    for (int k = 0; k < 8; k++) {
+        s[k] = _mm512_setzero_pd();
+    }
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        for (int k = 0; k < 8; k++) {
+            s[k] = _mm512_add_pd(s[k], _mm512_loadu_pd(a + i + 8 * k));
+        }
+    }
+    for (; i + 8 <= n; i += 8) {
+        s[0] = _mm512_add_pd(s[0], _mm512_loadu_pd(a + i));
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        s[1] = _mm512_add_pd(s[1], _mm512_maskz_loadu_pd(mask, a + i));
+    }
+
+    __m512d t = _mm512_add_pd(
+        _mm512_add_pd(_mm512_add_pd(s[0], s[1]), _mm512_add_pd(s[2], s[3])),
+        _mm512_add_pd(_mm512_add_pd(s[4], s[5]), _mm512_add_pd(s[6], s[7])));
+    return _mm512_reduce_add_pd(t);
+}
+
+__attribute__((target("avx512f"))) static void avx512_axpy(double alpha,
+                                                           const double *x,
+                                                           double *y,
+                                                           size_t n) {
+    __m512d s = _mm512_set1_pd(alpha);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_pd(y + i, _mm512_fmadd_pd(s, _mm512_loadu_pd(x + i),
+                                                _mm512_loadu_pd(y + i)));
+    }
+    if (i < n) {
+        __mmask8 mask = (__mmask8)((1u << (n - i)) - 1);
+        __m512d xv = _mm512_maskz_loadu_pd(mask, x + i);
+        __m512d yv = _mm512_maskz_loadu_pd(mask, y + i);
+        _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(s, xv, yv));
+    }
+}
+
+static const VectorKernels avx512_kernels = {
+    .name = "avx512",
+    .add = avx512_add,
+    .subtract = avx512_subtract,
+    .scale = avx512_scale,
+    .axpy = avx512_axpy,
+    .dot = avx512_dot,
+    .sum_squares = avx512_sum_squares,
+    .sum = avx512_sum,
+};
+
+#endif  // VECTOR_KERNELS_X86
+
+#ifdef VECTOR_KERNELS_NEON
+
+// ---------------------------------------------------------------------------
+// NEON kernels (AArch64, 2 doubles per register)
+// ---------------------------------------------------------------------------
+
+static void neon_add(const double *a, const double *b, double *out,
+                     size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f64(out + i, vaddq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+        vst1q_f64(out + i + 2,
+                  vaddq_f64(vld1q_f64(a + i + 2), vld1q_f64(b + i + 2)));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] + b[i];
+    }
+}
+
+static void neon_subtract(const double *a, const double *b, double *out,
+                          size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f64(out + i, vsubq_f64(vld1q_f64(a + i), vld1q_f64(b + i)));
+        vst1q_f64(out + i + 2,
+                  vsubq_f64(vld1q_f64(a + i + 2), vld1q_f64(b + i + 2)));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] - b[i];
+    }
+}
+
+static void neon_scale(const double *a, double scalar, double *out,
+                       size_t n) {
+    float64x2_t s = vdupq_n_f64(scalar);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f64(out + i, vmulq_f64(vld1q_f64(a + i), s));
+        vst1q_f64(out + i + 2, vmulq_f64(vld1q_f64(a + i + 2), s));
+    }
+    for (; i < n; i++) {
+        out[i] = a[i] * scalar;
+    }
+}
+
+static double neon_dot(const double *a, const double *b, size_t n) {
+    float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+    float64x2_t s2 = vdupq_n_f64(0.0), s3 = vdupq_n_f64(0.0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = vfmaq_f64(s0, vld1q_f64(a + i), vld1q_f64(b + i));
+        s1 = vfmaq_f64(s1, vld1q_f64(a + i + 2), vld1q_f64(b + i + 2));
+        s2 = vfmaq_f64(s2, vld1q_f64(a + i + 4), vld1q_f64(b + i + 4));
+        s3 = vfmaq_f64(s3, vld1q_f64(a + i + 6), vld1q_f64(b + i + 6));
+    }
+
+    double sum = vaddvq_f64(vaddq_f64(vaddq_f64(s0, s1), vaddq_f64(s2, s3)));
+    for (; i < n; i++) {
+        sum += a[i] * b[i];
+    }
+
+    return sum;
+}
+
+static double neon_sum_squares(const double *a, size_t n) {
+    return neon_dot(a, a, n);
+}
+
+static double neon_sum(const double *a, size_t n) {
+    float64x2_t s0 = vdupq_n_f64(0.0), s1 = vdupq_n_f64(0.0);
+    float64x2_t s2 = vdupq_n_f64(0.0), s3 = vdupq_n_f64(0.0);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        s0 = vaddq_f64(s0, vld1q_f64(a + i));
+        s1 = vaddq_f64(s1, vld1q_f64(a + i + 2));
+        s2 = vaddq_f64(s2, vld1q_f64(a + i + 4));
+        s3 = vaddq_f64(s3, vld1q_f64(a + i + 6));
+    }
+
+    double sum = vaddvq_f64(vaddq_f64(vaddq_f64(s0, s1), vaddq_f64(s2, s3)));
+    for (; i < n; i++) {
+        sum += a[i];
+    }
+
+    return sum;
+}
+
+static void neon_axpy(double alpha, const double *x, double *y, size_t n) {
+    float64x2_t s = vdupq_n_f64(alpha);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        vst1q_f64(y + i, vfmaq_f64(vld1q_f64(y + i), s, vld1q_f64(x + i)));
+        vst1q_f64(y + i + 2,
+                  vfmaq_f64(vld1q_f64(y + i + 2), s, vld1q_f64(x + i + 2)));
+    }
+    for (; i < n; i++) {
+        y[i] += alpha * x[i];
+    }
+}
+
+static const VectorKernels neon_kernels = {
+    .name = "neon",
+    .add = neon_add,
+    .subtract = neon_subtract,
+    .scale = neon_scale,
+    .axpy = neon_axpy,
+    .dot = neon_dot,
+    .sum_squares = neon_sum_squares,
+    .sum = neon_sum,
+};
+
+#endif  // VECTOR_KERNELS_NEON
+
+// ---------------------------------------------------------------------------
+// Dispatch
+// ---------------------------------------------------------------------------
+
+static const VectorKernels *vector_kernels_detect(void) {
+    const VectorKernels *candidates[4];
+    int count = 0;
+
+    candidates[count++] = &scalar_kernels;
+
+#ifdef VECTOR_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        candidates[count++] = &sse2_kernels;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        candidates[count++] = &avx2_kernels;
+    }
+    if (__builtin_cpu_supports("avx512f")) {
+        candidates[count++] = &avx512_kernels;
+    }
+#endif
+
+#ifdef VECTOR_KERNELS_NEON
+    candidates[count++] = &neon_kernels;
+#endif
+
+    // Honor an explicit request for any supported table
+    const char *forced = getenv("MATHLIB_ISA");
+    if (forced != NULL) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(forced, candidates[i]->name) == 0) {
+                return candidates[i];
+            }
+        }
+    }
+
+    return candidates[count - 1];
+}
+
+const VectorKernels *vector_kernels(void) {
+    // Detection is idempotent, so concurrent first callers may both run it
+    static _Atomic(const VectorKernels *) selected = NULL;
+
+    const VectorKernels *table =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (table == NULL) {
+        table = vector_kernels_detect();
+        atomic_store_explicit(&selected, table, memory_order_release);
+    }
+
+    return table;
+}
\ No newline at end of file
@@ -1,8 +1,20 @@
 #include "../include/vector_math.h"
 
+#include <float.h>
+#include <string.h>
+
+#include "../include/blas_backend.h"
+#include "../include/math_plan.h"
+#include "../include/perf_counters.h"
+#include "../include/vector_kernels.h"
+
 int vector_create(int size, Vector *result) {
-    DEBUG_PRINT("Creating vector of size %d\n", size);
+    return vector_create_with(size, allocator_current(), result);
+}
 
+// Shared by the zeroed and uninitialized constructors
+static int vector_create_common(int size, Allocator *allocator, int zero,
+                                Vector *result) {
     if (result == NULL) {
         return ERROR_NULL_POINTER;
     }
@@ -11,26 +23,49 @@ int vector_create(int size, Vector *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
+    // Large zeroed heap vectors come from fresh pages, which need no fill
+    size_t bytes = (size_t)size * sizeof(double);
+    if (zero && allocator == NULL && bytes >= ALLOCATOR_PAGES_THRESHOLD) {
+        allocator = allocator_pages();
+    }
+
     result->size = size;
-    result->data = (double *)malloc(size * sizeof(double));
+    result->allocator = allocator;
+    result->data = (double *)allocator_alloc(allocator, bytes);
 
     if (result->data == NULL) {
         return ERROR_NULL_POINTER;
     }
+    perf_alloc(0, (uint64_t)bytes);
 
     // Initialize to zeros
-    for (int i = 0; i < size; i++) {
-        result->data[i] = 0.0;
+    if (zero && (allocator == NULL || !allocator->zeroed)) {
+        memset(result->data, 0, bytes);
     }
 
     return SUCCESS;
 }
 
+int vector_create_with(int size, Allocator *allocator, Vector *result) {
+    DEBUG_PRINT("Creating vector of size %d\n", size);
+    return vector_create_common(size, allocator, 1, result);
+}
+
+int vector_create_uninitialized(int size, Vector *result) {
+    return vector_create_uninitialized_with(size, allocator_current(), result);
+}
+
+int vector_create_uninitialized_with(int size, Allocator *allocator,
+                                     Vector *result) {
+    DEBUG_PRINT("Creating uninitialized vector of size %d\n", size);
+    return vector_create_common(size, allocator, 0, result);
+}
+
 void vector_free(Vector *v) {
     DEBUG_PRINT("Freeing vector\n");
 
     if (v != NULL && v->data != NULL) {
-        free(v->data);
+        allocator_free(v->allocator, v->data, (size_t)v->size * sizeof(double));
         v->data = NULL;
         v->size = 0;
     }
@@ -47,16 +82,12 @@ int vector_add(const Vector *v1, const Vector *v2, Vector *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    int status = vector_create(v1->size, result);
+    int status = vector_create_uninitialized(v1->size, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < v1->size; i++) {
-        result->data[i] = v1->data[i] + v2->data[i];
-    }
-
-    return SUCCESS;
+    return vector_add_into(v1, v2, result);
 }
 
 int vector_subtract(const Vector *v1, const Vector *v2, Vector *result) {
@@ -70,16 +101,12 @@ int vector_subtract(const Vector *v1, const Vector *v2, Vector *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    int status = vector_create(v1->size, result);
+    int status = vector_create_uninitialized(v1->size, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < v1->size; i++) {
-        result->data[i] = v1->data[i] - v2->data[i];
-    }
-
-    return SUCCESS;
+    return vector_subtract_into(v1, v2, result);
 }
 
 int vector_scale(const Vector *v, double scalar, Vector *result) {
@@ -89,16 +116,12 @@ int vector_scale(const Vector *v, double scalar, Vector *result) {
         return ERROR_NULL_POINTER;
     }
 
-    int status = vector_create(v->size, result);
+    int status = vector_create_uninitialized(v->size, result);
     if (status != SUCCESS) {
         return status;
     }
 
-    for (int i = 0; i < v->size; i++) {
-        result->data[i] = v->data[i] * scalar;
-    }
-
-    return SUCCESS;
+    return vector_scale_into(v, scalar, result);
 }
 
 int vector_dot_product(const Vector *v1, const Vector *v2, double *result) {
@@ -112,14 +135,86 @@ int vector_dot_product(const Vector *v1, const Vector *v2, double *result) {
         return ERROR_INVALID_DIMENSION;
     }
 
-    *result = 0.0;
-    for (int i = 0; i < v1->size; i++) {
-        *result += v1->data[i] * v2->data[i];
+    size_t n = (size_t)v1->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    if (!blas_backend_use(BLAS_OP_DOT, 2 * n) ||
+        blas_ddot(v1->data, v2->data, n, result) != SUCCESS) {
+        *result = vector_kernels()->dot(v1->data, v2->data, n);
     }
+    perf_end(&scope, PERF_OP_VECTOR_DOT, 16 * n, 2 * n);
 
     return SUCCESS;
 }
 
+// 2^-e as two factors: a single one overflows for subnormal magnitudes
+static void vector_norm_factors(int e, double *s1, double *s2) {
+    int half = -e / 2;
+    *s1 = ldexp(1.0, half);
+    *s2 = ldexp(1.0, -e - half);
+}
+
+// Euclidean norm without spurious overflow or underflow (the BLAS nrm2
+// contract), returned as norm = ldexp(result, *exponent) so that tiny norms
+// keep full precision. Ordinary data takes one pass: the plain sum of
+// squares is accurate whenever it lands in [DBL_MIN / DBL_EPSILON, DBL_MAX]
+// and *exponent is 0. Anything else (huge or tiny elements) is summed again
+// after scaling the largest element into [1, 2) by an exact power of two.
+static double vector_norm_scaled(const double *a, size_t n, int *exponent) {
+    const VectorKernels *kernels = vector_kernels();
+    *exponent = 0;
+
+    double sum = kernels->sum_squares(a, n);
+    if (sum >= DBL_MIN / DBL_EPSILON && sum <= DBL_MAX) {
+        return sqrt(sum);
+    }
+    if (isnan(sum)) {
+        return sum;
+    }
+
+    double max = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double x = fabs(a[i]);
+        max = x > max ? x : max;
+    }
+    if (max == 0.0 || isinf(max)) {
+        return max;
+    }
+
+    // Blocks of scaled copies keep the SIMD kernel's accumulators
+    int e = ilogb(max);
+    double s1, s2;
+    vector_norm_factors(e, &s1, &s2);
+    double scaled[256];
+    double total = 0.0;
+    for (size_t first = 0; first < n; first += 256) {
+        size_t len = n - first < 256 ? n - first : 256;
+        kernels->scale(a + first, s1, scaled, len);
+        kernels->scale(scaled, s2, scaled, len);
+        total += kernels->sum_squares(scaled, len);
+    }
+
+    *exponent = e;
+    return sqrt(total);
+}
+
+// out = a / ldexp(norm, exponent) for a nonzero norm from
+// vector_norm_scaled; out may be a
+static void vector_normalize_data(const double *a, double norm, int exponent,
+                                  double *out, size_t n) {
+    const VectorKernels *kernels = vector_kernels();
+
+    if (exponent == 0) {
+        kernels->scale(a, 1.0 / norm, out, n);
+        return;
+    }
+
+    double s1, s2;
+    vector_norm_factors(exponent, &s1, &s2);
+    kernels->scale(a, s1, out, n);
+    kernels->scale(out, s2 / norm, out, n);
+}
+
 int vector_magnitude(const Vector *v, double *result) {
     DEBUG_PRINT("Calculating vector magnitude\n");
 
@@ -127,12 +222,13 @@ int vector_magnitude(const Vector *v, double *result) {
         return ERROR_NULL_POINTER;
     }
 
-    double sum = 0.0;
-    for (int i = 0; i < v->size; i++) {
-        sum += v->data[i] * v->data[i];
-    }
-
-    *result = sqrt(sum);
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    int exponent;
+    double norm = vector_norm_scaled(v->data, n, &exponent);
+    *result = ldexp(norm, exponent);
+    perf_end(&scope, PERF_OP_VECTOR_MAGNITUDE, 8 * n, 2 * n);
     return SUCCESS;
 }
 
@@ -143,16 +239,354 @@ int vector_normalize(const Vector *v, Vector *result) {
         return ERROR_NULL_POINTER;
     }
 
-    double magnitude;
-    int status = vector_magnitude(v, &magnitude);
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    int exponent;
+    double norm = vector_norm_scaled(v->data, n, &exponent);
+    if (norm == 0) {
+        return ERROR_DIVISION_BY_ZERO;
+    }
+
+    int status = vector_create_uninitialized(v->size, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    vector_normalize_data(v->data, norm, exponent, result->data, n);
+    perf_end(&scope, PERF_OP_VECTOR_NORMALIZE, 24 * n, 4 * n);
+    return SUCCESS;
+}
+
+// In-place and output-parameter variants
+
+// Result must already hold a buffer of the operand size
+static int vector_check_into(const Vector *v, const Vector *result) {
+    if (v->data == NULL || result->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (result->size != v->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    return SUCCESS;
+}
+
+int vector_copy(const Vector *src, Vector *dst) {
+    DEBUG_PRINT("Copying vector\n");
+
+    if (src == NULL || dst == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_check_into(src, dst);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    if (dst->data != src->data) {
+        memcpy(dst->data, src->data, (size_t)src->size * sizeof(double));
+    }
+
+    return SUCCESS;
+}
+
+int vector_add_into(const Vector *v1, const Vector *v2, Vector *result) {
+    DEBUG_PRINT("Adding vectors into result\n");
+
+    if (v1 == NULL || v2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v2->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v1->size != v2->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = vector_check_into(v1, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    size_t n = (size_t)v1->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    vector_kernels()->add(v1->data, v2->data, result->data, n);
+    perf_end(&scope, PERF_OP_VECTOR_ADD, 24 * n, n);
+
+    return SUCCESS;
+}
+
+int vector_subtract_into(const Vector *v1, const Vector *v2, Vector *result) {
+    DEBUG_PRINT("Subtracting vectors into result\n");
+
+    if (v1 == NULL || v2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v2->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v1->size != v2->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = vector_check_into(v1, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    size_t n = (size_t)v1->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    vector_kernels()->subtract(v1->data, v2->data, result->data, n);
+    perf_end(&scope, PERF_OP_VECTOR_SUBTRACT, 24 * n, n);
+
+    return SUCCESS;
+}
+
+int vector_scale_into(const Vector *v, double scalar, Vector *result) {
+    DEBUG_PRINT("Scaling vector by %f into result\n", scalar);
+
+    if (v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_check_into(v, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    if (!blas_backend_use(BLAS_OP_SCALE, n) ||
+        blas_dscal(v->data, scalar, result->data, n) != SUCCESS) {
+        vector_kernels()->scale(v->data, scalar, result->data, n);
+    }
+    perf_end(&scope, PERF_OP_VECTOR_SCALE, 16 * n, n);
+
+    return SUCCESS;
+}
+
+int vector_scale_inplace(Vector *v, double scalar) {
+    return vector_scale_into(v, scalar, v);
+}
 
+int vector_axpy(double alpha, const Vector *x, Vector *y) {
+    DEBUG_PRINT("Computing y += %f * x\n", alpha);
+
+    if (x == NULL || y == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_check_into(x, y);
     if (status != SUCCESS) {
         return status;
     }
 
-    if (magnitude == 0) {
+    size_t n = (size_t)x->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    vector_kernels()->axpy(alpha, x->data, y->data, n);
+    perf_end(&scope, PERF_OP_VECTOR_AXPY, 24 * n, 2 * n);
+
+    return SUCCESS;
+}
+
+int vector_normalize_into(const Vector *v, Vector *result) {
+    DEBUG_PRINT("Normalizing vector into result\n");
+
+    if (v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_check_into(v, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    int exponent;
+    double norm = vector_norm_scaled(v->data, n, &exponent);
+    if (norm == 0) {
         return ERROR_DIVISION_BY_ZERO;
     }
 
-    return vector_scale(v, 1.0 / magnitude, result);
+    vector_normalize_data(v->data, norm, exponent, result->data, n);
+    perf_end(&scope, PERF_OP_VECTOR_NORMALIZE, 24 * n, 4 * n);
+    return SUCCESS;
+}
+
+int vector_normalize_inplace(Vector *v) {
+    return vector_normalize_into(v, v);
+}
+
+// Checked-once plans
+
+static int vector_plan_run_add(const MathPlan *plan) {
+    plan->kernels->add(plan->x, plan->y, plan->out, plan->n);
+    return SUCCESS;
+}
+
+static int vector_plan_run_subtract(const MathPlan *plan) {
+    plan->kernels->subtract(plan->x, plan->y, plan->out, plan->n);
+    return SUCCESS;
+}
+
+// path is 1 when the vendor library takes the operation
+static int vector_plan_run_scale(const MathPlan *plan) {
+    if (!plan->path ||
+        blas_dscal(plan->x, plan->alpha, plan->out, plan->n) != SUCCESS) {
+        plan->kernels->scale(plan->x, plan->alpha, plan->out, plan->n);
+    }
+    return SUCCESS;
+}
+
+static int vector_plan_run_axpy(const MathPlan *plan) {
+    plan->kernels->axpy(plan->alpha, plan->x, plan->out, plan->n);
+    return SUCCESS;
+}
+
+static int vector_plan_run_dot(const MathPlan *plan) {
+    if (!plan->path ||
+        blas_ddot(plan->x, plan->y, plan->n, plan->out) != SUCCESS) {
+        *plan->out = plan->kernels->dot(plan->x, plan->y, plan->n);
+    }
+    return SUCCESS;
+}
+
+// Checks shared by the two-operand element-wise plans
+static int vector_plan_binary(MathPlan *plan, const Vector *v1,
+                              const Vector *v2, Vector *result) {
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    if (v1 == NULL || v2 == NULL || result == NULL || v2->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v1->size != v2->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    int status = vector_check_into(v1, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    plan->kernels = vector_kernels();
+    plan->x = v1->data;
+    plan->y = v2->data;
+    plan->out = result->data;
+    plan->n = (size_t)v1->size;
+    return SUCCESS;
+}
+
+int vector_plan_add(MathPlan *plan, const Vector *v1, const Vector *v2,
+                    Vector *result) {
+    DEBUG_PRINT("Planning vector addition\n");
+
+    int status = vector_plan_binary(plan, v1, v2, result);
+    if (status == SUCCESS) {
+        plan->run = vector_plan_run_add;
+    }
+    return status;
+}
+
+int vector_plan_subtract(MathPlan *plan, const Vector *v1, const Vector *v2,
+                         Vector *result) {
+    DEBUG_PRINT("Planning vector subtraction\n");
+
+    int status = vector_plan_binary(plan, v1, v2, result);
+    if (status == SUCCESS) {
+        plan->run = vector_plan_run_subtract;
+    }
+    return status;
+}
+
+int vector_plan_dot_product(MathPlan *plan, const Vector *v1,
+                            const Vector *v2, double *result) {
+    DEBUG_PRINT("Planning dot product\n");
+
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    if (v1 == NULL || v2 == NULL || result == NULL || v1->data == NULL ||
+        v2->data == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v1->size != v2->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    plan->kernels = vector_kernels();
+    plan->x = v1->data;
+    plan->y = v2->data;
+    plan->out = result;
+    plan->n = (size_t)v1->size;
+    plan->path = blas_backend_use(BLAS_OP_DOT, 2 * plan->n);
+    plan->run = vector_plan_run_dot;
+    return SUCCESS;
+}
+
+// Checks shared by the one-operand plans
+static int vector_plan_unary(MathPlan *plan, const Vector *v,
+                             Vector *result) {
+    if (plan == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+    memset(plan, 0, sizeof(*plan));
+
+    if (v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    int status = vector_check_into(v, result);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    plan->kernels = vector_kernels();
+    plan->x = v->data;
+    plan->out = result->data;
+    plan->n = (size_t)v->size;
+    return SUCCESS;
+}
+
+int vector_plan_scale(MathPlan *plan, const Vector *v, double scalar,
+                      Vector *result) {
+    DEBUG_PRINT("Planning vector scaling by %f\n", scalar);
+
+    int status = vector_plan_unary(plan, v, result);
+    if (status == SUCCESS) {
+        plan->alpha = scalar;
+        plan->path = blas_backend_use(BLAS_OP_SCALE, plan->n);
+        plan->run = vector_plan_run_scale;
+    }
+    return status;
+}
+
+int vector_plan_axpy(MathPlan *plan, double alpha, const Vector *x,
+                     Vector *y) {
+    DEBUG_PRINT("Planning y += %f * x\n", alpha);
+
+    int status = vector_plan_unary(plan, x, y);
+    if (status == SUCCESS) {
+        plan->alpha = alpha;
+        plan->run = vector_plan_run_axpy;
+    }
+    return status;
 }
\ No newline at end of file
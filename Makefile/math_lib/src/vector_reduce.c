@@ -0,0 +1,334 @@
+#include "../include/vector_math.h"
+
+#include <float.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "../include/perf_counters.h"
+#include "../include/vector_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VECTOR_REDUCE_X86 1
+#else
+#define VECTOR_REDUCE_X86 0
+#endif
+
+// The error-free transforms below only hold when every operation rounds
+// exactly as written. The Makefile builds this file with -ffp-contract=off
+// so the compiler cannot fuse them into FMAs.
+
+// Pairwise leaves are summed by the FAST kernel; 256 elements keep the
+// per-leaf error small while amortizing the call
+#define REDUCE_PAIRWISE_BLOCK 256
+
+typedef double ReduceDouble4 __attribute__((vector_size(32)));
+
+// Knuth's TwoSum: s + x == t + e exactly, whatever the magnitudes. s becomes
+// t and e is added to the compensation c. Works on scalars and vectors.
+#define REDUCE_TWO_SUM(s, c, x)                \
+    do {                                       \
+        __typeof__(s) t_ = (s) + (x);          \
+        __typeof__(s) z_ = t_ - (s);           \
+        (c) += ((s) - (t_ - z_)) + ((x) - z_); \
+        (s) = t_;                              \
+    } while (0)
+
+// Dekker's TwoProduct for targets without FMA: p == a * b rounded and
+// a * b == p + e exactly, barring overflow in the Veltkamp split
+#define REDUCE_TWO_PRODUCT_SPLIT(x, y, p, e)                                \
+    do {                                                                    \
+        __typeof__(x) cx_ = 134217729.0 * (x);                              \
+        __typeof__(x) cy_ = 134217729.0 * (y);                              \
+        __typeof__(x) xh_ = cx_ - (cx_ - (x));                              \
+        __typeof__(x) yh_ = cy_ - (cy_ - (y));                              \
+        __typeof__(x) xl_ = (x) - xh_;                                      \
+        __typeof__(x) yl_ = (y) - yh_;                                      \
+        (p) = (x) * (y);                                                    \
+        (e) = xl_ * yl_ - ((((p) - xh_ * yh_) - xl_ * yh_) - xh_ * yl_);    \
+    } while (0)
+
+// ---------------------------------------------------------------------------
+// Pairwise
+// ---------------------------------------------------------------------------
+
+static double pairwise_sum(const VectorKernels *k, const double *a,
+                           size_t n) {
+    if (n <= REDUCE_PAIRWISE_BLOCK) {
+        return k->sum(a, n);
+    }
+
+    size_t half = n / 2;
+    return pairwise_sum(k, a, half) + pairwise_sum(k, a + half, n - half);
+}
+
+static double pairwise_dot(const VectorKernels *k, const double *a,
+                           const double *b, size_t n) {
+    if (n <= REDUCE_PAIRWISE_BLOCK) {
+        return k->dot(a, b, n);
+    }
+
+    size_t half = n / 2;
+    return pairwise_dot(k, a, b, half) +
+           pairwise_dot(k, a + half, b + half, n - half);
+}
+
+// ---------------------------------------------------------------------------
+// Compensated
+// ---------------------------------------------------------------------------
+
+// Each kernel keeps eight lanes of (sum, compensation) pairs, two vectors
+// wide so consecutive TwoSums do not wait on each other. reduce_fold then
+// combines the two vectors of sums and of compensations with the scalar
+// transform.
+static void reduce_fold(const void *sums, const void *comps, double *sum,
+                        double *comp) {
+    double s[8], c[8];
+    memcpy(s, sums, sizeof(s));
+    memcpy(c, comps, sizeof(c));
+
+    *sum = 0.0;
+    *comp = 0.0;
+    for (int l = 0; l < 8; l++) {
+        REDUCE_TWO_SUM(*sum, *comp, s[l]);
+        *comp += c[l];
+    }
+}
+
+static inline __attribute__((always_inline)) double compensated_sum_body(
+    const double *a, size_t n) {
+    ReduceDouble4 s[2] = {{0.0}, {0.0}};
+    ReduceDouble4 c[2] = {{0.0}, {0.0}};
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        ReduceDouble4 x0, x1;
+        memcpy(&x0, a + i, sizeof(x0));
+        memcpy(&x1, a + i + 4, sizeof(x1));
+        REDUCE_TWO_SUM(s[0], c[0], x0);
+        REDUCE_TWO_SUM(s[1], c[1], x1);
+    }
+
+    double sum, comp;
+    reduce_fold(s, c, &sum, &comp);
+    for (; i < n; i++) {
+        REDUCE_TWO_SUM(sum, comp, a[i]);
+    }
+
+    return sum + comp;
+}
+
+// Ogita-Rump-Oishi Dot2: TwoProduct on every term, TwoSum on the running
+// sum
+static double compensated_dot_generic(const double *a, const double *b,
+                                      size_t n) {
+    ReduceDouble4 s[2] = {{0.0}, {0.0}};
+    ReduceDouble4 c[2] = {{0.0}, {0.0}};
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        for (int v = 0; v < 2; v++) {
+            ReduceDouble4 x, y, p, e;
+            memcpy(&x, a + i + 4 * v, sizeof(x));
+            memcpy(&y, b + i + 4 * v, sizeof(y));
+            REDUCE_TWO_PRODUCT_SPLIT(x, y, p, e);
+            REDUCE_TWO_SUM(s[v], c[v], p);
+            c[v] += e;
+        }
+    }
+
+    double sum, comp;
+    reduce_fold(s, c, &sum, &comp);
+    for (; i < n; i++) {
+        double p = a[i] * b[i];
+        REDUCE_TWO_SUM(sum, comp, p);
+        comp += fma(a[i], b[i], -p);
+    }
+
+    return sum + comp;
+}
+
+static double compensated_sum_generic(const double *a, size_t n) {
+    return compensated_sum_body(a, n);
+}
+
+#if VECTOR_REDUCE_X86
+__attribute__((target("avx2,fma"))) static double compensated_dot_avx2(
+    const double *a, const double *b, size_t n) {
+    __m256d s[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    __m256d c[2] = {_mm256_setzero_pd(), _mm256_setzero_pd()};
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        for (int v = 0; v < 2; v++) {
+            __m256d x = _mm256_loadu_pd(a + i + 4 * v);
+            __m256d y = _mm256_loadu_pd(b + i + 4 * v);
+            __m256d p = _mm256_mul_pd(x, y);
+            REDUCE_TWO_SUM(s[v], c[v], p);
+            c[v] += _mm256_fmsub_pd(x, y, p);
+        }
+    }
+
+    double sum, comp;
+    reduce_fold(s, c, &sum, &comp);
+    for (; i < n; i++) {
+        double p = a[i] * b[i];
+        REDUCE_TWO_SUM(sum, comp, p);
+        comp += fma(a[i], b[i], -p);
+    }
+
+    return sum + comp;
+}
+
+__attribute__((target("avx2,fma"))) static double compensated_sum_avx2(
+    const double *a, size_t n) {
+    return compensated_sum_body(a, n);
+}
+#endif
+
+typedef struct {
+    double (*sum)(const double *a, size_t n);
+    double (*dot)(const double *a, const double *b, size_t n);
+} CompensatedKernels;
+
+static const CompensatedKernels *compensated_kernels(void) {
+    static const CompensatedKernels generic = {compensated_sum_generic,
+                                               compensated_dot_generic};
+#if VECTOR_REDUCE_X86
+    static const CompensatedKernels avx2 = {compensated_sum_avx2,
+                                            compensated_dot_avx2};
+#endif
+    static _Atomic(const CompensatedKernels *) selected = NULL;
+
+    const CompensatedKernels *kernels =
+        atomic_load_explicit(&selected, memory_order_acquire);
+    if (kernels == NULL) {
+        kernels = &generic;
+#if VECTOR_REDUCE_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernels = &avx2;
+        }
+#endif
+        atomic_store_explicit(&selected, kernels, memory_order_release);
+    }
+
+    return kernels;
+}
+
+// ---------------------------------------------------------------------------
+// Public API
+// ---------------------------------------------------------------------------
+
+static int reduce_sum(const double *a, size_t n, ReductionMode mode,
+                      double *result) {
+    switch (mode) {
+        case REDUCTION_FAST:
+            *result = vector_kernels()->sum(a, n);
+            return SUCCESS;
+        case REDUCTION_PAIRWISE:
+            *result = pairwise_sum(vector_kernels(), a, n);
+            return SUCCESS;
+        case REDUCTION_COMPENSATED:
+            *result = compensated_kernels()->sum(a, n);
+            return SUCCESS;
+    }
+
+    return ERROR_INVALID_DIMENSION;
+}
+
+static int reduce_dot(const double *a, const double *b, size_t n,
+                      ReductionMode mode, double *result) {
+    switch (mode) {
+        case REDUCTION_FAST:
+            *result = vector_kernels()->dot(a, b, n);
+            return SUCCESS;
+        case REDUCTION_PAIRWISE:
+            *result = pairwise_dot(vector_kernels(), a, b, n);
+            return SUCCESS;
+        case REDUCTION_COMPENSATED:
+            *result = compensated_kernels()->dot(a, b, n);
+            return SUCCESS;
+    }
+
+    return ERROR_INVALID_DIMENSION;
+}
+
+// Traced by vector_sum_mode
+int vector_sum(const Vector *v, double *result) {
+    return vector_sum_mode(v, REDUCTION_FAST, result);
+}
+
+int vector_sum_mode(const Vector *v, ReductionMode mode, double *result) {
+    DEBUG_PRINT("Summing vector\n");
+
+    if (v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    int status = reduce_sum(v->data, n, mode, result);
+    if (status == SUCCESS) {
+        perf_end(&scope, PERF_OP_VECTOR_SUM, 8 * n, n);
+    }
+
+    return status;
+}
+
+int vector_dot_product_mode(const Vector *v1, const Vector *v2,
+                            ReductionMode mode, double *result) {
+    DEBUG_PRINT("Calculating dot product\n");
+
+    if (v1 == NULL || v2 == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    if (v1->size != v2->size) {
+        return ERROR_INVALID_DIMENSION;
+    }
+
+    size_t n = (size_t)v1->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    int status = reduce_dot(v1->data, v2->data, n, mode, result);
+    if (status == SUCCESS) {
+        perf_end(&scope, PERF_OP_VECTOR_DOT, 16 * n, 2 * n);
+    }
+
+    return status;
+}
+
+int vector_magnitude_mode(const Vector *v, ReductionMode mode,
+                          double *result) {
+    // FAST is vector_magnitude, which traces the call itself
+    if (mode == REDUCTION_FAST) {
+        return vector_magnitude(v, result);
+    }
+
+    DEBUG_PRINT("Calculating vector magnitude\n");
+
+    if (v == NULL || result == NULL) {
+        return ERROR_NULL_POINTER;
+    }
+
+    size_t n = (size_t)v->size;
+    PerfScope scope;
+    perf_begin(&scope);
+    double sum_squares;
+    int status = reduce_dot(v->data, v->data, n, mode, &sum_squares);
+    if (status != SUCCESS) {
+        return status;
+    }
+
+    // Out of range (or NaN from TwoSum on infinities): accept FAST
+    // accumulation to get the rescaling
+    if (!(sum_squares >= DBL_MIN / DBL_EPSILON && sum_squares <= DBL_MAX)) {
+        return vector_magnitude(v, result);
+    }
+
+    *result = sqrt(sum_squares);
+    perf_end(&scope, PERF_OP_VECTOR_MAGNITUDE, 8 * n, 2 * n);
+    return SUCCESS;
+}
\ No newline at end of file
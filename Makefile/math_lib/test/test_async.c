@@ -0,0 +1,288 @@
+#include <string.h>
+
+#include "../include/async_queue.h"
+#include "../include/matrix_math.h"
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+#include "test_util.h"
+
+// Async queue tests: results of queued operations, fused matrix-vector
+// products, and submissions from inside a queue's own drain
+
+typedef struct {
+    AsyncQueue *queue;
+    int ran;
+    int first;
+    int second;
+} Nested;
+
+static int count_run(void *ctx) {
+    __atomic_add_fetch((int *)ctx, 1, __ATOMIC_RELAXED);
+    return SUCCESS;
+}
+
+// The drain has taken this operation off the queue, so one slot is free:
+// the first submission fits and the second finds the queue full
+static int submit_twice(void *ctx) {
+    Nested *n = (Nested *)ctx;
+    n->first = async_submit(n->queue, count_run, &n->ran, NULL);
+    n->second = async_submit(n->queue, count_run, &n->ran, NULL);
+    return SUCCESS;
+}
+
+static void submit_twice_callback(void *user, int status) {
+    (void)status;
+    submit_twice(user);
+}
+
+static void test_submit_from_drain(void) {
+    AsyncQueue queue;
+    CHECK_STATUS(async_queue_init(&queue, 1), SUCCESS);
+
+    Nested n = {&queue, 0, -1, -1};
+    AsyncFuture future = ASYNC_FUTURE_INIT;
+    CHECK_STATUS(async_submit(&queue, submit_twice, &n, &future), SUCCESS);
+    CHECK_STATUS(async_wait(&queue, &future), SUCCESS);
+    CHECK_STATUS(async_wait_all(&queue), SUCCESS);
+    CHECK(n.first == SUCCESS);
+    CHECK(n.second == ERROR_UNSUPPORTED);
+    CHECK(n.ran == 1);
+
+    // Callbacks are part of the drain too
+    Nested c = {&queue, 0, -1, -1};
+    int ran = 0;
+    async_future_init(&future, submit_twice_callback, &c);
+    CHECK_STATUS(async_submit(&queue, count_run, &ran, &future), SUCCESS);
+    CHECK_STATUS(async_wait(&queue, &future), SUCCESS);
+    CHECK_STATUS(async_wait_all(&queue), SUCCESS);
+    CHECK(ran == 1);
+    CHECK(c.first == SUCCESS);
+    CHECK(c.second == ERROR_UNSUPPORTED);
+    CHECK(c.ran == 1);
+
+    // Outside the drain a full queue still just makes the submitter wait
+    int total = 0;
+    for (int i = 0; i < 100; i++) {
+        CHECK_STATUS(async_submit(&queue, count_run, &total, NULL), SUCCESS);
+    }
+    CHECK_STATUS(async_wait_all(&queue), SUCCESS);
+    CHECK(total == 100);
+
+    async_queue_destroy(&queue);
+}
+
+// Products on one matrix are fused; each result matches the direct call
+static void test_results(void) {
+    enum { COUNT = 12, N = 96 };
+    AsyncQueue queue;
+    CHECK_STATUS(async_queue_init(&queue, 4), SUCCESS);
+
+    Matrix m;
+    Vector v[COUNT], result[COUNT], sum, scaled, expected;
+    CHECK_STATUS(matrix_create(N, N, &m), SUCCESS);
+    test_fill_matrix(&m, 5, 0.0);
+    for (int i = 0; i < COUNT; i++) {
+        CHECK_STATUS(vector_create(N, &v[i]), SUCCESS);
+        CHECK_STATUS(vector_create(N, &result[i]), SUCCESS);
+        test_fill_vector(&v[i], 10 + (unsigned)i);
+    }
+    CHECK_STATUS(vector_create(N, &sum), SUCCESS);
+    CHECK_STATUS(vector_create(N, &scaled), SUCCESS);
+
+    AsyncFuture futures[COUNT];
+    for (int i = 0; i < COUNT; i++) {
+        async_future_init(&futures[i], NULL, NULL);
+        CHECK_STATUS(async_matrix_vector_multiply(&queue, &m, &v[i],
+                                                  &result[i], &futures[i]),
+                     SUCCESS);
+    }
+    CHECK_STATUS(async_vector_add(&queue, &v[0], &v[1], &sum, NULL),
+                 SUCCESS);
+    CHECK_STATUS(async_vector_scale(&queue, &v[2], 3.0, &scaled, NULL),
+                 SUCCESS);
+    for (int i = 0; i < COUNT; i++) {
+        CHECK_STATUS(async_wait(&queue, &futures[i]), SUCCESS);
+        CHECK(async_future_done(&futures[i]));
+    }
+    CHECK_STATUS(async_wait_all(&queue), SUCCESS);
+
+    for (int i = 0; i < COUNT; i++) {
+        CHECK_STATUS(matrix_vector_multiply(&m, &v[i], &expected), SUCCESS);
+        CHECK(memcmp(expected.data, result[i].data, N * sizeof(double)) ==
+              0);
+        vector_free(&expected);
+    }
+    for (int i = 0; i < N; i++) {
+        CHECK(sum.data[i] == v[0].data[i] + v[1].data[i]);
+        CHECK(scaled.data[i] == v[2].data[i] * 3.0);
+    }
+
+    // Errors come back through the future and async_wait_all
+    AsyncFuture failed = ASYNC_FUTURE_INIT;
+    Vector short_vector;
+    CHECK_STATUS(vector_create(N - 1, &short_vector), SUCCESS);
+    CHECK_STATUS(async_vector_add(&queue, &v[0], &short_vector, &sum,
+                                  &failed),
+                 SUCCESS);
+    CHECK_STATUS(async_wait(&queue, &failed), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(async_wait_all(&queue), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(async_wait_all(&queue), SUCCESS);
+    vector_free(&short_vector);
+
+    for (int i = 0; i < COUNT; i++) {
+        vector_free(&v[i]);
+        vector_free(&result[i]);
+    }
+    vector_free(&sum);
+    vector_free(&scaled);
+    matrix_free(&m);
+    async_queue_destroy(&queue);
+}
+
+// More products on one matrix than one fused pass takes, next to products
+// that cannot be fused, all submitted from inside the drain so that they
+// are taken as one batch
+enum { SHARED = 45, TRANSPOSED = 3, FUSE_N = 80 };
+
+typedef struct {
+    AsyncQueue *queue;
+    const Matrix *shared;
+    const Matrix *single;
+    const Matrix *transposed;
+    Vector v[SHARED];
+    Vector result[SHARED];
+    Vector single_result;
+    Vector t_v[TRANSPOSED];
+    Vector t_result[TRANSPOSED];
+    Vector bad_result;
+    AsyncFuture futures[SHARED];
+    AsyncFuture bad_future;
+    int submitted;
+} FusedBatch;
+
+static int submit_products(void *ctx) {
+    FusedBatch *f = (FusedBatch *)ctx;
+    int ok = 1;
+    for (int i = 0; i < SHARED; i++) {
+        ok &= async_matrix_vector_multiply(f->queue, f->shared, &f->v[i],
+                                           &f->result[i],
+                                           &f->futures[i]) == SUCCESS;
+        if (i == SHARED / 2) {
+            ok &= async_matrix_vector_multiply(f->queue, f->single, &f->v[0],
+                                               &f->single_result,
+                                               NULL) == SUCCESS;
+            // Wrong result length: fails alone, not with its neighbours
+            ok &= async_matrix_vector_multiply(f->queue, f->shared, &f->v[1],
+                                               &f->bad_result,
+                                               &f->bad_future) == SUCCESS;
+        }
+    }
+    for (int i = 0; i < TRANSPOSED; i++) {
+        ok &= async_matrix_vector_multiply(f->queue, f->transposed,
+                                           &f->t_v[i], &f->t_result[i],
+                                           NULL) == SUCCESS;
+    }
+    f->submitted = ok;
+    return SUCCESS;
+}
+
+static void test_fused_batch(void) {
+    AsyncQueue queue;
+    CHECK_STATUS(async_queue_init(&queue, 64), SUCCESS);
+
+    Matrix shared, single, storage, transposed;
+    CHECK_STATUS(matrix_create(FUSE_N, FUSE_N, &shared), SUCCESS);
+    CHECK_STATUS(matrix_create(FUSE_N, FUSE_N, &single), SUCCESS);
+    CHECK_STATUS(matrix_create(FUSE_N / 2, FUSE_N, &storage), SUCCESS);
+    CHECK_STATUS(matrix_transpose_view(&storage, &transposed), SUCCESS);
+    test_fill_matrix(&shared, 61, 0.0);
+    test_fill_matrix(&single, 62, 0.0);
+    test_fill_matrix(&storage, 63, 0.0);
+
+    static FusedBatch f;
+    memset(&f, 0, sizeof(f));
+    f.queue = &queue;
+    f.shared = &shared;
+    f.single = &single;
+    f.transposed = &transposed;
+    for (int i = 0; i < SHARED; i++) {
+        CHECK_STATUS(vector_create(FUSE_N, &f.v[i]), SUCCESS);
+        CHECK_STATUS(vector_create(FUSE_N, &f.result[i]), SUCCESS);
+        test_fill_vector(&f.v[i], 70 + (unsigned)i);
+        async_future_init(&f.futures[i], NULL, NULL);
+    }
+    for (int i = 0; i < TRANSPOSED; i++) {
+        CHECK_STATUS(vector_create(FUSE_N / 2, &f.t_v[i]), SUCCESS);
+        CHECK_STATUS(vector_create(FUSE_N, &f.t_result[i]), SUCCESS);
+        test_fill_vector(&f.t_v[i], 130 + (unsigned)i);
+    }
+    CHECK_STATUS(vector_create(FUSE_N, &f.single_result), SUCCESS);
+    CHECK_STATUS(vector_create(FUSE_N - 1, &f.bad_result), SUCCESS);
+    async_future_init(&f.bad_future, NULL, NULL);
+
+    // Every product is counted once per pass over its matrix: two fused
+    // passes over the shared matrix, then one call per unfused product.
+    // The bad product fails before it is counted.
+    perf_counters_enable(1);
+    perf_reset();
+    CHECK_STATUS(async_submit(&queue, submit_products, &f, NULL), SUCCESS);
+    CHECK_STATUS(async_wait_all(&queue), ERROR_INVALID_DIMENSION);
+    PerfSnapshot snapshot;
+    CHECK_STATUS(perf_snapshot(&snapshot), SUCCESS);
+    perf_counters_enable(0);
+    CHECK(f.submitted);
+    CHECK(snapshot.ops[PERF_OP_MATRIX_VECTOR_MULTIPLY].calls ==
+          2 + 1 + TRANSPOSED);
+
+    CHECK_STATUS(async_wait(&queue, &f.bad_future), ERROR_INVALID_DIMENSION);
+    Vector expected;
+    for (int i = 0; i < SHARED; i++) {
+        CHECK_STATUS(async_wait(&queue, &f.futures[i]), SUCCESS);
+        CHECK_STATUS(matrix_vector_multiply(&shared, &f.v[i], &expected),
+                     SUCCESS);
+        CHECK(memcmp(expected.data, f.result[i].data,
+                     FUSE_N * sizeof(double)) == 0);
+        vector_free(&expected);
+    }
+    CHECK_STATUS(matrix_vector_multiply(&single, &f.v[0], &expected),
+                 SUCCESS);
+    CHECK(memcmp(expected.data, f.single_result.data,
+                 FUSE_N * sizeof(double)) == 0);
+    vector_free(&expected);
+    for (int i = 0; i < TRANSPOSED; i++) {
+        CHECK_STATUS(matrix_vector_multiply(&transposed, &f.t_v[i],
+                                            &expected),
+                     SUCCESS);
+        CHECK(memcmp(expected.data, f.t_result[i].data,
+                     FUSE_N * sizeof(double)) == 0);
+        vector_free(&expected);
+    }
+
+    for (int i = 0; i < SHARED; i++) {
+        vector_free(&f.v[i]);
+        vector_free(&f.result[i]);
+    }
+    for (int i = 0; i < TRANSPOSED; i++) {
+        vector_free(&f.t_v[i]);
+        vector_free(&f.t_result[i]);
+    }
+    vector_free(&f.single_result);
+    vector_free(&f.bad_result);
+    matrix_free(&shared);
+    matrix_free(&single);
+    matrix_free(&storage);
+    async_queue_destroy(&queue);
+}
+
+int main(void) {
+    // Inline, then on pool workers
+    test_submit_from_drain();
+    test_results();
+    test_fused_batch();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    test_submit_from_drain();
+    test_results();
+    test_fused_batch();
+    thread_pool_shutdown();
+    return test_finish("test_async");
+}
\ No newline at end of file
@@ -0,0 +1,414 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/basic_math.h"
+#include "../include/thread_pool.h"
+#include "test_util.h"
+
+// Batch basic math tests: exp_n, log_n and power_n error in ULPs against
+// a long double reference, lanes handed to the C library, divide_n zero
+// lanes, signed zeros, infinities, NaNs and subnormals, and lengths that
+// leave a partial group of four lanes
+
+// Bounds over the sweeps below (basic_math.h gives the measured maxima),
+// plus 2^-10 ULP for the error of the long double reference itself
+#define EXP_MAX_ULP 0.53
+#define LOG_MAX_ULP 0.5
+#define POWER_MAX_ULP 0.52
+#define SUBNORMAL_MAX_ULP 0.75
+#define REFERENCE_SLACK 0x1p-10
+
+#define SWEEP 200000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform in [lo, hi)
+static double rng_uniform(double lo, double hi) {
+    return lo + (hi - lo) * ((double)(rng_next() >> 11) * 0x1p-53);
+}
+
+static double from_bits(uint64_t bits) {
+    double x;
+    memcpy(&x, &bits, sizeof(x));
+    return x;
+}
+
+static int same_bits(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0 || (isnan(a) && isnan(b));
+}
+
+// |result - exact| in units of the double ULP at exact; the ULP of the
+// subnormal range is 2^-1074
+static double ulp_error(double result, long double exact) {
+    if (isinf(result) || isnan(result)) {
+        return result == exact ? 0.0 : INFINITY;
+    }
+    int exponent;
+    frexpl(exact, &exponent);
+    if (exponent < -1021) {
+        exponent = -1021;
+    }
+    return (double)(fabsl((long double)result - exact) /
+                    ldexpl(1.0L, exponent - 53));
+}
+
+typedef struct {
+    double normal;
+    double subnormal;
+} UlpMax;
+
+static void ulp_record(UlpMax *max, double result, long double exact) {
+    double error = ulp_error(result, exact);
+    if (fabsl(exact) < DBL_MIN) {
+        max->subnormal = fmax(max->subnormal, error);
+    } else if (fabsl(exact) <= DBL_MAX) {
+        max->normal = fmax(max->normal, error);
+    }
+}
+
+static void test_exp_ulp(void) {
+    double *x = (double *)malloc(SWEEP * sizeof(double));
+    double *out = (double *)malloc(SWEEP * sizeof(double));
+    CHECK(x != NULL && out != NULL);
+    // The whole finite range, the subnormal results below -708.4 and
+    // small arguments near 0
+    for (int i = 0; i < SWEEP; i++) {
+        switch (i % 3) {
+            case 0:
+                x[i] = rng_uniform(-745.1, 709.78);
+                break;
+            case 1:
+                x[i] = rng_uniform(-745.1, -708.3);
+                break;
+            default:
+                x[i] = ldexp(rng_uniform(-1.0, 1.0), -(int)(rng_next() % 60));
+                break;
+        }
+    }
+    CHECK_STATUS(exp_n(x, out, SWEEP), SUCCESS);
+
+    UlpMax max = {0.0, 0.0};
+    for (int i = 0; i < SWEEP; i++) {
+        ulp_record(&max, out[i], expl((long double)x[i]));
+    }
+    CHECK(max.normal <= EXP_MAX_ULP + REFERENCE_SLACK);
+    CHECK(max.subnormal <= SUBNORMAL_MAX_ULP + REFERENCE_SLACK);
+    free(x);
+    free(out);
+}
+
+static void test_log_ulp(void) {
+    double *x = (double *)malloc(SWEEP * sizeof(double));
+    double *out = (double *)malloc(SWEEP * sizeof(double));
+    CHECK(x != NULL && out != NULL);
+    // Random positive finite bit patterns cover every binade, subnormals
+    // included; the rest sit next to 1, where the cancellation is worst
+    for (int i = 0; i < SWEEP; i++) {
+        if (i % 2 == 0) {
+            uint64_t bits = rng_next() % 0x7ff0000000000000ull;
+            x[i] = from_bits(bits == 0 ? 1 : bits);
+        } else {
+            x[i] = 1.0 + ldexp(rng_uniform(-1.0, 1.0),
+                               -(int)(rng_next() % 40));
+        }
+    }
+    CHECK_STATUS(log_n(x, out, SWEEP), SUCCESS);
+
+    UlpMax max = {0.0, 0.0};
+    for (int i = 0; i < SWEEP; i++) {
+        if (x[i] != 1.0) {
+            ulp_record(&max, out[i], logl((long double)x[i]));
+        }
+    }
+    CHECK(max.normal <= LOG_MAX_ULP + REFERENCE_SLACK);
+    free(x);
+    free(out);
+}
+
+static void test_power_ulp(void) {
+    double *base = (double *)malloc(SWEEP * sizeof(double));
+    double *exponent = (double *)malloc(SWEEP * sizeof(double));
+    double *out = (double *)malloc(SWEEP * sizeof(double));
+    CHECK(base != NULL && exponent != NULL && out != NULL);
+    // Exponents chosen so the result stays finite: |y log x| up to 745
+    for (int i = 0; i < SWEEP; i++) {
+        base[i] = i % 2 == 0 ? rng_uniform(0.0, 4.0) + 0x1p-20
+                             : exp(rng_uniform(-700.0, 700.0));
+        double target = rng_uniform(-745.0, 709.0);
+        double lx = log(base[i]);
+        exponent[i] = fabs(lx) > 0x1p-30 ? target / lx : rng_uniform(-9, 9);
+        if (i % 5 == 0) {
+            exponent[i] = (double)(int)rng_uniform(-40.0, 40.0);
+        }
+    }
+    CHECK_STATUS(power_n(base, exponent, out, SWEEP), SUCCESS);
+
+    UlpMax max = {0.0, 0.0};
+    for (int i = 0; i < SWEEP; i++) {
+        ulp_record(&max, out[i],
+                   powl((long double)base[i], (long double)exponent[i]));
+    }
+    CHECK(max.normal <= POWER_MAX_ULP + REFERENCE_SLACK);
+    CHECK(max.subnormal <= SUBNORMAL_MAX_ULP + REFERENCE_SLACK);
+    free(base);
+    free(exponent);
+    free(out);
+}
+
+static const double specials[] = {
+    0.0,       -0.0,       1.0,         -1.0,    2.0,     -2.0,
+    0.5,       -0.5,       3.0,         -3.0,    0.1,     1024.0,
+    INFINITY,  -INFINITY,  NAN,         -NAN,    DBL_MAX, -DBL_MAX,
+    DBL_MIN,   -DBL_MIN,   0x1p-1074,   -0x1p-1074,
+    0x1.8p-1030, 1e300,    -1e300,      1e-300,
+    710.0,     -746.0,     709.7,       -745.1,
+};
+#define SPECIAL_COUNT (int)(sizeof(specials) / sizeof(specials[0]))
+
+// Lanes outside the fast paths give the C library result bit for bit;
+// the rest are within one ULP of it, with the same zero, infinity or NaN
+static int near_libm(double result, double expected, int special) {
+    if (special || expected == 0.0 || isinf(expected) || isnan(expected)) {
+        return same_bits(result, expected);
+    }
+    return ulp_error(result, expected) <= 1.0;
+}
+
+static void test_special_values(void) {
+    double out[SPECIAL_COUNT];
+    double row[SPECIAL_COUNT];
+
+    CHECK_STATUS(exp_n(specials, out, SPECIAL_COUNT), SUCCESS);
+    int exp_ok = 1;
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        exp_ok &= near_libm(out[i], exp(specials[i]), 0);
+    }
+    CHECK(exp_ok);
+    CHECK(out[1] == 1.0);
+
+    CHECK_STATUS(log_n(specials, out, SPECIAL_COUNT), SUCCESS);
+    int log_ok = 1;
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        const double x = specials[i];
+        log_ok &= near_libm(out[i], log(x), !(x > 0.0 && x < INFINITY));
+    }
+    CHECK(log_ok);
+    CHECK(out[0] == -INFINITY && out[1] == -INFINITY && isnan(out[3]));
+
+    CHECK_STATUS(sqrt_n(specials, out, SPECIAL_COUNT), SUCCESS);
+    int sqrt_ok = 1;
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        sqrt_ok &= same_bits(out[i], sqrt(specials[i]));
+    }
+    CHECK(sqrt_ok);
+    CHECK(signbit(out[1]));
+
+    // Every base against every exponent
+    int power_ok = 1;
+    for (int j = 0; j < SPECIAL_COUNT; j++) {
+        for (int i = 0; i < SPECIAL_COUNT; i++) {
+            row[i] = specials[j];
+        }
+        CHECK_STATUS(power_n(specials, row, out, SPECIAL_COUNT), SUCCESS);
+        for (int i = 0; i < SPECIAL_COUNT; i++) {
+            const double x = specials[i];
+            const double y = row[i];
+            const int special = !(x > 0.0 && x < INFINITY) || isnan(y);
+            const int ok = near_libm(out[i], pow(x, y), special);
+            if (!ok) {
+                fprintf(stderr, "power_n(%a, %a) = %a, pow gives %a\n", x, y,
+                        out[i], pow(x, y));
+            }
+            power_ok &= ok;
+        }
+    }
+    CHECK(power_ok);
+}
+
+static void test_elementwise_signs(void) {
+    double out[SPECIAL_COUNT];
+    double reversed[SPECIAL_COUNT];
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        reversed[i] = specials[SPECIAL_COUNT - 1 - i];
+    }
+
+    int ok = 1;
+    CHECK_STATUS(add_n(specials, reversed, out, SPECIAL_COUNT), SUCCESS);
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        ok &= same_bits(out[i], specials[i] + reversed[i]);
+    }
+    CHECK_STATUS(subtract_n(specials, reversed, out, SPECIAL_COUNT),
+                 SUCCESS);
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        ok &= same_bits(out[i], specials[i] - reversed[i]);
+    }
+    CHECK_STATUS(multiply_n(specials, reversed, out, SPECIAL_COUNT),
+                 SUCCESS);
+    for (int i = 0; i < SPECIAL_COUNT; i++) {
+        ok &= same_bits(out[i], specials[i] * reversed[i]);
+    }
+    CHECK(ok);
+
+    // -0 * 0 keeps its sign; products below the normal range are
+    // subnormal, not flushed
+    const double a[] = {-0.0, 0x1p-1000, -0x1p-540, 0x1p-1074};
+    const double b[] = {0.0, 0x1p-40, 0x1p-500, 0.5};
+    CHECK_STATUS(multiply_n(a, b, out, 4), SUCCESS);
+    CHECK(out[0] == 0.0 && signbit(out[0]));
+    CHECK(out[1] == 0x1p-1040 && out[2] == -0x1p-1040 && out[3] == 0.0);
+}
+
+// Zero divisors are flagged in zero_lanes and still divided, so their
+// lanes hold the IEEE result; the other lanes are plain quotients
+static void test_divide_zero_lanes(void) {
+    enum { N = 4099 };
+    double *a = (double *)malloc(N * sizeof(double));
+    double *b = (double *)malloc(N * sizeof(double));
+    double *out = (double *)malloc(N * sizeof(double));
+    double *expected = (double *)malloc(N * sizeof(double));
+    unsigned char *zero_lanes = (unsigned char *)malloc(N);
+    CHECK(a != NULL && b != NULL && out != NULL && expected != NULL &&
+          zero_lanes != NULL);
+
+    for (int i = 0; i < N; i++) {
+        a[i] = i % 7 == 3 ? 0.0 : rng_uniform(-2.0, 2.0);
+        b[i] = i % 13 == 0 ? (i % 26 == 0 ? 0.0 : -0.0)
+                           : rng_uniform(0.5, 3.0);
+        expected[i] = a[i] / b[i];
+    }
+
+    memset(zero_lanes, 0xaa, N);
+    CHECK_STATUS(divide_n(a, b, out, N, zero_lanes), ERROR_DIVISION_BY_ZERO);
+    int lanes_ok = 1, values_ok = 1;
+    for (int i = 0; i < N; i++) {
+        lanes_ok &= zero_lanes[i] == (i % 13 == 0);
+        values_ok &= same_bits(out[i], expected[i]);
+    }
+    CHECK(lanes_ok);
+    CHECK(values_ok);
+    CHECK(isnan(out[52]) && out[13] == copysign(INFINITY, -a[13]));
+
+    // No mask requested
+    CHECK_STATUS(divide_n(a, b, out, N, NULL), ERROR_DIVISION_BY_ZERO);
+
+    // The mask is taken before the quotients overwrite b
+    double *b_copy = (double *)malloc(N * sizeof(double));
+    CHECK(b_copy != NULL);
+    memcpy(b_copy, b, N * sizeof(double));
+    memset(zero_lanes, 0xaa, N);
+    CHECK_STATUS(divide_n(a, b, b, N, zero_lanes), ERROR_DIVISION_BY_ZERO);
+    lanes_ok = 1;
+    values_ok = 1;
+    for (int i = 0; i < N; i++) {
+        lanes_ok &= zero_lanes[i] == (b_copy[i] == 0.0);
+        values_ok &= same_bits(b[i], expected[i]);
+    }
+    CHECK(lanes_ok);
+    CHECK(values_ok);
+
+    // Nonzero divisors everywhere clear the whole mask
+    for (int i = 0; i < N; i++) {
+        b[i] = 1.0 + i;
+    }
+    memset(zero_lanes, 0xaa, N);
+    CHECK_STATUS(divide_n(a, b, out, N, zero_lanes), SUCCESS);
+    int cleared = 1;
+    for (int i = 0; i < N; i++) {
+        cleared &= zero_lanes[i] == 0;
+    }
+    CHECK(cleared);
+
+    free(a);
+    free(b);
+    free(b_copy);
+    free(out);
+    free(expected);
+    free(zero_lanes);
+}
+
+// Lengths that end in a partial group or block write exactly n results,
+// equal to the same elements computed as part of a longer call
+static void test_lengths(void) {
+    static const size_t lengths[] = {1, 2, 3, 5, 6, 7, 2047, 2049, 6147};
+    enum { MAX_LENGTH = 6147, GUARD = 5 };
+    static double x[MAX_LENGTH + GUARD], y[MAX_LENGTH + GUARD];
+    static double out[MAX_LENGTH + GUARD], full[MAX_LENGTH + GUARD];
+    static unsigned char zero_lanes[MAX_LENGTH + GUARD];
+    for (int i = 0; i < MAX_LENGTH + GUARD; i++) {
+        x[i] = rng_uniform(0.01, 20.0);
+        y[i] = rng_uniform(-5.0, 5.0);
+    }
+
+    typedef int (*Binary)(const double *, const double *, double *, size_t);
+    typedef int (*Unary)(const double *, double *, size_t);
+    static const Binary binaries[] = {add_n, subtract_n, multiply_n,
+                                      power_n};
+    static const Unary unaries[] = {sqrt_n, exp_n, log_n};
+
+    int exact = 1, guarded = 1;
+    for (int l = 0; l < (int)(sizeof(lengths) / sizeof(lengths[0])); l++) {
+        const size_t n = lengths[l];
+        for (int f = 0; f < 4 + 3 + 1; f++) {
+            for (int i = 0; i < MAX_LENGTH + GUARD; i++) {
+                out[i] = -1234.5;
+            }
+            if (f < 4) {
+                binaries[f](x, y, full, MAX_LENGTH + GUARD);
+                binaries[f](x, y, out, n);
+            } else if (f < 7) {
+                unaries[f - 4](x, full, MAX_LENGTH + GUARD);
+                unaries[f - 4](x, out, n);
+            } else {
+                divide_n(y, x, full, MAX_LENGTH + GUARD, NULL);
+                memset(zero_lanes, 7, sizeof(zero_lanes));
+                divide_n(y, x, out, n, zero_lanes);
+                guarded &= zero_lanes[n] == 7 && zero_lanes[n - 1] == 0;
+            }
+            for (size_t i = 0; i < n; i++) {
+                exact &= same_bits(out[i], full[i]);
+            }
+            for (size_t i = n; i < n + GUARD; i++) {
+                guarded &= out[i] == -1234.5;
+            }
+        }
+    }
+    CHECK(exact);
+    CHECK(guarded);
+
+    // Zero elements are a no-op
+    CHECK_STATUS(exp_n(x, out, 0), SUCCESS);
+    CHECK_STATUS(divide_n(x, y, out, 0, NULL), SUCCESS);
+    CHECK_STATUS(exp_n(NULL, out, 4), ERROR_NULL_POINTER);
+    CHECK_STATUS(power_n(x, NULL, out, 4), ERROR_NULL_POINTER);
+    CHECK_STATUS(divide_n(x, y, NULL, 4, NULL), ERROR_NULL_POINTER);
+}
+
+int main(void) {
+    // Inline, then split across pool workers
+    test_exp_ulp();
+    test_log_ulp();
+    test_power_ulp();
+    test_special_values();
+    test_elementwise_signs();
+    test_divide_zero_lanes();
+    test_lengths();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    thread_pool_set_min_work(1);
+    test_exp_ulp();
+    test_power_ulp();
+    test_divide_zero_lanes();
+    test_lengths();
+    thread_pool_shutdown();
+    return test_finish("test_basic");
+}
\ No newline at end of file
@@ -0,0 +1,303 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/matrix_batch.h"
+#include "../include/perf_counters.h"
+#include "../include/thread_pool.h"
+#include "test_util.h"
+
+// Matrix batch tests: every order against the scalar matrix_* functions,
+// batch counts that leave a partial SIMD group, results that are an
+// operand, and the batched operation counters
+
+// Counts around the 4 lanes of a group, and one large enough to split
+static const int counts[] = {1, 3, 4, 5, 7, 13, 67, 10001};
+#define COUNT_COUNT (int)(sizeof(counts) / sizeof(counts[0]))
+
+// Members filled one at a time through matrix_batch_set
+static void fill_batch(MatrixBatch *batch, unsigned seed) {
+    Matrix m;
+    CHECK_STATUS(matrix_create(batch->order, batch->order, &m), SUCCESS);
+    int status = SUCCESS;
+    for (int k = 0; k < batch->count; k++) {
+        test_fill_matrix(&m, seed + (unsigned)k, 0.0);
+        status |= matrix_batch_set(batch, k, &m);
+    }
+    CHECK_STATUS(status, SUCCESS);
+    matrix_free(&m);
+}
+
+static void fill_vector_batch(VectorBatch *batch, unsigned seed) {
+    Vector v;
+    CHECK_STATUS(vector_create(batch->size, &v), SUCCESS);
+    int status = SUCCESS;
+    for (int k = 0; k < batch->count; k++) {
+        test_fill_vector(&v, seed + (unsigned)k);
+        status |= vector_batch_set(batch, k, &v);
+    }
+    CHECK_STATUS(status, SUCCESS);
+    vector_free(&v);
+}
+
+static int same_batch(const double *a, const double *b, int planes,
+                      int stride, int count) {
+    for (int p = 0; p < planes; p++) {
+        if (memcmp(a + (size_t)p * stride, b + (size_t)p * stride,
+                   (size_t)count * sizeof(double)) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Each member against matrix_multiply, matrix_vector_multiply and
+// matrix_determinant on the same member; the closed forms and the scalar
+// paths may round differently
+static void test_against_scalar(void) {
+    for (int order = 1; order <= MATRIX_BATCH_MAX_ORDER; order++) {
+        for (int c = 0; c < COUNT_COUNT; c++) {
+            const int count = counts[c];
+            MatrixBatch a, b, product;
+            VectorBatch x, y;
+            Vector det;
+            CHECK_STATUS(matrix_batch_create(order, count, &a), SUCCESS);
+            CHECK_STATUS(matrix_batch_create(order, count, &b), SUCCESS);
+            CHECK_STATUS(matrix_batch_create(order, count, &product),
+                         SUCCESS);
+            CHECK_STATUS(vector_batch_create(order, count, &x), SUCCESS);
+            CHECK_STATUS(vector_batch_create(order, count, &y), SUCCESS);
+            CHECK_STATUS(vector_create(count, &det), SUCCESS);
+            fill_batch(&a, 10);
+            fill_batch(&b, 5000);
+            fill_vector_batch(&x, 20000);
+
+            CHECK_STATUS(matrix_multiply_batched(&a, &b, &product), SUCCESS);
+            CHECK_STATUS(matrix_vector_multiply_batched(&a, &x, &y), SUCCESS);
+            CHECK_STATUS(matrix_determinant_batched(&a, &det), SUCCESS);
+
+            double product_error = 0.0, vector_error = 0.0, det_error = 0.0;
+            Matrix ma, mb, expected, member;
+            Vector vx, vy, member_y;
+            CHECK_STATUS(matrix_create(order, order, &ma), SUCCESS);
+            CHECK_STATUS(matrix_create(order, order, &mb), SUCCESS);
+            CHECK_STATUS(matrix_create(order, order, &member), SUCCESS);
+            CHECK_STATUS(vector_create(order, &vx), SUCCESS);
+            CHECK_STATUS(vector_create(order, &member_y), SUCCESS);
+            int status = SUCCESS;
+            for (int k = 0; k < count; k++) {
+                status |= matrix_batch_get(&a, k, &ma);
+                status |= matrix_batch_get(&b, k, &mb);
+                status |= vector_batch_get(&x, k, &vx);
+                status |= matrix_batch_get(&product, k, &member);
+                status |= vector_batch_get(&y, k, &member_y);
+                if (status != SUCCESS) {
+                    break;
+                }
+
+                double d;
+                status |= matrix_multiply(&ma, &mb, &expected);
+                status |= matrix_vector_multiply(&ma, &vx, &vy);
+                status |= matrix_determinant(&ma, &d);
+                if (status != SUCCESS) {
+                    break;
+                }
+                product_error = fmax(product_error,
+                                     test_max_abs_diff(&expected, &member));
+                for (int i = 0; i < order; i++) {
+                    vector_error = fmax(vector_error,
+                                        fabs(vy.data[i] - member_y.data[i]));
+                }
+                det_error = fmax(det_error, fabs(d - det.data[k]));
+
+                matrix_free(&expected);
+                vector_free(&vy);
+            }
+            CHECK_STATUS(status, SUCCESS);
+            CHECK(product_error <= 1e-15);
+            CHECK(vector_error <= 1e-15);
+            CHECK(det_error <= 1e-15);
+
+            matrix_free(&ma);
+            matrix_free(&mb);
+            matrix_free(&member);
+            vector_free(&vx);
+            vector_free(&member_y);
+            matrix_batch_free(&a);
+            matrix_batch_free(&b);
+            matrix_batch_free(&product);
+            vector_batch_free(&x);
+            vector_batch_free(&y);
+            vector_free(&det);
+        }
+    }
+}
+
+// A result that is one of the operands gives the separate result bit for
+// bit
+static void test_in_place(void) {
+    for (int order = 1; order <= MATRIX_BATCH_MAX_ORDER; order++) {
+        for (int c = 0; c < COUNT_COUNT; c++) {
+            const int count = counts[c];
+            const int planes = order * order;
+            MatrixBatch a, b, expected;
+            VectorBatch x, expected_x;
+            CHECK_STATUS(matrix_batch_create(order, count, &a), SUCCESS);
+            CHECK_STATUS(matrix_batch_create(order, count, &b), SUCCESS);
+            CHECK_STATUS(matrix_batch_create(order, count, &expected),
+                         SUCCESS);
+            CHECK_STATUS(vector_batch_create(order, count, &x), SUCCESS);
+            CHECK_STATUS(vector_batch_create(order, count, &expected_x),
+                         SUCCESS);
+
+            fill_batch(&a, 30);
+            fill_batch(&b, 40);
+            CHECK_STATUS(matrix_multiply_batched(&a, &b, &expected), SUCCESS);
+            CHECK_STATUS(matrix_multiply_batched(&a, &b, &a), SUCCESS);
+            CHECK(same_batch(a.data, expected.data, planes, a.stride, count));
+
+            fill_batch(&a, 30);
+            CHECK_STATUS(matrix_multiply_batched(&a, &b, &b), SUCCESS);
+            CHECK(same_batch(b.data, expected.data, planes, b.stride, count));
+
+            // Squaring every member in place
+            fill_batch(&a, 50);
+            CHECK_STATUS(matrix_multiply_batched(&a, &a, &expected), SUCCESS);
+            CHECK_STATUS(matrix_multiply_batched(&a, &a, &a), SUCCESS);
+            CHECK(same_batch(a.data, expected.data, planes, a.stride, count));
+
+            fill_batch(&a, 60);
+            fill_vector_batch(&x, 70);
+            CHECK_STATUS(matrix_vector_multiply_batched(&a, &x, &expected_x),
+                         SUCCESS);
+            CHECK_STATUS(matrix_vector_multiply_batched(&a, &x, &x), SUCCESS);
+            CHECK(same_batch(x.data, expected_x.data, order, x.stride,
+                             count));
+
+            matrix_batch_free(&a);
+            matrix_batch_free(&b);
+            matrix_batch_free(&expected);
+            vector_batch_free(&x);
+            vector_batch_free(&expected_x);
+        }
+    }
+}
+
+#define PARTIAL_COUNT 6
+
+// The partial last group leaves the lanes past count alone: the
+// determinant writes only count values, and padding lanes of the planes
+// stay zero
+static void test_partial_group(void) {
+    const int count = PARTIAL_COUNT;
+    MatrixBatch a, product;
+    CHECK_STATUS(matrix_batch_create(3, count, &a), SUCCESS);
+    CHECK_STATUS(matrix_batch_create(3, count, &product), SUCCESS);
+    fill_batch(&a, 80);
+
+    double storage[PARTIAL_COUNT + 2];
+    for (int i = 0; i < count + 2; i++) {
+        storage[i] = -7.0;
+    }
+    Vector det = {count, storage + 1, NULL};
+    CHECK_STATUS(matrix_determinant_batched(&a, &det), SUCCESS);
+    CHECK(storage[0] == -7.0 && storage[count + 1] == -7.0);
+
+    CHECK_STATUS(matrix_multiply_batched(&a, &a, &product), SUCCESS);
+    int padding_zero = 1;
+    for (int p = 0; p < 9; p++) {
+        for (int k = count; k < product.stride; k++) {
+            padding_zero &= product.data[(size_t)p * product.stride + k] == 0.0;
+        }
+    }
+    CHECK(padding_zero);
+
+    matrix_batch_free(&a);
+    matrix_batch_free(&product);
+}
+
+static void test_errors(void) {
+    MatrixBatch a, b3, b_count;
+    VectorBatch x;
+    Vector det;
+    CHECK_STATUS(matrix_batch_create(0, 4, &a), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_batch_create(MATRIX_BATCH_MAX_ORDER + 1, 4, &a),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_batch_create(2, 4, &a), SUCCESS);
+    CHECK_STATUS(matrix_batch_create(3, 4, &b3), SUCCESS);
+    CHECK_STATUS(matrix_batch_create(2, 5, &b_count), SUCCESS);
+    CHECK_STATUS(vector_batch_create(3, 4, &x), SUCCESS);
+    CHECK_STATUS(vector_create(5, &det), SUCCESS);
+
+    CHECK_STATUS(matrix_multiply_batched(&a, &b3, &a),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_multiply_batched(&a, &b_count, &a),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_multiply_batched(&a, NULL, &a), ERROR_NULL_POINTER);
+    CHECK_STATUS(matrix_vector_multiply_batched(&a, &x, &x),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_determinant_batched(&a, &det),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_determinant_batched(NULL, &det), ERROR_NULL_POINTER);
+
+    matrix_batch_free(&a);
+    matrix_batch_free(&b3);
+    matrix_batch_free(&b_count);
+    vector_batch_free(&x);
+    vector_free(&det);
+}
+
+// Each batched op counts one call, with flops from the closed forms
+static void test_counters(void) {
+    const int count = 9;
+    MatrixBatch a, product;
+    VectorBatch x, y;
+    Vector det;
+    CHECK_STATUS(matrix_batch_create(4, count, &a), SUCCESS);
+    CHECK_STATUS(matrix_batch_create(4, count, &product), SUCCESS);
+    CHECK_STATUS(vector_batch_create(4, count, &x), SUCCESS);
+    CHECK_STATUS(vector_batch_create(4, count, &y), SUCCESS);
+    CHECK_STATUS(vector_create(count, &det), SUCCESS);
+    fill_batch(&a, 90);
+
+    perf_counters_enable(1);
+    perf_reset();
+    CHECK_STATUS(matrix_multiply_batched(&a, &a, &product), SUCCESS);
+    CHECK_STATUS(matrix_vector_multiply_batched(&a, &x, &y), SUCCESS);
+    CHECK_STATUS(matrix_determinant_batched(&a, &det), SUCCESS);
+    // Rejected calls are not counted
+    Vector no_data = {count, NULL, NULL};
+    CHECK_STATUS(matrix_determinant_batched(&a, &no_data), ERROR_NULL_POINTER);
+    PerfSnapshot snapshot;
+    CHECK_STATUS(perf_snapshot(&snapshot), SUCCESS);
+    perf_counters_enable(0);
+
+    CHECK(snapshot.ops[PERF_OP_BATCH_MULTIPLY].calls == 1);
+    CHECK(snapshot.ops[PERF_OP_BATCH_VECTOR_MULTIPLY].calls == 1);
+    const PerfOpCounters *d = &snapshot.ops[PERF_OP_BATCH_DETERMINANT];
+    CHECK(d->calls == 1);
+    CHECK(d->flops == 47u * count);
+    CHECK(d->bytes == 8u * 17u * count);
+    CHECK(strcmp(perf_op_name(PERF_OP_BATCH_DETERMINANT),
+                 "matrix_determinant_batched") == 0);
+
+    matrix_batch_free(&a);
+    matrix_batch_free(&product);
+    vector_batch_free(&x);
+    vector_batch_free(&y);
+    vector_free(&det);
+}
+
+int main(void) {
+    // Inline, then split across pool workers
+    test_against_scalar();
+    test_in_place();
+    test_partial_group();
+    test_errors();
+    test_counters();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    thread_pool_set_min_work(1);
+    test_against_scalar();
+    test_in_place();
+    thread_pool_shutdown();
+    return test_finish("test_batch");
+}
\ No newline at end of file
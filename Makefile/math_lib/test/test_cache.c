@@ -0,0 +1,499 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/async_queue.h"
+#include "../include/math_plan.h"
+#include "../include/matrix_batch.h"
+#include "../include/matrix_cache.h"
+#include "../include/matrix_lu.h"
+#include "../include/matrix_math.h"
+#include "../include/typed_math.h"
+#include "test_util.h"
+
+// Factorization cache tests: invalidation by every library writer, views,
+// LRU eviction and results identical to the uncached functions
+
+#define WRITER_ORDER 4
+
+typedef int (*WriterFn)(Matrix *m, const Matrix *other);
+
+static int write_copy(Matrix *m, const Matrix *other) {
+    return matrix_copy(other, m);
+}
+
+static int write_add(Matrix *m, const Matrix *other) {
+    return matrix_add_into(m, other, m);
+}
+
+static int write_subtract(Matrix *m, const Matrix *other) {
+    return matrix_subtract_into(m, other, m);
+}
+
+static int write_scale(Matrix *m, const Matrix *other) {
+    (void)other;
+    return matrix_scale_into(m, 2.0, m);
+}
+
+static int write_scale_inplace(Matrix *m, const Matrix *other) {
+    (void)other;
+    return matrix_scale_inplace(m, 2.0);
+}
+
+static int write_axpy(Matrix *m, const Matrix *other) {
+    return matrix_axpy(0.5, other, m);
+}
+
+static int write_transpose(Matrix *m, const Matrix *other) {
+    return matrix_transpose_into(other, m);
+}
+
+static int write_transpose_inplace(Matrix *m, const Matrix *other) {
+    (void)other;
+    return matrix_transpose_inplace(m);
+}
+
+static int write_multiply(Matrix *m, const Matrix *other) {
+    return matrix_multiply_into(1.0, other, other, 0.5, m);
+}
+
+static int write_lu_solve(Matrix *m, const Matrix *other) {
+    MatrixLU lu;
+    int status = matrix_lu(other, &lu);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = matrix_lu_solve_matrix_into(&lu, m, m);
+    matrix_lu_free(&lu);
+    return status;
+}
+
+static int write_sparse_to_dense(Matrix *m, const Matrix *other) {
+    SparseMatrix s;
+    int status = sparse_matrix_from_dense(other, SPARSE_CSR, &s);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = sparse_matrix_to_dense_into(&s, m);
+    sparse_matrix_free(&s);
+    return status;
+}
+
+static int write_sparse_multiply(Matrix *m, const Matrix *other) {
+    SparseMatrix s;
+    int status = sparse_matrix_from_dense(other, SPARSE_CSR, &s);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = sparse_matrix_multiply_into(1.0, &s, other, 1.0, m);
+    sparse_matrix_free(&s);
+    return status;
+}
+
+static int write_batch_get(Matrix *m, const Matrix *other) {
+    MatrixBatch batch;
+    int status = matrix_batch_create(WRITER_ORDER, 1, &batch);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = matrix_batch_set(&batch, 0, other);
+    if (status == SUCCESS) {
+        status = matrix_batch_get(&batch, 0, m);
+    }
+    matrix_batch_free(&batch);
+    return status;
+}
+
+static int write_f32_to_double(Matrix *m, const Matrix *other) {
+    MatrixF32 f;
+    int status = matrix_f32_create(m->rows, m->cols, &f);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = matrix_f32_from_double(other, &f);
+    if (status == SUCCESS) {
+        status = matrix_f32_to_double(&f, m);
+    }
+    matrix_f32_free(&f);
+    return status;
+}
+
+static int write_plan_add(Matrix *m, const Matrix *other) {
+    MathPlan plan;
+    int status = matrix_plan_add(&plan, m, other, m);
+    return status == SUCCESS ? math_plan_run(&plan) : status;
+}
+
+static int write_plan_multiply(Matrix *m, const Matrix *other) {
+    MathPlan plan;
+    int status = matrix_plan_multiply(&plan, 1.0, other, other, 0.5, m);
+    return status == SUCCESS ? math_plan_run(&plan) : status;
+}
+
+static int write_async_multiply(Matrix *m, const Matrix *other) {
+    AsyncQueue queue;
+    int status = async_queue_init(&queue, 4);
+    if (status != SUCCESS) {
+        return status;
+    }
+    status = async_matrix_multiply(&queue, 1.0, other, other, 0.5, m, NULL);
+    if (status == SUCCESS) {
+        status = async_wait_all(&queue);
+    }
+    async_queue_destroy(&queue);
+    return status;
+}
+
+static const struct {
+    const char *name;
+    WriterFn write;
+} writers[] = {
+    {"matrix_copy", write_copy},
+    {"matrix_add_into", write_add},
+    {"matrix_subtract_into", write_subtract},
+    {"matrix_scale_into", write_scale},
+    {"matrix_scale_inplace", write_scale_inplace},
+    {"matrix_axpy", write_axpy},
+    {"matrix_transpose_into", write_transpose},
+    {"matrix_transpose_inplace", write_transpose_inplace},
+    {"matrix_multiply_into", write_multiply},
+    {"matrix_lu_solve_matrix_into", write_lu_solve},
+    {"sparse_matrix_to_dense_into", write_sparse_to_dense},
+    {"sparse_matrix_multiply_into", write_sparse_multiply},
+    {"matrix_batch_get", write_batch_get},
+    {"matrix_f32_to_double", write_f32_to_double},
+    {"matrix_plan_add", write_plan_add},
+    {"matrix_plan_multiply", write_plan_multiply},
+    {"async_matrix_multiply", write_async_multiply},
+};
+
+static int same_double(double a, double b) {
+    return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+// Determinant and inverse computed without any cache
+static void uncached(const Matrix *m, double *det, Matrix *inverse) {
+    MatrixLU lu;
+    CHECK_STATUS(matrix_lu(m, &lu), SUCCESS);
+    CHECK_STATUS(matrix_lu_determinant(&lu, det), SUCCESS);
+    matrix_lu_free(&lu);
+    CHECK_STATUS(matrix_inverse(m, inverse), SUCCESS);
+}
+
+static void test_writers_invalidate(void) {
+    MatrixCache cache;
+    CHECK_STATUS(matrix_cache_init(&cache, 16, 0), SUCCESS);
+
+    Matrix m, other;
+    CHECK_STATUS(matrix_create(WRITER_ORDER, WRITER_ORDER, &m), SUCCESS);
+    CHECK_STATUS(matrix_create(WRITER_ORDER, WRITER_ORDER, &other), SUCCESS);
+    test_fill_matrix(&other, 7, 2.0);
+
+    for (size_t w = 0; w < sizeof(writers) / sizeof(writers[0]); w++) {
+        const int failures = test_failures;
+        test_fill_matrix(&m, 1, 3.0);
+
+        // Prime both kinds of entry for the old contents
+        double stale_det;
+        Matrix stale_inverse;
+        CHECK_STATUS(matrix_cache_determinant(&cache, &m, &stale_det),
+                     SUCCESS);
+        CHECK_STATUS(matrix_cache_inverse(&cache, &m, &stale_inverse),
+                     SUCCESS);
+
+        const uint64_t version = m.version;
+        CHECK_STATUS(writers[w].write(&m, &other), SUCCESS);
+        CHECK(m.version != version);
+
+        double det, fresh_det;
+        Matrix inverse, fresh_inverse;
+        uncached(&m, &fresh_det, &fresh_inverse);
+        CHECK_STATUS(matrix_cache_determinant(&cache, &m, &det), SUCCESS);
+        CHECK_STATUS(matrix_cache_inverse(&cache, &m, &inverse), SUCCESS);
+        CHECK(same_double(det, fresh_det));
+        CHECK(test_matrix_equal(&inverse, &fresh_inverse));
+        // The write changed the contents, so a stale answer would show
+        CHECK(!test_matrix_equal(&inverse, &stale_inverse));
+
+        if (test_failures != failures) {
+            fprintf(stderr, "  after writer %s\n", writers[w].name);
+        }
+        matrix_free(&stale_inverse);
+        matrix_free(&inverse);
+        matrix_free(&fresh_inverse);
+    }
+
+    matrix_free(&m);
+    matrix_free(&other);
+    matrix_cache_destroy(&cache);
+}
+
+static void test_views_not_cached(void) {
+    MatrixCache cache;
+    CHECK_STATUS(matrix_cache_init(&cache, 16, 0), SUCCESS);
+
+    Matrix m;
+    CHECK_STATUS(matrix_create(32, 32, &m), SUCCESS);
+    test_fill_matrix(&m, 3, 4.0);
+    CHECK(m.id != 0);
+
+    Matrix block, transposed;
+    CHECK_STATUS(matrix_view(&m, 0, 0, 16, 16, &block), SUCCESS);
+    CHECK_STATUS(matrix_transpose_view(&m, &transposed), SUCCESS);
+    CHECK(block.id == 0);
+    CHECK(transposed.id == 0);
+
+    double det, fresh_det;
+    Matrix inverse, fresh_inverse;
+    uncached(&transposed, &fresh_det, &fresh_inverse);
+    for (int pass = 0; pass < 2; pass++) {
+        CHECK_STATUS(matrix_cache_determinant(&cache, &transposed, &det),
+                     SUCCESS);
+        CHECK(same_double(det, fresh_det));
+        CHECK_STATUS(matrix_cache_inverse(&cache, &transposed, &inverse),
+                     SUCCESS);
+        CHECK(test_matrix_equal(&inverse, &fresh_inverse));
+        matrix_free(&inverse);
+        CHECK_STATUS(matrix_cache_determinant(&cache, &block, &det),
+                     SUCCESS);
+    }
+    matrix_free(&fresh_inverse);
+
+    MatrixCacheStats stats;
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 0);
+    CHECK(stats.bytes == 0);
+    CHECK(stats.hits == 0);
+
+    // The plain API never routes a view through an enabled cache
+    CHECK(matrix_cache_enable(&cache) == NULL);
+    CHECK(matrix_cache_for(&block) == NULL);
+    CHECK(matrix_cache_for(&transposed) == NULL);
+    CHECK(matrix_cache_for(&m) == &cache);
+    CHECK_STATUS(matrix_determinant(&transposed, &det), SUCCESS);
+    CHECK(same_double(det, fresh_det));
+    CHECK(matrix_cache_enable(NULL) == &cache);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 0);
+
+    matrix_free(&m);
+    matrix_cache_destroy(&cache);
+}
+
+static void test_evict_max_entries(void) {
+    MatrixCache cache;
+    CHECK_STATUS(matrix_cache_init(&cache, 3, 0), SUCCESS);
+
+    Matrix m[4];
+    for (int i = 0; i < 4; i++) {
+        CHECK_STATUS(matrix_create(4, 4, &m[i]), SUCCESS);
+        test_fill_matrix(&m[i], 11 + (unsigned)i, 2.0);
+    }
+
+    double det;
+    MatrixCacheStats stats;
+    for (int i = 0; i < 3; i++) {
+        CHECK_STATUS(matrix_cache_determinant(&cache, &m[i], &det), SUCCESS);
+    }
+    // m[0] becomes the most recently used, leaving m[1] the coldest
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[0], &det), SUCCESS);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[3], &det), SUCCESS);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 3);
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 4);
+
+    // m[0], m[2] and m[3] are still cached
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[0], &det), SUCCESS);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[2], &det), SUCCESS);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[3], &det), SUCCESS);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.hits == 4);
+    CHECK(stats.misses == 4);
+
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[1], &det), SUCCESS);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.misses == 5);
+    CHECK(stats.entries == 3);
+
+    matrix_cache_forget(&cache, &m[1]);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 2);
+    matrix_cache_clear(&cache);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 0);
+    CHECK(stats.bytes == 0);
+
+    for (int i = 0; i < 4; i++) {
+        matrix_free(&m[i]);
+    }
+    matrix_cache_destroy(&cache);
+}
+
+static void test_evict_max_bytes(void) {
+    Matrix m[3];
+    for (int i = 0; i < 3; i++) {
+        CHECK_STATUS(matrix_create(8, 8, &m[i]), SUCCESS);
+        test_fill_matrix(&m[i], 21 + (unsigned)i, 2.0);
+    }
+
+    // Size of one LU entry
+    MatrixCache cache;
+    MatrixCacheStats stats;
+    double det, fresh_det;
+    CHECK_STATUS(matrix_cache_init(&cache, 16, 0), SUCCESS);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[0], &det), SUCCESS);
+    matrix_cache_stats(&cache, &stats);
+    const size_t entry_bytes = stats.bytes;
+    CHECK(entry_bytes > 0);
+    matrix_cache_destroy(&cache);
+
+    // Room for two entries
+    CHECK_STATUS(matrix_cache_init(&cache, 16, entry_bytes * 5 / 2),
+                 SUCCESS);
+    for (int i = 0; i < 3; i++) {
+        CHECK_STATUS(matrix_cache_determinant(&cache, &m[i], &det), SUCCESS);
+    }
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 2);
+    CHECK(stats.bytes == 2 * entry_bytes);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[0], &det), SUCCESS);
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.hits == 0);
+    CHECK(stats.misses == 4);
+    matrix_cache_destroy(&cache);
+
+    // A result larger than the whole budget is returned but not kept
+    CHECK_STATUS(matrix_cache_init(&cache, 16, entry_bytes / 2), SUCCESS);
+    MatrixLU lu;
+    CHECK_STATUS(matrix_lu(&m[1], &lu), SUCCESS);
+    CHECK_STATUS(matrix_lu_determinant(&lu, &fresh_det), SUCCESS);
+    matrix_lu_free(&lu);
+    CHECK_STATUS(matrix_cache_determinant(&cache, &m[1], &det), SUCCESS);
+    CHECK(same_double(det, fresh_det));
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.entries == 0);
+    CHECK(stats.bytes == 0);
+    matrix_cache_destroy(&cache);
+
+    for (int i = 0; i < 3; i++) {
+        matrix_free(&m[i]);
+    }
+}
+
+static int same_vector(const Vector *a, const Vector *b) {
+    return a->size == b->size &&
+           memcmp(a->data, b->data, (size_t)a->size * sizeof(double)) == 0;
+}
+
+// Sizes on both sides of the LU block size
+static void test_bitwise_equal(void) {
+    static const int orders[] = {16, 63, 64, 65, 130};
+
+    MatrixCache cache;
+    CHECK_STATUS(matrix_cache_init(&cache, 16, 0), SUCCESS);
+
+    for (size_t k = 0; k < sizeof(orders) / sizeof(orders[0]); k++) {
+        const int n = orders[k];
+        Matrix m;
+        Vector b;
+        CHECK_STATUS(matrix_create(n, n, &m), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        test_fill_matrix(&m, 31 + (unsigned)n, 1.0);
+        test_fill_vector(&b, 5);
+
+        double fresh_det;
+        Matrix fresh_inverse;
+        Vector fresh_x;
+        uncached(&m, &fresh_det, &fresh_inverse);
+        CHECK_STATUS(matrix_solve(&m, &b, &fresh_x), SUCCESS);
+
+        // Explicit cache calls: a miss, then a hit
+        for (int pass = 0; pass < 2; pass++) {
+            double det;
+            Matrix inverse;
+            Vector x;
+            CHECK_STATUS(matrix_cache_determinant(&cache, &m, &det),
+                         SUCCESS);
+            CHECK(same_double(det, fresh_det));
+            CHECK_STATUS(matrix_cache_solve(&cache, &m, &b, &x), SUCCESS);
+            CHECK(same_vector(&x, &fresh_x));
+            CHECK_STATUS(matrix_cache_inverse(&cache, &m, &inverse),
+                         SUCCESS);
+            CHECK(test_matrix_equal(&inverse, &fresh_inverse));
+            vector_free(&x);
+            matrix_free(&inverse);
+        }
+
+        // The plain API routed through the enabled cache
+        matrix_cache_clear(&cache);
+        matrix_cache_enable(&cache);
+        for (int pass = 0; pass < 2; pass++) {
+            double det;
+            Matrix inverse;
+            Vector x;
+            CHECK_STATUS(matrix_determinant(&m, &det), SUCCESS);
+            CHECK(same_double(det, fresh_det));
+            CHECK_STATUS(matrix_solve(&m, &b, &x), SUCCESS);
+            CHECK(same_vector(&x, &fresh_x));
+            CHECK_STATUS(matrix_inverse(&m, &inverse), SUCCESS);
+            CHECK(test_matrix_equal(&inverse, &fresh_inverse));
+            vector_free(&x);
+            matrix_free(&inverse);
+        }
+        matrix_cache_enable(NULL);
+
+        MatrixCacheStats stats;
+        matrix_cache_stats(&cache, &stats);
+        CHECK(stats.entries == 2);
+
+        matrix_free(&m);
+        matrix_free(&fresh_inverse);
+        vector_free(&b);
+        vector_free(&fresh_x);
+    }
+
+    matrix_cache_destroy(&cache);
+}
+
+// An enabled cache must not serve the determinant of overwritten contents
+static void test_plain_api_refreshes(void) {
+    MatrixCache cache;
+    CHECK_STATUS(matrix_cache_init(&cache, 16, 0), SUCCESS);
+    matrix_cache_enable(&cache);
+
+    const int n = MATRIX_CACHE_MIN_ORDER;
+    Matrix m;
+    CHECK_STATUS(matrix_create(n, n, &m), SUCCESS);
+    for (int i = 0; i < n; i++) {
+        MATRIX_AT(&m, i, i) = 1.0;
+    }
+    matrix_mark_modified(&m);
+
+    double det;
+    CHECK_STATUS(matrix_determinant(&m, &det), SUCCESS);
+    CHECK(det == 1.0);
+    CHECK_STATUS(matrix_determinant(&m, &det), SUCCESS);
+    CHECK(det == 1.0);
+    CHECK_STATUS(matrix_scale_inplace(&m, 2.0), SUCCESS);
+    CHECK_STATUS(matrix_determinant(&m, &det), SUCCESS);
+    CHECK(det == 65536.0);
+
+    MatrixCacheStats stats;
+    matrix_cache_stats(&cache, &stats);
+    CHECK(stats.hits == 1);
+    CHECK(stats.misses == 2);
+
+    matrix_cache_enable(NULL);
+    matrix_free(&m);
+    matrix_cache_destroy(&cache);
+}
+
+int main(void) {
+    test_writers_invalidate();
+    test_views_not_cached();
+    test_evict_max_entries();
+    test_evict_max_bytes();
+    test_bitwise_equal();
+    test_plain_api_refreshes();
+    return test_finish("test_cache");
+}
\ No newline at end of file
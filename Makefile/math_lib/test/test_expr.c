@@ -0,0 +1,288 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/thread_pool.h"
+#include "../include/vector_expr.h"
+#include "test_util.h"
+
+// Vector expression tests: the node limit and malformed node lists,
+// evaluation over several blocks and a tail, results aliasing an input,
+// and reductions that do not depend on the thread count
+
+// Around the 256-element block, and past the 64 partials kept on the stack
+static const int sizes[] = {1, 255, 256, 257, 3 * 256 + 17, 64 * 256,
+                            64 * 256 + 5, 100003};
+#define SIZE_COUNT (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+static int same_data(const double *a, const double *b, int n) {
+    return memcmp(a, b, (size_t)n * sizeof(double)) == 0;
+}
+
+// (a + b) * 0.5 - a * c / (b + 2), element by element in the same order
+static double reference_element(double a, double b, double c) {
+    return (a + b) * 0.5 - a * c / (b + 2.0);
+}
+
+static int build_expression(VectorExpr *e, const Vector *a, const Vector *b,
+                            const Vector *c) {
+    vector_expr_init(e);
+    int x = vector_expr_input(e, a);
+    int y = vector_expr_input(e, b);
+    int z = vector_expr_input(e, c);
+    int half = vector_expr_scale(e, vector_expr_add(e, x, y), 0.5);
+    int shifted = vector_expr_add(e, y, vector_expr_constant(e, 2.0));
+    int ratio = vector_expr_divide(e, vector_expr_multiply(e, x, z), shifted);
+    return vector_expr_subtract(e, half, ratio);
+}
+
+static void test_eval(void) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        const int n = sizes[s];
+        Vector a, b, c, result;
+        CHECK_STATUS(vector_create(n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        CHECK_STATUS(vector_create(n, &c), SUCCESS);
+        CHECK_STATUS(vector_create(n, &result), SUCCESS);
+        test_fill_vector(&a, 1 + (unsigned)s);
+        test_fill_vector(&b, 20 + (unsigned)s);
+        test_fill_vector(&c, 40 + (unsigned)s);
+
+        VectorExpr e;
+        int root = build_expression(&e, &a, &b, &c);
+        CHECK(root >= 0);
+        CHECK_STATUS(vector_expr_eval(&e, root, &result), SUCCESS);
+        int exact = 1;
+        long double sum = 0.0L, dot = 0.0L;
+        for (int i = 0; i < n; i++) {
+            double expected =
+                reference_element(a.data[i], b.data[i], c.data[i]);
+            exact &= result.data[i] == expected;
+            sum += expected;
+            dot += (long double)expected * c.data[i];
+        }
+        CHECK(exact);
+
+        // Reductions agree with the materialized result
+        double expr_sum, expr_dot;
+        CHECK_STATUS(vector_expr_sum(&e, root, &expr_sum), SUCCESS);
+        CHECK_STATUS(vector_expr_dot(&e, root, 2, &expr_dot), SUCCESS);
+        CHECK(fabs(expr_sum - (double)sum) <= 1e-15 * n);
+        CHECK(fabs(expr_dot - (double)dot) <= 1e-15 * n);
+
+        vector_free(&a);
+        vector_free(&b);
+        vector_free(&c);
+        vector_free(&result);
+    }
+}
+
+// The result may be any of the inputs, including one read by several
+// nodes
+static void test_aliasing(void) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        const int n = sizes[s];
+        Vector a, b, c, expected;
+        CHECK_STATUS(vector_create(n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        CHECK_STATUS(vector_create(n, &c), SUCCESS);
+        CHECK_STATUS(vector_create(n, &expected), SUCCESS);
+
+        for (int target = 0; target < 3; target++) {
+            test_fill_vector(&a, 60 + (unsigned)s);
+            test_fill_vector(&b, 70 + (unsigned)s);
+            test_fill_vector(&c, 80 + (unsigned)s);
+            VectorExpr e;
+            int root = build_expression(&e, &a, &b, &c);
+            CHECK_STATUS(vector_expr_eval(&e, root, &expected), SUCCESS);
+            Vector *result = target == 0 ? &a : target == 1 ? &b : &c;
+            CHECK_STATUS(vector_expr_eval(&e, root, result), SUCCESS);
+            CHECK(same_data(result->data, expected.data, n));
+        }
+
+        // An input as the root, written onto itself and onto another input
+        test_fill_vector(&a, 90 + (unsigned)s);
+        memcpy(expected.data, a.data, (size_t)n * sizeof(double));
+        VectorExpr e;
+        vector_expr_init(&e);
+        int x = vector_expr_input(&e, &a);
+        CHECK_STATUS(vector_expr_eval(&e, x, &a), SUCCESS);
+        CHECK(same_data(a.data, expected.data, n));
+        CHECK_STATUS(vector_expr_eval(&e, x, &b), SUCCESS);
+        CHECK(same_data(b.data, expected.data, n));
+
+        vector_free(&a);
+        vector_free(&b);
+        vector_free(&c);
+        vector_free(&expected);
+    }
+}
+
+static void test_node_limit(void) {
+    Vector v, result;
+    CHECK_STATUS(vector_create(300, &v), SUCCESS);
+    CHECK_STATUS(vector_create(300, &result), SUCCESS);
+    test_fill_vector(&v, 5);
+
+    // One input and fifteen scales fill the expression
+    VectorExpr e;
+    vector_expr_init(&e);
+    int node = vector_expr_input(&e, &v);
+    for (int i = 1; i < VECTOR_EXPR_MAX_NODES; i++) {
+        node = vector_expr_scale(&e, node, 2.0);
+        CHECK(node == i);
+    }
+    CHECK(e.count == VECTOR_EXPR_MAX_NODES);
+    CHECK_STATUS(vector_expr_eval(&e, node, &result), SUCCESS);
+    int exact = 1;
+    for (int i = 0; i < v.size; i++) {
+        exact &= result.data[i] == ldexp(v.data[i], VECTOR_EXPR_MAX_NODES - 1);
+    }
+    CHECK(exact);
+
+    // Every builder rejects a seventeenth node, and the error passes
+    // through calls that nest it
+    CHECK_STATUS(vector_expr_input(&e, &v), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_constant(&e, 1.0), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_scale(&e, 0, 1.0), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_add(&e, 0, 1), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_divide(&e, vector_expr_constant(&e, 1.0), 0),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(e.count == VECTOR_EXPR_MAX_NODES);
+    double sum;
+    CHECK_STATUS(vector_expr_sum(&e, vector_expr_scale(&e, node, 2.0), &sum),
+                 ERROR_INVALID_DIMENSION);
+
+    vector_free(&v);
+    vector_free(&result);
+}
+
+static void test_malformed(void) {
+    Vector a, b, result;
+    CHECK_STATUS(vector_create(40, &a), SUCCESS);
+    CHECK_STATUS(vector_create(41, &b), SUCCESS);
+    CHECK_STATUS(vector_create(40, &result), SUCCESS);
+    test_fill_vector(&a, 7);
+    double value;
+
+    // Operands must already exist
+    VectorExpr e;
+    vector_expr_init(&e);
+    int x = vector_expr_input(&e, &a);
+    CHECK_STATUS(vector_expr_add(&e, x, 1), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_subtract(&e, 5, x), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_scale(&e, 1, 2.0), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_multiply(&e, x, ERROR_NULL_POINTER),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_expr_input(&e, &b), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_input(&e, NULL), ERROR_NULL_POINTER);
+    CHECK(e.count == 1);
+    CHECK_STATUS(vector_expr_eval(&e, 1, &result), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_eval(&e, -3, &result), -3);
+    CHECK_STATUS(vector_expr_dot(&e, x, 1, &value), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_eval(&e, x, &b), ERROR_INVALID_DIMENSION);
+
+    // Reductions need an input to fix the size; eval takes it from the
+    // result
+    VectorExpr constant;
+    vector_expr_init(&constant);
+    int one = vector_expr_constant(&constant, 1.5);
+    CHECK_STATUS(vector_expr_sum(&constant, one, &value),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_expr_eval(&constant, one, &b), SUCCESS);
+    CHECK(b.data[0] == 1.5 && b.data[40] == 1.5);
+
+    // Node lists the builders cannot produce are rejected at evaluation
+    vector_expr_init(&e);
+    x = vector_expr_input(&e, &a);
+    int sum = vector_expr_add(&e, x, x);
+    CHECK_STATUS(vector_expr_eval(&e, sum, &result), SUCCESS);
+
+    VectorExpr bad = e;
+    bad.nodes[sum].b = sum;
+    CHECK_STATUS(vector_expr_eval(&bad, sum, &result),
+                 ERROR_INVALID_DIMENSION);
+    bad = e;
+    bad.nodes[sum].a = -1;
+    CHECK_STATUS(vector_expr_sum(&bad, sum, &value), ERROR_INVALID_DIMENSION);
+    bad = e;
+    bad.nodes[sum].op = (VectorExprOp)42;
+    CHECK_STATUS(vector_expr_dot(&bad, sum, x, &value),
+                 ERROR_INVALID_DIMENSION);
+    bad = e;
+    bad.nodes[x].a = sum;
+    CHECK_STATUS(vector_expr_eval(&bad, sum, &result),
+                 ERROR_INVALID_DIMENSION);
+    bad = e;
+    bad.nodes[x].data = NULL;
+    CHECK_STATUS(vector_expr_eval(&bad, sum, &result), ERROR_NULL_POINTER);
+    bad = e;
+    bad.count = VECTOR_EXPR_MAX_NODES + 1;
+    CHECK_STATUS(vector_expr_eval(&bad, sum, &result),
+                 ERROR_INVALID_DIMENSION);
+    bad = e;
+    bad.count = -1;
+    CHECK_STATUS(vector_expr_sum(&bad, sum, &value), ERROR_INVALID_DIMENSION);
+
+    vector_free(&a);
+    vector_free(&b);
+    vector_free(&result);
+}
+
+// Partials are added in block order, so every pool size gives the inline
+// result bit for bit
+static void test_deterministic_reductions(void) {
+    static const int threads[] = {2, 3, 4, 7};
+    const size_t saved_min_work = thread_pool_min_work();
+
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        const int n = sizes[s];
+        Vector a, b, c;
+        CHECK_STATUS(vector_create(n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        CHECK_STATUS(vector_create(n, &c), SUCCESS);
+        test_fill_vector(&a, 100 + (unsigned)s);
+        test_fill_vector(&b, 110 + (unsigned)s);
+        test_fill_vector(&c, 120 + (unsigned)s);
+        VectorExpr e;
+        int root = build_expression(&e, &a, &b, &c);
+
+        double inline_sum, inline_dot;
+        CHECK_STATUS(vector_expr_sum(&e, root, &inline_sum), SUCCESS);
+        CHECK_STATUS(vector_expr_dot(&e, root, 0, &inline_dot), SUCCESS);
+
+        int same = 1;
+        for (int t = 0; t < (int)(sizeof(threads) / sizeof(threads[0]));
+             t++) {
+            CHECK_STATUS(thread_pool_init(threads[t], 0), SUCCESS);
+            // One block per chunk spreads even small sizes over the pool
+            thread_pool_set_min_work(1);
+            double pool_sum, pool_dot;
+            CHECK_STATUS(vector_expr_sum(&e, root, &pool_sum), SUCCESS);
+            CHECK_STATUS(vector_expr_dot(&e, root, 0, &pool_dot), SUCCESS);
+            same &= memcmp(&pool_sum, &inline_sum, sizeof(double)) == 0 &&
+                    memcmp(&pool_dot, &inline_dot, sizeof(double)) == 0;
+            thread_pool_set_min_work(saved_min_work);
+            thread_pool_shutdown();
+        }
+        CHECK(same);
+
+        vector_free(&a);
+        vector_free(&b);
+        vector_free(&c);
+    }
+}
+
+int main(void) {
+    // Inline, then split across pool workers
+    test_eval();
+    test_aliasing();
+    test_node_limit();
+    test_malformed();
+    test_deterministic_reductions();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    thread_pool_set_min_work(1);
+    test_eval();
+    test_aliasing();
+    thread_pool_shutdown();
+    return test_finish("test_expr");
+}
\ No newline at end of file
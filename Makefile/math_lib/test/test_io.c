@@ -0,0 +1,301 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/matrix_io.h"
+#include "../include/matrix_math.h"
+#include "test_util.h"
+
+// Matrix file tests: save/map round trips, header validation, truncation
+// and checksum verification, and the streamed products
+
+static char test_dir[] = "/tmp/mathlib_test_io_XXXXXX";
+static char path[sizeof(test_dir) + 32];
+
+static void patch_file(long offset, const void *bytes, size_t size) {
+    FILE *f = fopen(path, "r+b");
+    CHECK(f != NULL);
+    if (f == NULL) {
+        return;
+    }
+    CHECK(fseek(f, offset, SEEK_SET) == 0);
+    CHECK(fwrite(bytes, 1, size, f) == size);
+    fclose(f);
+}
+
+static long file_size(void) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+static void check_round_trip(const Matrix *m) {
+    Matrix mapped;
+    MatrixFileHeader header;
+    CHECK_STATUS(matrix_save(m, path), SUCCESS);
+    CHECK_STATUS(matrix_file_read_header(path, &header), SUCCESS);
+    CHECK(header.rows == (uint64_t)m->rows);
+    CHECK(header.cols == (uint64_t)m->cols);
+    CHECK(header.stride >= header.cols);
+    CHECK(header.data_offset % MATRIX_ALIGNMENT == 0);
+    CHECK(header.stride * sizeof(double) % MATRIX_ALIGNMENT == 0);
+
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_VERIFY, &mapped),
+                 SUCCESS);
+    CHECK(!MATRIX_IS_TRANSPOSED(&mapped));
+    CHECK((uintptr_t)mapped.data % MATRIX_ALIGNMENT == 0);
+    CHECK(mapped.id == 0);
+    CHECK(test_matrix_equal(&mapped, m));
+    matrix_free(&mapped);
+    CHECK(mapped.data == NULL);
+}
+
+static void test_round_trip(void) {
+    static const int shapes[][2] = {{1, 1}, {5, 7}, {130, 65}};
+
+    for (size_t k = 0; k < sizeof(shapes) / sizeof(shapes[0]); k++) {
+        Matrix m, transposed, block;
+        CHECK_STATUS(matrix_create(shapes[k][0], shapes[k][1], &m), SUCCESS);
+        test_fill_matrix(&m, 60 + (unsigned)k, 0.0);
+        check_round_trip(&m);
+
+        // Views are written as their logical matrix
+        CHECK_STATUS(matrix_transpose_view(&m, &transposed), SUCCESS);
+        check_round_trip(&transposed);
+        if (m.rows > 2 && m.cols > 2) {
+            CHECK_STATUS(matrix_view(&m, 1, 2, m.rows - 2, m.cols - 2,
+                                     &block),
+                         SUCCESS);
+            check_round_trip(&block);
+            CHECK_STATUS(matrix_transpose_view(&block, &transposed),
+                         SUCCESS);
+            check_round_trip(&transposed);
+        }
+        matrix_free(&m);
+    }
+}
+
+// Private mappings keep element stores in memory; shared ones write them
+// through to the file
+static void test_mapping_modes(void) {
+    Matrix m, mapped, again;
+    CHECK_STATUS(matrix_create(4, 3, &m), SUCCESS);
+    test_fill_matrix(&m, 71, 0.0);
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+
+    CHECK_STATUS(matrix_map_file(path, 0, &mapped), SUCCESS);
+    matrix_set(&mapped, 2, 1, 42.0);
+    matrix_free(&mapped);
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_VERIFY, &again), SUCCESS);
+    CHECK(test_matrix_equal(&again, &m));
+    matrix_free(&again);
+
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_SHARED | MATRIX_MAP_POPULATE,
+                                 &mapped),
+                 SUCCESS);
+    matrix_set(&mapped, 2, 1, 42.0);
+    matrix_free(&mapped);
+    CHECK_STATUS(matrix_map_file(path, 0, &again), SUCCESS);
+    CHECK(matrix_get(&again, 2, 1) == 42.0);
+    CHECK(matrix_get(&again, 0, 0) == matrix_get(&m, 0, 0));
+    matrix_free(&again);
+
+    matrix_free(&m);
+}
+
+static void check_rejected(const char *what) {
+    const int failures = test_failures;
+    Matrix mapped;
+    MatrixFileHeader header;
+    CHECK_STATUS(matrix_file_read_header(path, &header),
+                 ERROR_INVALID_FORMAT);
+    CHECK_STATUS(matrix_map_file(path, 0, &mapped), ERROR_INVALID_FORMAT);
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_VERIFY, &mapped),
+                 ERROR_INVALID_FORMAT);
+    if (test_failures != failures) {
+        fprintf(stderr, "  with %s\n", what);
+    }
+}
+
+static void test_bad_header(void) {
+    Matrix m;
+    CHECK_STATUS(matrix_create(6, 5, &m), SUCCESS);
+    test_fill_matrix(&m, 81, 0.0);
+
+    const uint32_t bad32 = 0xdeadbeefu;
+    const uint64_t zero = 0;
+    const uint64_t misaligned = sizeof(MatrixFileHeader) + 8;
+    const uint64_t narrow = 4;
+    const uint64_t huge = (uint64_t)1 << 40;
+    static const struct {
+        const char *what;
+        size_t offset;
+        size_t size;
+    } fields[] = {
+        {"a bad magic", offsetof(MatrixFileHeader, magic), 4},
+        {"a bad version", offsetof(MatrixFileHeader, version), 4},
+        {"a foreign byte order", offsetof(MatrixFileHeader, endian_tag), 4},
+        {"a bad dtype", offsetof(MatrixFileHeader, dtype), 4},
+    };
+
+    for (size_t k = 0; k < sizeof(fields) / sizeof(fields[0]); k++) {
+        CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+        patch_file((long)fields[k].offset, &bad32, fields[k].size);
+        check_rejected(fields[k].what);
+    }
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    patch_file((long)offsetof(MatrixFileHeader, rows), &zero, sizeof(zero));
+    check_rejected("zero rows");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    patch_file((long)offsetof(MatrixFileHeader, stride), &narrow,
+               sizeof(narrow));
+    check_rejected("a stride below cols");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    patch_file((long)offsetof(MatrixFileHeader, data_offset), &misaligned,
+               sizeof(misaligned));
+    check_rejected("a misaligned data offset");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    patch_file((long)offsetof(MatrixFileHeader, rows), &huge, sizeof(huge));
+    check_rejected("more rows than the file holds");
+
+    matrix_free(&m);
+}
+
+static void test_truncated(void) {
+    Matrix m;
+    CHECK_STATUS(matrix_create(9, 10, &m), SUCCESS);
+    test_fill_matrix(&m, 91, 0.0);
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    const long size = file_size();
+    CHECK(truncate(path, size - 8) == 0);
+    check_rejected("a truncated data region");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    CHECK(truncate(path, (off_t)sizeof(MatrixFileHeader)) == 0);
+    check_rejected("no data region");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    CHECK(truncate(path, 10) == 0);
+    check_rejected("a truncated header");
+
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    CHECK(truncate(path, 0) == 0);
+    check_rejected("an empty file");
+
+    Matrix mapped;
+    CHECK(unlink(path) == 0);
+    CHECK_STATUS(matrix_map_file(path, 0, &mapped), ERROR_IO);
+
+    matrix_free(&m);
+}
+
+static void test_checksum(void) {
+    Matrix m, mapped;
+    MatrixFileHeader header;
+    CHECK_STATUS(matrix_create(8, 8, &m), SUCCESS);
+    test_fill_matrix(&m, 101, 0.0);
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    CHECK_STATUS(matrix_file_read_header(path, &header), SUCCESS);
+
+    // One flipped bit in the last element
+    const long last = (long)header.data_offset +
+                      (long)((7 * header.stride + 7) * sizeof(double));
+    double value = matrix_get(&m, 7, 7);
+    unsigned char bytes[sizeof(double)];
+    memcpy(bytes, &value, sizeof(double));
+    bytes[0] ^= 1;
+    patch_file(last, bytes, sizeof(bytes));
+
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_VERIFY, &mapped),
+                 ERROR_INVALID_FORMAT);
+    // Without VERIFY the header alone is checked
+    CHECK_STATUS(matrix_map_file(path, 0, &mapped), SUCCESS);
+    CHECK(matrix_get(&mapped, 7, 7) != value);
+    matrix_free(&mapped);
+
+    // A changed checksum field is caught the same way
+    CHECK_STATUS(matrix_save(&m, path), SUCCESS);
+    const uint64_t checksum = header.checksum ^ 1;
+    patch_file((long)offsetof(MatrixFileHeader, checksum), &checksum,
+               sizeof(checksum));
+    CHECK_STATUS(matrix_map_file(path, MATRIX_MAP_VERIFY, &mapped),
+                 ERROR_INVALID_FORMAT);
+
+    matrix_free(&m);
+}
+
+// Panels far smaller than the file force several reads
+static void test_streamed_products(void) {
+    Matrix a, transposed, b, expected, result;
+    Vector v, expected_v, result_v;
+    CHECK_STATUS(matrix_create(70, 33, &a), SUCCESS);
+    CHECK_STATUS(matrix_create(33, 6, &b), SUCCESS);
+    CHECK_STATUS(vector_create(70, &v), SUCCESS);
+    test_fill_matrix(&a, 111, 0.0);
+    test_fill_matrix(&b, 113, 0.0);
+    test_fill_vector(&v, 7);
+
+    // Saved transposed, so the file holds the 33 x 70 matrix A^T
+    CHECK_STATUS(matrix_transpose_view(&a, &transposed), SUCCESS);
+    CHECK_STATUS(matrix_save(&transposed, path), SUCCESS);
+
+    CHECK_STATUS(matrix_vector_multiply(&transposed, &v, &expected_v),
+                 SUCCESS);
+    CHECK_STATUS(matrix_file_vector_multiply(path, 4096, &v, &result_v),
+                 SUCCESS);
+    double diff = 0.0;
+    for (int i = 0; i < expected_v.size; i++) {
+        diff = fmax(diff, fabs(expected_v.data[i] - result_v.data[i]));
+    }
+    CHECK(diff < 1e-12 * 70);
+
+    Matrix c;
+    CHECK_STATUS(matrix_create(70, 6, &c), SUCCESS);
+    test_fill_matrix(&c, 117, 0.0);
+    CHECK_STATUS(matrix_multiply(&transposed, &c, &expected), SUCCESS);
+    CHECK_STATUS(matrix_file_multiply(path, 4096, &c, &result), SUCCESS);
+    CHECK(test_max_abs_diff(&expected, &result) < 1e-12 * 70);
+    CHECK_STATUS(matrix_file_multiply(path, 4096, &b, &result),
+                 ERROR_INVALID_DIMENSION);
+
+    matrix_free(&a);
+    matrix_free(&b);
+    matrix_free(&c);
+    matrix_free(&expected);
+    matrix_free(&result);
+    vector_free(&v);
+    vector_free(&expected_v);
+    vector_free(&result_v);
+}
+
+int main(void) {
+    if (mkdtemp(test_dir) == NULL) {
+        perror("mkdtemp");
+        return 1;
+    }
+    snprintf(path, sizeof(path), "%s/matrix.bin", test_dir);
+
+    test_round_trip();
+    test_mapping_modes();
+    test_bad_header();
+    test_truncated();
+    test_checksum();
+    test_streamed_products();
+
+    unlink(path);
+    rmdir(test_dir);
+    return test_finish("test_io");
+}
\ No newline at end of file
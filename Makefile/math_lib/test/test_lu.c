@@ -0,0 +1,428 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/matrix_lu.h"
+#include "../include/matrix_math.h"
+#include "test_util.h"
+
+// LU factorization tests: factors, solves, inverse and determinant, at
+// orders around the panel width (64) where the blocked code changes shape
+
+static const int orders[] = {1, 2, 3, 5, 63, 64, 65, 130};
+#define ORDER_COUNT (int)(sizeof(orders) / sizeof(orders[0]))
+
+static double vector_max_abs(const Vector *v) {
+    double max = 0.0;
+    for (int i = 0; i < v->size; i++) {
+        double a = fabs(v->data[i]);
+        if (a > max || a != a) {
+            max = a;
+        }
+    }
+    return max;
+}
+
+// max |A x - b| relative to |b|
+static double residual(const Matrix *a, const Vector *x, const Vector *b) {
+    Vector ax;
+    CHECK_STATUS(matrix_vector_multiply(a, x, &ax), SUCCESS);
+    for (int i = 0; i < ax.size; i++) {
+        ax.data[i] -= b->data[i];
+    }
+    double r = vector_max_abs(&ax) / vector_max_abs(b);
+    vector_free(&ax);
+    return r;
+}
+
+static int same_factors(const MatrixLU *a, const MatrixLU *b) {
+    const int n = a->lu.rows;
+    return a->sign == b->sign && test_matrix_equal(&a->lu, &b->lu) &&
+           memcmp(a->pivots, b->pivots, (size_t)n * sizeof(int)) == 0;
+}
+
+// P A = L U, rebuilt from the packed factors
+static void test_factors_reconstruct(void) {
+    for (int k = 0; k < ORDER_COUNT; k++) {
+        const int n = orders[k];
+        Matrix a, l, u, pa, product;
+        MatrixLU lu;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        test_fill_matrix(&a, 100 + (unsigned)n, 0.0);
+        CHECK_STATUS(matrix_lu(&a, &lu), SUCCESS);
+        CHECK(lu.sign == 1 || lu.sign == -1);
+
+        CHECK_STATUS(matrix_create(n, n, &l), SUCCESS);
+        CHECK_STATUS(matrix_create(n, n, &u), SUCCESS);
+        for (int i = 0; i < n; i++) {
+            CHECK(lu.pivots[i] >= i && lu.pivots[i] < n);
+            for (int j = 0; j < n; j++) {
+                double v = MATRIX_AT(&lu.lu, i, j);
+                if (j < i) {
+                    MATRIX_AT(&l, i, j) = v;
+                } else {
+                    MATRIX_AT(&u, i, j) = v;
+                }
+            }
+            MATRIX_AT(&l, i, i) = 1.0;
+        }
+
+        // Apply the row exchanges in order
+        CHECK_STATUS(matrix_create(n, n, &pa), SUCCESS);
+        CHECK_STATUS(matrix_copy(&a, &pa), SUCCESS);
+        for (int i = 0; i < n; i++) {
+            int p = lu.pivots[i];
+            for (int j = 0; j < n; j++) {
+                double t = MATRIX_AT(&pa, i, j);
+                MATRIX_AT(&pa, i, j) = MATRIX_AT(&pa, p, j);
+                MATRIX_AT(&pa, p, j) = t;
+            }
+        }
+
+        CHECK_STATUS(matrix_multiply(&l, &u, &product), SUCCESS);
+        CHECK(test_max_abs_diff(&product, &pa) < 1e-12 * n);
+
+        // Refilling the factor object matches a fresh factorization
+        Matrix other;
+        MatrixLU fresh;
+        CHECK_STATUS(matrix_create(n, n, &other), SUCCESS);
+        test_fill_matrix(&other, 200 + (unsigned)n, 0.0);
+        CHECK_STATUS(matrix_lu_into(&other, &lu), SUCCESS);
+        CHECK_STATUS(matrix_lu(&other, &fresh), SUCCESS);
+        CHECK(same_factors(&lu, &fresh));
+
+        matrix_lu_free(&fresh);
+        matrix_lu_free(&lu);
+        matrix_free(&a);
+        matrix_free(&other);
+        matrix_free(&l);
+        matrix_free(&u);
+        matrix_free(&pa);
+        matrix_free(&product);
+    }
+}
+
+static void test_solve(void) {
+    for (int k = 0; k < ORDER_COUNT; k++) {
+        const int n = orders[k];
+        Matrix a;
+        Vector b, x, y;
+        MatrixLU lu;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        test_fill_matrix(&a, 300 + (unsigned)n, 0.0);
+        test_fill_vector(&b, 17);
+
+        CHECK_STATUS(matrix_lu(&a, &lu), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve(&lu, &b, &x), SUCCESS);
+        CHECK(residual(&a, &x, &b) < 1e-10);
+
+        CHECK_STATUS(matrix_solve(&a, &b, &y), SUCCESS);
+        CHECK(memcmp(x.data, y.data, (size_t)n * sizeof(double)) == 0);
+
+        // x == b: the right-hand side is overwritten by the solution
+        Vector in_place;
+        CHECK_STATUS(vector_create(n, &in_place), SUCCESS);
+        memcpy(in_place.data, b.data, (size_t)n * sizeof(double));
+        CHECK_STATUS(matrix_lu_solve_into(&lu, &in_place, &in_place),
+                     SUCCESS);
+        CHECK(memcmp(in_place.data, x.data, (size_t)n * sizeof(double)) ==
+              0);
+
+        Vector wrong;
+        CHECK_STATUS(vector_create(n + 1, &wrong), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_into(&lu, &b, &wrong),
+                     ERROR_INVALID_DIMENSION);
+        CHECK_STATUS(matrix_lu_solve_into(&lu, &wrong, &x),
+                     ERROR_INVALID_DIMENSION);
+
+        vector_free(&wrong);
+        vector_free(&in_place);
+        vector_free(&x);
+        vector_free(&y);
+        vector_free(&b);
+        matrix_lu_free(&lu);
+        matrix_free(&a);
+    }
+}
+
+// Every column of X solves A x = b for the matching column of B
+static void test_solve_matrix(void) {
+    for (int k = 0; k < ORDER_COUNT; k++) {
+        const int n = orders[k];
+        const int width = 7;
+        Matrix a, b, x, ax, aliased;
+        MatrixLU lu;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        CHECK_STATUS(matrix_create(n, width, &b), SUCCESS);
+        test_fill_matrix(&a, 400 + (unsigned)n, 0.0);
+        test_fill_matrix(&b, 23, 0.0);
+
+        CHECK_STATUS(matrix_lu(&a, &lu), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_matrix(&lu, &b, &x), SUCCESS);
+        CHECK_STATUS(matrix_multiply(&a, &x, &ax), SUCCESS);
+        CHECK(test_max_abs_diff(&ax, &b) < 1e-10 * n);
+
+        CHECK_STATUS(matrix_create(n, width, &aliased), SUCCESS);
+        CHECK_STATUS(matrix_copy(&b, &aliased), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_matrix_into(&lu, &aliased, &aliased),
+                     SUCCESS);
+        CHECK(test_matrix_equal(&aliased, &x));
+
+        // Agrees with the single right-hand side solve
+        Vector column, solution;
+        CHECK_STATUS(vector_create(n, &column), SUCCESS);
+        for (int i = 0; i < n; i++) {
+            column.data[i] = MATRIX_AT(&b, i, 3);
+        }
+        CHECK_STATUS(matrix_lu_solve(&lu, &column, &solution), SUCCESS);
+        double diff = 0.0;
+        for (int i = 0; i < n; i++) {
+            diff = fmax(diff, fabs(solution.data[i] - MATRIX_AT(&x, i, 3)));
+        }
+        CHECK(diff < 1e-10 * vector_max_abs(&solution));
+
+        vector_free(&column);
+        vector_free(&solution);
+        matrix_lu_free(&lu);
+        matrix_free(&a);
+        matrix_free(&b);
+        matrix_free(&x);
+        matrix_free(&ax);
+        matrix_free(&aliased);
+    }
+}
+
+static void test_inverse(void) {
+    for (int k = 0; k < ORDER_COUNT; k++) {
+        const int n = orders[k];
+        Matrix a, inverse, product, identity;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        CHECK_STATUS(matrix_create(n, n, &identity), SUCCESS);
+        test_fill_matrix(&a, 500 + (unsigned)n, 0.0);
+        for (int i = 0; i < n; i++) {
+            MATRIX_AT(&identity, i, i) = 1.0;
+        }
+
+        CHECK_STATUS(matrix_inverse(&a, &inverse), SUCCESS);
+        CHECK_STATUS(matrix_multiply(&a, &inverse, &product), SUCCESS);
+        CHECK(test_max_abs_diff(&product, &identity) < 1e-9);
+
+        matrix_free(&a);
+        matrix_free(&inverse);
+        matrix_free(&product);
+        matrix_free(&identity);
+    }
+}
+
+// A row permutation of a triangular matrix with diagonal entries of 1 and
+// 2 has an exactly known determinant
+static void test_determinant(void) {
+    for (int k = 0; k < ORDER_COUNT; k++) {
+        const int n = orders[k];
+        Matrix a, transposed;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        test_fill_matrix(&a, 600 + (unsigned)n, 0.0);
+
+        double expected = 1.0;
+        for (int i = 0; i < n; i++) {
+            for (int j = 0; j < i; j++) {
+                MATRIX_AT(&a, i, j) = 0.0;
+            }
+            MATRIX_AT(&a, i, i) = i % 9 == 0 ? 2.0 : 1.0;
+            expected *= MATRIX_AT(&a, i, i);
+        }
+        if (n > 1) {
+            double *r0 = MATRIX_ROW(&a, 0);
+            double *r1 = MATRIX_ROW(&a, n - 1);
+            for (int j = 0; j < n; j++) {
+                double t = r0[j];
+                r0[j] = r1[j];
+                r1[j] = t;
+            }
+            expected = -expected;
+        }
+        matrix_mark_modified(&a);
+
+        double det, lu_det;
+        MatrixLU lu;
+        CHECK_STATUS(matrix_determinant(&a, &det), SUCCESS);
+        CHECK(fabs(det - expected) <= 1e-12 * fabs(expected));
+        CHECK_STATUS(matrix_lu(&a, &lu), SUCCESS);
+        CHECK_STATUS(matrix_lu_determinant(&lu, &lu_det), SUCCESS);
+        CHECK(fabs(lu_det - expected) <= 1e-12 * fabs(expected));
+        if (n > 3) {
+            CHECK(det == lu_det);
+        }
+
+        CHECK_STATUS(matrix_transpose_view(&a, &transposed), SUCCESS);
+        CHECK_STATUS(matrix_determinant(&transposed, &det), SUCCESS);
+        CHECK(fabs(det - expected) <= 1e-12 * fabs(expected));
+
+        matrix_lu_free(&lu);
+        matrix_free(&a);
+    }
+}
+
+// A zero column stays exactly zero through elimination
+static void test_singular(void) {
+    static const int sizes[] = {4, 63, 64, 65, 130};
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        const int n = sizes[k];
+        Matrix a, b, x, inverse;
+        Vector v, y;
+        MatrixLU lu;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        test_fill_matrix(&a, 700 + (unsigned)n, 0.0);
+        const int zero = n / 2;
+        for (int i = 0; i < n; i++) {
+            MATRIX_AT(&a, i, zero) = 0.0;
+        }
+        matrix_mark_modified(&a);
+
+        CHECK_STATUS(matrix_lu(&a, &lu), SUCCESS);
+        double det = 1.0;
+        CHECK_STATUS(matrix_lu_determinant(&lu, &det), SUCCESS);
+        CHECK(det == 0.0);
+        CHECK_STATUS(matrix_determinant(&a, &det), SUCCESS);
+        CHECK(det == 0.0);
+
+        CHECK_STATUS(vector_create(n, &v), SUCCESS);
+        CHECK_STATUS(vector_create(n, &y), SUCCESS);
+        test_fill_vector(&v, 29);
+        CHECK_STATUS(matrix_lu_solve_into(&lu, &v, &y),
+                     ERROR_SINGULAR_MATRIX);
+        CHECK_STATUS(matrix_lu_solve_into(&lu, &v, &v),
+                     ERROR_SINGULAR_MATRIX);
+
+        Vector unused;
+        CHECK_STATUS(matrix_lu_solve(&lu, &v, &unused),
+                     ERROR_SINGULAR_MATRIX);
+        CHECK_STATUS(matrix_solve(&a, &v, &unused), ERROR_SINGULAR_MATRIX);
+
+        CHECK_STATUS(matrix_create(n, 3, &b), SUCCESS);
+        CHECK_STATUS(matrix_create(n, 3, &x), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_matrix_into(&lu, &b, &x),
+                     ERROR_SINGULAR_MATRIX);
+        Matrix none;
+        CHECK_STATUS(matrix_lu_solve_matrix(&lu, &b, &none),
+                     ERROR_SINGULAR_MATRIX);
+        CHECK_STATUS(matrix_inverse(&a, &inverse), ERROR_SINGULAR_MATRIX);
+
+        matrix_lu_free(&lu);
+        matrix_free(&a);
+        matrix_free(&b);
+        matrix_free(&x);
+        vector_free(&v);
+        vector_free(&y);
+    }
+}
+
+// Transposed views and sub-block views factor exactly like a copy
+static void test_view_inputs(void) {
+    static const int sizes[] = {5, 63, 64, 65, 130};
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        const int n = sizes[k];
+        Matrix a, transposed, copy, big, block, block_copy;
+        MatrixLU from_view, from_copy;
+        CHECK_STATUS(matrix_create(n, n, &a), SUCCESS);
+        test_fill_matrix(&a, 800 + (unsigned)n, 0.0);
+
+        CHECK_STATUS(matrix_transpose_view(&a, &transposed), SUCCESS);
+        CHECK_STATUS(matrix_transpose(&a, &copy), SUCCESS);
+        CHECK_STATUS(matrix_lu(&transposed, &from_view), SUCCESS);
+        CHECK_STATUS(matrix_lu(&copy, &from_copy), SUCCESS);
+        CHECK(same_factors(&from_view, &from_copy));
+
+        double det_view, det_copy;
+        CHECK_STATUS(matrix_determinant(&transposed, &det_view), SUCCESS);
+        CHECK_STATUS(matrix_determinant(&copy, &det_copy), SUCCESS);
+        CHECK(det_view == det_copy);
+
+        Vector b, x;
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        test_fill_vector(&b, 31);
+        CHECK_STATUS(matrix_solve(&transposed, &b, &x), SUCCESS);
+        CHECK(residual(&copy, &x, &b) < 1e-10);
+
+        // Transposed right-hand sides
+        Matrix rhs, rhs_t, rhs_copy, x_view, x_copy;
+        CHECK_STATUS(matrix_create(4, n, &rhs), SUCCESS);
+        test_fill_matrix(&rhs, 37, 0.0);
+        CHECK_STATUS(matrix_transpose_view(&rhs, &rhs_t), SUCCESS);
+        CHECK_STATUS(matrix_transpose(&rhs, &rhs_copy), SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_matrix(&from_copy, &rhs_t, &x_view),
+                     SUCCESS);
+        CHECK_STATUS(matrix_lu_solve_matrix(&from_copy, &rhs_copy, &x_copy),
+                     SUCCESS);
+        CHECK(test_matrix_equal(&x_view, &x_copy));
+
+        Matrix inverse_view, inverse_copy;
+        CHECK_STATUS(matrix_inverse(&transposed, &inverse_view), SUCCESS);
+        CHECK_STATUS(matrix_inverse(&copy, &inverse_copy), SUCCESS);
+        CHECK(test_matrix_equal(&inverse_view, &inverse_copy));
+
+        // A block of a larger matrix, padded stride included
+        MatrixLU from_block, from_block_copy;
+        CHECK_STATUS(matrix_create(n + 3, n + 5, &big), SUCCESS);
+        test_fill_matrix(&big, 900 + (unsigned)n, 0.0);
+        CHECK_STATUS(matrix_view(&big, 2, 3, n, n, &block), SUCCESS);
+        CHECK_STATUS(matrix_create(n, n, &block_copy), SUCCESS);
+        CHECK_STATUS(matrix_copy(&block, &block_copy), SUCCESS);
+        CHECK_STATUS(matrix_lu(&block, &from_block), SUCCESS);
+        CHECK_STATUS(matrix_lu(&block_copy, &from_block_copy), SUCCESS);
+        CHECK(same_factors(&from_block, &from_block_copy));
+
+        matrix_lu_free(&from_view);
+        matrix_lu_free(&from_copy);
+        matrix_lu_free(&from_block);
+        matrix_lu_free(&from_block_copy);
+        matrix_free(&a);
+        matrix_free(&copy);
+        matrix_free(&big);
+        matrix_free(&block_copy);
+        matrix_free(&rhs);
+        matrix_free(&rhs_copy);
+        matrix_free(&x_view);
+        matrix_free(&x_copy);
+        matrix_free(&inverse_view);
+        matrix_free(&inverse_copy);
+        vector_free(&b);
+        vector_free(&x);
+    }
+}
+
+static void test_invalid_arguments(void) {
+    Matrix rect;
+    MatrixLU lu;
+    double det;
+    CHECK_STATUS(matrix_create(3, 4, &rect), SUCCESS);
+    CHECK_STATUS(matrix_lu(&rect, &lu), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_determinant(&rect, &det), ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_lu(NULL, &lu), ERROR_NULL_POINTER);
+    CHECK_STATUS(matrix_lu(&rect, NULL), ERROR_NULL_POINTER);
+    CHECK_STATUS(matrix_lu_determinant(NULL, &det), ERROR_NULL_POINTER);
+
+    CHECK_STATUS(matrix_lu_create(4, &lu), SUCCESS);
+    CHECK_STATUS(matrix_lu_into(&rect, &lu), ERROR_INVALID_DIMENSION);
+    Matrix b;
+    CHECK_STATUS(matrix_create(5, 2, &b), SUCCESS);
+    CHECK_STATUS(matrix_lu_solve_matrix_into(&lu, &b, &b),
+                 ERROR_INVALID_DIMENSION);
+    matrix_lu_free(&lu);
+    matrix_free(&b);
+    matrix_free(&rect);
+}
+
+int main(void) {
+    test_factors_reconstruct();
+    test_solve();
+    test_solve_matrix();
+    test_inverse();
+    test_determinant();
+    test_singular();
+    test_view_inputs();
+    test_invalid_arguments();
+    return test_finish("test_lu");
+}
\ No newline at end of file
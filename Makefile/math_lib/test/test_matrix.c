@@ -0,0 +1,200 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/matrix_math.h"
+#include "../include/thread_pool.h"
+#include "test_util.h"
+
+// Dense matrix-vector tests: products with several right-hand sides and
+// with transposed matrices, against the single product and a naive
+// reference
+
+static const int shapes[][2] = {{1, 1}, {7, 5}, {33, 64}, {130, 257}};
+#define SHAPE_COUNT (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+// Counts around MATRIX_GEMV_GROUP (8)
+static const int counts[] = {2, 7, 8, 9, 17};
+#define COUNT_COUNT (int)(sizeof(counts) / sizeof(counts[0]))
+#define MAX_COUNT 17
+
+// max |m v - result| in long double, relative to the row length
+static double reference_error(const Matrix *m, const Vector *v,
+                              const Vector *result) {
+    double error = 0.0;
+    for (int i = 0; i < m->rows; i++) {
+        long double sum = 0.0L;
+        for (int j = 0; j < m->cols; j++) {
+            sum += (long double)matrix_get(m, i, j) * v->data[j];
+        }
+        double d = fabs((double)(sum - result->data[i]));
+        if (d > error || d != d) {
+            error = d;
+        }
+    }
+    return error / m->cols;
+}
+
+static int same_vector(const Vector *a, const Vector *b) {
+    return a->size == b->size &&
+           memcmp(a->data, b->data, (size_t)a->size * sizeof(double)) == 0;
+}
+
+static void create_vectors(Vector *v, int count, int size, unsigned seed) {
+    for (int k = 0; k < count; k++) {
+        CHECK_STATUS(vector_create(size, &v[k]), SUCCESS);
+        test_fill_vector(&v[k], seed + (unsigned)k);
+    }
+}
+
+static void free_vectors(Vector *v, int count) {
+    for (int k = 0; k < count; k++) {
+        vector_free(&v[k]);
+    }
+}
+
+// Each result of the row-major pass is bitwise the single product
+static void test_many(void) {
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        for (int c = 0; c < COUNT_COUNT; c++) {
+            const int rows = shapes[s][0];
+            const int cols = shapes[s][1];
+            const int count = counts[c];
+            Matrix m;
+            Vector v[MAX_COUNT], result[MAX_COUNT], created[MAX_COUNT];
+            CHECK_STATUS(matrix_create(rows, cols, &m), SUCCESS);
+            test_fill_matrix(&m, 11 + (unsigned)s, 0.0);
+            create_vectors(v, count, cols, 40);
+            create_vectors(result, count, rows, 90);
+
+            CHECK_STATUS(matrix_vector_multiply_many_into(&m, v, result,
+                                                          count),
+                         SUCCESS);
+            CHECK_STATUS(matrix_vector_multiply_many(&m, v, created, count),
+                         SUCCESS);
+            for (int k = 0; k < count; k++) {
+                Vector single;
+                CHECK_STATUS(matrix_vector_multiply(&m, &v[k], &single),
+                             SUCCESS);
+                CHECK(same_vector(&result[k], &single));
+                CHECK(same_vector(&created[k], &single));
+                vector_free(&single);
+            }
+
+            free_vectors(v, count);
+            free_vectors(result, count);
+            free_vectors(created, count);
+            matrix_free(&m);
+        }
+    }
+}
+
+// m^T v through the transposed functions, a transposed view, and the
+// multiple right-hand side sweep over the stored rows
+static void test_transposed(void) {
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        const int rows = shapes[s][0];
+        const int cols = shapes[s][1];
+        Matrix m, view, copy;
+        CHECK_STATUS(matrix_create(rows, cols, &m), SUCCESS);
+        test_fill_matrix(&m, 21 + (unsigned)s, 0.0);
+        CHECK_STATUS(matrix_transpose_view(&m, &view), SUCCESS);
+        CHECK_STATUS(matrix_transpose(&m, &copy), SUCCESS);
+
+        Vector v[MAX_COUNT], result[MAX_COUNT];
+        create_vectors(v, MAX_COUNT, rows, 50);
+        create_vectors(result, MAX_COUNT, cols, 60);
+
+        Vector direct, through_view, into;
+        CHECK_STATUS(matrix_transpose_vector_multiply(&m, &v[0], &direct),
+                     SUCCESS);
+        CHECK_STATUS(matrix_vector_multiply(&view, &v[0], &through_view),
+                     SUCCESS);
+        CHECK(same_vector(&direct, &through_view));
+        CHECK(reference_error(&copy, &v[0], &direct) < 1e-15);
+
+        CHECK_STATUS(vector_create(cols, &into), SUCCESS);
+        CHECK_STATUS(matrix_transpose_vector_multiply_into(&m, &v[0], &into),
+                     SUCCESS);
+        CHECK(same_vector(&into, &direct));
+
+        for (int c = 0; c < COUNT_COUNT; c++) {
+            const int count = counts[c];
+            CHECK_STATUS(matrix_transpose_vector_multiply_many_into(
+                             &m, v, result, count),
+                         SUCCESS);
+            double error = 0.0;
+            for (int k = 0; k < count; k++) {
+                error = fmax(error, reference_error(&copy, &v[k], &result[k]));
+            }
+            CHECK(error < 1e-15);
+        }
+
+        // Transposing a transposed view gives the plain product
+        Vector w, plain, twice;
+        CHECK_STATUS(vector_create(cols, &w), SUCCESS);
+        test_fill_vector(&w, 70);
+        CHECK_STATUS(matrix_vector_multiply(&m, &w, &plain), SUCCESS);
+        CHECK_STATUS(matrix_transpose_vector_multiply(&view, &w, &twice),
+                     SUCCESS);
+        CHECK(same_vector(&plain, &twice));
+
+        vector_free(&w);
+        vector_free(&plain);
+        vector_free(&twice);
+        vector_free(&direct);
+        vector_free(&through_view);
+        vector_free(&into);
+        free_vectors(v, MAX_COUNT);
+        free_vectors(result, MAX_COUNT);
+        matrix_free(&copy);
+        matrix_free(&m);
+    }
+}
+
+static void test_errors(void) {
+    Matrix m;
+    Vector v[3], result[3], created[3];
+    CHECK_STATUS(matrix_create(4, 6, &m), SUCCESS);
+    create_vectors(v, 3, 6, 80);
+    create_vectors(result, 3, 4, 81);
+
+    CHECK_STATUS(matrix_vector_multiply_many_into(&m, v, result, 0), SUCCESS);
+    CHECK_STATUS(matrix_vector_multiply_many_into(&m, v, result, -1),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_vector_multiply_many_into(&m, NULL, result, 3),
+                 ERROR_NULL_POINTER);
+
+    // One bad vector rejects the whole call
+    Vector wrong;
+    CHECK_STATUS(vector_create(5, &wrong), SUCCESS);
+    Vector saved = v[2];
+    v[2] = wrong;
+    CHECK_STATUS(matrix_vector_multiply_many_into(&m, v, result, 3),
+                 ERROR_INVALID_DIMENSION);
+    memset(created, 0, sizeof(created));
+    CHECK_STATUS(matrix_vector_multiply_many(&m, v, created, 3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(created[0].data == NULL);
+    v[2] = saved;
+    CHECK_STATUS(matrix_transpose_vector_multiply_many_into(&m, v, result, 3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_transpose_vector_multiply_into(&m, &v[0], &result[0]),
+                 ERROR_INVALID_DIMENSION);
+
+    vector_free(&wrong);
+    free_vectors(v, 3);
+    free_vectors(result, 3);
+    matrix_free(&m);
+}
+
+int main(void) {
+    // Inline, then split across pool workers
+    test_many();
+    test_transposed();
+    test_errors();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    test_many();
+    test_transposed();
+    thread_pool_shutdown();
+    return test_finish("test_matrix");
+}
\ No newline at end of file
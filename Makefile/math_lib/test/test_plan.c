@@ -0,0 +1,263 @@
+#include <string.h>
+
+#include "../include/math_plan.h"
+#include "../include/matrix_math.h"
+#include "../include/vector_math.h"
+#include "test_util.h"
+
+// Execution plan tests: builders reject what the direct calls reject, and
+// running a plan gives bit for bit the direct call's result, also after
+// the operand elements change
+
+static int same_vector(const Vector *a, const Vector *b) {
+    return a->size == b->size &&
+           memcmp(a->data, b->data, (size_t)a->size * sizeof(double)) == 0;
+}
+
+static void test_bad_shapes(void) {
+    Vector v3, v4, out3;
+    Matrix m23, m32, m33, m22;
+    MathPlan plan;
+    double dot;
+    CHECK_STATUS(vector_create(3, &v3), SUCCESS);
+    CHECK_STATUS(vector_create(4, &v4), SUCCESS);
+    CHECK_STATUS(vector_create(3, &out3), SUCCESS);
+    CHECK_STATUS(matrix_create(2, 3, &m23), SUCCESS);
+    CHECK_STATUS(matrix_create(3, 2, &m32), SUCCESS);
+    CHECK_STATUS(matrix_create(3, 3, &m33), SUCCESS);
+    CHECK_STATUS(matrix_create(2, 2, &m22), SUCCESS);
+
+    CHECK_STATUS(vector_plan_add(&plan, &v3, &v4, &out3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(plan.run == NULL);
+    CHECK_STATUS(vector_plan_subtract(&plan, &v3, &v3, &v4),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(plan.run == NULL);
+    CHECK_STATUS(vector_plan_scale(&plan, &v4, 2.0, &out3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_plan_axpy(&plan, 2.0, &v3, &v4),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_plan_dot_product(&plan, &v3, &v4, &dot),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_plan_dot_product(&plan, &v3, &v3, NULL),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_plan_add(&plan, NULL, &v3, &out3),
+                 ERROR_NULL_POINTER);
+    CHECK(plan.run == NULL);
+    CHECK_STATUS(vector_plan_add(NULL, &v3, &v3, &out3), ERROR_NULL_POINTER);
+
+    CHECK_STATUS(matrix_plan_add(&plan, &m23, &m32, &m23),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(plan.run == NULL);
+    CHECK_STATUS(matrix_plan_subtract(&plan, &m23, &m23, &m33),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_scale(&plan, &m23, 2.0, &m32),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_axpy(&plan, 2.0, &m23, &m33),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_vector_multiply(&plan, &m23, &v4, &out3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_vector_multiply(&plan, &m32, &v3, &out3),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_multiply(&plan, 1.0, &m23, &m23, 0.0, &m22),
+                 ERROR_INVALID_DIMENSION);
+    CHECK(plan.run == NULL);
+    CHECK_STATUS(matrix_plan_multiply(&plan, 1.0, &m23, &m32, 0.0, &m33),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_plan_multiply(&plan, 1.0, &m23, NULL, 0.0, &m22),
+                 ERROR_NULL_POINTER);
+    CHECK(plan.run == NULL);
+
+    vector_free(&v3);
+    vector_free(&v4);
+    vector_free(&out3);
+    matrix_free(&m23);
+    matrix_free(&m32);
+    matrix_free(&m33);
+    matrix_free(&m22);
+}
+
+// Lengths around the vector kernels' unroll width
+static void test_vector_plans(void) {
+    static const int sizes[] = {1, 7, 64, 1001};
+
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        const int n = sizes[k];
+        Vector a, b, planned, direct;
+        MathPlan plan;
+        CHECK_STATUS(vector_create(n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        CHECK_STATUS(vector_create(n, &planned), SUCCESS);
+        CHECK_STATUS(vector_create(n, &direct), SUCCESS);
+        test_fill_vector(&a, 3 + (unsigned)n);
+        test_fill_vector(&b, 5 + (unsigned)n);
+
+        CHECK_STATUS(vector_plan_add(&plan, &a, &b, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_add_into(&a, &b, &direct), SUCCESS);
+        CHECK(same_vector(&planned, &direct));
+
+        // The plan reads the current elements on every run
+        test_fill_vector(&a, 11 + (unsigned)n);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_add_into(&a, &b, &direct), SUCCESS);
+        CHECK(same_vector(&planned, &direct));
+
+        CHECK_STATUS(vector_plan_subtract(&plan, &a, &b, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_subtract_into(&a, &b, &direct), SUCCESS);
+        CHECK(same_vector(&planned, &direct));
+
+        CHECK_STATUS(vector_plan_scale(&plan, &a, -1.75, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_scale_into(&a, -1.75, &direct), SUCCESS);
+        CHECK(same_vector(&planned, &direct));
+
+        CHECK_STATUS(vector_copy(&b, &planned), SUCCESS);
+        CHECK_STATUS(vector_copy(&b, &direct), SUCCESS);
+        CHECK_STATUS(vector_plan_axpy(&plan, 0.375, &a, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_axpy(0.375, &a, &direct), SUCCESS);
+        CHECK_STATUS(vector_axpy(0.375, &a, &direct), SUCCESS);
+        CHECK(same_vector(&planned, &direct));
+
+        double planned_dot = 0.0, direct_dot = 1.0;
+        CHECK_STATUS(vector_plan_dot_product(&plan, &a, &b, &planned_dot),
+                     SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(vector_dot_product(&a, &b, &direct_dot), SUCCESS);
+        CHECK(memcmp(&planned_dot, &direct_dot, sizeof(double)) == 0);
+
+        vector_free(&a);
+        vector_free(&b);
+        vector_free(&planned);
+        vector_free(&direct);
+    }
+}
+
+static void test_matrix_plans(void) {
+    static const int shapes[][3] = {{1, 1, 1}, {5, 7, 3}, {70, 33, 90}};
+
+    for (size_t k = 0; k < sizeof(shapes) / sizeof(shapes[0]); k++) {
+        const int m = shapes[k][0];
+        const int n = shapes[k][1];
+        const int p = shapes[k][2];
+        Matrix a, b, c, planned, direct, transposed;
+        Vector v, planned_v, direct_v;
+        MathPlan plan;
+        CHECK_STATUS(matrix_create(m, n, &a), SUCCESS);
+        CHECK_STATUS(matrix_create(m, n, &b), SUCCESS);
+        CHECK_STATUS(matrix_create(n, p, &c), SUCCESS);
+        CHECK_STATUS(matrix_create(m, n, &planned), SUCCESS);
+        CHECK_STATUS(matrix_create(m, n, &direct), SUCCESS);
+        CHECK_STATUS(vector_create(n, &v), SUCCESS);
+        CHECK_STATUS(vector_create(m, &planned_v), SUCCESS);
+        CHECK_STATUS(vector_create(m, &direct_v), SUCCESS);
+        test_fill_matrix(&a, 21 + (unsigned)k, 0.0);
+        test_fill_matrix(&b, 23 + (unsigned)k, 0.0);
+        test_fill_matrix(&c, 25 + (unsigned)k, 0.0);
+        test_fill_vector(&v, 27 + (unsigned)k);
+
+        CHECK_STATUS(matrix_plan_add(&plan, &a, &b, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(matrix_add_into(&a, &b, &direct), SUCCESS);
+        CHECK(test_matrix_equal(&planned, &direct));
+
+        CHECK_STATUS(matrix_plan_subtract(&plan, &a, &b, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(matrix_subtract_into(&a, &b, &direct), SUCCESS);
+        CHECK(test_matrix_equal(&planned, &direct));
+
+        CHECK_STATUS(matrix_plan_scale(&plan, &a, 3.5, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(matrix_scale_into(&a, 3.5, &direct), SUCCESS);
+        CHECK(test_matrix_equal(&planned, &direct));
+
+        // Each run bumps the destination's version
+        const uint64_t version = planned.version;
+        CHECK_STATUS(matrix_plan_axpy(&plan, -0.5, &a, &planned), SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK(planned.version != version);
+        CHECK_STATUS(matrix_axpy(-0.5, &a, &direct), SUCCESS);
+        CHECK(test_matrix_equal(&planned, &direct));
+
+        CHECK_STATUS(matrix_plan_vector_multiply(&plan, &a, &v, &planned_v),
+                     SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(matrix_vector_multiply_into(&a, &v, &direct_v), SUCCESS);
+        CHECK(same_vector(&planned_v, &direct_v));
+
+        // Transposed operands are resolved at plan time
+        CHECK_STATUS(matrix_transpose_view(&a, &transposed), SUCCESS);
+        Vector w, planned_w, direct_w;
+        CHECK_STATUS(vector_create(m, &w), SUCCESS);
+        CHECK_STATUS(vector_create(n, &planned_w), SUCCESS);
+        CHECK_STATUS(vector_create(n, &direct_w), SUCCESS);
+        test_fill_vector(&w, 29);
+        CHECK_STATUS(matrix_plan_vector_multiply(&plan, &transposed, &w,
+                                                 &planned_w),
+                     SUCCESS);
+        CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+        CHECK_STATUS(matrix_vector_multiply_into(&transposed, &w, &direct_w),
+                     SUCCESS);
+        CHECK(same_vector(&planned_w, &direct_w));
+
+        // result = alpha * A * C + beta * result, and with a transposed C
+        static const double scalars[][2] = {{1.0, 0.0}, {-2.0, 0.5}};
+        for (size_t s = 0; s < 2; s++) {
+            const double alpha = scalars[s][0];
+            const double beta = scalars[s][1];
+            Matrix planned_p, direct_p, planned_t, direct_t, view;
+            CHECK_STATUS(matrix_create(m, p, &planned_p), SUCCESS);
+            CHECK_STATUS(matrix_create(m, p, &direct_p), SUCCESS);
+            test_fill_matrix(&planned_p, 31, 0.0);
+            CHECK_STATUS(matrix_copy(&planned_p, &direct_p), SUCCESS);
+            CHECK_STATUS(matrix_plan_multiply(&plan, alpha, &a, &c, beta,
+                                              &planned_p),
+                         SUCCESS);
+            CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+            CHECK_STATUS(matrix_multiply_into(alpha, &a, &c, beta, &direct_p),
+                         SUCCESS);
+            CHECK(test_matrix_equal(&planned_p, &direct_p));
+
+            CHECK_STATUS(matrix_create(p, m, &planned_t), SUCCESS);
+            CHECK_STATUS(matrix_create(p, m, &direct_t), SUCCESS);
+            test_fill_matrix(&planned_t, 37, 0.0);
+            CHECK_STATUS(matrix_copy(&planned_t, &direct_t), SUCCESS);
+            CHECK_STATUS(matrix_transpose_view(&planned_t, &view), SUCCESS);
+            CHECK_STATUS(matrix_plan_multiply(&plan, alpha, &a, &c, beta,
+                                              &view),
+                         SUCCESS);
+            CHECK_STATUS(math_plan_run(&plan), SUCCESS);
+            CHECK_STATUS(matrix_transpose_view(&direct_t, &view), SUCCESS);
+            CHECK_STATUS(matrix_multiply_into(alpha, &a, &c, beta, &view),
+                         SUCCESS);
+            CHECK(test_matrix_equal(&planned_t, &direct_t));
+
+            matrix_free(&planned_p);
+            matrix_free(&direct_p);
+            matrix_free(&planned_t);
+            matrix_free(&direct_t);
+        }
+
+        vector_free(&w);
+        vector_free(&planned_w);
+        vector_free(&direct_w);
+        vector_free(&v);
+        vector_free(&planned_v);
+        vector_free(&direct_v);
+        matrix_free(&a);
+        matrix_free(&b);
+        matrix_free(&c);
+        matrix_free(&planned);
+        matrix_free(&direct);
+    }
+}
+
+int main(void) {
+    test_bad_shapes();
+    test_vector_plans();
+    test_matrix_plans();
+    return test_finish("test_plan");
+}
\ No newline at end of file
@@ -0,0 +1,339 @@
+#include <math.h>
+#include <string.h>
+
+#include "../include/matrix_math.h"
+#include "test_util.h"
+
+// Sparse matrix tests: dense round trips, CSR <-> CSC conversion and the
+// sparse x dense products against a naive dense reference
+
+static const int shapes[][2] = {{1, 1}, {7, 5}, {64, 33}, {130, 65}};
+#define SHAPE_COUNT (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+// About one element in five is nonzero; row 1 and the last column stay
+// empty when the shape has them
+static void fill_sparse_pattern(Matrix *m, unsigned seed) {
+    for (int i = 0; i < m->rows; i++) {
+        for (int j = 0; j < m->cols; j++) {
+            seed = seed * 1103515245u + 12345u;
+            unsigned r = seed >> 16 & 0x7fff;
+            int empty = (i == 1 && m->rows > 1) ||
+                        (j == m->cols - 1 && m->cols > 1);
+            double value = (double)(r % 1000) / 250.0 - 2.0;
+            matrix_set(m, i, j, !empty && r % 5 == 0 ? value + 0.125 : 0.0);
+        }
+    }
+    matrix_mark_modified(m);
+}
+
+static int count_nonzeros(const Matrix *m) {
+    int nnz = 0;
+    for (int i = 0; i < m->rows; i++) {
+        for (int j = 0; j < m->cols; j++) {
+            nnz += matrix_get(m, i, j) != 0.0;
+        }
+    }
+    return nnz;
+}
+
+static int major_count(const SparseMatrix *s) {
+    return s->format == SPARSE_CSR ? s->rows : s->cols;
+}
+
+// Offsets are monotone, indices in range and strictly increasing within
+// each row (CSR) or column (CSC), and no stored value is zero
+static int well_formed(const SparseMatrix *s) {
+    const int major = major_count(s);
+    const int minor = s->format == SPARSE_CSR ? s->cols : s->rows;
+    if (s->offsets[0] != 0 || s->offsets[major] != s->nnz) {
+        return 0;
+    }
+    for (int o = 0; o < major; o++) {
+        if (s->offsets[o] > s->offsets[o + 1]) {
+            return 0;
+        }
+        for (int p = s->offsets[o]; p < s->offsets[o + 1]; p++) {
+            if (s->indices[p] < 0 || s->indices[p] >= minor ||
+                s->values[p] == 0.0) {
+                return 0;
+            }
+            if (p > s->offsets[o] && s->indices[p] <= s->indices[p - 1]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static int same_sparse(const SparseMatrix *a, const SparseMatrix *b) {
+    if (a->rows != b->rows || a->cols != b->cols || a->nnz != b->nnz ||
+        a->format != b->format) {
+        return 0;
+    }
+    const size_t nnz = (size_t)a->nnz;
+    return memcmp(a->offsets, b->offsets,
+                  (size_t)(major_count(a) + 1) * sizeof(int)) == 0 &&
+           memcmp(a->indices, b->indices, nnz * sizeof(int)) == 0 &&
+           memcmp(a->values, b->values, nnz * sizeof(double)) == 0;
+}
+
+static void test_dense_round_trip(void) {
+    for (int k = 0; k < SHAPE_COUNT; k++) {
+        Matrix dense, transposed, copy;
+        CHECK_STATUS(matrix_create(shapes[k][0], shapes[k][1], &dense),
+                     SUCCESS);
+        fill_sparse_pattern(&dense, 40 + (unsigned)k);
+        const int nnz = count_nonzeros(&dense);
+
+        for (int f = 0; f < 2; f++) {
+            const SparseFormat format = f == 0 ? SPARSE_CSR : SPARSE_CSC;
+            SparseMatrix s;
+            Matrix back;
+            CHECK_STATUS(sparse_matrix_from_dense(&dense, format, &s),
+                         SUCCESS);
+            CHECK(s.format == format);
+            CHECK(s.nnz == nnz);
+            CHECK(well_formed(&s));
+            CHECK_STATUS(sparse_matrix_to_dense(&s, &back), SUCCESS);
+            CHECK(test_matrix_equal(&back, &dense));
+
+            // _into overwrites every element, zeros included
+            test_fill_matrix(&back, 3, 1.0);
+            CHECK_STATUS(sparse_matrix_to_dense_into(&s, &back), SUCCESS);
+            CHECK(test_matrix_equal(&back, &dense));
+            matrix_free(&back);
+            sparse_matrix_free(&s);
+        }
+
+        // A transposed view converts like its explicit transpose
+        SparseMatrix from_view, from_copy;
+        CHECK_STATUS(matrix_transpose_view(&dense, &transposed), SUCCESS);
+        CHECK_STATUS(matrix_transpose(&dense, &copy), SUCCESS);
+        CHECK_STATUS(sparse_matrix_from_dense(&transposed, SPARSE_CSR,
+                                              &from_view),
+                     SUCCESS);
+        CHECK_STATUS(sparse_matrix_from_dense(&copy, SPARSE_CSR, &from_copy),
+                     SUCCESS);
+        CHECK(same_sparse(&from_view, &from_copy));
+
+        sparse_matrix_free(&from_view);
+        sparse_matrix_free(&from_copy);
+        matrix_free(&copy);
+        matrix_free(&dense);
+    }
+}
+
+static void test_convert(void) {
+    for (int k = 0; k < SHAPE_COUNT; k++) {
+        Matrix dense;
+        CHECK_STATUS(matrix_create(shapes[k][0], shapes[k][1], &dense),
+                     SUCCESS);
+        fill_sparse_pattern(&dense, 50 + (unsigned)k);
+
+        SparseMatrix csr, csc, to_csc, to_csr, same;
+        CHECK_STATUS(sparse_matrix_from_dense(&dense, SPARSE_CSR, &csr),
+                     SUCCESS);
+        CHECK_STATUS(sparse_matrix_from_dense(&dense, SPARSE_CSC, &csc),
+                     SUCCESS);
+
+        CHECK_STATUS(sparse_matrix_convert(&csr, SPARSE_CSC, &to_csc),
+                     SUCCESS);
+        CHECK(well_formed(&to_csc));
+        CHECK(same_sparse(&to_csc, &csc));
+
+        CHECK_STATUS(sparse_matrix_convert(&to_csc, SPARSE_CSR, &to_csr),
+                     SUCCESS);
+        CHECK(well_formed(&to_csr));
+        CHECK(same_sparse(&to_csr, &csr));
+
+        CHECK_STATUS(sparse_matrix_convert(&csc, SPARSE_CSC, &same),
+                     SUCCESS);
+        CHECK(same_sparse(&same, &csc));
+        CHECK(same.values != csc.values);
+
+        sparse_matrix_free(&csr);
+        sparse_matrix_free(&csc);
+        sparse_matrix_free(&to_csc);
+        sparse_matrix_free(&to_csr);
+        sparse_matrix_free(&same);
+        matrix_free(&dense);
+    }
+
+    // No nonzeros at all
+    Matrix zero;
+    SparseMatrix empty, converted;
+    CHECK_STATUS(matrix_create(6, 4, &zero), SUCCESS);
+    CHECK_STATUS(sparse_matrix_from_dense(&zero, SPARSE_CSR, &empty),
+                 SUCCESS);
+    CHECK(empty.nnz == 0);
+    CHECK_STATUS(sparse_matrix_convert(&empty, SPARSE_CSC, &converted),
+                 SUCCESS);
+    CHECK(converted.nnz == 0);
+    CHECK(well_formed(&converted));
+    sparse_matrix_free(&empty);
+    sparse_matrix_free(&converted);
+    matrix_free(&zero);
+}
+
+static void test_vector_multiply(void) {
+    for (int k = 0; k < SHAPE_COUNT; k++) {
+        Matrix dense;
+        Vector v, expected;
+        CHECK_STATUS(matrix_create(shapes[k][0], shapes[k][1], &dense),
+                     SUCCESS);
+        CHECK_STATUS(vector_create(shapes[k][1], &v), SUCCESS);
+        fill_sparse_pattern(&dense, 60 + (unsigned)k);
+        test_fill_vector(&v, 9);
+        CHECK_STATUS(matrix_vector_multiply(&dense, &v, &expected), SUCCESS);
+
+        for (int f = 0; f < 2; f++) {
+            SparseMatrix s;
+            Vector y;
+            CHECK_STATUS(sparse_matrix_from_dense(
+                             &dense, f == 0 ? SPARSE_CSR : SPARSE_CSC, &s),
+                         SUCCESS);
+            CHECK_STATUS(sparse_matrix_vector_multiply(&s, &v, &y), SUCCESS);
+            double diff = 0.0;
+            for (int i = 0; i < y.size; i++) {
+                diff = fmax(diff, fabs(y.data[i] - expected.data[i]));
+            }
+            CHECK(diff < 1e-12 * shapes[k][1]);
+            vector_free(&y);
+
+            Vector wrong;
+            CHECK_STATUS(vector_create(shapes[k][1] + 1, &wrong), SUCCESS);
+            CHECK_STATUS(sparse_matrix_vector_multiply(&s, &wrong, &y),
+                         ERROR_INVALID_DIMENSION);
+            vector_free(&wrong);
+            sparse_matrix_free(&s);
+        }
+
+        matrix_free(&dense);
+        vector_free(&v);
+        vector_free(&expected);
+    }
+}
+
+// alpha * dense(A) * B + beta * C, element by element; beta == 0 ignores
+// C entirely
+static void reference_multiply(double alpha, const Matrix *a, const Matrix *b,
+                               double beta, const Matrix *c,
+                               Matrix *expected) {
+    for (int i = 0; i < a->rows; i++) {
+        for (int j = 0; j < b->cols; j++) {
+            double sum = 0.0;
+            for (int p = 0; p < a->cols; p++) {
+                sum += matrix_get(a, i, p) * matrix_get(b, p, j);
+            }
+            double value = alpha * sum;
+            if (beta != 0.0) {
+                value += beta * matrix_get(c, i, j);
+            }
+            matrix_set(expected, i, j, value);
+        }
+    }
+}
+
+static void test_multiply(void) {
+    static const double betas[] = {0.0, 1.0, -0.75};
+    static const double alphas[] = {1.0, 2.5, 0.0};
+    const int width = 9;
+
+    for (int k = 0; k < SHAPE_COUNT; k++) {
+        const int rows = shapes[k][0];
+        const int inner = shapes[k][1];
+        Matrix dense, b, b_storage, b_t, c0, expected;
+        CHECK_STATUS(matrix_create(rows, inner, &dense), SUCCESS);
+        CHECK_STATUS(matrix_create(inner, width, &b), SUCCESS);
+        CHECK_STATUS(matrix_create(width, inner, &b_storage), SUCCESS);
+        CHECK_STATUS(matrix_create(rows, width, &c0), SUCCESS);
+        CHECK_STATUS(matrix_create(rows, width, &expected), SUCCESS);
+        fill_sparse_pattern(&dense, 70 + (unsigned)k);
+        test_fill_matrix(&b, 13, 0.0);
+        test_fill_matrix(&c0, 19, 0.0);
+        CHECK_STATUS(matrix_transpose_view(&b_storage, &b_t), SUCCESS);
+        CHECK_STATUS(matrix_copy(&b, &b_t), SUCCESS);
+
+        SparseMatrix s[2];
+        CHECK_STATUS(sparse_matrix_from_dense(&dense, SPARSE_CSR, &s[0]),
+                     SUCCESS);
+        CHECK_STATUS(sparse_matrix_from_dense(&dense, SPARSE_CSC, &s[1]),
+                     SUCCESS);
+
+        for (size_t bi = 0; bi < sizeof(betas) / sizeof(betas[0]); bi++) {
+            for (size_t ai = 0; ai < sizeof(alphas) / sizeof(alphas[0]);
+                 ai++) {
+                const double alpha = alphas[ai];
+                const double beta = betas[bi];
+                reference_multiply(alpha, &dense, &b, beta, &c0, &expected);
+
+                for (int f = 0; f < 2; f++) {
+                    for (int t = 0; t < 2; t++) {
+                        const int failures = test_failures;
+                        Matrix c;
+                        CHECK_STATUS(matrix_create(rows, width, &c), SUCCESS);
+                        if (beta == 0.0) {
+                            // Must be overwritten, not scaled
+                            for (int i = 0; i < rows; i++) {
+                                for (int j = 0; j < width; j++) {
+                                    MATRIX_AT(&c, i, j) = NAN;
+                                }
+                            }
+                        } else {
+                            CHECK_STATUS(matrix_copy(&c0, &c), SUCCESS);
+                        }
+
+                        const Matrix *rhs = t == 0 ? &b : &b_t;
+                        CHECK_STATUS(sparse_matrix_multiply_into(
+                                         alpha, &s[f], rhs, beta, &c),
+                                     SUCCESS);
+                        CHECK(test_max_abs_diff(&c, &expected) <
+                              1e-12 * (inner + 1));
+                        if (test_failures != failures) {
+                            fprintf(stderr,
+                                    "  %dx%d %s alpha %g beta %g%s\n", rows,
+                                    inner, f == 0 ? "CSR" : "CSC", alpha,
+                                    beta, t == 0 ? "" : " transposed B");
+                        }
+                        matrix_free(&c);
+                    }
+                }
+            }
+        }
+
+        // The allocating form is alpha = 1, beta = 0
+        reference_multiply(1.0, &dense, &b, 0.0, &c0, &expected);
+        for (int f = 0; f < 2; f++) {
+            Matrix c;
+            CHECK_STATUS(sparse_matrix_multiply(&s[f], &b, &c), SUCCESS);
+            CHECK(test_max_abs_diff(&c, &expected) < 1e-12 * (inner + 1));
+            matrix_free(&c);
+        }
+
+        // Shape mismatches
+        Matrix wrong;
+        CHECK_STATUS(matrix_create(rows + 1, width, &wrong), SUCCESS);
+        CHECK_STATUS(sparse_matrix_multiply_into(1.0, &s[0], &b, 0.0, &wrong),
+                     ERROR_INVALID_DIMENSION);
+        CHECK_STATUS(sparse_matrix_multiply_into(1.0, &s[0], &wrong, 0.0,
+                                                 &c0),
+                     ERROR_INVALID_DIMENSION);
+        matrix_free(&wrong);
+
+        sparse_matrix_free(&s[0]);
+        sparse_matrix_free(&s[1]);
+        matrix_free(&dense);
+        matrix_free(&b);
+        matrix_free(&b_storage);
+        matrix_free(&c0);
+        matrix_free(&expected);
+    }
+}
+
+int main(void) {
+    test_dense_round_trip();
+    test_convert();
+    test_vector_multiply();
+    test_multiply();
+    return test_finish("test_sparse");
+}
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/trace_log.h"
+#include "test_util.h"
+
+// Trace log tests: ring wraparound, dumps racing with writers, and ring
+// reuse once a thread exits
+
+// Every retained line, as trace_dump writes it
+typedef struct {
+    char *text;
+    size_t size;
+    int count;
+} Dump;
+
+static void dump_take(Dump *d) {
+    FILE *out = open_memstream(&d->text, &d->size);
+    CHECK(out != NULL);
+    d->count = trace_dump(out);
+    fclose(out);
+}
+
+// Text of the next line after its "[tid] seconds " prefix, or NULL
+static char *dump_next(char **cursor) {
+    char *line = *cursor;
+    if (line == NULL || *line == '\0') {
+        return NULL;
+    }
+    char *end = strchr(line, '\n');
+    if (end != NULL) {
+        *end = '\0';
+        *cursor = end + 1;
+    } else {
+        *cursor = line + strlen(line);
+    }
+    char *space = strchr(line, ' ');
+    space = space != NULL ? strchr(space + 1, ' ') : NULL;
+    return space != NULL ? space + 1 : line + strlen(line);
+}
+
+static void record_lines(const char *tag, int count) {
+    for (int i = 0; i < count; i++) {
+        trace_record("%s %d\n", tag, i);
+    }
+}
+
+static void *record_thread(void *arg) {
+    record_lines((const char *)arg, 3);
+    return NULL;
+}
+
+static void run_thread(void *(*fn)(void *), void *arg) {
+    pthread_t thread;
+    CHECK(pthread_create(&thread, NULL, fn, arg) == 0);
+    CHECK(pthread_join(thread, NULL) == 0);
+}
+
+// A thread key created after the trace log's own has its destructor run
+// after the ring is released
+static pthread_key_t late_key;
+
+static void late_destructor(void *arg) {
+    (void)arg;
+    trace_record("destructor line\n");
+}
+
+static void *late_thread(void *arg) {
+    record_lines((const char *)arg, 2);
+    pthread_setspecific(late_key, arg);
+    return NULL;
+}
+
+// The second thread takes over the ring of the first; its records follow
+// the first thread's in the same ring
+static void test_ring_reuse(void) {
+    trace_clear();
+    run_thread(record_thread, "first");
+    run_thread(record_thread, "second");
+
+    Dump d;
+    dump_take(&d);
+    CHECK(d.count == 6);
+    static const char *expected[] = {"first 0",  "first 1",  "first 2",
+                                     "second 0", "second 1", "second 2"};
+    char *cursor = d.text;
+    for (int i = 0; i < 6; i++) {
+        char *text = dump_next(&cursor);
+        CHECK(text != NULL && strcmp(text, expected[i]) == 0);
+    }
+    free(d.text);
+
+    // Trace points in later thread-local destructors record nothing, and
+    // the next thread starts cleanly on the released ring
+    CHECK(pthread_key_create(&late_key, late_destructor) == 0);
+    trace_clear();
+    run_thread(late_thread, "late");
+    run_thread(record_thread, "after");
+    dump_take(&d);
+    CHECK(d.count == 5);
+    CHECK(strstr(d.text, "destructor line") == NULL);
+    CHECK(strstr(d.text, "late 1") != NULL);
+    CHECK(strstr(d.text, "after 2") != NULL);
+    free(d.text);
+    pthread_key_delete(late_key);
+}
+
+// A ring keeps the newest TRACE_RING_RECORDS lines, oldest first, each
+// cut to TRACE_TEXT_BYTES - 1 characters
+static void test_wraparound(void) {
+    const int total = TRACE_RING_RECORDS + 89;
+    trace_clear();
+    record_lines("wrap", total);
+
+    Dump d;
+    dump_take(&d);
+    CHECK(d.count == TRACE_RING_RECORDS);
+    char *cursor = d.text;
+    int in_order = 1;
+    for (int i = total - TRACE_RING_RECORDS; i < total; i++) {
+        char expected[32];
+        snprintf(expected, sizeof(expected), "wrap %d", i);
+        char *text = dump_next(&cursor);
+        in_order &= text != NULL && strcmp(text, expected) == 0;
+    }
+    CHECK(in_order);
+    CHECK(dump_next(&cursor) == NULL);
+    free(d.text);
+
+    char long_line[3 * TRACE_TEXT_BYTES];
+    memset(long_line, 'x', sizeof(long_line) - 1);
+    long_line[sizeof(long_line) - 1] = '\0';
+    trace_clear();
+    trace_record("%s", long_line);
+    dump_take(&d);
+    cursor = d.text;
+    char *text = dump_next(&cursor);
+    CHECK(text != NULL && strlen(text) == TRACE_TEXT_BYTES - 1);
+    free(d.text);
+
+    trace_clear();
+    dump_take(&d);
+    CHECK(d.count == 0);
+    free(d.text);
+}
+
+// Writers fill whole lines whose body is derived from their number, so a
+// torn copy shows up as a body that does not match
+enum { WRITERS = 4, WRITES = 40000 };
+
+static int writers_done;
+
+static void line_body(int writer, int n, char *body, size_t size) {
+    const size_t length = 20 + (size_t)(n % 60);
+    size_t i = 0;
+    for (; i < length && i + 1 < size; i++) {
+        body[i] = (char)('a' + (writer * 7 + n + (int)i) % 26);
+    }
+    body[i] = '\0';
+}
+
+static void *writer_thread(void *arg) {
+    const int writer = (int)(size_t)arg;
+    char body[96];
+    for (int n = 0; n < WRITES; n++) {
+        line_body(writer, n, body, sizeof(body));
+        trace_record("w%d %d %s\n", writer, n, body);
+    }
+    __atomic_add_fetch(&writers_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static void test_concurrent_dump(void) {
+    trace_clear();
+    pthread_t threads[WRITERS];
+    for (int w = 0; w < WRITERS; w++) {
+        CHECK(pthread_create(&threads[w], NULL, writer_thread,
+                             (void *)(size_t)w) == 0);
+    }
+
+    int dumps = 0;
+    int torn = 0;
+    int out_of_order = 0;
+    int done;
+    do {
+        done = __atomic_load_n(&writers_done, __ATOMIC_ACQUIRE) == WRITERS;
+        Dump d;
+        dump_take(&d);
+        dumps++;
+
+        int last[WRITERS];
+        for (int w = 0; w < WRITERS; w++) {
+            last[w] = -1;
+        }
+        char *cursor = d.text;
+        char *text;
+        while ((text = dump_next(&cursor)) != NULL) {
+            int writer, n, used = 0;
+            char body[96];
+            if (sscanf(text, "w%d %d %n", &writer, &n, &used) != 2 ||
+                writer < 0 || writer >= WRITERS) {
+                torn++;
+                continue;
+            }
+            line_body(writer, n, body, sizeof(body));
+            torn += strcmp(text + used, body) != 0;
+            out_of_order += n <= last[writer];
+            last[writer] = n;
+        }
+        free(d.text);
+    } while (!done);
+
+    for (int w = 0; w < WRITERS; w++) {
+        pthread_join(threads[w], NULL);
+    }
+    CHECK(dumps > 1);
+    CHECK(torn == 0);
+    CHECK(out_of_order == 0);
+
+    // Once the writers stop every ring holds its newest lines intact
+    Dump d;
+    dump_take(&d);
+    CHECK(d.count == WRITERS * TRACE_RING_RECORDS);
+    free(d.text);
+}
+
+int main(void) {
+    trace_enable(1);
+    CHECK(trace_enabled());
+    test_ring_reuse();
+    test_wraparound();
+    test_concurrent_dump();
+    trace_enable(0);
+    CHECK(!trace_enabled());
+    return test_finish("test_trace");
+}
\ No newline at end of file
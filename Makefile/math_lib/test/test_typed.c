@@ -0,0 +1,379 @@
+#include <float.h>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../include/matrix_math.h"
+#include "../include/thread_pool.h"
+#include "../include/typed_math.h"
+#include "test_util.h"
+
+// Typed precision tests: bf16 and binary16 conversions against an exact
+// reference, and float/bf16/f16 matrix products against double products
+// of the same rounded inputs
+
+static uint32_t bits_of(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+    return u;
+}
+
+static float float_of(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+}
+
+// Exact value of a binary16 bit pattern
+static double f16_reference(f16_t h) {
+    const int exponent = h >> 10 & 0x1f;
+    const int mantissa = h & 0x3ff;
+    const double sign = h & 0x8000 ? -1.0 : 1.0;
+
+    if (exponent == 0x1f) {
+        return mantissa != 0 ? NAN : sign * INFINITY;
+    }
+    if (exponent == 0) {
+        return sign * ldexp(mantissa, -24);
+    }
+    return sign * ldexp(1024 + mantissa, exponent - 25);
+}
+
+static int f16_is_nan(f16_t h) {
+    return (h & 0x7c00) == 0x7c00 && (h & 0x3ff) != 0;
+}
+
+static int bf16_is_nan(bf16_t h) {
+    return (h & 0x7f80) == 0x7f80 && (h & 0x7f) != 0;
+}
+
+// Every pattern widens exactly and narrows back to itself
+static void test_f16_round_trip(void) {
+    int mismatches = 0;
+    for (uint32_t u = 0; u <= 0xffff; u++) {
+        const f16_t h = (f16_t)u;
+        const float x = f16_to_float(h);
+        const double expected = f16_reference(h);
+        if (f16_is_nan(h)) {
+            mismatches += !isnan(x) || !f16_is_nan(float_to_f16(x)) ||
+                          (float_to_f16(x) & 0x8000) != (h & 0x8000);
+            continue;
+        }
+        mismatches +=
+            (double)x != expected || !signbit(x) != !signbit(expected);
+        mismatches += float_to_f16(x) != h;
+    }
+    CHECK(mismatches == 0);
+}
+
+static void test_bf16_round_trip(void) {
+    int mismatches = 0;
+    for (uint32_t u = 0; u <= 0xffff; u++) {
+        const bf16_t h = (bf16_t)u;
+        const float x = bf16_to_float(h);
+        mismatches += bits_of(x) != u << 16;
+        if (bf16_is_nan(h)) {
+            mismatches += !bf16_is_nan(float_to_bf16(x));
+        } else {
+            mismatches += float_to_bf16(x) != h;
+        }
+    }
+    CHECK(mismatches == 0);
+}
+
+// Halfway between neighbouring halves rounds to the even one; one float ulp
+// either side of it rounds to the nearer one
+static void test_f16_rounding(void) {
+    int mismatches = 0;
+    for (uint32_t u = 0; u < 0x7c00; u++) {
+        const f16_t lo = (f16_t)u;
+        const f16_t hi = (f16_t)(u + 1);
+        // Above 65504 the next step up is the overflow threshold 65520
+        const double upper = hi == 0x7c00 ? 65536.0 : f16_reference(hi);
+        const float mid = (float)((f16_reference(lo) + upper) / 2.0);
+        const f16_t even = (lo & 1) == 0 ? lo : hi;
+
+        for (int s = 0; s < 2; s++) {
+            const float sign = s == 0 ? 1.0f : -1.0f;
+            const f16_t bit = s == 0 ? 0 : 0x8000;
+            mismatches += float_to_f16(sign * mid) != (even | bit);
+            mismatches +=
+                float_to_f16(sign * nextafterf(mid, 0.0f)) != (lo | bit);
+            mismatches +=
+                float_to_f16(sign * nextafterf(mid, INFINITY)) != (hi | bit);
+        }
+    }
+    CHECK(mismatches == 0);
+
+    CHECK(float_to_f16(65504.0f) == 0x7bff);
+    CHECK(float_to_f16(65520.0f) == 0x7c00);
+    CHECK(float_to_f16(1e10f) == 0x7c00);
+    CHECK(float_to_f16(-1e10f) == 0xfc00);
+    CHECK(float_to_f16(1e-10f) == 0x0000);
+    CHECK(float_to_f16(-1e-10f) == 0x8000);
+    CHECK(float_to_f16(-0.0f) == 0x8000);
+}
+
+static void test_bf16_rounding(void) {
+    int mismatches = 0;
+    for (uint32_t u = 0; u < 0x7f80; u++) {
+        const uint32_t mid = u << 16 | 0x8000u;
+        const bf16_t even = (bf16_t)((u & 1) == 0 ? u : u + 1);
+
+        for (uint32_t s = 0; s < 2; s++) {
+            const uint32_t sign = s << 31;
+            const bf16_t bit = (bf16_t)(s << 15);
+            mismatches += float_to_bf16(float_of(mid | sign)) != (even | bit);
+            mismatches += float_to_bf16(float_of((mid - 1) | sign)) !=
+                          (bf16_t)(u | bit);
+            mismatches += float_to_bf16(float_of((mid + 1) | sign)) !=
+                          (bf16_t)((u + 1) | bit);
+        }
+    }
+    CHECK(mismatches == 0);
+    CHECK(float_to_bf16(FLT_MAX) == 0x7f80);
+}
+
+static void test_special_values(void) {
+    CHECK(float_to_f16(INFINITY) == 0x7c00);
+    CHECK(float_to_f16(-INFINITY) == 0xfc00);
+    CHECK(isinf(f16_to_float(0x7c00)) && f16_to_float(0x7c00) > 0.0f);
+    CHECK(isinf(f16_to_float(0xfc00)) && f16_to_float(0xfc00) < 0.0f);
+    CHECK(float_to_bf16(INFINITY) == 0x7f80);
+    CHECK(float_to_bf16(-INFINITY) == 0xff80);
+
+    // NaNs whose payload sits only in the dropped bits stay NaN
+    static const uint32_t nans[] = {0x7fc00000u, 0x7f800001u, 0xff800001u,
+                                    0x7f801000u, 0x7fffffffu};
+    for (size_t i = 0; i < sizeof(nans) / sizeof(nans[0]); i++) {
+        const float nan = float_of(nans[i]);
+        CHECK(f16_is_nan(float_to_f16(nan)));
+        CHECK(bf16_is_nan(float_to_bf16(nan)));
+        CHECK(isnan(f16_to_float(float_to_f16(nan))));
+        CHECK(isnan(bf16_to_float(float_to_bf16(nan))));
+    }
+}
+
+// Shapes straddle MR (6), NR (16), KC (256) and NC (512)
+static const int gemm_shapes[][3] = {
+    {1, 1, 1}, {7, 17, 5}, {13, 257, 33}, {97, 1030, 260}, {31, 300, 530},
+};
+
+static const float gemm_scalars[][2] = {
+    {1.0f, 0.0f}, {2.5f, 0.0f}, {-0.5f, 1.5f}, {0.0f, -0.75f},
+};
+
+// Elements come back through the type's own rounding, so the double
+// reference sees exactly what the typed product sees
+#define DEFINE_GEMM_TEST(PREFIX, UNIT)                                       \
+    static void test_##PREFIX##_gemm(void) {                                 \
+        for (size_t s = 0; s < sizeof(gemm_shapes) / sizeof(gemm_shapes[0]); \
+             s++) {                                                          \
+            const int m = gemm_shapes[s][0];                                 \
+            const int k = gemm_shapes[s][1];                                 \
+            const int n = gemm_shapes[s][2];                                 \
+            for (size_t c = 0;                                               \
+                 c < sizeof(gemm_scalars) / sizeof(gemm_scalars[0]); c++) {  \
+                check_gemm(m, k, n, gemm_scalars[c][0], gemm_scalars[c][1],  \
+                           UNIT, PREFIX##_gemm_round_trip,                   \
+                           PREFIX##_gemm_run);                               \
+            }                                                                \
+        }                                                                    \
+    }
+
+typedef void (*RoundTrip)(Matrix *m);
+typedef int (*GemmRun)(float alpha, const Matrix *a, const Matrix *b,
+                       float beta, Matrix *c);
+
+// c = alpha * a * b + beta * c in the typed precision, with every operand
+// rounded to the element type first
+static void check_gemm(int m, int k, int n, float alpha, float beta,
+                       double unit, RoundTrip round_trip, GemmRun run) {
+    Matrix a, b, c, result;
+    CHECK_STATUS(matrix_create(m, k, &a), SUCCESS);
+    CHECK_STATUS(matrix_create(k, n, &b), SUCCESS);
+    CHECK_STATUS(matrix_create(m, n, &c), SUCCESS);
+    CHECK_STATUS(matrix_create(m, n, &result), SUCCESS);
+    test_fill_matrix(&a, (unsigned)(m * 31 + k), 0.0);
+    test_fill_matrix(&b, (unsigned)(k * 17 + n), 0.0);
+    test_fill_matrix(&c, (unsigned)(n * 7 + m), 0.0);
+    round_trip(&a);
+    round_trip(&b);
+    round_trip(&c);
+
+    // beta == 0 must overwrite C, NaNs included
+    CHECK_STATUS(matrix_copy(&c, &result), SUCCESS);
+    if (beta == 0.0f) {
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < n; j++) {
+                matrix_set(&result, i, j, NAN);
+            }
+        }
+        matrix_mark_modified(&result);
+    }
+    CHECK_STATUS(run(alpha, &a, &b, beta, &result), SUCCESS);
+
+    // Float accumulation over k terms plus one rounding to storage
+    const double depth = (k + 3) * ldexp(1.0, -24);
+    int bad = 0;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            double sum = 0.0;
+            double magnitude = 0.0;
+            for (int p = 0; p < k; p++) {
+                double t = (double)alpha * matrix_get(&a, i, p) *
+                           matrix_get(&b, p, j);
+                sum += t;
+                magnitude += fabs(t);
+            }
+            if (beta != 0.0f) {
+                double t = (double)beta * matrix_get(&c, i, j);
+                sum += t;
+                magnitude += fabs(t);
+            }
+            double got = matrix_get(&result, i, j);
+            double tolerance = 2.0 * unit * fabs(sum) + depth * magnitude;
+            bad += !(fabs(got - sum) <= tolerance);
+        }
+    }
+    CHECK(bad == 0);
+    if (bad != 0) {
+        fprintf(stderr, "  %dx%dx%d alpha %g beta %g: %d elements off\n", m,
+                k, n, alpha, beta, bad);
+    }
+
+    matrix_free(&a);
+    matrix_free(&b);
+    matrix_free(&c);
+    matrix_free(&result);
+}
+
+#define DEFINE_GEMM_HELPERS(PREFIX, MATRIX_TYPE)                              \
+    static void PREFIX##_gemm_round_trip(Matrix *m) {                         \
+        MATRIX_TYPE t;                                                        \
+        CHECK_STATUS(matrix_##PREFIX##_create(m->rows, m->cols, &t),          \
+                     SUCCESS);                                                \
+        CHECK_STATUS(matrix_##PREFIX##_from_double(m, &t), SUCCESS);          \
+        CHECK_STATUS(matrix_##PREFIX##_to_double(&t, m), SUCCESS);            \
+        matrix_##PREFIX##_free(&t);                                           \
+    }                                                                         \
+                                                                              \
+    static int PREFIX##_gemm_run(float alpha, const Matrix *a,                \
+                                 const Matrix *b, float beta, Matrix *c) {    \
+        MATRIX_TYPE ta, tb, tc;                                               \
+        CHECK_STATUS(matrix_##PREFIX##_create(a->rows, a->cols, &ta),         \
+                     SUCCESS);                                                \
+        CHECK_STATUS(matrix_##PREFIX##_create(b->rows, b->cols, &tb),         \
+                     SUCCESS);                                                \
+        CHECK_STATUS(matrix_##PREFIX##_create(c->rows, c->cols, &tc),         \
+                     SUCCESS);                                                \
+        CHECK_STATUS(matrix_##PREFIX##_from_double(a, &ta), SUCCESS);         \
+        CHECK_STATUS(matrix_##PREFIX##_from_double(b, &tb), SUCCESS);         \
+        CHECK_STATUS(matrix_##PREFIX##_from_double(c, &tc), SUCCESS);         \
+        int status =                                                          \
+            matrix_##PREFIX##_multiply_into(alpha, &ta, &tb, beta, &tc);      \
+        CHECK_STATUS(matrix_##PREFIX##_to_double(&tc, c), SUCCESS);           \
+        matrix_##PREFIX##_free(&ta);                                          \
+        matrix_##PREFIX##_free(&tb);                                          \
+        matrix_##PREFIX##_free(&tc);                                          \
+        return status;                                                        \
+    }
+
+DEFINE_GEMM_HELPERS(f32, MatrixF32)
+DEFINE_GEMM_HELPERS(bf16, MatrixBF16)
+DEFINE_GEMM_HELPERS(f16, MatrixF16)
+
+// Unit roundoff of each storage format
+DEFINE_GEMM_TEST(f32, 0x1p-24)
+DEFINE_GEMM_TEST(bf16, 0x1p-9)
+DEFINE_GEMM_TEST(f16, 0x1p-11)
+
+static void test_gemm_errors(void) {
+    MatrixF16 a, b, c;
+    CHECK_STATUS(matrix_f16_create(4, 5, &a), SUCCESS);
+    CHECK_STATUS(matrix_f16_create(6, 3, &b), SUCCESS);
+    CHECK_STATUS(matrix_f16_create(4, 3, &c), SUCCESS);
+    CHECK_STATUS(matrix_f16_multiply_into(1.0f, &a, &b, 0.0f, &c),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(matrix_f16_multiply_into(1.0f, NULL, &b, 0.0f, &c),
+                 ERROR_NULL_POINTER);
+    matrix_f16_free(&a);
+    matrix_f16_free(&b);
+    matrix_f16_free(&c);
+}
+
+// Typed matrices have no views of their own; views enter and leave through
+// the double conversions, which follow the view's logical layout
+static void test_view_conversions(void) {
+    Matrix m, transposed, copy, block, back;
+    MatrixBF16 from_view, from_copy;
+    CHECK_STATUS(matrix_create(9, 14, &m), SUCCESS);
+    test_fill_matrix(&m, 77, 0.0);
+
+    CHECK_STATUS(matrix_transpose_view(&m, &transposed), SUCCESS);
+    CHECK_STATUS(matrix_transpose(&m, &copy), SUCCESS);
+    CHECK_STATUS(matrix_bf16_create(14, 9, &from_view), SUCCESS);
+    CHECK_STATUS(matrix_bf16_create(14, 9, &from_copy), SUCCESS);
+    CHECK_STATUS(matrix_bf16_from_double(&transposed, &from_view), SUCCESS);
+    CHECK_STATUS(matrix_bf16_from_double(&copy, &from_copy), SUCCESS);
+    int same = 1;
+    for (int i = 0; i < 14; i++) {
+        same &= memcmp(from_view.data + (size_t)i * from_view.stride,
+                       from_copy.data + (size_t)i * from_copy.stride,
+                       9 * sizeof(bf16_t)) == 0;
+    }
+    CHECK(same);
+
+    // Writing through a block view leaves the rest of the parent alone
+    CHECK_STATUS(matrix_create(9, 14, &back), SUCCESS);
+    CHECK_STATUS(matrix_copy(&m, &back), SUCCESS);
+    CHECK_STATUS(matrix_view(&back, 2, 3, 5, 4, &block), SUCCESS);
+    MatrixF16 small;
+    CHECK_STATUS(matrix_f16_create(5, 4, &small), SUCCESS);
+    CHECK_STATUS(matrix_f16_from_double(&block, &small), SUCCESS);
+    CHECK_STATUS(matrix_f16_to_double(&small, &block), SUCCESS);
+    double diff = 0.0;
+    int outside = 1;
+    for (int i = 0; i < 9; i++) {
+        for (int j = 0; j < 14; j++) {
+            double d = fabs(matrix_get(&back, i, j) - matrix_get(&m, i, j));
+            if (i >= 2 && i < 7 && j >= 3 && j < 7) {
+                diff = fmax(diff, d);
+            } else {
+                outside &= d == 0.0;
+            }
+        }
+    }
+    CHECK(outside);
+    CHECK(diff <= 0x1p-12);
+
+    matrix_f16_free(&small);
+    matrix_bf16_free(&from_view);
+    matrix_bf16_free(&from_copy);
+    matrix_free(&copy);
+    matrix_free(&back);
+    matrix_free(&m);
+}
+
+static void test_gemm_all(void) {
+    test_f32_gemm();
+    test_bf16_gemm();
+    test_f16_gemm();
+    test_gemm_errors();
+}
+
+int main(void) {
+    test_f16_round_trip();
+    test_bf16_round_trip();
+    test_f16_rounding();
+    test_bf16_rounding();
+    test_special_values();
+    test_view_conversions();
+
+    // Inline, then split across pool workers
+    test_gemm_all();
+    CHECK_STATUS(thread_pool_init(4, 0), SUCCESS);
+    test_gemm_all();
+    thread_pool_shutdown();
+    return test_finish("test_typed");
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#ifndef TEST_UTIL_H
+#define TEST_UTIL_H
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../include/matrix_math.h"
+
+// Minimal check helpers shared by the test programs
+// A failed check prints its location and the test carries on, so one run
+// reports every failure. test_finish returns the exit status for main.
+
+static int test_checks;
+static int test_failures;
+
+#define CHECK(cond)                                                    \
+    do {                                                               \
+        test_checks++;                                                 \
+        if (!(cond)) {                                                 \
+            test_failures++;                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,     \
+                    __LINE__, #cond);                                  \
+        }                                                              \
+    } while (0)
+
+#define CHECK_STATUS(expr, expected) CHECK((expr) == (expected))
+
+static inline int test_finish(const char *name) {
+    printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+// Deterministic values in [-0.5, 0.5); with dominance added to the
+// diagonal a square matrix is well conditioned
+static inline void test_fill_matrix(Matrix *m, unsigned seed,
+                                    double dominance) {
+    for (int i = 0; i < m->rows; i++) {
+        for (int j = 0; j < m->cols; j++) {
+            seed = seed * 1103515245u + 12345u;
+            double value = (double)(seed >> 16 & 0x7fff) / 32768.0 - 0.5;
+            matrix_set(m, i, j, i == j ? value + dominance : value);
+        }
+    }
+    matrix_mark_modified(m);
+}
+
+static inline void test_fill_vector(Vector *v, unsigned seed) {
+    for (int i = 0; i < v->size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        v->data[i] = (double)(seed >> 16 & 0x7fff) / 32768.0 - 0.5;
+    }
+}
+
+// Logical elements compared bit for bit
+static inline int test_matrix_equal(const Matrix *a, const Matrix *b) {
+    if (a->rows != b->rows || a->cols != b->cols) {
+        return 0;
+    }
+    for (int i = 0; i < a->rows; i++) {
+        for (int j = 0; j < a->cols; j++) {
+            double x = matrix_get(a, i, j);
+            double y = matrix_get(b, i, j);
+            if (memcmp(&x, &y, sizeof(double)) != 0) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+static inline double test_max_abs_diff(const Matrix *a, const Matrix *b) {
+    double max = 0.0;
+    for (int i = 0; i < a->rows; i++) {
+        for (int j = 0; j < a->cols; j++) {
+            double d = fabs(matrix_get(a, i, j) - matrix_get(b, i, j));
+            if (d > max || d != d) {
+                max = d;
+            }
+        }
+    }
+    return max;
+}
+
+#endif  // TEST_UTIL_H
\ No newline at end of file
@@ -0,0 +1,264 @@
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "../include/trace_log.h"
+#include "../include/vector_math.h"
+#include "test_util.h"
+
+// Reduction mode tests: ill-conditioned sums and dot products that only
+// the compensated mode gets exactly, magnitudes outside the range of the
+// sum of squares, and one trace line per call
+
+static const ReductionMode modes[] = {REDUCTION_FAST, REDUCTION_PAIRWISE,
+                                      REDUCTION_COMPENSATED};
+#define MODE_COUNT (int)(sizeof(modes) / sizeof(modes[0]))
+
+// Sizes around the pairwise block (256) and the SIMD lane counts
+static const int sizes[] = {1, 3, 8, 31, 256, 257, 1000, 4099};
+#define SIZE_COUNT (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+static long double reference_dot(const Vector *a, const Vector *b) {
+    long double sum = 0.0L;
+    for (int i = 0; i < a->size; i++) {
+        sum += (long double)a->data[i] * b->data[i];
+    }
+    return sum;
+}
+
+// Well-conditioned data: every mode agrees with the long double reference,
+// and FAST is bitwise the unmoded call
+static void test_agreement(void) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        const int n = sizes[s];
+        Vector a, b, ones;
+        CHECK_STATUS(vector_create(n, &a), SUCCESS);
+        CHECK_STATUS(vector_create(n, &b), SUCCESS);
+        CHECK_STATUS(vector_create(n, &ones), SUCCESS);
+        test_fill_vector(&a, 3 + (unsigned)s);
+        test_fill_vector(&b, 70 + (unsigned)s);
+        for (int i = 0; i < n; i++) {
+            ones.data[i] = 1.0;
+        }
+        const double sum_ref = (double)reference_dot(&a, &ones);
+        const double dot_ref = (double)reference_dot(&a, &b);
+        const double mag_ref = sqrt((double)reference_dot(&a, &a));
+        const double tolerance = 1e-15 * (n + 1);
+
+        for (int m = 0; m < MODE_COUNT; m++) {
+            double sum, dot, magnitude;
+            CHECK_STATUS(vector_sum_mode(&a, modes[m], &sum), SUCCESS);
+            CHECK_STATUS(vector_dot_product_mode(&a, &b, modes[m], &dot),
+                         SUCCESS);
+            CHECK_STATUS(vector_magnitude_mode(&a, modes[m], &magnitude),
+                         SUCCESS);
+            CHECK(fabs(sum - sum_ref) <= tolerance);
+            CHECK(fabs(dot - dot_ref) <= tolerance);
+            CHECK(fabs(magnitude - mag_ref) <= tolerance);
+            if (modes[m] == REDUCTION_COMPENSATED) {
+                CHECK(sum == sum_ref);
+                CHECK(dot == dot_ref);
+            }
+        }
+
+        double fast, plain;
+        CHECK_STATUS(vector_sum_mode(&a, REDUCTION_FAST, &fast), SUCCESS);
+        CHECK_STATUS(vector_sum(&a, &plain), SUCCESS);
+        CHECK(fast == plain);
+        CHECK_STATUS(vector_dot_product_mode(&a, &b, REDUCTION_FAST, &fast),
+                     SUCCESS);
+        CHECK_STATUS(vector_dot_product(&a, &b, &plain), SUCCESS);
+        CHECK(fast == plain);
+        CHECK_STATUS(vector_magnitude_mode(&a, REDUCTION_FAST, &fast),
+                     SUCCESS);
+        CHECK_STATUS(vector_magnitude(&a, &plain), SUCCESS);
+        CHECK(fast == plain);
+
+        vector_free(&a);
+        vector_free(&b);
+        vector_free(&ones);
+    }
+}
+
+// Powers of two up to 2^60, ones, the negated powers, and ones again, each
+// a quarter of the vector: every partial sum of the large terms is exact,
+// so the only error is losing the first ones, which FAST and PAIRWISE do
+// and COMPENSATED must not
+static void test_ill_conditioned_sum(void) {
+    const int n = 2048;
+    const int quarter = n / 4;
+    Vector v;
+    CHECK_STATUS(vector_create(n, &v), SUCCESS);
+    for (int i = 0; i < quarter; i++) {
+        const double big = ldexp(1.0, 40 + i % 21);
+        v.data[i] = big;
+        v.data[quarter + i] = 1.0;
+        v.data[2 * quarter + i] = -big;
+        v.data[3 * quarter + i] = 1.0;
+    }
+    const double exact = n / 2;
+
+    double fast, pairwise, compensated;
+    CHECK_STATUS(vector_sum_mode(&v, REDUCTION_FAST, &fast), SUCCESS);
+    CHECK_STATUS(vector_sum_mode(&v, REDUCTION_PAIRWISE, &pairwise),
+                 SUCCESS);
+    CHECK_STATUS(vector_sum_mode(&v, REDUCTION_COMPENSATED, &compensated),
+                 SUCCESS);
+    CHECK(compensated == exact);
+    CHECK(fast != exact);
+    CHECK(pairwise != exact);
+    vector_free(&v);
+}
+
+// (1 + 2^-30)(1 - 2^-30) = 1 - 2^-60 rounds to 1, and the -1 terms cancel
+// those ones: the exact dot product, -count * 2^-60, is left entirely in
+// the rounding errors of the products
+static void test_ill_conditioned_dot(void) {
+    const int n = 2048;
+    Vector a, b;
+    CHECK_STATUS(vector_create(n, &a), SUCCESS);
+    CHECK_STATUS(vector_create(n, &b), SUCCESS);
+    for (int i = 0; i < n / 2; i++) {
+        a.data[i] = 1.0 + ldexp(1.0, -30);
+        b.data[i] = 1.0 - ldexp(1.0, -30);
+        a.data[n / 2 + i] = -1.0;
+        b.data[n / 2 + i] = 1.0;
+    }
+    const double exact = -ldexp(n / 2, -60);
+
+    double fast, pairwise, compensated;
+    CHECK_STATUS(vector_dot_product_mode(&a, &b, REDUCTION_FAST, &fast),
+                 SUCCESS);
+    CHECK_STATUS(vector_dot_product_mode(&a, &b, REDUCTION_PAIRWISE,
+                                         &pairwise),
+                 SUCCESS);
+    CHECK_STATUS(vector_dot_product_mode(&a, &b, REDUCTION_COMPENSATED,
+                                         &compensated),
+                 SUCCESS);
+    CHECK(compensated == exact);
+    CHECK(fast != exact);
+    CHECK(pairwise != exact);
+    vector_free(&a);
+    vector_free(&b);
+}
+
+// Squares that overflow or underflow take the rescaling fallback in every
+// mode; infinities and NaNs come through as they do in vector_magnitude
+static void test_magnitude_range(void) {
+    static const double scales[] = {1e200, 1e-200, DBL_MAX / 64,
+                                    DBL_MIN * 1e-6};
+    const int n = 1000;
+    for (int s = 0; s < (int)(sizeof(scales) / sizeof(scales[0])); s++) {
+        Vector v;
+        CHECK_STATUS(vector_create(n, &v), SUCCESS);
+        test_fill_vector(&v, 90 + (unsigned)s);
+        long double unit = 0.0L;
+        for (int i = 0; i < n; i++) {
+            unit += (long double)v.data[i] * v.data[i];
+            v.data[i] *= scales[s];
+        }
+        // Subnormal elements keep only part of their significand
+        const double relative = scales[s] < DBL_MIN ? 1e-8 : 1e-14;
+        const double expected = sqrt((double)unit) * scales[s];
+
+        double plain;
+        CHECK_STATUS(vector_magnitude(&v, &plain), SUCCESS);
+        CHECK(isfinite(plain) && plain > 0.0);
+        for (int m = 0; m < MODE_COUNT; m++) {
+            double magnitude;
+            CHECK_STATUS(vector_magnitude_mode(&v, modes[m], &magnitude),
+                         SUCCESS);
+            CHECK(magnitude == plain);
+            CHECK(fabs(magnitude - expected) <= relative * expected);
+        }
+        vector_free(&v);
+    }
+
+    Vector v;
+    CHECK_STATUS(vector_create(37, &v), SUCCESS);
+    test_fill_vector(&v, 99);
+    v.data[20] = -INFINITY;
+    for (int m = 0; m < MODE_COUNT; m++) {
+        double magnitude;
+        CHECK_STATUS(vector_magnitude_mode(&v, modes[m], &magnitude),
+                     SUCCESS);
+        CHECK(magnitude == INFINITY);
+    }
+    v.data[7] = NAN;
+    for (int m = 0; m < MODE_COUNT; m++) {
+        double magnitude, sum;
+        CHECK_STATUS(vector_magnitude_mode(&v, modes[m], &magnitude),
+                     SUCCESS);
+        CHECK_STATUS(vector_sum_mode(&v, modes[m], &sum), SUCCESS);
+        CHECK(isnan(sum));
+    }
+    vector_free(&v);
+}
+
+static void test_errors(void) {
+    Vector a, b;
+    double result;
+    CHECK_STATUS(vector_create(4, &a), SUCCESS);
+    CHECK_STATUS(vector_create(5, &b), SUCCESS);
+    CHECK_STATUS(vector_sum_mode(NULL, REDUCTION_PAIRWISE, &result),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_sum_mode(&a, REDUCTION_PAIRWISE, NULL),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_magnitude_mode(NULL, REDUCTION_FAST, &result),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_magnitude_mode(NULL, REDUCTION_COMPENSATED, &result),
+                 ERROR_NULL_POINTER);
+    CHECK_STATUS(vector_dot_product_mode(&a, &b, REDUCTION_COMPENSATED,
+                                         &result),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_sum_mode(&a, (ReductionMode)7, &result),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_dot_product_mode(&a, &a, (ReductionMode)7, &result),
+                 ERROR_INVALID_DIMENSION);
+    CHECK_STATUS(vector_magnitude_mode(&a, (ReductionMode)7, &result),
+                 ERROR_INVALID_DIMENSION);
+    vector_free(&a);
+    vector_free(&b);
+}
+
+// Each call leaves exactly one line in the trace log
+static void test_trace_lines(void) {
+    Vector v;
+    CHECK_STATUS(vector_create(16, &v), SUCCESS);
+    test_fill_vector(&v, 5);
+    FILE *out = fopen("/dev/null", "w");
+    CHECK(out != NULL);
+    trace_enable(1);
+    for (int m = 0; m < MODE_COUNT; m++) {
+        double result;
+        trace_clear();
+        CHECK_STATUS(vector_sum_mode(&v, modes[m], &result), SUCCESS);
+        CHECK(trace_dump(out) == 1);
+        trace_clear();
+        CHECK_STATUS(vector_magnitude_mode(&v, modes[m], &result), SUCCESS);
+        CHECK(trace_dump(out) == 1);
+        trace_clear();
+        CHECK_STATUS(vector_dot_product_mode(&v, &v, modes[m], &result),
+                     SUCCESS);
+        CHECK(trace_dump(out) == 1);
+    }
+    double result;
+    trace_clear();
+    CHECK_STATUS(vector_sum(&v, &result), SUCCESS);
+    CHECK(trace_dump(out) == 1);
+    trace_enable(0);
+    if (out != NULL) {
+        fclose(out);
+    }
+    vector_free(&v);
+}
+
+int main(void) {
+    test_agreement();
+    test_ill_conditioned_sum();
+    test_ill_conditioned_dot();
+    test_magnitude_range();
+    test_errors();
+    test_trace_lines();
+    return test_finish("test_vector");
+}
\ No newline at end of file